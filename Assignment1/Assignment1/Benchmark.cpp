@@ -0,0 +1,89 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "../Common/CBenchmark.h"
+
+#include "CSimpleArraysTask.h"
+#include "CStreamingArraysTask.h"
+#include "CMatrixRotateTask.h"
+#include "CMatrixPermuteTask.h"
+#include "CMatrixRotateBatchTask.h"
+
+#include <iostream>
+
+using namespace std;
+
+// Benchmark runner for the tasks of assignment 1, see CBenchmarkRunner for the options.
+int main(int argc, char** argv)
+{
+	CBenchmarkRunner runner;
+
+	runner.RegisterTask("vecadd",
+		[](const BenchmarkCase& Case) -> IComputeTask* { return new CSimpleArraysTask(Case.Size); },
+		{ 1 << 11, 1 << 15, 1 << 20, 1 << 25 }, { 16, 1, 1, 64, 1, 1, 256, 1, 1, 1024, 1, 1 });
+
+	// chunks of 2M elements, the variant is the number of buffer sets
+	runner.RegisterTask("vecadd_stream",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			if(Case.Variant == "double")
+				return new CStreamingArraysTask(Case.Size, 1 << 21, 2);
+			if(Case.Variant == "triple")
+				return new CStreamingArraysTask(Case.Size, 1 << 21, 3);
+			return nullptr;
+		},
+		{ 1 << 22, 1 << 25, 1 << 27 }, { 256, 1, 1 },
+		{ "double", "triple" });
+
+	// the size is the width of the matrix, it has half as many rows
+	// (both kernels run in each case, they are reported separately)
+	runner.RegisterTask("rotate",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			if(Case.Size < 2)
+				return nullptr;
+			return new CMatrixRotateTask(Case.Size, Case.Size / 2);
+		},
+		{ 1024, 2048, 4096 }, { 16, 16, 1, 32, 16, 1, 32, 8, 1 });
+
+	// the variant is the permutation, the matrix has half as many rows as columns
+	runner.RegisterTask("permute",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			EPermutation permutation;
+			if(Case.Size < 2 || !CMatrixPermuteTask::ParsePermutation(Case.Variant, permutation))
+				return nullptr;
+			return new CMatrixPermuteTask(Case.Size, Case.Size / 2, permutation);
+		},
+		{ 1024, 2048, 4096 }, { 8, 8, 1, 16, 16, 1 },
+		{ "transpose", "rot90", "rot180", "rot270", "flip_h", "flip_v" });
+
+	// the size is the width and height of the matrices, the batch holds about 4M elements;
+	// "varying" alternates between full and half size matrices
+	runner.RegisterTask("rotate_batched",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			if(Case.Size < 2)
+				return nullptr;
+			size_t batchSize = (1 << 22) / (Case.Size * Case.Size);
+			if(Case.Variant == "uniform")
+				return new CMatrixRotateBatchTask(batchSize, Case.Size, Case.Size);
+			if(Case.Variant != "varying")
+				return nullptr;
+			vector<CMatrixRotateBatchTask::MatrixSize> sizes;
+			for(size_t i = 0; i < batchSize; i++) {
+				size_t size = (i % 2) ? Case.Size / 2 : Case.Size;
+				sizes.push_back({ size, size });
+			}
+			return new CMatrixRotateBatchTask(sizes);
+		},
+		{ 32, 64, 128, 256 }, { 8, 8, 1, 16, 16, 1 },
+		{ "uniform", "varying" });
+
+	auto success = runner.EnterMainLoop(argc, argv);
+
+#ifdef _MSC_VER
+	cout << "Press 'Enter'..." << endl;
+	cin.get();
+#endif
+
+	return success ? 0 : 1;
+}
@@ -6,7 +6,10 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CAssignment1.h"
 
 #include "CSimpleArraysTask.h"
+#include "CStreamingArraysTask.h"
 #include "CMatrixRotateTask.h"
+#include "CMatrixPermuteTask.h"
+#include "CMatrixRotateBatchTask.h"
 
 #include <iostream>
 
@@ -29,6 +32,20 @@ bool CAssignment1::DoCompute()
 		}
 
 	}
+
+	// a size which is no multiple of the vector widths tests the tail handling of the vector kernels
+	{
+		size_t localWorkSize[3] = { 256, 1, 1 };
+		CSimpleArraysTask task((1 << 20) + 3);
+		RunComputeTask(task, localWorkSize);
+	}
+
+	// the same addition streamed through the device in chunks, the last chunk is incomplete
+	{
+		size_t localWorkSize[3] = { 256, 1, 1 };
+		CStreamingArraysTask task((1 << 25) + 5, 1 << 21);
+		RunComputeTask(task, localWorkSize);
+	}
 	
 	if (false){
 		// skip those
@@ -59,6 +76,42 @@ bool CAssignment1::DoCompute()
 		RunComputeTask(task, LocalWorkSize);
 	}
 
+	// Generalized permutations, on sizes which are no multiple of the tile size
+	std::cout << std::endl << std::endl << "Running matrix permutation example..." << std::endl << std::endl;
+	for (int p = 0; p < NUM_PERMUTATIONS; p++) {
+		size_t LocalWorkSize[3] = {16, 16, 1};
+		CMatrixPermuteTask task(2047, 1023, EPermutation(p));
+		RunComputeTask(task, LocalWorkSize);
+	}
+	for (int p = 0; p < NUM_PERMUTATIONS; p++) {
+		size_t LocalWorkSize[3] = {16, 16, 1};
+		CMatrixPermuteTask task(1025, 1025, EPermutation(p), ELEMENT_FLOAT, true);
+		RunComputeTask(task, LocalWorkSize);
+	}
+	{
+		size_t LocalWorkSize[3] = {16, 16, 1};
+		CMatrixPermuteTask intTask(2048, 1024, PERMUTE_TRANSPOSE, ELEMENT_INT);
+		RunComputeTask(intTask, LocalWorkSize);
+		CMatrixPermuteTask halfTask(2048, 1024, PERMUTE_TRANSPOSE, ELEMENT_HALF);
+		RunComputeTask(halfTask, LocalWorkSize);
+	}
+
+	// Many small matrices, rotated in a single launch and compared with one launch per matrix
+	std::cout << std::endl << std::endl << "Running batched matrix rotation example..." << std::endl << std::endl;
+	{
+		size_t LocalWorkSize[3] = {16, 16, 1};
+		CMatrixRotateBatchTask task(1024, 32, 32);
+		RunComputeTask(task, LocalWorkSize);
+	}
+	{
+		size_t LocalWorkSize[3] = {16, 16, 1};
+		vector<CMatrixRotateBatchTask::MatrixSize> sizes;
+		for (size_t i = 0; i < 512; i++)
+			sizes.push_back({ 8 + (i * 7) % 57, 8 + (i * 13) % 41 });
+		CMatrixRotateBatchTask task(sizes);
+		RunComputeTask(task, LocalWorkSize);
+	}
+
 	return true;
 }
 
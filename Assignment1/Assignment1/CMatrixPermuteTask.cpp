@@ -0,0 +1,278 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CMatrixPermuteTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CHostMatrix.h"
+#include "../Common/CThreadPool.h"
+#include "../Common/CTrace.h"
+
+#include <sstream>
+#include <string.h>
+
+using namespace std;
+
+// position of the input element (x, y) of a W x H matrix in the permuted matrix (see MatrixPermute.cl)
+static void PermutePosition(EPermutation Permutation, unsigned int x, unsigned int y, unsigned int W, unsigned int H,
+	unsigned int& OutX, unsigned int& OutY)
+{
+	switch (Permutation) {
+		case PERMUTE_TRANSPOSE:			OutX = y;			OutY = x;			break;
+		case PERMUTE_ROTATE_90:			OutX = H - 1 - y;	OutY = x;			break;
+		case PERMUTE_ROTATE_180:		OutX = W - 1 - x;	OutY = H - 1 - y;	break;
+		case PERMUTE_ROTATE_270:		OutX = y;			OutY = W - 1 - x;	break;
+		case PERMUTE_FLIP_HORIZONTAL:	OutX = W - 1 - x;	OutY = y;			break;
+		default:						OutX = x;			OutY = H - 1 - y;	break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CMatrixPermuteTask
+
+CMatrixPermuteTask::CMatrixPermuteTask(size_t SizeX, size_t SizeY, EPermutation Permutation,
+	EElementType ElementType, bool InPlace)
+	: m_SizeX(static_cast<unsigned>(SizeX)), m_SizeY(static_cast<unsigned>(SizeY)),
+	m_Permutation(Permutation), m_ElementType(ElementType), m_InPlace(InPlace),
+	m_hM(NULL), m_hMR(NULL), m_hGPUResult(NULL), m_dM(NULL), m_dMR(NULL),
+	m_Program(NULL), m_Kernel(NULL)
+{
+	memset(m_TunedLocalWorkSize, 0, sizeof(m_TunedLocalWorkSize));
+}
+
+CMatrixPermuteTask::~CMatrixPermuteTask()
+{
+	ReleaseResources();
+}
+
+const char* CMatrixPermuteTask::GetPermutationName(EPermutation Permutation)
+{
+	switch (Permutation) {
+		case PERMUTE_TRANSPOSE:			return "transpose";
+		case PERMUTE_ROTATE_90:			return "rot90";
+		case PERMUTE_ROTATE_180:		return "rot180";
+		case PERMUTE_ROTATE_270:		return "rot270";
+		case PERMUTE_FLIP_HORIZONTAL:	return "flip_h";
+		case PERMUTE_FLIP_VERTICAL:		return "flip_v";
+		default:						return "unknown";
+	}
+}
+
+const char* CMatrixPermuteTask::GetElementTypeName(EElementType ElementType)
+{
+	switch (ElementType) {
+		case ELEMENT_INT:	return "int";
+		case ELEMENT_HALF:	return "half";
+		default:			return "float";
+	}
+}
+
+bool CMatrixPermuteTask::ParsePermutation(const std::string& Name, EPermutation& Permutation)
+{
+	for (int p = 0; p < NUM_PERMUTATIONS; p++) {
+		if (Name == GetPermutationName(EPermutation(p))) {
+			Permutation = EPermutation(p);
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t CMatrixPermuteTask::GetElementSize() const
+{
+	return m_ElementType == ELEMENT_HALF ? sizeof(cl_half) : sizeof(cl_float);
+}
+
+unsigned int CMatrixPermuteTask::GetOutputWidth() const
+{
+	bool transposing = (m_Permutation == PERMUTE_TRANSPOSE || m_Permutation == PERMUTE_ROTATE_90
+		|| m_Permutation == PERMUTE_ROTATE_270);
+	return transposing ? m_SizeY : m_SizeX;
+}
+
+string CMatrixPermuteTask::GetName() const
+{
+	string name = string("Permute_") + GetPermutationName(m_Permutation) + "_" + GetElementTypeName(m_ElementType);
+	return m_InPlace ? name + "_inplace" : name;
+}
+
+bool CMatrixPermuteTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	if (m_InPlace && m_SizeX != m_SizeY) {
+		cerr << "In-place permutation requires a square matrix (" << m_SizeX << "x" << m_SizeY << ")" << endl;
+		return false;
+	}
+
+	size_t bytes = GetElementSize() * m_SizeX * m_SizeY;
+
+	//CPU resources (the arrays shared with the device are aligned for zero-copy buffers)
+	m_hM = CLUtil::AllocHostArray<unsigned char>(bytes);
+	m_hMR = new unsigned char[bytes];
+	m_hGPUResult = CLUtil::AllocHostArray<unsigned char>(bytes);
+
+	//fill the matrix with random bits, the kernels only move the elements
+	for (size_t i = 0; i < bytes; i++) {
+		m_hM[i] = (unsigned char)(rand() & 0xff);
+	}
+
+	cl_int clError;
+	if (m_InPlace) {
+		// the input is uploaded from m_hM before every run, the buffer holds the result
+		m_dM = CreateHostBuffer(Context, CL_MEM_READ_WRITE, bytes, m_hGPUResult, &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+	} else {
+		m_dM = CreateHostBuffer(Context, CL_MEM_READ_ONLY, bytes, m_hM, &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+		m_dMR = CreateHostBuffer(Context, CL_MEM_WRITE_ONLY, bytes, m_hGPUResult, &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+	}
+
+	// the element type and the permutation are compile-time parameters
+	string programCode;
+	if (!CLUtil::LoadProgramSourceToMemory("../Assignment1/MatrixPermute.cl", programCode)) {
+		return false;
+	}
+
+	const char* typeName = m_ElementType == ELEMENT_HALF ? "ushort" : GetElementTypeName(m_ElementType);
+	ostringstream options;
+	options << "-D T=" << typeName << " -D PERMUTATION=" << int(m_Permutation);
+	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode, options.str());
+	if (m_Program == nullptr) return false;
+
+	int sizeX = m_SizeX, sizeY = m_SizeY;
+	if (m_InPlace) {
+		m_Kernel = clCreateKernel(m_Program, "PermuteInPlace", &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create kernel: PermuteInPlace");
+
+		clError = clSetKernelArg(m_Kernel, 0, sizeof(cl_mem), (void*)&m_dM);
+		clError |= clSetKernelArg(m_Kernel, 1, sizeof(cl_int), (void*)&sizeX);
+		V_RETURN_FALSE_CL(clError, "Failed to set kernel args: PermuteInPlace");
+	} else {
+		m_Kernel = clCreateKernel(m_Program, "Permute", &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create kernel: Permute");
+
+		clError = clSetKernelArg(m_Kernel, 0, sizeof(cl_mem), (void*)&m_dM);
+		clError |= clSetKernelArg(m_Kernel, 1, sizeof(cl_mem), (void*)&m_dMR);
+		clError |= clSetKernelArg(m_Kernel, 2, sizeof(cl_int), (void*)&sizeX);
+		clError |= clSetKernelArg(m_Kernel, 3, sizeof(cl_int), (void*)&sizeY);
+		V_RETURN_FALSE_CL(clError, "Failed to set kernel args: Permute");
+	}
+
+	// the in-place kernel changes the matrix, it is uploaded again before the validated run
+	CAutoTuner::Request request(GetName(), m_Kernel, 2, m_SizeX, m_SizeY);
+	if (!m_InPlace) {
+		request.Prepare = [this](const size_t LocalWorkSize[3]) {
+			return LocalWorkSize[0] == LocalWorkSize[1] && SetTileSize(LocalWorkSize[0]);
+		};
+	}
+	TuneLocalWorkSize(request, m_TunedLocalWorkSize);
+
+	return true;
+}
+
+void CMatrixPermuteTask::ReleaseResources()
+{
+	ReleaseBuffer(m_dM);
+	ReleaseBuffer(m_dMR);
+
+	SAFE_RELEASE_KERNEL(m_Kernel);
+	SAFE_RELEASE_PROGRAM(m_Program);
+
+	//CPU resources (after the buffers, which might use them)
+	CLUtil::FreeHostArray(m_hM);
+	SAFE_DELETE_ARRAY(m_hMR);
+	CLUtil::FreeHostArray(m_hGPUResult);
+}
+
+bool CMatrixPermuteTask::SetTileSize(size_t TileSize)
+{
+	return clSetKernelArg(m_Kernel, 4, TileSize * (TileSize + 1) * GetElementSize(), NULL) == CL_SUCCESS;
+}
+
+void CMatrixPermuteTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	size_t bytes = GetElementSize() * m_SizeX * m_SizeY;
+
+	cl_int clErr;
+	{
+		CScopedTimer timer("WriteBuffers");
+		clErr = CLUtil::UploadBuffer(CommandQueue, m_dM, bytes, m_hM, m_TransferPolicy, CL_TRUE);
+		V_RETURN_CL(clErr, "Error copying data from host to device");
+	}
+
+	// the tiles are square
+	size_t localWorkSize[2];
+	if (m_TunedLocalWorkSize[0] > 0) {
+		localWorkSize[0] = m_TunedLocalWorkSize[0];
+		localWorkSize[1] = m_TunedLocalWorkSize[1];
+	} else {
+		localWorkSize[0] = LocalWorkSize[0];
+		localWorkSize[1] = m_InPlace ? LocalWorkSize[1] : LocalWorkSize[0];
+	}
+	if (!m_InPlace && !SetTileSize(localWorkSize[0])) {
+		cerr << "Failed to set kernel args: Permute (tile of " << localWorkSize[0] << "x" << localWorkSize[0] << ")" << endl;
+		return;
+	}
+
+	size_t globalWorkSize[2];
+	globalWorkSize[0] = CLUtil::GetGlobalWorkSize(m_SizeX, localWorkSize[0]);
+	globalWorkSize[1] = CLUtil::GetGlobalWorkSize(m_SizeY, localWorkSize[1]);
+
+	cout << GetName() << ": " << m_SizeX << "x" << m_SizeY << " in groups of size "
+		<< localWorkSize[0] << "x" << localWorkSize[1] << endl;
+
+	double ms = CLUtil::ProfileKernel(CommandQueue, m_Kernel, 2, globalWorkSize, localWorkSize, 100);
+	CLUtil::PrintBandwidth(GetName(), 2 * bytes, ms);
+
+	if (m_InPlace) {
+		// every profiled run permuted the matrix again, run once on the original
+		clErr = CLUtil::UploadBuffer(CommandQueue, m_dM, bytes, m_hM, m_TransferPolicy);
+		V_RETURN_CL(clErr, "Error copying data from host to device");
+		clErr = clEnqueueNDRangeKernel(CommandQueue, m_Kernel, 2, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+		V_RETURN_CL(clErr, "Error executing kernel: PermuteInPlace");
+	}
+
+	clErr = CLUtil::DownloadBuffer(CommandQueue, m_InPlace ? m_dM : m_dMR, bytes, m_hGPUResult, m_TransferPolicy);
+	V_RETURN_CL(clErr, "Error reading result array");
+}
+
+void CMatrixPermuteTask::ComputeCPU()
+{
+	size_t elementSize = GetElementSize();
+	unsigned int outputWidth = GetOutputWidth();
+
+	// 32 bit elements are only moved, so the blocked float routines work for int as well
+	if (elementSize == sizeof(float) && m_Permutation == PERMUTE_TRANSPOSE) {
+		CHostMatrix::Transpose((const float*)m_hM, (float*)m_hMR, m_SizeX, m_SizeY);
+		return;
+	}
+	if (elementSize == sizeof(float) && m_Permutation == PERMUTE_ROTATE_90) {
+		CHostMatrix::RotateClockwise((const float*)m_hM, (float*)m_hMR, m_SizeX, m_SizeY);
+		return;
+	}
+
+	// every thread reads whole rows of the matrix
+	CThreadPool::Get().ParallelFor(0, m_SizeY, 16, [&](size_t Begin, size_t End) {
+		for (unsigned int y = (unsigned int)Begin; y < (unsigned int)End; y++) {
+			for (unsigned int x = 0; x < m_SizeX; x++) {
+				unsigned int outX, outY;
+				PermutePosition(m_Permutation, x, y, m_SizeX, m_SizeY, outX, outY);
+				memcpy(m_hMR + (size_t(outY) * outputWidth + outX) * elementSize,
+					m_hM + (size_t(y) * m_SizeX + x) * elementSize, elementSize);
+			}
+		}
+	});
+}
+
+bool CMatrixPermuteTask::ValidateResults()
+{
+	if (memcmp(m_hMR, m_hGPUResult, GetElementSize() * m_SizeX * m_SizeY) != 0) {
+		cout << "Results of " << GetName() << " are incorrect!" << endl;
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
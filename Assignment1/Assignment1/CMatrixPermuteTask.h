@@ -0,0 +1,117 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CMATRIX_PERMUTE_TASK_H
+#define _CMATRIX_PERMUTE_TASK_H
+
+#include "../Common/IComputeTask.h"
+
+#include <string>
+
+enum EPermutation
+{
+	PERMUTE_TRANSPOSE,
+	//! clockwise rotations
+	PERMUTE_ROTATE_90,
+	PERMUTE_ROTATE_180,
+	PERMUTE_ROTATE_270,
+	//! mirrors the columns
+	PERMUTE_FLIP_HORIZONTAL,
+	//! mirrors the rows
+	PERMUTE_FLIP_VERTICAL,
+	NUM_PERMUTATIONS
+};
+
+enum EElementType
+{
+	ELEMENT_FLOAT,
+	ELEMENT_INT,
+	//! 16 bit floats, only moved, so the device needs no fp16 support
+	ELEMENT_HALF
+};
+
+//! A1/T2 generalized: transposes, rotates or flips a matrix of any size
+/*!
+	The kernel reads square tiles (the local work size is LocalWorkSize[0] x LocalWorkSize[0])
+	into padded local memory and writes them permuted, so reads and writes are coalesced.
+	Tiles at the right and bottom edge may be partially filled.
+
+	In-place mode (square matrices only) needs no second buffer: every work-item swaps
+	the elements of one cycle of the permutation directly in global memory.
+*/
+class CMatrixPermuteTask : public IComputeTask
+{
+public:
+	CMatrixPermuteTask(size_t SizeX, size_t SizeY, EPermutation Permutation,
+		EElementType ElementType = ELEMENT_FLOAT, bool InPlace = false);
+	virtual ~CMatrixPermuteTask();
+
+	static const char* GetPermutationName(EPermutation Permutation);
+
+	static const char* GetElementTypeName(EElementType ElementType);
+
+	//! Parses the names of GetPermutationName(), returns false if the name is unknown
+	static bool ParsePermutation(const std::string& Name, EPermutation& Permutation);
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// the matrix is read and written once
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = size_t(m_SizeX) * m_SizeY; Bytes = 2 * GetElementSize() * Elements; }
+
+protected:
+	size_t GetElementSize() const;
+
+	//! width of the permuted matrix (the height for transposing permutations)
+	unsigned int GetOutputWidth() const;
+
+	//! sets the local memory of the tile for the local work size
+	bool SetTileSize(size_t TileSize);
+
+	//! name of the kernel variant for the output and the tuning database
+	std::string GetName() const;
+
+	unsigned int		m_SizeX;
+	unsigned int		m_SizeY;
+	EPermutation		m_Permutation;
+	EElementType		m_ElementType;
+	bool				m_InPlace;
+
+	//raw elements on the CPU: input, CPU result and GPU result
+	unsigned char		*m_hM, *m_hMR, *m_hGPUResult;
+
+	//input and output on the GPU (no output buffer in in-place mode)
+	cl_mem				m_dM, m_dMR;
+
+	cl_program			m_Program;
+	cl_kernel			m_Kernel;
+
+	//square local work size found by the autotuner, zero if not tuned
+	size_t				m_TunedLocalWorkSize[3];
+};
+
+#endif // _CMATRIX_PERMUTE_TASK_H
@@ -0,0 +1,238 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CMatrixRotateBatchTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CHostMatrix.h"
+#include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
+
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CMatrixRotateBatchTask
+
+CMatrixRotateBatchTask::CMatrixRotateBatchTask(size_t BatchSize, size_t SizeX, size_t SizeY)
+	: CMatrixRotateBatchTask(vector<MatrixSize>(BatchSize, MatrixSize{SizeX, SizeY}))
+{
+}
+
+CMatrixRotateBatchTask::CMatrixRotateBatchTask(const std::vector<MatrixSize>& Sizes)
+	: m_Sizes(Sizes), m_NumElements(0), m_MaxSizeX(0), m_MaxSizeY(0),
+	m_hM(NULL), m_hMR(NULL), m_hGPUResultBatched(NULL), m_hGPUResultPerMatrix(NULL),
+	m_dM(NULL), m_dMR(NULL), m_dDescriptors(NULL), m_Program(NULL), m_Kernel(NULL), m_FirstMatrixArg(0)
+{
+	for (size_t i = 0; i < m_Sizes.size(); i++) {
+		m_Offsets.push_back(m_NumElements);
+		m_NumElements += m_Sizes[i].SizeX * m_Sizes[i].SizeY;
+		m_MaxSizeX = max(m_MaxSizeX, m_Sizes[i].SizeX);
+		m_MaxSizeY = max(m_MaxSizeY, m_Sizes[i].SizeY);
+	}
+}
+
+CMatrixRotateBatchTask::~CMatrixRotateBatchTask()
+{
+	ReleaseResources();
+}
+
+bool CMatrixRotateBatchTask::IsUniform() const
+{
+	for (size_t i = 1; i < m_Sizes.size(); i++) {
+		if (m_Sizes[i].SizeX != m_Sizes[0].SizeX || m_Sizes[i].SizeY != m_Sizes[0].SizeY)
+			return false;
+	}
+	return true;
+}
+
+bool CMatrixRotateBatchTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	if (m_Sizes.empty()) {
+		cerr << "The batch contains no matrices" << endl;
+		return false;
+	}
+
+	//CPU resources (the arrays shared with the device are aligned for zero-copy buffers)
+	m_hM = CLUtil::AllocHostArray<float>(m_NumElements);
+	m_hMR = new float[m_NumElements];
+	m_hGPUResultBatched = new float[m_NumElements];
+	m_hGPUResultPerMatrix = CLUtil::AllocHostArray<float>(m_NumElements);
+
+	for (size_t i = 0; i < m_NumElements; i++) {
+		m_hM[i] = float(rand()) / float(RAND_MAX);
+	}
+
+	cl_int clError;
+	m_dM = CreateHostBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_float) * m_NumElements, m_hM, &clError);
+	V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+	// the batched result is copied out of the buffer before the per-matrix launches overwrite it
+	m_dMR = CreateHostBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_float) * m_NumElements, m_hGPUResultPerMatrix, &clError);
+	V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+
+	string programCode;
+	if (!CLUtil::LoadProgramSourceToMemory("../Assignment1/MatrixRot.cl", programCode)) {
+		return false;
+	}
+	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode);
+	if (m_Program == nullptr) return false;
+
+	if (IsUniform()) {
+		m_Kernel = clCreateKernel(m_Program, "MatrixRotBatched", &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create kernel: MatrixRotBatched");
+
+		cl_uint sizeX = (cl_uint)m_Sizes[0].SizeX, sizeY = (cl_uint)m_Sizes[0].SizeY;
+		clError = clSetKernelArg(m_Kernel, 0, sizeof(cl_mem), (void*)&m_dM);
+		clError |= clSetKernelArg(m_Kernel, 1, sizeof(cl_mem), (void*)&m_dMR);
+		clError |= clSetKernelArg(m_Kernel, 2, sizeof(cl_uint), (void*)&sizeX);
+		clError |= clSetKernelArg(m_Kernel, 3, sizeof(cl_uint), (void*)&sizeY);
+		V_RETURN_FALSE_CL(clError, "Failed to set kernel args: MatrixRotBatched");
+		m_FirstMatrixArg = 4;
+	} else {
+		vector<cl_uint> descriptors;
+		for (size_t i = 0; i < m_Sizes.size(); i++) {
+			descriptors.push_back((cl_uint)m_Offsets[i]);
+			descriptors.push_back((cl_uint)m_Sizes[i].SizeX);
+			descriptors.push_back((cl_uint)m_Sizes[i].SizeY);
+			descriptors.push_back(0);
+		}
+		m_dDescriptors = clCreateBuffer(Context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_uint) * descriptors.size(), descriptors.data(), &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+
+		m_Kernel = clCreateKernel(m_Program, "MatrixRotBatchedTable", &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create kernel: MatrixRotBatchedTable");
+
+		clError = clSetKernelArg(m_Kernel, 0, sizeof(cl_mem), (void*)&m_dM);
+		clError |= clSetKernelArg(m_Kernel, 1, sizeof(cl_mem), (void*)&m_dMR);
+		clError |= clSetKernelArg(m_Kernel, 2, sizeof(cl_mem), (void*)&m_dDescriptors);
+		V_RETURN_FALSE_CL(clError, "Failed to set kernel args: MatrixRotBatchedTable");
+		m_FirstMatrixArg = 3;
+	}
+
+	return true;
+}
+
+void CMatrixRotateBatchTask::ReleaseResources()
+{
+	ReleaseBuffer(m_dM);
+	ReleaseBuffer(m_dMR);
+	SAFE_RELEASE_MEMOBJECT(m_dDescriptors);
+
+	SAFE_RELEASE_KERNEL(m_Kernel);
+	SAFE_RELEASE_PROGRAM(m_Program);
+
+	//CPU resources (after the buffers, which might use them)
+	CLUtil::FreeHostArray(m_hM);
+	SAFE_DELETE_ARRAY(m_hMR);
+	SAFE_DELETE_ARRAY(m_hGPUResultBatched);
+	CLUtil::FreeHostArray(m_hGPUResultPerMatrix);
+}
+
+cl_int CMatrixRotateBatchTask::EnqueueRotation(cl_command_queue CommandQueue, const size_t LocalWorkSize[2], size_t First, size_t Count)
+{
+	cl_int first = (cl_int)First;
+	cl_int clError = clSetKernelArg(m_Kernel, m_FirstMatrixArg, sizeof(cl_int), (void*)&first);
+	if (clError != CL_SUCCESS) return clError;
+
+	// a single matrix only needs the work-groups covering it
+	size_t sizeX = Count == 1 ? m_Sizes[First].SizeX : m_MaxSizeX;
+	size_t sizeY = Count == 1 ? m_Sizes[First].SizeY : m_MaxSizeY;
+
+	size_t globalWorkSize[3] = {
+		CLUtil::GetGlobalWorkSize(sizeX, LocalWorkSize[0]),
+		CLUtil::GetGlobalWorkSize(sizeY, LocalWorkSize[1]),
+		Count
+	};
+	size_t localWorkSize[3] = { LocalWorkSize[0], LocalWorkSize[1], 1 };
+	return clEnqueueNDRangeKernel(CommandQueue, m_Kernel, 3, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+}
+
+double CMatrixRotateBatchTask::TimeBatch(cl_command_queue CommandQueue, const size_t LocalWorkSize[2], bool PerMatrix, int NIterations)
+{
+	cl_int clError = clFinish(CommandQueue);
+
+	CTimer timer;
+	timer.Start();
+	for (int i = 0; i < NIterations; i++) {
+		if (PerMatrix) {
+			for (size_t m = 0; m < m_Sizes.size(); m++)
+				clError |= EnqueueRotation(CommandQueue, LocalWorkSize, m, 1);
+		} else {
+			clError |= EnqueueRotation(CommandQueue, LocalWorkSize, 0, m_Sizes.size());
+		}
+	}
+	clError |= clFinish(CommandQueue);
+	timer.Stop();
+
+	if (clError != CL_SUCCESS) {
+		cout << "kernel execution failure: " << CLUtil::GetCLErrorString(clError) << endl;
+		return -1;
+	}
+	return timer.GetElapsedMilliseconds() / double(NIterations);
+}
+
+void CMatrixRotateBatchTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	cl_int clErr;
+	{
+		CScopedTimer timer("WriteBuffers");
+		clErr = CLUtil::UploadBuffer(CommandQueue, m_dM, sizeof(cl_float) * m_NumElements, m_hM, m_TransferPolicy, CL_TRUE);
+		V_RETURN_CL(clErr, "Error copying data from host to device");
+	}
+
+	// the tiles are square, the padding column is part of the local memory
+	size_t localWorkSize[2] = { LocalWorkSize[0], LocalWorkSize[0] };
+	clErr = clSetKernelArg(m_Kernel, m_FirstMatrixArg + 1, localWorkSize[0] * (localWorkSize[0] + 1) * sizeof(float), NULL);
+	V_RETURN_CL(clErr, "Failed to set kernel args: tile");
+
+	cout << "Rotating " << m_Sizes.size() << (IsUniform() ? " matrices" : " matrices of different sizes")
+		<< " (largest " << m_MaxSizeX << "x" << m_MaxSizeY << ") in tiles of " << localWorkSize[0] << "x" << localWorkSize[1] << endl;
+
+	// one launch for the whole batch
+	double batchedMs = TimeBatch(CommandQueue, localWorkSize, false, 100);
+	clErr = CLUtil::DownloadBuffer(CommandQueue, m_dMR, sizeof(float) * m_NumElements, m_hGPUResultBatched, m_TransferPolicy);
+	V_RETURN_CL(clErr, "Error reading batched result array");
+
+	// one launch per matrix, on a cleared output
+	clErr = CLUtil::ClearBuffer(CommandQueue, m_dMR, sizeof(float) * m_NumElements, m_TransferPolicy);
+	V_RETURN_CL(clErr, "Error clearing the result array");
+	double perMatrixMs = TimeBatch(CommandQueue, localWorkSize, true, 10);
+	clErr = CLUtil::DownloadBuffer(CommandQueue, m_dMR, sizeof(float) * m_NumElements, m_hGPUResultPerMatrix, m_TransferPolicy);
+	V_RETURN_CL(clErr, "Error reading per-matrix result array");
+
+	cout << "  batched:    " << batchedMs << " ms per batch (1 launch)" << endl;
+	cout << "  per matrix: " << perMatrixMs << " ms per batch (" << m_Sizes.size() << " launches)" << endl;
+	if (batchedMs > 0)
+		cout << "  speedup of the single launch: " << perMatrixMs / batchedMs << endl;
+	CLUtil::PrintBandwidth("batched", 2 * sizeof(float) * m_NumElements, batchedMs);
+
+	CBenchmarkRecorder::ReportTime("rotate_batched", batchedMs);
+	CBenchmarkRecorder::ReportTime("rotate_per_matrix", perMatrixMs);
+}
+
+void CMatrixRotateBatchTask::ComputeCPU()
+{
+	for (size_t i = 0; i < m_Sizes.size(); i++) {
+		CHostMatrix::RotateClockwise(m_hM + m_Offsets[i], m_hMR + m_Offsets[i], m_Sizes[i].SizeX, m_Sizes[i].SizeY);
+	}
+}
+
+bool CMatrixRotateBatchTask::ValidateResults()
+{
+	if (memcmp(m_hMR, m_hGPUResultBatched, sizeof(float) * m_NumElements) != 0) {
+		cout << "Results of the batched rotation are incorrect!" << endl;
+		return false;
+	}
+	if (memcmp(m_hMR, m_hGPUResultPerMatrix, sizeof(float) * m_NumElements) != 0) {
+		cout << "Results of the per-matrix rotation are incorrect!" << endl;
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,96 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CMATRIX_ROTATE_BATCH_TASK_H
+#define _CMATRIX_ROTATE_BATCH_TASK_H
+
+#include "../Common/IComputeTask.h"
+
+#include <vector>
+
+//! A1/T2 batched: rotates many small matrices clockwise in a single launch
+/*!
+	The matrices are stored one after the other. The third dimension of the NDRange is
+	the index of the matrix, the first two cover one matrix in square tiles
+	(LocalWorkSize[0] x LocalWorkSize[0]). If all matrices have the same size the kernel
+	computes their offsets, otherwise it reads them from a descriptor table.
+
+	ComputeGPU() compares the single launch with one launch per matrix.
+*/
+class CMatrixRotateBatchTask : public IComputeTask
+{
+public:
+	//! Size of one matrix of the batch
+	struct MatrixSize
+	{
+		size_t	SizeX;
+		size_t	SizeY;
+	};
+
+	//! BatchSize matrices of SizeX x SizeY
+	CMatrixRotateBatchTask(size_t BatchSize, size_t SizeX, size_t SizeY);
+
+	//! Matrices of different sizes
+	CMatrixRotateBatchTask(const std::vector<MatrixSize>& Sizes);
+
+	virtual ~CMatrixRotateBatchTask();
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// every matrix is read and written once
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_NumElements; Bytes = 2 * sizeof(float) * Elements; }
+
+protected:
+	bool IsUniform() const;
+
+	//! Enqueues the matrices [First, First + Count), the kernel arguments except FirstMatrix must be set
+	cl_int EnqueueRotation(cl_command_queue CommandQueue, const size_t LocalWorkSize[2], size_t First, size_t Count);
+
+	//! Host time per batch in ms of NIterations runs, including the launch overhead
+	double TimeBatch(cl_command_queue CommandQueue, const size_t LocalWorkSize[2], bool PerMatrix, int NIterations);
+
+	std::vector<MatrixSize>	m_Sizes;
+	//! first element of each matrix
+	std::vector<size_t>		m_Offsets;
+	size_t					m_NumElements;
+	size_t					m_MaxSizeX, m_MaxSizeY;
+
+	float				*m_hM, *m_hMR;
+	float				*m_hGPUResultBatched, *m_hGPUResultPerMatrix;
+
+	cl_mem				m_dM, m_dMR;
+	//! (offset, SizeX, SizeY, 0) of each matrix, only used for different sizes
+	cl_mem				m_dDescriptors;
+
+	cl_program			m_Program;
+	cl_kernel			m_Kernel;
+	//! index of the FirstMatrix argument of m_Kernel, the local tile follows it
+	cl_uint				m_FirstMatrixArg;
+};
+
+#endif // _CMATRIX_ROTATE_BATCH_TASK_H
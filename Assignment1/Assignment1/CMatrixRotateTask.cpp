@@ -6,6 +6,8 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CMatrixRotateTask.h"
 
 #include "../Common/CLUtil.h"
+#include "../Common/CHostMatrix.h"
+#include "../Common/CTrace.h"
 
 #include <string.h>
 
@@ -17,8 +19,11 @@ using namespace std;
 CMatrixRotateTask::CMatrixRotateTask(size_t SizeX, size_t SizeY)
 	:m_SizeX(static_cast<unsigned>(SizeX)), m_SizeY(static_cast<unsigned>(SizeY)), m_hM(NULL), m_hMR(NULL), m_dM(NULL),
 	m_dMR(NULL), m_hGPUResultNaive(NULL), m_hGPUResultOpt(NULL), m_Program(NULL),
-	m_NaiveKernel(NULL), m_OptimizedKernel(NULL)
+	m_NaiveKernel(NULL), m_OptimizedKernel(NULL), m_DeviceValidation(false)
 {
+	m_DeviceResultValid[0] = m_DeviceResultValid[1] = false;
+	memset(m_TunedNaiveLocalWorkSize, 0, sizeof(m_TunedNaiveLocalWorkSize));
+	memset(m_TunedOptimizedLocalWorkSize, 0, sizeof(m_TunedOptimizedLocalWorkSize));
 }
 
 CMatrixRotateTask::~CMatrixRotateTask()
@@ -28,11 +33,11 @@ CMatrixRotateTask::~CMatrixRotateTask()
 
 bool CMatrixRotateTask::InitResources(cl_device_id Device, cl_context Context)
 {
-	//CPU resources
-	m_hM = new float[m_SizeX * m_SizeY];
+	//CPU resources (the arrays shared with the device are aligned for zero-copy buffers)
+	m_hM = CLUtil::AllocHostArray<float>(m_SizeX * m_SizeY);
 	m_hMR = new float[m_SizeX * m_SizeY];
 	m_hGPUResultNaive = new float[m_SizeX * m_SizeY];
-	m_hGPUResultOpt = new float[m_SizeX * m_SizeY];
+	m_hGPUResultOpt = CLUtil::AllocHostArray<float>(m_SizeX * m_SizeY);
 
 	//fill the matrix with random floats
 	for(unsigned int i = 0; i < m_SizeX * m_SizeY; i++)
@@ -44,9 +49,10 @@ bool CMatrixRotateTask::InitResources(cl_device_id Device, cl_context Context)
 
 	cl_int clError;
 	// buffers are declared in header
-	m_dM = clCreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_float) * m_SizeX * m_SizeY, NULL, &clError);
+	m_dM = CreateHostBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_float) * m_SizeX * m_SizeY, m_hM, &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
-	m_dMR = clCreateBuffer(Context, CL_MEM_WRITE_ONLY, sizeof(cl_float) * m_SizeX * m_SizeY, NULL, &clError);
+	// the naive result is copied out of the buffer before the optimized kernel overwrites it
+	m_dMR = CreateHostBuffer(Context, CL_MEM_WRITE_ONLY, sizeof(cl_float) * m_SizeX * m_SizeY, m_hGPUResultOpt, &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
 
 	/////////////////////////////////////////
@@ -83,23 +89,38 @@ bool CMatrixRotateTask::InitResources(cl_device_id Device, cl_context Context)
 	clError |= clSetKernelArg(m_OptimizedKernel, 2, sizeof(cl_int), (void*)&m_SizeX);
 	clError |= clSetKernelArg(m_OptimizedKernel, 3, sizeof(cl_int), (void*)&m_SizeY);
 	V_RETURN_FALSE_CL(clError, "Failed to set kernel args: MatrixRotOptimized");
-	
+
+	// the kernels have no bounds checks, so the tiles have to divide the matrix
+	CAutoTuner::Request naive("MatrixRotNaive", m_NaiveKernel, 2, m_SizeX, m_SizeY);
+	naive.Divisible = true;
+	TuneLocalWorkSize(naive, m_TunedNaiveLocalWorkSize);
+
+	// the optimized kernel splits the rows of a tile into rotated rows of the tile height
+	CAutoTuner::Request optimized("MatrixRotOptimized", m_OptimizedKernel, 2, m_SizeX, m_SizeY);
+	optimized.Divisible = true;
+	optimized.Prepare = [this](const size_t LocalWorkSize[3]) {
+		if(LocalWorkSize[0] < LocalWorkSize[1] || LocalWorkSize[0] % LocalWorkSize[1] != 0)
+			return false;
+		return clSetKernelArg(m_OptimizedKernel, 4, LocalWorkSize[0] * LocalWorkSize[1] * sizeof(float), NULL) == CL_SUCCESS;
+	};
+	TuneLocalWorkSize(optimized, m_TunedOptimizedLocalWorkSize);
 
 	return true;
 }
 
 void CMatrixRotateTask::ReleaseResources()
 {
-	//CPU resources
-	SAFE_DELETE_ARRAY(m_hM);
-	SAFE_DELETE_ARRAY(m_hMR);
-	SAFE_DELETE_ARRAY(m_hGPUResultNaive);
-	SAFE_DELETE_ARRAY(m_hGPUResultOpt);
-
 	// release device resources
 
-	SAFE_RELEASE_MEMOBJECT(m_dM);
-	SAFE_RELEASE_MEMOBJECT(m_dMR);
+	ReleaseBuffer(m_dM);
+	ReleaseBuffer(m_dMR);
+	m_Validator.Release();
+
+	//CPU resources (after the buffers, which might use them)
+	CLUtil::FreeHostArray(m_hM);
+	SAFE_DELETE_ARRAY(m_hMR);
+	SAFE_DELETE_ARRAY(m_hGPUResultNaive);
+	CLUtil::FreeHostArray(m_hGPUResultOpt);
 
 }
 
@@ -110,8 +131,13 @@ void CMatrixRotateTask::ComputeGPU(cl_context Context, cl_command_queue CommandQ
 	/////////////////////////////////////////////////
 	// Write input data to the GPU
 	cl_int clErr;
-	clErr = clEnqueueWriteBuffer(CommandQueue, m_dM, CL_FALSE, 0, sizeof(cl_float) * m_SizeX * m_SizeY, m_hM, 0, NULL, NULL);
-	V_RETURN_CL(clErr, "Error copying data from host to device");
+	{
+		CScopedTimer timer("WriteBuffers");
+		clErr = CLUtil::UploadBuffer(CommandQueue, m_dM, sizeof(cl_float) * m_SizeX * m_SizeY, m_hM, m_TransferPolicy, CL_TRUE);
+		V_RETURN_CL(clErr, "Error copying data from host to device");
+	}
+	// the CPU result is uploaded once, then only the comparison results are read back
+	m_DeviceValidation = CDeviceValidator::IsEnabled() && m_Validator.SetGolden(CommandQueue, m_hMR, size_t(m_SizeX) * m_SizeY);
 
 	//launch kernels
 
@@ -119,15 +145,16 @@ void CMatrixRotateTask::ComputeGPU(cl_context Context, cl_command_queue CommandQ
 
 	size_t globalWorkSize[2];
 	size_t nGroups[2];
+	size_t* localWorkSize = m_TunedNaiveLocalWorkSize[0] > 0 ? m_TunedNaiveLocalWorkSize : LocalWorkSize;
 
-	globalWorkSize[0] = CLUtil::GetGlobalWorkSize(m_SizeX, LocalWorkSize[0]);
-	globalWorkSize[1] = CLUtil::GetGlobalWorkSize(m_SizeY, LocalWorkSize[1]);
+	globalWorkSize[0] = CLUtil::GetGlobalWorkSize(m_SizeX, localWorkSize[0]);
+	globalWorkSize[1] = CLUtil::GetGlobalWorkSize(m_SizeY, localWorkSize[1]);
 
-	nGroups[0] = globalWorkSize[0] / LocalWorkSize[0];
-	nGroups[1] = globalWorkSize[1] / LocalWorkSize[1];
+	nGroups[0] = globalWorkSize[0] / localWorkSize[0];
+	nGroups[1] = globalWorkSize[1] / localWorkSize[1];
 
 	cout << "Executing " << globalWorkSize[0] << "x" << globalWorkSize[1] << " threads in " << nGroups[0] << "x" << nGroups[1] 
-		<< " groups of size " << LocalWorkSize[0] << "x" << LocalWorkSize[1] << endl;
+		<< " groups of size " << localWorkSize[0] << "x" << localWorkSize[1] << endl;
 
 	// clErr = clEnqueueNDRangeKernel(CommandQueue, m_NaiveKernel, 2, NULL, &globalWorkSize[0], LocalWorkSize, 0, NULL, NULL);
 	// V_RETURN_CL(clErr, "Error executing kernel");
@@ -135,50 +162,78 @@ void CMatrixRotateTask::ComputeGPU(cl_context Context, cl_command_queue CommandQ
 	double time = 0;
 	
 	//naive kernel
-	time = CLUtil::ProfileKernel(CommandQueue, m_NaiveKernel, 2, &globalWorkSize[0], LocalWorkSize, 1000);
+	time = CLUtil::ProfileKernel(CommandQueue, m_NaiveKernel, 2, &globalWorkSize[0], localWorkSize, 1000);
 	cout<<"Executed naive kernel in "<<time<<" ms."<<endl;
 	
-	//This command has to be blocking, since we need the data
-	clErr = clEnqueueReadBuffer(CommandQueue, m_dMR, CL_TRUE, 0, sizeof(float) * m_SizeX * m_SizeY, m_hGPUResultNaive, 0, NULL, NULL);
-	V_RETURN_CL(clErr, "Error reading naive result array");
+	if (m_DeviceValidation) {
+		CDeviceValidator::Result result;
+		clErr = m_Validator.Compare(CommandQueue, m_dMR, result);
+		V_RETURN_CL(clErr, "Error comparing the naive result on the device");
+		CDeviceValidator::PrintResult("MatrixRotNaive", result);
+		m_DeviceResultValid[0] = result.IsValid();
+
+		// the optimized kernel writes the same buffer, it must not pass with the naive result
+		clErr = m_Validator.Clear(CommandQueue, m_dMR);
+		V_RETURN_CL(clErr, "Error clearing the result array");
+	} else {
+		//This command has to be blocking, since we need the data
+		clErr = CLUtil::DownloadBuffer(CommandQueue, m_dMR, sizeof(float) * m_SizeX * m_SizeY, m_hGPUResultNaive, m_TransferPolicy);
+		V_RETURN_CL(clErr, "Error reading naive result array");
+	}
 
 	clFinish(CommandQueue);
 
 	//optimized kernel
 	
+	// the tuned tile of the optimized kernel may differ from the naive one
+	localWorkSize = m_TunedOptimizedLocalWorkSize[0] > 0 ? m_TunedOptimizedLocalWorkSize : LocalWorkSize;
+	globalWorkSize[0] = CLUtil::GetGlobalWorkSize(m_SizeX, localWorkSize[0]);
+	globalWorkSize[1] = CLUtil::GetGlobalWorkSize(m_SizeY, localWorkSize[1]);
+
 	// allocate shared (local) memory for the kernel -> done in INIT
 	// local memory:
-	clErr = clSetKernelArg(m_OptimizedKernel, 4, LocalWorkSize[0] * LocalWorkSize[1] * sizeof(float), NULL);
+	clErr = clSetKernelArg(m_OptimizedKernel, 4, localWorkSize[0] * localWorkSize[1] * sizeof(float), NULL);
 	V_RETURN_CL(clErr, "Failed to set kernel args: MatrixRotOptimized");
 
 	// run kernel
 	time = 0;
 	//clErr = clEnqueueNDRangeKernel(CommandQueue, m_OptimizedKernel, 2, NULL, &globalWorkSize[0], LocalWorkSize, 0, NULL, NULL);
 	V_RETURN_CL(clErr, "Error executing kernel");
-	time = CLUtil::ProfileKernel(CommandQueue, m_OptimizedKernel, 2, &globalWorkSize[0], LocalWorkSize, 1000);
+	time = CLUtil::ProfileKernel(CommandQueue, m_OptimizedKernel, 2, &globalWorkSize[0], localWorkSize, 1000);
 	cout<<"Executed optimized kernel in "<<time<<" ms."<<endl;
 
+	if (m_DeviceValidation) {
+		CDeviceValidator::Result result;
+		clErr = m_Validator.Compare(CommandQueue, m_dMR, result);
+		V_RETURN_CL(clErr, "Error comparing the optimized result on the device");
+		CDeviceValidator::PrintResult("MatrixRotOptimized", result);
+		m_DeviceResultValid[1] = result.IsValid();
+		return;
+	}
+
 	// read back results synchronously.
 	//This command has to be blocking, since we need the data
-	clErr = clEnqueueReadBuffer(CommandQueue, m_dMR, CL_TRUE, 0, sizeof(float) * m_SizeX * m_SizeY, m_hGPUResultOpt, 0, NULL, NULL);
+	clErr = CLUtil::DownloadBuffer(CommandQueue, m_dMR, sizeof(float) * m_SizeX * m_SizeY, m_hGPUResultOpt, m_TransferPolicy);
 	V_RETURN_CL(clErr, "Error reading optimized result array");
 }
 
 void CMatrixRotateTask::ComputeCPU()
 {
-	for(unsigned int x = 0; x < m_SizeX; x++)
-	{
-		for(unsigned int y = 0; y < m_SizeY; y++)
-		{
-			m_hMR[ x * m_SizeY + (m_SizeY - y - 1) ] = m_hM[ y * m_SizeX + x ];
-		}
-	}
+	// cache-blocked and multithreaded (see CHostMatrix)
+	CHostMatrix::RotateClockwise(m_hM, m_hMR, m_SizeX, m_SizeY);
 }
 
 bool CMatrixRotateTask::ValidateResults()
 {
 	// for (unsigned int i = 0; i < m_SizeX * m_SizeY; i++) {cout << m_hMR[i] << " ";}	// debug
 	cout << endl;
+	if (m_DeviceValidation) {
+		if (!m_DeviceResultValid[0])
+			cout<<"Results of the naive kernel are incorrect!"<<endl;
+		if (!m_DeviceResultValid[1])
+			cout<<"Results of the optimized kernel are incorrect!"<<endl;
+		return m_DeviceResultValid[0] && m_DeviceResultValid[1];
+	}
 	if(!(memcmp(m_hMR, m_hGPUResultNaive, m_SizeX * m_SizeY * sizeof(float)) == 0))
 	{
 		// for (unsigned int i = 0; i < m_SizeX * m_SizeY; i++) {cout << m_hGPUResultNaive[i] << " ";}		// debug
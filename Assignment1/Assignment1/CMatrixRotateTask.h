@@ -21,6 +21,7 @@
 #define _CMATRIX_ROTATE_TASK_H
 
 #include "../Common/IComputeTask.h"
+#include "../Common/CDeviceValidator.h"
 
 //! A1/T2: Matrix rotation
 class CMatrixRotateTask : public IComputeTask
@@ -40,6 +41,9 @@ public:
 
 	virtual bool ValidateResults();
 
+	// the matrix is read and written once by each kernel
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = size_t(m_SizeX) * m_SizeY; Bytes = 2 * sizeof(float) * Elements; }
+
 protected:
 	//NOTE: we have two memory address spaces, so we mark pointers with a prefix
 	//to avoid confusions: 'h' - host, 'd' - device
@@ -61,6 +65,16 @@ protected:
 	cl_program			m_Program;
 	cl_kernel			m_NaiveKernel;
 	cl_kernel			m_OptimizedKernel;
+
+	//local work sizes found by the autotuner, zero if not tuned
+	size_t				m_TunedNaiveLocalWorkSize[3];
+	size_t				m_TunedOptimizedLocalWorkSize[3];
+
+	//compares the results on the device instead of reading them back (see CDeviceValidator)
+	CDeviceValidator	m_Validator;
+	bool				m_DeviceValidation;
+	//results of the comparisons on the device (naive, optimized)
+	bool				m_DeviceResultValid[2];
 };
 
 #endif // _CMATRIX_ROTATE_TASK_H
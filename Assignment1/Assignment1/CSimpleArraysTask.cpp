@@ -6,6 +6,9 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CSimpleArraysTask.h"
 
 #include "../Common/CLUtil.h"
+#include "../Common/CExpression.h"
+#include "../Common/CThreadPool.h"
+#include "../Common/CTrace.h"
 
 #include <string.h>
 
@@ -14,8 +17,15 @@ using namespace std;
 ///////////////////////////////////////////////////////////////////////////////
 // CSimpleArraysTask
 
-CSimpleArraysTask::CSimpleArraysTask(size_t ArraySize)
-	: m_ArraySize(ArraySize)
+static const char* g_VariantKernels[CSimpleArraysTask::NUM_VARIANTS] = {
+	"VecAdd",
+	"VecAdd4",
+	"VecAdd8",
+	"VecAddStrided"
+};
+
+CSimpleArraysTask::CSimpleArraysTask(size_t ArraySize, unsigned int ElementsPerItem)
+	: m_ArraySize(ArraySize), m_ElementsPerItem(ElementsPerItem > 0 ? ElementsPerItem : 1)
 {
 }
 
@@ -26,11 +36,11 @@ CSimpleArraysTask::~CSimpleArraysTask()
 
 bool CSimpleArraysTask::InitResources(cl_device_id Device, cl_context Context)
 {
-	//CPU resources
-	m_hA = new int[m_ArraySize];
-	m_hB = new int[m_ArraySize];
+	//CPU resources (the arrays shared with the device are aligned for zero-copy buffers)
+	m_hA = CLUtil::AllocHostArray<int>(m_ArraySize);
+	m_hB = CLUtil::AllocHostArray<int>(m_ArraySize);
 	m_hC = new int[m_ArraySize];
-	m_hGPUResult = new int[m_ArraySize];
+	m_hGPUResult = CLUtil::AllocHostArray<int>(m_ArraySize);
 	
 	//fill A and B with random integers
 	for(unsigned int i = 0; i < m_ArraySize; i++)
@@ -46,11 +56,11 @@ bool CSimpleArraysTask::InitResources(cl_device_id Device, cl_context Context)
 
 	cl_int clError;
 	// buffers are declared in header
-	m_dA = clCreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_int) * m_ArraySize, NULL, &clError);
+	m_dA = CreateHostBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_int) * m_ArraySize, m_hA, &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
-	m_dB = clCreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_int) * m_ArraySize, NULL, &clError);
+	m_dB = CreateHostBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_int) * m_ArraySize, m_hB, &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
-	m_dC = clCreateBuffer(Context, CL_MEM_WRITE_ONLY, sizeof(cl_int) * m_ArraySize, NULL, &clError);
+	m_dC = CreateHostBuffer(Context, CL_MEM_WRITE_ONLY, sizeof(cl_int) * m_ArraySize, m_hGPUResult, &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
 
 
@@ -69,71 +79,83 @@ bool CSimpleArraysTask::InitResources(cl_device_id Device, cl_context Context)
 	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode);
 	if (m_Program == nullptr) return false;
 
-	//create kernels from program
-	m_Kernel = clCreateKernel(m_Program, "VecAdd", &clError);
-	V_RETURN_FALSE_CL(clError, "Failed to create kernel: VecAdd");
-
-
-	//bind kernel arguments: adresses of vectors and size of them
-	clError  = clSetKernelArg(m_Kernel, 0, sizeof(cl_mem), (void*) &m_dA); 
-	clError |= clSetKernelArg(m_Kernel, 1, sizeof(cl_mem), (void*) &m_dB);
-	clError |= clSetKernelArg(m_Kernel, 2, sizeof(cl_mem), (void*) &m_dC);
-	clError |= clSetKernelArg(m_Kernel, 3, sizeof(cl_int), (void*) &m_ArraySize);
-	V_RETURN_FALSE_CL(clError, "Failed to set kernel args: VecAdd");
-
+	//create kernels from program, all variants have the same arguments
+	for (unsigned int v = 0; v < NUM_VARIANTS; v++) {
+		m_Kernels[v] = clCreateKernel(m_Program, g_VariantKernels[v], &clError);
+		V_RETURN_FALSE_CL(clError, string("Failed to create kernel: ") + g_VariantKernels[v]);
+
+		//bind kernel arguments: adresses of vectors and size of them
+		clError  = clSetKernelArg(m_Kernels[v], 0, sizeof(cl_mem), (void*) &m_dA); 
+		clError |= clSetKernelArg(m_Kernels[v], 1, sizeof(cl_mem), (void*) &m_dB);
+		clError |= clSetKernelArg(m_Kernels[v], 2, sizeof(cl_mem), (void*) &m_dC);
+		clError |= clSetKernelArg(m_Kernels[v], 3, sizeof(cl_int), (void*) &m_ArraySize);
+		V_RETURN_FALSE_CL(clError, string("Failed to set kernel args: ") + g_VariantKernels[v]);
+
+		size_t nItems = (m_ArraySize + GetElementsPerItem(v) - 1) / GetElementsPerItem(v);
+		CAutoTuner::Request request(g_VariantKernels[v], m_Kernels[v], 1, nItems);
+		TuneLocalWorkSize(request, m_TunedLocalWorkSize[v]);
+	}
 
 	return true;
 }
 
 void CSimpleArraysTask::ReleaseResources()
 {
-	//CPU resources
-	SAFE_DELETE_ARRAY(m_hA);
-	SAFE_DELETE_ARRAY(m_hB);
-	SAFE_DELETE_ARRAY(m_hC);
-	SAFE_DELETE_ARRAY(m_hGPUResult);
-
 	/////////////////////////////////////////////////
 	// Sect. 4.5., 4.6.	
 
 	// free resources on the GPU
 	cl_int clErr = 0;
 	//clReleaseMemObject(m_dA);
-	SAFE_RELEASE_MEMOBJECT(m_dA);
+	ReleaseBuffer(m_dA);
 	V_RETURN_CL(clErr, "Could not release memory A on device.");
 	//clReleaseMemObject(m_dB);
-	SAFE_RELEASE_MEMOBJECT(m_dB);
+	ReleaseBuffer(m_dB);
 	V_RETURN_CL(clErr, "Could not release memory B on device.");
 	//clReleaseMemObject(m_dC);
-	SAFE_RELEASE_MEMOBJECT(m_dC);
+	ReleaseBuffer(m_dC);
 	V_RETURN_CL(clErr, "Could not release memory C on device.");
+	m_Validator.Release();
 
 	// release program
 	SAFE_RELEASE_PROGRAM(m_Program);
-	// release kernel
-	SAFE_RELEASE_KERNEL(m_Kernel);
+	// release kernels
+	for (unsigned int v = 0; v < NUM_VARIANTS; v++)
+		SAFE_RELEASE_KERNEL(m_Kernels[v]);
 
+	//CPU resources (after the buffers, which might use them)
+	CLUtil::FreeHostArray(m_hA);
+	CLUtil::FreeHostArray(m_hB);
+	SAFE_DELETE_ARRAY(m_hC);
+	CLUtil::FreeHostArray(m_hGPUResult);
 
 }
 
 void CSimpleArraysTask::ComputeCPU()
 {
-	for(unsigned int i = 0; i < m_ArraySize; i++)
-	{
-		m_hC[i] = m_hA[i] + m_hB[m_ArraySize - i - 1];
-	}
+	CThreadPool::Get().ParallelFor(0, m_ArraySize, 65536, [&](size_t Begin, size_t End) {
+		for(size_t i = Begin; i < End; i++)
+		{
+			m_hC[i] = m_hA[i] + m_hB[m_ArraySize - i - 1];
+		}
+	});
 }
 
 void CSimpleArraysTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	/////////////////////////////////////////////////
 	// Sect. 4.5
-	// Write input data to the GPU
+	// Write input data to the GPU (blocking, so the span covers the transfer)
 	cl_int clErr;
-	clErr = clEnqueueWriteBuffer(CommandQueue, m_dA, CL_FALSE, 0, m_ArraySize * sizeof(int), m_hA, 0, NULL, NULL);
-	V_RETURN_CL(clErr, "Error copying data A from host to device");
-	clErr = clEnqueueWriteBuffer(CommandQueue, m_dB, CL_FALSE, 0, m_ArraySize * sizeof(int), m_hB, 0, NULL, NULL);
-	V_RETURN_CL(clErr, "Error copying data B from host to device");
+	{
+		CScopedTimer timer("WriteBuffers");
+		clErr = CLUtil::UploadBuffer(CommandQueue, m_dA, m_ArraySize * sizeof(int), m_hA, m_TransferPolicy, CL_TRUE);
+		V_RETURN_CL(clErr, "Error copying data A from host to device");
+		clErr = CLUtil::UploadBuffer(CommandQueue, m_dB, m_ArraySize * sizeof(int), m_hB, m_TransferPolicy, CL_TRUE);
+		V_RETURN_CL(clErr, "Error copying data B from host to device");
+	}
+	// the CPU result is uploaded once, then only the comparison results are read back
+	m_DeviceValidation = CDeviceValidator::IsEnabled() && m_Validator.SetGolden(CommandQueue, m_hC, m_ArraySize);
 
 
 	/////////////////////////////////////////
@@ -145,28 +167,105 @@ void CSimpleArraysTask::ComputeGPU(cl_context Context, cl_command_queue CommandQ
 			//				utility function to measure execution time.
 			//				Also print out the execution time.
 			
-	// Determine number of thread groups and launch kernel
+	// Determine number of thread groups and launch the kernel of each variant
+	// (two arrays are read and one is written)
+	size_t bytes = 3 * sizeof(int) * m_ArraySize;
+	for (unsigned int v = 0; v < NUM_VARIANTS; v++) {
+		size_t* localWorkSize = m_TunedLocalWorkSize[v][0] > 0 ? m_TunedLocalWorkSize[v] : LocalWorkSize;
+		size_t nItems = (m_ArraySize + GetElementsPerItem(v) - 1) / GetElementsPerItem(v);
+		size_t globalWorkSize = CLUtil::GetGlobalWorkSize(nItems, localWorkSize[0]);
+		size_t nGroups = globalWorkSize / localWorkSize[0];
+		cout << g_VariantKernels[v] << ": executing " << globalWorkSize << " threads in " << nGroups << " groups of size " << localWorkSize[0]
+			<< " (" << GetElementsPerItem(v) << " elements per thread)" << endl;
+
+		V_RETURN_CL(ClearResult(CommandQueue), "Error clearing the result array");
+
+		// standard call but we use Profile Kernel()
+		//clErr = clEnqueueNDRangeKernel(CommandQueue, m_Kernels[v], 1, NULL, &globalWorkSize, localWorkSize, 0, NULL, NULL);
+		//V_RETURN_CL(clErr, "Error executing kernel");
+
+		double ms = CLUtil::ProfileKernel(CommandQueue, m_Kernels[v], 1, &globalWorkSize, localWorkSize, 1000);
+		CLUtil::PrintBandwidth(g_VariantKernels[v], bytes, ms);
+
+		m_VariantValid[v] = CheckResult(CommandQueue, g_VariantKernels[v]);
+	}
 
-	size_t globalWorkSize = CLUtil::GetGlobalWorkSize(m_ArraySize, LocalWorkSize[0]);
-	size_t nGroups = globalWorkSize / LocalWorkSize[0];
-	cout << "Executing " << globalWorkSize << " threads in " << nGroups << " groups of size " << LocalWorkSize[0] << endl;
+	ComputeExpression(CommandQueue, LocalWorkSize);
+}
 
-	// standard call but we use Profile Kernel()
-	//clErr = clEnqueueNDRangeKernel(CommandQueue, m_Kernel, 1, NULL, &globalWorkSize, LocalWorkSize, 0, NULL, NULL);
-	//V_RETURN_CL(clErr, "Error executing kernel");
+cl_int CSimpleArraysTask::ClearResult(cl_command_queue CommandQueue)
+{
+	if (m_DeviceValidation)
+		return m_Validator.Clear(CommandQueue, m_dC);
 
-	CLUtil::ProfileKernel(CommandQueue, m_Kernel, 1, &globalWorkSize, LocalWorkSize, 1000);
+	return CLUtil::ClearBuffer(CommandQueue, m_dC, m_ArraySize * sizeof(int), m_TransferPolicy);
+}
 
+bool CSimpleArraysTask::CheckResult(cl_command_queue CommandQueue, const char* Name)
+{
+	cl_int clErr;
+	if (m_DeviceValidation) {
+		CScopedTimer timer("ValidateOnDevice");
+		CDeviceValidator::Result result;
+		clErr = m_Validator.Compare(CommandQueue, m_dC, result);
+		V_RETURN_FALSE_CL(clErr, "Error comparing the result on the device");
+		CDeviceValidator::PrintResult(Name, result);
+		return result.IsValid();
+	}
 
 	// read back results synchronously.
 	//This command has to be blocking, since we need the data
-	clErr = clEnqueueReadBuffer(CommandQueue, m_dC, CL_TRUE, 0, m_ArraySize * sizeof(int), m_hGPUResult, 0, NULL, NULL);
-	V_RETURN_CL(clErr, "Error reading result array");
+	{
+		CScopedTimer timer("ReadBuffer");
+		clErr = CLUtil::DownloadBuffer(CommandQueue, m_dC, m_ArraySize * sizeof(int), m_hGPUResult, m_TransferPolicy);
+		V_RETURN_FALSE_CL(clErr, "Error reading result array");
+	}
+	return memcmp(m_hC, m_hGPUResult, m_ArraySize * sizeof(int)) == 0;
+}
+
+void CSimpleArraysTask::ComputeExpression(cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	CDeviceArray<cl_int> A(m_dA, m_ArraySize), B(m_dB, m_ArraySize), C(m_dC, m_ArraySize);
+
+	V_RETURN_CL(ClearResult(CommandQueue), "Error clearing the result array");
+
+	cl_kernel kernel = PrepareExpression(CommandQueue, C, A + Reverse(B));
+	if (kernel == nullptr) return;
+
+	size_t globalWorkSize = CLUtil::GetGlobalWorkSize(m_ArraySize, LocalWorkSize[0]);
+	cout << "FusedExpression A + Reverse(B):" << endl;
+	double ms = CLUtil::ProfileKernel(CommandQueue, kernel, 1, &globalWorkSize, LocalWorkSize, 1000);
+	CLUtil::PrintBandwidth("FusedExpression", 3 * sizeof(int) * m_ArraySize, ms);
+
+	m_ExpressionValid = CheckResult(CommandQueue, "FusedExpression");
 }
 
 bool CSimpleArraysTask::ValidateResults()
 {
-	return (memcmp(m_hC, m_hGPUResult, m_ArraySize * sizeof(float)) == 0);
+	bool success = true;
+
+	for (unsigned int v = 0; v < NUM_VARIANTS; v++) {
+		if (!m_VariantValid[v]) {
+			cout << "Validation of kernel " << g_VariantKernels[v] << " failed." << endl;
+			success = false;
+		}
+	}
+	if (!m_ExpressionValid) {
+		cout << "Validation of the fused expression failed." << endl;
+		success = false;
+	}
+
+	return success;
+}
+
+size_t CSimpleArraysTask::GetElementsPerItem(unsigned int Variant) const
+{
+	switch (Variant) {
+		case 1: return 4;
+		case 2: return 8;
+		case 3: return m_ElementsPerItem;
+		default: return 1;
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
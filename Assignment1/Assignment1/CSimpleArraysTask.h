@@ -21,12 +21,21 @@
 #define _CSIMPLE_ARRAYS_TASK_H
 
 #include "../Common/IComputeTask.h"
+#include "../Common/CDeviceValidator.h"
 
 //! A1/T1: Simple vector addition
+/*!
+	ComputeGPU() runs four variants of the kernel, each of them is validated:
+	one element per work-item, int4 and int8 vector loads and a grid-stride loop
+	with ElementsPerItem elements per work-item.
+	The same addition is also evaluated as fused expression A + Reverse(B) (see CExpression.h).
+*/
 class CSimpleArraysTask : public IComputeTask
 {
 public:
-	CSimpleArraysTask(size_t ArraySize);
+	enum { NUM_VARIANTS = 4 };
+
+	CSimpleArraysTask(size_t ArraySize, unsigned int ElementsPerItem = 16);
 	virtual ~CSimpleArraysTask();
 
 	// IComputeTask
@@ -41,12 +50,17 @@ public:
 
 	virtual bool ValidateResults();
 
+	// two arrays are read and one is written
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_ArraySize; Bytes = 3 * sizeof(int) * m_ArraySize; }
+
 protected:
 	//NOTE: we have two memory address spaces, so we mark pointers with a prefix
 	//to avoid confusions: 'h' - host, 'd' - device
 	
 	//number of array elements
 	size_t				m_ArraySize = 0;
+	//elements per work-item of the grid-stride variant
+	unsigned int		m_ElementsPerItem = 16;
 
 	//integer arrays on the CPU
 	int					*m_hA = nullptr, *m_hB = nullptr, *m_hC = nullptr;
@@ -55,9 +69,32 @@ protected:
 	cl_mem				m_dA = nullptr, m_dB = nullptr, m_dC = nullptr;
 	int					*m_hGPUResult = nullptr;
 
-	//OpenCL program and kernels
+	//OpenCL program and kernels (one per variant)
 	cl_program			m_Program = nullptr;
-	cl_kernel			m_Kernel = nullptr;
+	cl_kernel			m_Kernels[NUM_VARIANTS] = {};
+
+	//local work sizes found by the autotuner, zero if not tuned
+	size_t				m_TunedLocalWorkSize[NUM_VARIANTS][3] = {};
+
+	//result of the comparison with the CPU result for each variant
+	bool				m_VariantValid[NUM_VARIANTS] = {};
+	bool				m_ExpressionValid = false;
+
+	//compares the results on the device instead of reading them back (see CDeviceValidator)
+	CDeviceValidator	m_Validator;
+	bool				m_DeviceValidation = false;
+
+	//clears m_dC, so a variant cannot pass with the values of the previous one
+	cl_int ClearResult(cl_command_queue CommandQueue);
+
+	//compares m_dC with the CPU result
+	bool CheckResult(cl_command_queue CommandQueue, const char* Name);
+
+	//runs the addition as generated kernel and compares it with the CPU result
+	void ComputeExpression(cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	//number of elements a work-item of the variant processes
+	size_t GetElementsPerItem(unsigned int Variant) const;
 };
 
 #endif // _CSIMPLE_ARRAYS_TASK_H
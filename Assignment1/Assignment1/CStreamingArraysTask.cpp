@@ -0,0 +1,205 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CStreamingArraysTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CEventGraph.h"
+#include "../Common/CThreadPool.h"
+#include "../Common/CBenchmark.h"
+
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CStreamingArraysTask
+
+CStreamingArraysTask::CStreamingArraysTask(size_t ArraySize, size_t ChunkSize, unsigned int NumBufferSets)
+	: m_ArraySize(ArraySize), m_ChunkSize(ChunkSize > 0 ? ChunkSize : 1), m_NumBufferSets(max(NumBufferSets, 2u)),
+	m_hA(NULL), m_hB(NULL), m_hC(NULL), m_hGPUResult(NULL), m_Program(NULL), m_Kernel(NULL),
+	m_SerialValid(false), m_OverlappedValid(false)
+{
+}
+
+CStreamingArraysTask::~CStreamingArraysTask()
+{
+	ReleaseResources();
+}
+
+bool CStreamingArraysTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	//CPU resources, the whole arrays only exist on the host
+	m_hA = CLUtil::AllocHostArray<int>(m_ArraySize);
+	m_hB = CLUtil::AllocHostArray<int>(m_ArraySize);
+	m_hC = new int[m_ArraySize];
+	m_hGPUResult = CLUtil::AllocHostArray<int>(m_ArraySize);
+
+	for(size_t i = 0; i < m_ArraySize; i++)
+	{
+		m_hA[i] = rand() % 1024;
+		m_hB[i] = rand() % 1024;
+	}
+
+	// the buffer sets should not take more than a quarter of the device memory
+	cl_ulong maxAlloc = 0, globalMem = 0;
+	clGetDeviceInfo(Device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAlloc), &maxAlloc, NULL);
+	clGetDeviceInfo(Device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(globalMem), &globalMem, NULL);
+	size_t maxChunk = size_t(min<cl_ulong>(maxAlloc, globalMem / (4 * 3 * m_NumBufferSets)) / sizeof(int));
+	if(maxChunk > 0 && m_ChunkSize > maxChunk)
+	{
+		cout << "Reducing the chunk size to " << maxChunk << " elements to fit into device memory" << endl;
+		m_ChunkSize = maxChunk;
+	}
+	m_ChunkSize = max<size_t>(1, min(m_ChunkSize, m_ArraySize));
+
+	//device resources, always copied chunk by chunk (the transfer policy does not apply)
+	cl_int clError;
+	m_BufferSets.resize(m_NumBufferSets);
+	for(unsigned int i = 0; i < m_NumBufferSets; i++)
+	{
+		BufferSet& set = m_BufferSets[i];
+		set.A = CreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_int) * m_ChunkSize, &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+		set.B = CreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_int) * m_ChunkSize, &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+		set.C = CreateBuffer(Context, CL_MEM_WRITE_ONLY, sizeof(cl_int) * m_ChunkSize, &clError);
+		V_RETURN_FALSE_CL(clError, "Failed to create buffer on device");
+	}
+
+	string programCode;
+	if(!CLUtil::LoadProgramSourceToMemory("../Assignment1/VectorAdd.cl", programCode))
+		return false;
+	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode);
+	if(m_Program == nullptr) return false;
+
+	// the arguments are set per chunk
+	m_Kernel = clCreateKernel(m_Program, "VecAdd", &clError);
+	V_RETURN_FALSE_CL(clError, "Failed to create kernel: VecAdd");
+
+	return true;
+}
+
+void CStreamingArraysTask::ReleaseResources()
+{
+	for(size_t i = 0; i < m_BufferSets.size(); i++)
+	{
+		ReleaseBuffer(m_BufferSets[i].A);
+		ReleaseBuffer(m_BufferSets[i].B);
+		ReleaseBuffer(m_BufferSets[i].C);
+	}
+	m_BufferSets.clear();
+
+	SAFE_RELEASE_KERNEL(m_Kernel);
+	SAFE_RELEASE_PROGRAM(m_Program);
+
+	CLUtil::FreeHostArray(m_hA);
+	CLUtil::FreeHostArray(m_hB);
+	SAFE_DELETE_ARRAY(m_hC);
+	CLUtil::FreeHostArray(m_hGPUResult);
+}
+
+void CStreamingArraysTask::ComputeCPU()
+{
+	CThreadPool::Get().ParallelFor(0, m_ArraySize, 65536, [&](size_t Begin, size_t End) {
+		for(size_t i = Begin; i < End; i++)
+		{
+			m_hC[i] = m_hA[i] + m_hB[m_ArraySize - i - 1];
+		}
+	});
+}
+
+double CStreamingArraysTask::RunStreaming(cl_command_queue CommandQueue, size_t LocalWorkSize, bool Concurrent)
+{
+	// clear the result, so the second run cannot pass with the values of the first one
+	memset(m_hGPUResult, 0, m_ArraySize * sizeof(int));
+
+	size_t numChunks = (m_ArraySize + m_ChunkSize - 1) / m_ChunkSize;
+	vector<CEventGraph::NodeId> reads(numChunks, -1);
+
+	CEventGraph graph(CommandQueue, Concurrent);
+	for(size_t k = 0; k < numChunks; k++)
+	{
+		size_t first = k * m_ChunkSize;
+		size_t count = min(m_ChunkSize, m_ArraySize - first);
+		const BufferSet& set = m_BufferSets[k % m_NumBufferSets];
+
+		// the download of the previous chunk in this buffer set also waited for its kernel
+		CEventGraph::Dependencies reuse;
+		if(k >= m_NumBufferSets)
+			reuse.push_back(reads[k - m_NumBufferSets]);
+
+		CEventGraph::NodeId writeA = graph.EnqueueWriteBuffer(set.A, 0, count * sizeof(int), m_hA + first, reuse);
+		CEventGraph::NodeId writeB = graph.EnqueueWriteBuffer(set.B, 0, count * sizeof(int), m_hB + m_ArraySize - first - count, { writeA });
+
+		cl_int numElements = (cl_int)count;
+		cl_int clError = clSetKernelArg(m_Kernel, 0, sizeof(cl_mem), (void*)&set.A);
+		clError |= clSetKernelArg(m_Kernel, 1, sizeof(cl_mem), (void*)&set.B);
+		clError |= clSetKernelArg(m_Kernel, 2, sizeof(cl_mem), (void*)&set.C);
+		clError |= clSetKernelArg(m_Kernel, 3, sizeof(cl_int), (void*)&numElements);
+		if(clError != CL_SUCCESS)
+		{
+			cerr << "Error: Failed to set kernel args: VecAdd [" << CLUtil::GetCLErrorString(clError) << "]" << endl;
+			return -1;
+		}
+
+		size_t globalWorkSize = CLUtil::GetGlobalWorkSize(count, LocalWorkSize);
+		CEventGraph::NodeId kernel = graph.EnqueueKernel(m_Kernel, 1, &globalWorkSize, &LocalWorkSize, { writeB });
+		reads[k] = graph.EnqueueReadBuffer(set.C, 0, count * sizeof(int), m_hGPUResult + first, { kernel });
+	}
+
+	if(graph.Finish() != CL_SUCCESS)
+		return -1;
+	graph.PrintSummary(Concurrent ? "Streaming (overlapped)" : "Streaming (serialized)");
+	return graph.GetElapsedMilliseconds();
+}
+
+void CStreamingArraysTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	size_t numChunks = (m_ArraySize + m_ChunkSize - 1) / m_ChunkSize;
+	cout << "Streaming " << m_ArraySize << " elements in " << numChunks << " chunks of " << m_ChunkSize
+		<< " elements through " << m_NumBufferSets << " buffer sets" << endl;
+
+	double serialMs = RunStreaming(CommandQueue, LocalWorkSize[0], false);
+	m_SerialValid = serialMs >= 0 && memcmp(m_hC, m_hGPUResult, m_ArraySize * sizeof(int)) == 0;
+
+	double overlappedMs = RunStreaming(CommandQueue, LocalWorkSize[0], true);
+	m_OverlappedValid = overlappedMs >= 0 && memcmp(m_hC, m_hGPUResult, m_ArraySize * sizeof(int)) == 0;
+
+	if(serialMs < 0 || overlappedMs < 0)
+	{
+		cerr << "Error streaming the arrays through the device" << endl;
+		return;
+	}
+
+	cout << "  serialized: " << serialMs << " ms, overlapped: " << overlappedMs << " ms";
+	if(overlappedMs > 0)
+		cout << " (speedup " << serialMs / overlappedMs << ")";
+	cout << endl;
+	// the time includes the transfers, so this is the bandwidth seen by the host arrays
+	CLUtil::PrintBandwidth("Streaming", 3 * sizeof(int) * m_ArraySize, overlappedMs);
+
+	CBenchmarkRecorder::ReportTime("stream_serialized", serialMs);
+	CBenchmarkRecorder::ReportTime("stream_overlapped", overlappedMs);
+}
+
+bool CStreamingArraysTask::ValidateResults()
+{
+	bool success = true;
+	if(!m_SerialValid)
+	{
+		cout << "Validation of the serialized streaming failed." << endl;
+		success = false;
+	}
+	if(!m_OverlappedValid)
+	{
+		cout << "Validation of the overlapped streaming failed." << endl;
+		success = false;
+	}
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,88 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CSTREAMING_ARRAYS_TASK_H
+#define _CSTREAMING_ARRAYS_TASK_H
+
+#include "../Common/IComputeTask.h"
+
+#include <vector>
+
+//! A1/T1 streaming: the vector addition of CSimpleArraysTask on arrays which need not fit into device memory
+/*!
+	The arrays stay on the host and are processed in chunks of ChunkSize elements.
+	Each chunk is uploaded into one of NumBufferSets sets of device buffers, added with
+	the VecAdd kernel and downloaded again. The commands form a CEventGraph on several
+	queues, so the upload of chunk k+1, the kernel of chunk k and the download of chunk k-1
+	can run at the same time. A buffer set is only overwritten after the download of the
+	chunk which used it before.
+
+	Since B is read backwards, chunk [s, s+n) of C needs B[size-s-n, size-s), which is again
+	a contiguous range and the kernel reverses it within the chunk.
+
+	ComputeGPU() runs the same chunks once serialized on one queue and once overlapped
+	and compares the times. Both results are validated.
+*/
+class CStreamingArraysTask : public IComputeTask
+{
+public:
+	CStreamingArraysTask(size_t ArraySize, size_t ChunkSize = 1 << 20, unsigned int NumBufferSets = 3);
+	virtual ~CStreamingArraysTask();
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// two arrays are read and one is written, each of them is transferred once
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_ArraySize; Bytes = 3 * sizeof(int) * m_ArraySize; }
+
+protected:
+	//! Device buffers for one chunk
+	struct BufferSet
+	{
+		cl_mem	A, B, C;
+	};
+
+	//! Streams all chunks through the device and returns the host time in ms, or -1 on failure
+	double RunStreaming(cl_command_queue CommandQueue, size_t LocalWorkSize, bool Concurrent);
+
+	size_t				m_ArraySize;
+	size_t				m_ChunkSize;
+	unsigned int		m_NumBufferSets;
+
+	int					*m_hA, *m_hB, *m_hC;
+	int					*m_hGPUResult;
+
+	std::vector<BufferSet>	m_BufferSets;
+
+	cl_program			m_Program;
+	cl_kernel			m_Kernel;
+
+	//! result of the serialized and of the overlapped run
+	bool				m_SerialValid, m_OverlappedValid;
+};
+
+#endif // _CSTREAMING_ARRAYS_TASK_H
@@ -0,0 +1,128 @@
+// Permutations of the elements of a matrix (transpose, rotations, flips)
+//
+// compile-time parameters (see CMatrixPermuteTask):
+//   T            element type (half matrices are moved as ushort, no fp16 support is needed)
+//   PERMUTATION  0: transpose, 1: rotate 90 degrees clockwise, 2: rotate 180 degrees,
+//                3: rotate 270 degrees clockwise, 4: flip horizontally, 5: flip vertically
+
+// position of the input element (x, y) of a W x H matrix in the output matrix
+inline int2 Forward(int x, int y, int W, int H)
+{
+#if PERMUTATION == 0
+	return (int2)(y, x);
+#elif PERMUTATION == 1
+	return (int2)(H - 1 - y, x);
+#elif PERMUTATION == 2
+	return (int2)(W - 1 - x, H - 1 - y);
+#elif PERMUTATION == 3
+	return (int2)(y, W - 1 - x);
+#elif PERMUTATION == 4
+	return (int2)(W - 1 - x, y);
+#else
+	return (int2)(x, H - 1 - y);
+#endif
+}
+
+// input element which is moved to the output position (ox, oy)
+inline int2 Inverse(int ox, int oy, int W, int H)
+{
+#if PERMUTATION == 0
+	return (int2)(oy, ox);
+#elif PERMUTATION == 1
+	return (int2)(oy, H - 1 - ox);
+#elif PERMUTATION == 2
+	return (int2)(W - 1 - ox, H - 1 - oy);
+#elif PERMUTATION == 3
+	return (int2)(W - 1 - oy, ox);
+#elif PERMUTATION == 4
+	return (int2)(W - 1 - ox, oy);
+#else
+	return (int2)(ox, H - 1 - oy);
+#endif
+}
+
+// width of the output matrix
+inline int OutputWidth(int W, int H)
+{
+#if PERMUTATION == 0 || PERMUTATION == 1 || PERMUTATION == 3
+	return H;
+#else
+	return W;
+#endif
+}
+
+// every work-group reads a square tile (the local size must be square) in rows,
+// and writes the permuted tile in rows of the output matrix
+// tile: local size * (local size + 1) elements, the padding column moves the
+// elements of a tile column into different banks
+__kernel void Permute(__global const T* M, __global T* MR, int W, int H, __local T* tile)
+{
+	int tileSize = get_local_size(0);
+	int pitch = tileSize + 1;
+	int2 LID = (int2)(get_local_id(0), get_local_id(1));
+	int2 origin = (int2)(get_group_id(0), get_group_id(1)) * tileSize;
+
+	// edge tiles are only partially filled
+	int2 GID = origin + LID;
+	if (GID.x < W && GID.y < H) {
+		tile[LID.y * pitch + LID.x] = M[GID.y * W + GID.x];
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// the permuted tile covers the rectangle between the images of two opposite corners
+	int2 a = Forward(origin.x, origin.y, W, H);
+	int2 b = Forward(origin.x + tileSize - 1, origin.y + tileSize - 1, W, H);
+	int2 out = min(a, b) + LID;
+
+	// positions outside of the matrix map to elements outside of it
+	int2 src = Inverse(out.x, out.y, W, H);
+	if (src.x >= 0 && src.x < W && src.y >= 0 && src.y < H) {
+		MR[out.y * OutputWidth(W, H) + out.x] = tile[(src.y - origin.y) * pitch + (src.x - origin.x)];
+	}
+}
+
+// in-place version for a N x N matrix: every work-item moves one cycle of the permutation
+// (two elements, or four for the rotations by 90 and 270 degrees)
+// the accesses are not coalesced, it trades bandwidth for the second buffer
+__kernel void PermuteInPlace(__global T* M, int N)
+{
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+
+#if PERMUTATION == 1 || PERMUTATION == 3
+	// one quarter of the matrix starts all cycles (the center of an odd matrix stays)
+	if (x >= (N + 1) / 2 || y >= N / 2) { return; }
+
+	int2 p0 = (int2)(x, y);
+	int2 p1 = Forward(p0.x, p0.y, N, N);
+	int2 p2 = Forward(p1.x, p1.y, N, N);
+	int2 p3 = Forward(p2.x, p2.y, N, N);
+	T v0 = M[p0.y * N + p0.x];
+	T v1 = M[p1.y * N + p1.x];
+	T v2 = M[p2.y * N + p2.x];
+	T v3 = M[p3.y * N + p3.x];
+	M[p1.y * N + p1.x] = v0;
+	M[p2.y * N + p2.x] = v1;
+	M[p3.y * N + p3.x] = v2;
+	M[p0.y * N + p0.x] = v3;
+#else
+	if (x >= N || y >= N) { return; }
+
+	// only the first element of every pair swaps
+#if PERMUTATION == 0
+	if (y >= x) { return; }
+#elif PERMUTATION == 2
+	if (y * N + x >= N * N - 1 - (y * N + x)) { return; }
+#elif PERMUTATION == 4
+	if (x >= N / 2) { return; }
+#else
+	if (y >= N / 2) { return; }
+#endif
+
+	int2 q = Forward(x, y, N, N);
+	T v = M[y * N + x];
+	M[y * N + x] = M[q.y * N + q.x];
+	M[q.y * N + q.x] = v;
+#endif
+}
@@ -80,4 +80,53 @@ __kernel void MatrixRotOptimized(__global const float* M, __global float* MR, ui
 
 	//MR[GID.y]
 }
- 
\ No newline at end of file
+ 
+
+// rotates the tile of the current work-group of a W x H matrix (any size, the tile is
+// local size x local size), used by the batched kernels
+// tile: local size * (local size + 1) floats, the padding keeps the columns in different banks
+inline void RotateTile(__global const float* M, __global float* MR, int W, int H, __local float* tile)
+{
+	int tileSize = get_local_size(0);
+	int pitch = tileSize + 1;
+	int2 LID = (int2)(get_local_id(0), get_local_id(1));
+	int2 origin = (int2)(get_group_id(0), get_group_id(1)) * tileSize;
+
+	int2 GID = origin + LID;
+	if (GID.x < W && GID.y < H) {
+		tile[LID.y * pitch + LID.x] = M[GID.y * W + GID.x];
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// the element (x, y) moves to (H - 1 - y, x), the rotated tile starts at the
+	// rotated lower left corner of the tile, which may be left of the matrix for edge tiles
+	int2 out = (int2)(H - origin.y - tileSize, origin.x) + LID;
+	int srcX = out.y;
+	int srcY = H - 1 - out.x;
+	if (out.x >= 0 && srcX < W) {
+		MR[out.y * H + out.x] = tile[(srcY - origin.y) * pitch + (srcX - origin.x)];
+	}
+}
+
+// rotates a batch of equally sized matrices stored one after the other,
+// the third dimension is the index of the matrix (starting at FirstMatrix)
+__kernel void MatrixRotBatched(__global const float* M, __global float* MR, uint SizeX, uint SizeY,
+							int FirstMatrix, __local float* tile)
+{
+	size_t offset = (size_t)(FirstMatrix + get_global_id(2)) * SizeX * SizeY;
+	RotateTile(M + offset, MR + offset, SizeX, SizeY, tile);
+}
+
+// rotates a batch of matrices of different sizes, Descriptors holds (offset, SizeX, SizeY, 0)
+// of each matrix; the first two dimensions cover the largest matrix
+__kernel void MatrixRotBatchedTable(__global const float* M, __global float* MR, __global const uint4* Descriptors,
+							int FirstMatrix, __local float* tile)
+{
+	uint4 desc = Descriptors[FirstMatrix + get_global_id(2)];
+
+	// whole work-groups outside of a smaller matrix leave before the barrier
+	if (get_group_id(0) * get_local_size(0) >= desc.y || get_group_id(1) * get_local_size(1) >= desc.z) { return; }
+
+	RotateTile(M + desc.x, MR + desc.x, desc.y, desc.z, tile);
+}
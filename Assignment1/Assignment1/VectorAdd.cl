@@ -7,5 +7,49 @@ __kernel void VecAdd(__global const int* a, __global const int* b, __global int*
 	return;
 }
 
+// every work-item adds 4 consecutive elements with vector loads,
+// the last work-item falls back to scalar code if numElements is not a multiple of 4
+__kernel void VecAdd4(__global const int* a, __global const int* b, __global int* c, int numElements) {
+
+	int i = get_global_id(0) * 4;
+	if (i >= numElements) { return; }
+	if (i + 4 <= numElements) {
+		// b is read backwards: the chunk ends at numElements - i - 1
+		int4 va = vload4(0, a + i);
+		int4 vb = vload4(0, b + numElements - i - 4).s3210;
+		vstore4(va + vb, 0, c + i);
+	} else {
+		for (; i < numElements; i++) {
+			c[i] = a[i] + b[numElements - i - 1];
+		}
+	}
+}
+
+// same as VecAdd4 with 8 elements per work-item
+__kernel void VecAdd8(__global const int* a, __global const int* b, __global int* c, int numElements) {
+
+	int i = get_global_id(0) * 8;
+	if (i >= numElements) { return; }
+	if (i + 8 <= numElements) {
+		int8 va = vload8(0, a + i);
+		int8 vb = vload8(0, b + numElements - i - 8).s76543210;
+		vstore8(va + vb, 0, c + i);
+	} else {
+		for (; i < numElements; i++) {
+			c[i] = a[i] + b[numElements - i - 1];
+		}
+	}
+}
+
+// grid-stride loop: the grid is smaller than the array and every work-item
+// handles the elements GID, GID + global size, ... (coalesced in every iteration)
+__kernel void VecAddStrided(__global const int* a, __global const int* b, __global int* c, int numElements) {
+
+	int stride = get_global_size(0);
+	for (int i = get_global_id(0); i < numElements; i += stride) {
+		c[i] = a[i] + b[numElements - i - 1];
+	}
+}
+
 
 
@@ -7,9 +7,16 @@ GPU Computing / GPGPU Praktikum source code.
 
 #include "CLUtil.h"
 #include "CTimer.h"
+#include "CDeviceValidator.h"
+#include "CEventGraph.h"
+#include "CThreadPool.h"
+#include "CTrace.h"
 
 #include <vector>
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <stdlib.h>
 
 using namespace std;
 
@@ -36,7 +43,9 @@ using namespace std;
 // CAssignmentBase
 
 CAssignmentBase::CAssignmentBase()
-	: m_CLPlatform(nullptr), m_CLDevice(nullptr), m_CLContext(nullptr), m_CLCommandQueue(nullptr)
+	: m_CLPlatform(nullptr), m_CLDevice(nullptr), m_CLContext(nullptr), m_CLCommandQueue(nullptr),
+	m_ProfilingEnabled(true), m_BufferPoolEnabled(true), m_TransferPolicy(TRANSFER_COPY), m_TuningDatabase("autotune.txt"),
+	m_DeviceType(0), m_DeviceIndex(-1), m_ListDevices(false)
 {
 }
 
@@ -45,8 +54,17 @@ CAssignmentBase::~CAssignmentBase()
 	ReleaseCLContext();
 }
 
-bool CAssignmentBase::EnterMainLoop(int, char**)
+bool CAssignmentBase::EnterMainLoop(int argc, char** argv)
 {
+	if (!ParseCommandLine(argc, argv))
+		return false;
+
+	if(m_ListDevices)
+	{
+		ListDevices();
+		return true;
+	}
+
 	if(!InitCLContext())
 		return false;
 
@@ -54,87 +72,321 @@ bool CAssignmentBase::EnterMainLoop(int, char**)
 
 	ReleaseCLContext();
 
+	WriteTrace();
+
 	return success;
 }
 
-#define PRINT_INFO(title, buffer, bufferSize, maxBufferSize, expr) { expr; buffer[bufferSize] = '\0'; std::cout << title << ": " << buffer << std::endl; }
+bool CAssignmentBase::ParseCommandLine(int argc, char** argv)
+{
+	// defaults from the environment, the command line takes precedence
+	const char* env;
+	if ((env = getenv("CL_DEVICE_TYPE")) && !SetDeviceType(env))
+		return false;
+	if ((env = getenv("CL_PLATFORM")))
+		m_PlatformFilter = env;
+	if ((env = getenv("CL_DEVICE")))
+		m_DeviceIndex = atoi(env);
 
-bool CAssignmentBase::InitCLContext()
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--no-profiling")
+			m_ProfilingEnabled = false;
+		else if (arg == "--trace" && i + 1 < argc)
+			m_TraceFile = argv[++i];
+		else if (arg == "--cpu-threads" && i + 1 < argc)
+			CThreadPool::SetNumThreads((unsigned int)atoi(argv[++i]));
+		else if (arg == "--out-of-order")
+			CEventGraph::SetOutOfOrderEnabled(true);
+		else if (arg == "--device-validation")
+			CDeviceValidator::SetEnabled(true);
+		else if (arg == "--no-buffer-pool")
+			m_BufferPoolEnabled = false;
+		else if (arg == "--transfer" && i + 1 < argc)
+		{
+			string policy = argv[++i];
+			if(policy == "copy")
+				m_TransferPolicy = TRANSFER_COPY;
+			else if(policy == "zero-copy")
+				m_TransferPolicy = TRANSFER_ZERO_COPY;
+			else if(policy == "auto")
+				m_TransferPolicy = TRANSFER_AUTO;
+			else
+			{
+				cerr<<"Unknown transfer policy: "<<policy<<" (expected copy, zero-copy or auto)"<<endl;
+				return false;
+			}
+		}
+		else if (arg == "--autotune")
+			m_AutoTuner.SetEnabled(true);
+		else if (arg == "--retune")
+		{
+			m_AutoTuner.SetEnabled(true);
+			m_AutoTuner.SetRetune(true);
+		}
+		else if (arg == "--tuning-db" && i + 1 < argc)
+			m_TuningDatabase = argv[++i];
+		else if (arg == "--peak-bandwidth" && i + 1 < argc)
+			CLUtil::SetPeakBandwidth(atof(argv[++i]));
+		else if(arg == "--device-type" && i + 1 < argc)
+		{
+			if(!SetDeviceType(argv[++i]))
+				return false;
+		}
+		else if(arg == "--platform" && i + 1 < argc)
+			m_PlatformFilter = argv[++i];
+		else if(arg == "--device" && i + 1 < argc)
+			m_DeviceIndex = atoi(argv[++i]);
+		else if(arg == "--list-devices")
+			m_ListDevices = true;
+		else
+		{
+			cerr<<"Unknown command line option: "<<arg<<endl;
+			return false;
+		}
+	}
+
+	// spans are only recorded if somebody wants to see them
+	CTraceRecorder::SetEnabled(!m_TraceFile.empty());
+
+	return true;
+}
+
+bool CAssignmentBase::SetDeviceType(const std::string& Type)
 {
-	//////////////////////////////////////////////////////
-	//(Sect 4.3)
+	string type = Type;
+	transform(type.begin(), type.end(), type.begin(), ::tolower);
+
+	if(type == "gpu")
+		m_DeviceType = CL_DEVICE_TYPE_GPU;
+	else if(type == "cpu")
+		m_DeviceType = CL_DEVICE_TYPE_CPU;
+	else if(type == "accelerator")
+		m_DeviceType = CL_DEVICE_TYPE_ACCELERATOR;
+	else if(type == "all")
+		m_DeviceType = CL_DEVICE_TYPE_ALL;
+	else
+	{
+		cerr<<"Unknown device type: "<<Type<<" (expected gpu, cpu, accelerator or all)"<<endl;
+		return false;
+	}
+	return true;
+}
 
-	// 1. get all platform IDs
+void CAssignmentBase::WriteTrace()
+{
+	if(!m_TraceFile.empty())
+		CTraceRecorder::WriteChromeTrace(m_TraceFile);
+}
 
-	std::vector<cl_platform_id> platformIds;
-	const cl_uint c_MaxPlatforms = 16;
-	platformIds.resize(c_MaxPlatforms);
+cl_command_queue_properties CAssignmentBase::GetCommandQueueProperties() const
+{
+	return m_ProfilingEnabled ? CL_QUEUE_PROFILING_ENABLE : 0;
+}
 
-	cl_uint countPlatforms;
-	V_RETURN_FALSE_CL(clGetPlatformIDs(c_MaxPlatforms, &platformIds[0], &countPlatforms), "Failed to get CL platform ID");
-	platformIds.resize(countPlatforms);
+#define PRINT_INFO(title, buffer, bufferSize, maxBufferSize, expr) { expr; buffer[bufferSize] = '\0'; std::cout << title << ": " << buffer << std::endl; }
 
-	// 2. find all available GPU devices
-	std::vector<cl_device_id> deviceIds;
-	const int maxDevices = 16;
-	deviceIds.resize(maxDevices);
-	int countAllDevices = 0;
+// case insensitive substring search
+static bool ContainsIgnoreCase(std::string Str, std::string Pattern)
+{
+	transform(Str.begin(), Str.end(), Str.begin(), ::tolower);
+	transform(Pattern.begin(), Pattern.end(), Pattern.begin(), ::tolower);
+	return Str.find(Pattern) != string::npos;
+}
+
+static string GetPlatformString(cl_platform_id Platform, cl_platform_info Info)
+{
+	char buffer[1024] = "";
+	clGetPlatformInfo(Platform, Info, sizeof(buffer) - 1, buffer, NULL);
+	return buffer;
+}
 
-	// Searching for the graphics device with the most dedicated video memory.
+static string GetDeviceString(cl_device_id Device, cl_device_info Info)
+{
+	char buffer[8192] = "";
+	clGetDeviceInfo(Device, Info, sizeof(buffer) - 1, buffer, NULL);
+	return buffer;
+}
 
-	cl_device_type deviceType = CL_DEVICE_TYPE_GPU;
+static vector<cl_platform_id> GetPlatforms()
+{
+	cl_uint countPlatforms = 0;
+	if(clGetPlatformIDs(0, NULL, &countPlatforms) != CL_SUCCESS || countPlatforms == 0)
+		return vector<cl_platform_id>();
 
-	cl_ulong maxGlobalMemorySize = 0;
-	cl_device_id bestDeviceId = NULL;
+	vector<cl_platform_id> platformIds(countPlatforms);
+	clGetPlatformIDs(countPlatforms, &platformIds[0], NULL);
+	return platformIds;
+}
 
-	for (size_t i = 0; i < platformIds.size(); i++)
+static vector<cl_device_id> GetDevices(cl_platform_id Platform, cl_device_type DeviceType)
+{
+	cl_uint countDevices = 0;
+	cl_int res = clGetDeviceIDs(Platform, DeviceType, 0, NULL, &countDevices);
+	// Maybe there are no devices of this type and some poor implementation doesn't set count devices to zero and return CL_DEVICE_NOT_FOUND.
+	if(res != CL_SUCCESS || countDevices == 0)
 	{
-		// Getting the available devices.
-		cl_uint countDevices;
-		auto res = clGetDeviceIDs(platformIds[i], deviceType, 1, &deviceIds[countAllDevices], &countDevices);
-		if (res != CL_SUCCESS) // Maybe there are no GPU devices and some poor implementation doesn't set count devices to zero and return CL_DEVICE_NOT_FOUND.
-		{
-			char buffer[1024];
-			clGetPlatformInfo(platformIds[i], CL_PLATFORM_NAME, 1024, buffer, nullptr);
+		if(res != CL_SUCCESS && res != CL_DEVICE_NOT_FOUND)
 			printf("[WARNING]: clGetDeviceIDs() failed. Error type: %s, Platform name: %s!\n",
-				CLUtil::GetCLErrorString(res), buffer);
-			continue;
-		}
-		for (size_t j = 0; j < countDevices; j++)
+				CLUtil::GetCLErrorString(res), GetPlatformString(Platform, CL_PLATFORM_NAME).c_str());
+		return vector<cl_device_id>();
+	}
+
+	vector<cl_device_id> deviceIds(countDevices);
+	clGetDeviceIDs(Platform, DeviceType, countDevices, &deviceIds[0], NULL);
+	return deviceIds;
+}
+
+bool CAssignmentBase::GetMatchingDevices(std::vector<cl_device_id>& Devices)
+{
+	vector<cl_platform_id> platformIds = GetPlatforms();
+	if(platformIds.empty())
+	{
+		cerr<<"No OpenCL platform was found."<<endl;
+		return false;
+	}
+
+	// without an explicit type we prefer GPUs, but also run on CPU-only hosts
+	vector<cl_device_type> types;
+	if(m_DeviceType == 0)
+	{
+		types.push_back(CL_DEVICE_TYPE_GPU);
+		types.push_back(CL_DEVICE_TYPE_ALL);
+	}
+	else
+		types.push_back(m_DeviceType);
+
+	Devices.clear();
+	for(size_t t = 0; t < types.size() && Devices.empty(); t++)
+	{
+		for(size_t i = 0; i < platformIds.size(); i++)
 		{
-			cl_device_id currentDeviceId = deviceIds[countAllDevices + j];
-			cl_ulong globalMemorySize;
-			cl_bool isUsingUnifiedMemory;
-			clGetDeviceInfo(currentDeviceId, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &globalMemorySize, NULL);
-			clGetDeviceInfo(currentDeviceId, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &isUsingUnifiedMemory, NULL);
+			if(!m_PlatformFilter.empty() && !ContainsIgnoreCase(GetPlatformString(platformIds[i], CL_PLATFORM_NAME), m_PlatformFilter))
+				continue;
 
-			if (!isUsingUnifiedMemory && globalMemorySize > maxGlobalMemorySize)
+			vector<cl_device_id> deviceIds = GetDevices(platformIds[i], types[t]);
+			for(size_t j = 0; j < deviceIds.size(); j++)
 			{
-				bestDeviceId = currentDeviceId;
-				maxGlobalMemorySize = globalMemorySize;
+				if(!m_RequiredExtension.empty() && GetDeviceString(deviceIds[j], CL_DEVICE_EXTENSIONS).find(m_RequiredExtension) == string::npos)
+					continue;
+				Devices.push_back(deviceIds[j]);
 			}
 		}
 
-		countAllDevices += countDevices;
+		if(Devices.empty() && t + 1 < types.size())
+			cout<<"No GPU with OpenCL support was found, trying all device types."<<endl;
 	}
-	deviceIds.resize(countAllDevices);
 
-	if (countAllDevices == 0)
+	return true;
+}
+
+bool CAssignmentBase::SelectDevice()
+{
+	vector<cl_device_id> deviceIds;
+	if(!GetMatchingDevices(deviceIds))
+		return false;
+
+	if(deviceIds.empty())
 	{
-		std::cout << "No device of the selected type with OpenCL support was found.";
+		std::cout << "No device of the selected type with OpenCL support was found." << std::endl;
 		return false;
 	}
 
-	// No discrete graphics device was found: falling back to the first found device.
-	if (bestDeviceId == NULL)
+	cl_device_id bestDeviceId = NULL;
+
+	if(m_DeviceIndex >= 0)
 	{
-		bestDeviceId = deviceIds[0];
+		if(m_DeviceIndex >= (int)deviceIds.size())
+		{
+			cerr<<"Device index "<<m_DeviceIndex<<" is out of range, "<<deviceIds.size()<<" matching devices were found (see --list-devices)."<<endl;
+			return false;
+		}
+		bestDeviceId = deviceIds[m_DeviceIndex];
+	}
+	else
+	{
+		// Searching for the graphics device with the most dedicated video memory.
+		cl_ulong maxGlobalMemorySize = 0;
+		for(size_t i = 0; i < deviceIds.size(); i++)
+		{
+			cl_device_type type;
+			cl_ulong globalMemorySize;
+			cl_bool isUsingUnifiedMemory;
+			clGetDeviceInfo(deviceIds[i], CL_DEVICE_TYPE, sizeof(cl_device_type), &type, NULL);
+			clGetDeviceInfo(deviceIds[i], CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &globalMemorySize, NULL);
+			clGetDeviceInfo(deviceIds[i], CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &isUsingUnifiedMemory, NULL);
+
+			if((type & CL_DEVICE_TYPE_GPU) && !isUsingUnifiedMemory && globalMemorySize > maxGlobalMemorySize)
+			{
+				bestDeviceId = deviceIds[i];
+				maxGlobalMemorySize = globalMemorySize;
+			}
+		}
+
+		// No discrete graphics device was found: falling back to the first found device.
+		if(bestDeviceId == NULL)
+		{
+			bestDeviceId = deviceIds[0];
+		}
 	}
 
-	// Choosing the first available device.
 	m_CLDevice = bestDeviceId;
 	clGetDeviceInfo(m_CLDevice, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &m_CLPlatform, NULL);
 
+	return true;
+}
+
+void CAssignmentBase::ListDevices()
+{
+	vector<cl_device_id> matching;
+	GetMatchingDevices(matching);
+
+	vector<cl_platform_id> platformIds = GetPlatforms();
+	for(size_t i = 0; i < platformIds.size(); i++)
+	{
+		cout<<"Platform "<<i<<": "<<GetPlatformString(platformIds[i], CL_PLATFORM_NAME)
+			<<" ("<<GetPlatformString(platformIds[i], CL_PLATFORM_VERSION)<<")"<<endl;
+
+		vector<cl_device_id> deviceIds = GetDevices(platformIds[i], CL_DEVICE_TYPE_ALL);
+		for(size_t j = 0; j < deviceIds.size(); j++)
+		{
+			cl_device_id device = deviceIds[j];
+			cl_device_type type;
+			cl_uint computeUnits, clockFrequency;
+			cl_ulong globalMemorySize, localMemorySize;
+			size_t maxWorkGroupSize;
+			cl_bool unifiedMemory;
+			clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+			clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(computeUnits), &computeUnits, NULL);
+			clGetDeviceInfo(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(clockFrequency), &clockFrequency, NULL);
+			clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(globalMemorySize), &globalMemorySize, NULL);
+			clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localMemorySize), &localMemorySize, NULL);
+			clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxWorkGroupSize), &maxWorkGroupSize, NULL);
+			clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unifiedMemory), &unifiedMemory, NULL);
+
+			string typeName = (type & CL_DEVICE_TYPE_GPU) ? "GPU" : (type & CL_DEVICE_TYPE_CPU) ? "CPU" :
+				(type & CL_DEVICE_TYPE_ACCELERATOR) ? "Accelerator" : "Other";
+
+			// the index to pass to --device, if the device matches the other selection options
+			vector<cl_device_id>::iterator it = find(matching.begin(), matching.end(), device);
+			if(it != matching.end())
+				cout<<"  ["<<(it - matching.begin())<<"] ";
+			else
+				cout<<"  [-] ";
+
+			cout<<GetDeviceString(device, CL_DEVICE_NAME)<<" ("<<typeName<<")"<<endl;
+			cout<<"      Vendor: "<<GetDeviceString(device, CL_DEVICE_VENDOR)<<", driver "<<GetDeviceString(device, CL_DRIVER_VERSION)<<endl;
+			cout<<"      "<<GetDeviceString(device, CL_DEVICE_VERSION)<<", "<<GetDeviceString(device, CL_DEVICE_OPENCL_C_VERSION)<<endl;
+			cout<<"      Compute units: "<<computeUnits<<", clock: "<<clockFrequency<<" MHz, max work-group size: "<<maxWorkGroupSize<<endl;
+			cout<<"      Global memory: "<<(globalMemorySize >> 20)<<" MB"<<(unifiedMemory ? " (unified with host)" : "")
+				<<", local memory: "<<(localMemorySize >> 10)<<" KB"<<endl;
+		}
+	}
+}
+
+void CAssignmentBase::PrintDeviceInfo()
+{
 	// Printing platform and device data.
 	const int maxBufferSize = 1024;
 	char buffer[maxBufferSize];
@@ -152,6 +404,17 @@ bool CAssignmentBase::InitCLContext()
 	clGetDeviceInfo(m_CLDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMemorySize, &bufferSize);
 	std::cout << "Local memory size: " << localMemorySize << " Byte" << std::endl;
 	std::cout << std::endl << "******************************" << std::endl << std::endl;
+}
+
+bool CAssignmentBase::InitCLContext()
+{
+	//////////////////////////////////////////////////////
+	//(Sect 4.3)
+
+	if(!SelectDevice())
+		return false;
+
+	PrintDeviceInfo();
 
 	// Create a new OpenCL context on the selected device.
 
@@ -166,9 +429,19 @@ bool CAssignmentBase::InitCLContext()
 
 	// Create command queue
 
-	m_CLCommandQueue = clCreateCommandQueue(m_CLContext, m_CLDevice, 0, &clError);
+	m_CLCommandQueue = clCreateCommandQueue(m_CLContext, m_CLDevice, GetCommandQueueProperties(), &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create the command queue in the context.");
 
+	if (!m_DeviceCaps.Query(m_CLDevice, m_CLContext))
+		return false;
+	m_DeviceCaps.Print();
+
+	// keep at most a quarter of the device memory in released buffers
+	if (m_DeviceCaps.GlobalMemSize > 0)
+		m_BufferPool.SetMaxPooledBytes(size_t(m_DeviceCaps.GlobalMemSize / 4));
+
+	m_AutoTuner.Init(m_CLContext, m_CLDevice, m_TuningDatabase);
+
 	return true;
 }
 
@@ -180,6 +453,15 @@ void CAssignmentBase::ReleaseCLContext()
 		m_CLCommandQueue = nullptr;
 	}
 	if (m_CLContext != nullptr) {
+		m_BufferPool.PrintStatistics();
+		m_BufferPool.Clear();
+
+		// saves the tuning results and releases the tuner's queue
+		m_AutoTuner.Release();
+
+		// cached programs and kernels hold a reference to the context
+		CLUtil::ReleaseCachedObjects(m_CLContext);
+		CEventGraph::ReleaseQueues(m_CLContext);
 		clReleaseContext(m_CLContext);
 		m_CLContext = nullptr;
 	}
@@ -191,28 +473,46 @@ bool CAssignmentBase::RunComputeTask(IComputeTask& Task, size_t LocalWorkSize[3]
 	{
 		std::cerr<<"Error: RunComputeTask() cannot execute because the OpenCL context has not been created first."<<endl;
 	}
+
+	CScopedTimer taskTimer("RunComputeTask");
+
+	PrepareTask(Task);
 	
-	if(!Task.InitResources(m_CLDevice, m_CLContext))
 	{
-		std::cerr << "Error during resource allocation. Aborting execution." <<endl;
-		Task.ReleaseResources();
-		return false;
+		CScopedTimer timer("InitResources");
+		if(!Task.InitResources(m_CLDevice, m_CLContext))
+		{
+			std::cerr << "Error during resource allocation. Aborting execution." <<endl;
+			Task.ReleaseResources();
+			return false;
+		}
 	}
 
 	// Compute the golden result.
 	cout << "Computing CPU reference result...";
-	Task.ComputeCPU();
+	{
+		CScopedTimer timer("ComputeCPU");
+		Task.ComputeCPU();
+	}
 	cout << "DONE" << endl;
 
 	// Running the same task on the GPU.
 	cout << "Computing GPU result...";
 
 	// Runing the kernel N times. This make the measurement of the execution time more accurate.
-	Task.ComputeGPU(m_CLContext, m_CLCommandQueue, LocalWorkSize);
+	{
+		CScopedTimer timer("ComputeGPU");
+		Task.ComputeGPU(m_CLContext, m_CLCommandQueue, LocalWorkSize);
+	}
 	cout << "DONE" << endl;
 
 	// Validating results.
-	if (Task.ValidateResults())
+	bool valid;
+	{
+		CScopedTimer timer("ValidateResults");
+		valid = Task.ValidateResults();
+	}
+	if (valid)
 	{
 		cout << "GOLD TEST PASSED!" << endl;
 	}
@@ -222,9 +522,24 @@ bool CAssignmentBase::RunComputeTask(IComputeTask& Task, size_t LocalWorkSize[3]
 	}
 	
 	// Cleaning up.
-	Task.ReleaseResources();
+	{
+		CScopedTimer timer("ReleaseResources");
+		Task.ReleaseResources();
+	}
 
 	return true;
 }
 
+void CAssignmentBase::PrepareTask(IComputeTask& Task)
+{
+	Task.SetBufferPool(m_BufferPoolEnabled ? &m_BufferPool : nullptr);
+	Task.SetAutoTuner(&m_AutoTuner);
+	Task.SetDeviceCaps(&m_DeviceCaps);
+
+	if(Task.GetTransferPolicy() == TRANSFER_DEFAULT)
+		Task.SetTransferPolicy(m_TransferPolicy);
+	Task.SetTransferPolicy(CLUtil::ResolveTransferPolicy(m_CLDevice, Task.GetTransferPolicy()));
+	cout<<"Transfer policy: "<<CLUtil::GetTransferPolicyName(Task.GetTransferPolicy())<<endl;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,137 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CAUTO_TUNER_H
+#define _CAUTO_TUNER_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+//! Searches the fastest local work size of a kernel and keeps the winners in a per-device database
+/*!
+	The candidates are the power of two shapes which the device accepts for the kernel
+	(CL_KERNEL_WORK_GROUP_SIZE, CL_DEVICE_MAX_WORK_ITEM_SIZES) and whose number of work-items
+	is a multiple of CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE. Each candidate is launched
+	on a profiling queue of the tuner and the one with the lowest median event time wins.
+
+	Results are stored per device (name and driver version), kernel name and problem size
+	in a text file, so later runs on the same device reuse them without measuring.
+	A task consults the tuner in its InitResources() (see IComputeTask::TuneLocalWorkSize()),
+	so the kernel arguments must already be set at that time.
+
+	Tuning is disabled by default (see the --autotune option of CAssignmentBase).
+*/
+class CAutoTuner
+{
+public:
+	//! Describes a kernel launch to tune
+	struct Request
+	{
+		Request(const std::string& Name, cl_kernel Kernel, cl_uint Dimensions,
+			size_t SizeX, size_t SizeY = 1, size_t SizeZ = 1);
+
+		//! Key of the database entry, e.g. the kernel name and its variant
+		std::string		Name;
+		cl_kernel		Kernel;
+		cl_uint			Dimensions;
+		//! Number of work-items needed in each dimension, the global work size is rounded up
+		size_t			ProblemSize[3];
+		//! The local work size has to divide the problem size (for kernels without bounds checks)
+		bool			Divisible;
+		//! Called before a candidate is measured, e.g. to set local memory arguments. Returns false to skip it.
+		std::function<bool(const size_t LocalWorkSize[3])>	Prepare;
+		//! Replaces the measurement of a single launch of Kernel (e.g. for multi-pass algorithms).
+		/*!
+			Returns the time of one run in ms, or a negative value if the candidate failed.
+			Kernel is still used to determine the valid candidates.
+		*/
+		std::function<double(cl_command_queue Queue, const size_t LocalWorkSize[3])>	Measure;
+	};
+
+	CAutoTuner();
+
+	~CAutoTuner();
+
+	void SetEnabled(bool Enabled) { m_Enabled = Enabled; }
+
+	bool IsEnabled() const { return m_Enabled; }
+
+	//! Measures again also if the database already has an entry
+	void SetRetune(bool Retune) { m_Retune = Retune; }
+
+	//! Selects the device to tune for and loads the database. Call Release() before the context is released.
+	bool Init(cl_context Context, cl_device_id Device, const std::string& DatabasePath);
+
+	//! Saves the database if it was changed and releases the queue of the tuner
+	void Release();
+
+	//! Sets LocalWorkSize to the tuned shape, searching it if the database has none
+	/*!
+		Returns false and leaves LocalWorkSize unchanged if tuning is disabled or no candidate worked.
+	*/
+	bool GetLocalWorkSize(const Request& R, size_t LocalWorkSize[3]);
+
+	//! The shapes which are valid for the kernel on the device, three entries per candidate
+	void GetCandidates(const Request& R, std::vector<size_t>& Candidates) const;
+
+	bool Load(const std::string& Path);
+
+	bool Save(const std::string& Path) const;
+
+protected:
+	struct Entry
+	{
+		size_t	LocalWorkSize[3];
+		double	Milliseconds;
+	};
+
+	CAutoTuner(const CAutoTuner&);
+	CAutoTuner& operator=(const CAutoTuner&);
+
+	std::string GetKey(const Request& R) const;
+
+	//! Median time of a candidate in ms, negative if it failed
+	double MeasureCandidate(const Request& R, const size_t LocalWorkSize[3]);
+
+	bool						m_Enabled;
+	bool						m_Retune;
+	bool						m_Modified;
+
+	cl_context					m_Context;
+	cl_device_id				m_Device;
+	cl_command_queue			m_Queue;
+	std::string					m_DeviceName;
+	std::string					m_DatabasePath;
+
+	//! device, name and problem size separated by tabs
+	std::map<std::string, Entry>	m_Entries;
+};
+
+#endif // _CAUTO_TUNER_H
@@ -0,0 +1,182 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CBufferPool.h"
+
+#include <iostream>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CBufferPool
+
+// smallest size class, also the granularity of small buffers
+static const size_t c_MinSizeClass = 4096;
+
+CBufferPool::CBufferPool()
+	: m_Context(nullptr), m_MaxPooledBytes(size_t(512) << 20)
+{
+	m_Statistics.Hits = 0;
+	m_Statistics.Misses = 0;
+	m_Statistics.BytesLive = 0;
+	m_Statistics.HighWaterBytes = 0;
+	m_Statistics.BytesPooled = 0;
+}
+
+CBufferPool::~CBufferPool()
+{
+	Clear();
+}
+
+size_t CBufferPool::GetSizeClass(size_t Size)
+{
+	if(Size <= c_MinSizeClass)
+		return c_MinSizeClass;
+
+	// round up to a quarter of the largest power of two below Size
+	size_t powerOfTwo = c_MinSizeClass;
+	while(powerOfTwo <= Size / 2)
+		powerOfTwo *= 2;
+	size_t step = powerOfTwo / 4;
+	return ((Size + step - 1) / step) * step;
+}
+
+cl_mem CBufferPool::Acquire(cl_context Context, cl_mem_flags Flags, size_t Size, cl_int* pError)
+{
+	if(Flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR))
+	{
+		cerr<<"CBufferPool: buffers with host pointer flags cannot be pooled."<<endl;
+		if(pError)
+			*pError = CL_INVALID_VALUE;
+		return nullptr;
+	}
+
+	size_t size = GetSizeClass(Size);
+
+	lock_guard<mutex> lock(m_Mutex);
+
+	// buffers of another context cannot be used any more
+	if(Context != m_Context)
+	{
+		Trim(0);
+		m_Context = Context;
+	}
+
+	// smallest free buffer which is large enough, but not wasting more than half of its memory
+	size_t best = m_Free.size();
+	for(size_t i = 0; i < m_Free.size(); i++)
+	{
+		const Entry& e = m_Free[i];
+		if(e.Flags == Flags && e.Size >= size && e.Size <= 2 * size && (best == m_Free.size() || e.Size < m_Free[best].Size))
+			best = i;
+	}
+
+	Entry entry;
+	if(best < m_Free.size())
+	{
+		entry = m_Free[best];
+		m_Free.erase(m_Free.begin() + best);
+		m_Statistics.BytesPooled -= entry.Size;
+		m_Statistics.Hits++;
+		if(pError)
+			*pError = CL_SUCCESS;
+	}
+	else
+	{
+		cl_int clError;
+		entry.Buffer = clCreateBuffer(Context, Flags, size, NULL, &clError);
+		if(clError != CL_SUCCESS)
+		{
+			// the pooled buffers might be in the way, try once more without them
+			Trim(0);
+			entry.Buffer = clCreateBuffer(Context, Flags, size, NULL, &clError);
+		}
+		if(pError)
+			*pError = clError;
+		if(clError != CL_SUCCESS)
+			return nullptr;
+
+		entry.Flags = Flags;
+		entry.Size = size;
+		m_Statistics.Misses++;
+	}
+
+	m_Live[entry.Buffer] = entry;
+	m_Statistics.BytesLive += entry.Size;
+	if(m_Statistics.BytesLive > m_Statistics.HighWaterBytes)
+		m_Statistics.HighWaterBytes = m_Statistics.BytesLive;
+
+	return entry.Buffer;
+}
+
+void CBufferPool::Release(cl_mem& Buffer)
+{
+	if(Buffer == nullptr)
+		return;
+
+	lock_guard<mutex> lock(m_Mutex);
+
+	auto it = m_Live.find(Buffer);
+	if(it == m_Live.end())
+	{
+		clReleaseMemObject(Buffer);
+	}
+	else
+	{
+		m_Statistics.BytesLive -= it->second.Size;
+		m_Free.push_back(it->second);
+		m_Statistics.BytesPooled += it->second.Size;
+		m_Live.erase(it);
+
+		Trim(m_MaxPooledBytes);
+	}
+
+	Buffer = nullptr;
+}
+
+void CBufferPool::Trim(size_t MaxBytes)
+{
+	size_t n = 0;
+	while(n < m_Free.size() && m_Statistics.BytesPooled > MaxBytes)
+	{
+		clReleaseMemObject(m_Free[n].Buffer);
+		m_Statistics.BytesPooled -= m_Free[n].Size;
+		n++;
+	}
+	m_Free.erase(m_Free.begin(), m_Free.begin() + n);
+}
+
+void CBufferPool::Clear()
+{
+	lock_guard<mutex> lock(m_Mutex);
+	Trim(0);
+}
+
+void CBufferPool::SetMaxPooledBytes(size_t MaxBytes)
+{
+	lock_guard<mutex> lock(m_Mutex);
+	m_MaxPooledBytes = MaxBytes;
+	Trim(m_MaxPooledBytes);
+}
+
+CBufferPool::Statistics CBufferPool::GetStatistics() const
+{
+	lock_guard<mutex> lock(m_Mutex);
+	return m_Statistics;
+}
+
+void CBufferPool::PrintStatistics() const
+{
+	Statistics s = GetStatistics();
+	size_t requests = s.Hits + s.Misses;
+	if(requests == 0)
+		return;
+
+	cout<<"Buffer pool: "<<requests<<" allocations, "<<s.Hits<<" reused ("<<100.0 * s.Hits / requests<<"%), "
+		<<s.Misses<<" created, high-water mark "<<s.HighWaterBytes / double(1 << 20)<<" MB, "
+		<<s.BytesLive / double(1 << 20)<<" MB live, "<<s.BytesPooled / double(1 << 20)<<" MB pooled"<<endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
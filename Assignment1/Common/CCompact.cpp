@@ -0,0 +1,247 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CCompact.h"
+
+#include "CLUtil.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CCompact
+
+std::mutex CCompact::s_Mutex;
+std::map<std::pair<cl_command_queue, std::string>, CCompact::Entry> CCompact::s_Entries;
+static const bool s_ReleaseHookRegistered = CLUtil::RegisterReleaseHook(&CCompact::ReleaseKernels);
+
+static const size_t c_MaxLocalSize = 256;
+
+// the count of empty inputs, it has to stay valid until the non-blocking write is done
+static const cl_uint c_Zero = 0;
+
+// specialized by -D options: the word type W and the number of WORDS per element. With PREDICATE,
+// the element type T and Keep(x) are defined by the code in front of it (see GetEntry())
+static const char* c_CompactSource =
+	"#ifdef PREDICATE\n"
+	"__kernel void Flags(__global const T* input, ulong n, __global uint* flags)\n"
+	"{\n"
+	"\tsize_t i = get_global_id(0);\n"
+	"\tif(i < n)\n"
+	"\t\tflags[i] = Keep(input[i]);\n"
+	"}\n"
+	"#endif\n"
+	"\n"
+	"// positions is the inclusive scan of the flags: element i is kept if it differs from the one before,\n"
+	"// which is also the output position. The last work-item writes the number of kept elements.\n"
+	"__kernel void Scatter(__global const W* input, __global W* output, ulong n,\n"
+	"\t__global const uint* positions, __global uint* count)\n"
+	"{\n"
+	"\tsize_t i = get_global_id(0);\n"
+	"\tif(i >= n)\n"
+	"\t\treturn;\n"
+	"\n"
+	"\tuint end = positions[i];\n"
+	"\tuint begin = i > 0 ? positions[i - 1] : 0;\n"
+	"\tif(end != begin) {\n"
+	"\t\tfor(uint w = 0; w < WORDS; w++)\n"
+	"\t\t\toutput[(size_t)begin * WORDS + w] = input[i * WORDS + w];\n"
+	"\t}\n"
+	"\tif(i == n - 1)\n"
+	"\t\t*count = end;\n"
+	"}\n";
+
+CCompact::Entry* CCompact::GetEntry(cl_command_queue Queue, size_t ElementSize, const char* TypeName, const std::string& Predicate)
+{
+	cl_context context;
+	cl_device_id device;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+
+	// the elements are copied in the largest words which divide their size
+	static const char* wordTypes[] = { "uint4", "uint2", "uint", "ushort", "uchar" };
+	size_t wordSize = 16;
+	int word = 0;
+	while(ElementSize % wordSize != 0)
+	{
+		wordSize /= 2;
+		word++;
+	}
+
+	ostringstream options;
+	options<<"-D W="<<wordTypes[word]<<" -D WORDS="<<ElementSize / wordSize;
+	string source = c_CompactSource;
+	if(TypeName != nullptr)
+	{
+		options<<" -D PREDICATE";
+		ostringstream predicate;
+		predicate<<"// "<<Predicate<<"\n"
+			<<"#define T "<<TypeName<<"\n"
+			<<"inline uint Keep(T x) { return ("<<Predicate<<") ? 1 : 0; }\n\n";
+		source = predicate.str() + source;
+	}
+
+	string key = options.str() + "\n" + source;
+	Entry& entry = s_Entries[make_pair(Queue, key)];
+	if(entry.ScatterKernel != nullptr)
+		return &entry;
+
+	cl_program program = CLUtil::BuildCLProgramFromMemory(device, context, source, options.str());
+	if(program == nullptr)
+	{
+		s_Entries.erase(make_pair(Queue, key));
+		return nullptr;
+	}
+
+	cl_int clError = CL_SUCCESS, clError2;
+	if(TypeName != nullptr)
+	{
+		entry.FlagsKernel = clCreateKernel(program, "Flags", &clError2);
+		clError |= clError2;
+	}
+	entry.ScatterKernel = clCreateKernel(program, "Scatter", &clError2);
+	clError |= clError2;
+	clReleaseProgram(program);
+
+	entry.Count = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &clError2);
+	clError |= clError2;
+
+	if(clError != CL_SUCCESS)
+	{
+		cerr<<"Error: failed to create the compaction kernels ["<<CLUtil::GetCLErrorString(clError)<<"]"<<endl;
+		ReleaseEntry(entry);
+		s_Entries.erase(make_pair(Queue, key));
+		return nullptr;
+	}
+
+	entry.Context = context;
+	return &entry;
+}
+
+cl_int CCompact::Reserve(Entry& E, size_t Count)
+{
+	if(E.Capacity >= Count)
+		return CL_SUCCESS;
+
+	// the old buffers may still be used by enqueued kernels, releasing them only drops our reference
+	SAFE_RELEASE_MEMOBJECT(E.Flags);
+	SAFE_RELEASE_MEMOBJECT(E.Positions);
+	E.Capacity = 0;
+
+	cl_int clError, clError2;
+	E.Positions = clCreateBuffer(E.Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * Count, NULL, &clError2);
+	clError = clError2;
+	if(E.FlagsKernel != nullptr)
+	{
+		E.Flags = clCreateBuffer(E.Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * Count, NULL, &clError2);
+		clError |= clError2;
+	}
+	if(clError == CL_SUCCESS)
+		E.Capacity = Count;
+	return clError;
+}
+
+cl_int CCompact::Run(cl_command_queue Queue, cl_mem Input, cl_mem Flags, cl_mem Output, size_t Count, size_t ElementSize,
+	const char* TypeName, const std::string& Predicate, cl_mem CountBuffer, cl_uint* pCount)
+{
+	// the positions are computed with 32 bit integers
+	if(ElementSize == 0 || (Flags == nullptr && TypeName == nullptr) || Count > numeric_limits<cl_uint>::max())
+		return CL_INVALID_VALUE;
+
+	if(Count == 0)
+	{
+		if(pCount != nullptr)
+			*pCount = 0;
+		if(CountBuffer != nullptr)
+			return clEnqueueWriteBuffer(Queue, CountBuffer, CL_FALSE, 0, sizeof(cl_uint), &c_Zero, 0, NULL, NULL);
+		return CL_SUCCESS;
+	}
+
+	lock_guard<mutex> lock(s_Mutex);
+	// with flags the predicate is not used, so all calls with the same element size share the kernels
+	Entry* pEntry = GetEntry(Queue, ElementSize, Flags == nullptr ? TypeName : nullptr, Flags == nullptr ? Predicate : string());
+	if(pEntry == nullptr)
+		return CL_BUILD_PROGRAM_FAILURE;
+
+	cl_int clError = Reserve(*pEntry, Count);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	// the largest power of two the device allows as local size, which divides the global size
+	cl_device_id device;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+	size_t maxLocalSize = 1;
+	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxLocalSize), &maxLocalSize, NULL);
+	size_t localWorkSize = 1;
+	while(localWorkSize * 2 <= min(maxLocalSize, c_MaxLocalSize))
+		localWorkSize *= 2;
+	size_t globalWorkSize = CLUtil::GetGlobalWorkSize(Count, localWorkSize);
+	cl_ulong n = Count;
+
+	if(Flags == nullptr)
+	{
+		clError = clSetKernelArg(pEntry->FlagsKernel, 0, sizeof(cl_mem), &Input);
+		clError |= clSetKernelArg(pEntry->FlagsKernel, 1, sizeof(cl_ulong), &n);
+		clError |= clSetKernelArg(pEntry->FlagsKernel, 2, sizeof(cl_mem), &pEntry->Flags);
+		if(clError != CL_SUCCESS)
+			return clError;
+		clError = clEnqueueNDRangeKernel(Queue, pEntry->FlagsKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+		if(clError != CL_SUCCESS)
+			return clError;
+		Flags = pEntry->Flags;
+	}
+
+	clError = Scan(Queue, Flags, pEntry->Positions, Count, SCAN_INCLUSIVE);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	cl_mem countBuffer = (CountBuffer != nullptr) ? CountBuffer : pEntry->Count;
+	clError = clSetKernelArg(pEntry->ScatterKernel, 0, sizeof(cl_mem), &Input);
+	clError |= clSetKernelArg(pEntry->ScatterKernel, 1, sizeof(cl_mem), &Output);
+	clError |= clSetKernelArg(pEntry->ScatterKernel, 2, sizeof(cl_ulong), &n);
+	clError |= clSetKernelArg(pEntry->ScatterKernel, 3, sizeof(cl_mem), &pEntry->Positions);
+	clError |= clSetKernelArg(pEntry->ScatterKernel, 4, sizeof(cl_mem), &countBuffer);
+	if(clError != CL_SUCCESS)
+		return clError;
+	clError = clEnqueueNDRangeKernel(Queue, pEntry->ScatterKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	// enqueued behind the scatter, so the host does not wait here
+	if(pCount != nullptr)
+		clError = clEnqueueReadBuffer(Queue, countBuffer, CL_FALSE, 0, sizeof(cl_uint), pCount, 0, NULL, NULL);
+	return clError;
+}
+
+void CCompact::ReleaseEntry(Entry& E)
+{
+	SAFE_RELEASE_KERNEL(E.FlagsKernel);
+	SAFE_RELEASE_KERNEL(E.ScatterKernel);
+	SAFE_RELEASE_MEMOBJECT(E.Flags);
+	SAFE_RELEASE_MEMOBJECT(E.Positions);
+	SAFE_RELEASE_MEMOBJECT(E.Count);
+	E.Capacity = 0;
+}
+
+void CCompact::ReleaseKernels(cl_context Context)
+{
+	lock_guard<mutex> lock(s_Mutex);
+	for(auto it = s_Entries.begin(); it != s_Entries.end(); )
+	{
+		if(Context == nullptr || it->second.Context == Context)
+		{
+			ReleaseEntry(it->second);
+			it = s_Entries.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,118 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CDEVICE_VALIDATOR_H
+#define _CDEVICE_VALIDATOR_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include "CExpression.h"
+
+#include <string>
+
+//! Compares device results with the golden result on the device
+/*!
+	The golden result is uploaded once, then each comparison runs a kernel which counts
+	the mismatching elements, finds the first one and the largest absolute error. Only
+	these few bytes are read back instead of the whole result.
+
+	Integer results have to match exactly. Float results may differ by Tolerance
+	(absolute), a tolerance of 0 requires equal values.
+
+	The tasks use it instead of reading back their results if it is enabled
+	(see the --device-validation option of CAssignmentBase).
+
+	Usage:
+	m_Validator.SetGolden(CommandQueue, m_hResultCPU, n);
+	CDeviceValidator::Result result;
+	V_RETURN_CL(m_Validator.Compare(CommandQueue, m_dResult, result), "...");
+	m_Valid = result.IsValid();
+*/
+class CDeviceValidator
+{
+public:
+	struct Result
+	{
+		size_t	Mismatches;
+		//! index of the first mismatching element, only set if there are mismatches
+		size_t	FirstMismatch;
+		float	MaxAbsError;
+
+		bool IsValid() const { return Mismatches == 0; }
+	};
+
+	CDeviceValidator();
+
+	~CDeviceValidator();
+
+	static void SetEnabled(bool Enabled);
+
+	static bool IsEnabled() { return s_Enabled; }
+
+	//! Uploads the Count elements of pGolden, the element type selects the comparison
+	template<class T>
+	bool SetGolden(cl_command_queue Queue, const T* pGolden, size_t Count, float Tolerance = 0)
+	{
+		return SetGolden(Queue, CLTypeName<T>::Get(), sizeof(T), pGolden, Count, Tolerance);
+	}
+
+	//! Compares the first elements of Buffer with the golden result (blocking)
+	cl_int Compare(cl_command_queue Queue, cl_mem Buffer, Result& R);
+
+	//! Sets the elements of Buffer to zero, so a kernel cannot pass with an earlier result
+	cl_int Clear(cl_command_queue Queue, cl_mem Buffer);
+
+	//! Prints the mismatches of a failed comparison
+	static void PrintResult(const std::string& Name, const Result& R);
+
+	void Release();
+
+protected:
+	CDeviceValidator(const CDeviceValidator&);
+	CDeviceValidator& operator=(const CDeviceValidator&);
+
+	bool SetGolden(cl_command_queue Queue, const char* TypeName, size_t ElementSize, const void* pGolden, size_t Count, float Tolerance);
+
+	//! Source of the comparison kernels for one element type
+	static std::string GetSource(const char* TypeName);
+
+	//! The local work size for Kernel, at most CL_KERNEL_WORK_GROUP_SIZE
+	static size_t GetLocalWorkSize(cl_kernel Kernel, cl_device_id Device);
+
+	size_t		m_Count;
+	float		m_Tolerance;
+	cl_mem		m_dGolden;
+	//! mismatches, first mismatch and the bits of the largest error
+	cl_mem		m_dStatistics;
+	cl_kernel	m_CompareKernel;
+	cl_kernel	m_ClearKernel;
+	size_t		m_CompareLocalWorkSize;
+	size_t		m_ClearLocalWorkSize;
+
+	static bool	s_Enabled;
+};
+
+#endif // _CDEVICE_VALIDATOR_H
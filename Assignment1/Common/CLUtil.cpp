@@ -5,12 +5,50 @@ GPU Computing / GPGPU Praktikum source code.
 
 #include "CLUtil.h"
 #include "CTimer.h"
+#include "CTrace.h"
+#include "CBenchmark.h"
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <direct.h>
+	#include <malloc.h>
+	#define MKDIR(path) _mkdir(path)
+#else
+	#include <sys/stat.h>
+	#define MKDIR(path) mkdir(path, 0755)
+#endif
 
 using namespace std;
 
+// Program cache: in-process programs keyed by (context, source hash) and a
+// directory for the binaries on disk. The directory can be overridden with
+// the environment variable CL_PROGRAM_CACHE_DIR (empty value disables it).
+static const char* GetDefaultProgramCacheDir()
+{
+	const char* dir = getenv("CL_PROGRAM_CACHE_DIR");
+	return dir ? dir : "clcache";
+}
+
+string CLUtil::s_ProgramCacheDir = GetDefaultProgramCacheDir();
+map<CLUtil::ProgramCacheKey, cl_program> CLUtil::s_ProgramCache;
+mutex CLUtil::s_ProgramCacheMutex;
+
+static double GetDefaultPeakBandwidth()
+{
+	const char* bandwidth = getenv("CL_PEAK_BANDWIDTH");
+	return bandwidth ? atof(bandwidth) : 0.0;
+}
+
+double CLUtil::s_PeakBandwidth = GetDefaultPeakBandwidth();
+
 ///////////////////////////////////////////////////////////////////////////////
 // CLUtil
 
@@ -51,32 +89,211 @@ bool CLUtil::LoadProgramSourceToMemory(const std::string& Path, std::string& Sou
 
 cl_program CLUtil::BuildCLProgramFromMemory(cl_device_id Device, cl_context Context, const std::string& SourceCode, const std::string& CompileOptions)
 {
-	
-	// Ignore the last parameter CompileOptions in assignment 1
-	// This may be used later to pass flags and macro definitions to the OpenCL compiler
+	// the key covers everything that influences the generated binary
+	string key = SourceCode + '\0' + CompileOptions + '\0' + GetDeviceIdentification(Device);
+	unsigned long long hash = HashString(key);
 
-	cl_program prog = nullptr;
+	// 1. identical build within this run?
+	{
+		lock_guard<mutex> lock(s_ProgramCacheMutex);
+		auto it = s_ProgramCache.find(ProgramCacheKey(Context, hash));
+		if(it != s_ProgramCache.end())
+		{
+			clRetainProgram(it->second);
+			return it->second;
+		}
+	}
 
-	const char* src = SourceCode.c_str();
-	size_t length = SourceCode.size();
-	cl_int clError;
-	prog = clCreateProgramWithSource(Context, 1, &src, &length, &clError);
-	if (clError != CL_SUCCESS) {
-		cerr << "Failed to create CL program from source.";
+	// 2. binary from a previous run?
+	cl_program prog = LoadProgramBinary(Device, Context, hash, CompileOptions);
+
+	// 3. compile from source
+	if(prog == nullptr)
+	{
+		const char* src = SourceCode.c_str();
+		size_t length = SourceCode.size();
+
+		cl_int clError;
+		prog = clCreateProgramWithSource(Context, 1, &src, &length, &clError);
+		if(CL_SUCCESS != clError)
+		{
+			cerr<<"Failed to create CL program from source.";
+			return nullptr;
+		}
+
+		// program created, now build it:
+		const char* pCompileOptions = CompileOptions.size() > 0 ? CompileOptions.c_str() : nullptr;
+		clError = clBuildProgram(prog, 1, &Device, pCompileOptions, NULL, NULL);
+		PrintBuildLog(prog, Device);
+		if(CL_SUCCESS != clError)
+		{
+			cerr<<"Failed to build CL program.";
+			SAFE_RELEASE_PROGRAM(prog);
+			return nullptr;
+		}
+
+		SaveProgramBinary(prog, hash);
+	}
+
+	// the cache keeps its own reference, the caller releases the returned one
+	lock_guard<mutex> lock(s_ProgramCacheMutex);
+	clRetainProgram(prog);
+	s_ProgramCache[ProgramCacheKey(Context, hash)] = prog;
+
+	return prog;
+}
+
+void CLUtil::SetProgramCacheDir(const std::string& Path)
+{
+	s_ProgramCacheDir = Path;
+}
+
+void CLUtil::ReleaseProgramCache(cl_context Context)
+{
+	lock_guard<mutex> lock(s_ProgramCacheMutex);
+	for(auto it = s_ProgramCache.begin(); it != s_ProgramCache.end(); )
+	{
+		if(Context == nullptr || it->first.first == Context)
+		{
+			clReleaseProgram(it->second);
+			it = s_ProgramCache.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+// constructed on first use, the hooks are registered during static initialization
+static vector<CLUtil::ReleaseHook>& GetReleaseHooks()
+{
+	static vector<CLUtil::ReleaseHook> hooks;
+	return hooks;
+}
+
+bool CLUtil::RegisterReleaseHook(ReleaseHook Hook)
+{
+	GetReleaseHooks().push_back(Hook);
+	return true;
+}
+
+void CLUtil::ReleaseCachedObjects(cl_context Context)
+{
+	// the cached kernels reference the cached programs
+	vector<ReleaseHook>& hooks = GetReleaseHooks();
+	for(size_t i = 0; i < hooks.size(); i++)
+		hooks[i](Context);
+	ReleaseProgramCache(Context);
+}
+
+string CLUtil::GetDeviceIdentification(cl_device_id Device)
+{
+	char buffer[1024];
+	string id;
+
+	cl_platform_id platform;
+	clGetDeviceInfo(Device, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platform, NULL);
+	if(clGetPlatformInfo(platform, CL_PLATFORM_NAME, sizeof(buffer), buffer, NULL) == CL_SUCCESS)
+		id += buffer;
+	id += '|';
+	if(clGetDeviceInfo(Device, CL_DEVICE_NAME, sizeof(buffer), buffer, NULL) == CL_SUCCESS)
+		id += buffer;
+	id += '|';
+	if(clGetDeviceInfo(Device, CL_DRIVER_VERSION, sizeof(buffer), buffer, NULL) == CL_SUCCESS)
+		id += buffer;
+
+	return id;
+}
+
+unsigned long long CLUtil::HashString(const std::string& Data)
+{
+	// 64 bit FNV-1a
+	unsigned long long hash = 14695981039346656037ULL;
+	for(size_t i = 0; i < Data.size(); i++)
+	{
+		hash ^= (unsigned char)Data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+string CLUtil::GetProgramBinaryPath(unsigned long long Hash)
+{
+	if(s_ProgramCacheDir.empty())
+		return "";
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.clbin", Hash);
+	return s_ProgramCacheDir + "/" + name;
+}
+
+cl_program CLUtil::LoadProgramBinary(cl_device_id Device, cl_context Context, unsigned long long Hash, const std::string& CompileOptions)
+{
+	string path = GetProgramBinaryPath(Hash);
+	if(path.empty())
+		return nullptr;
+
+	ifstream binaryFile(path.c_str(), ios::binary);
+	if(!binaryFile.is_open())
+		return nullptr;
+
+	vector<unsigned char> binary((istreambuf_iterator<char>(binaryFile)), istreambuf_iterator<char>());
+	if(binary.empty())
+		return nullptr;
+
+	const unsigned char* pBinary = &binary[0];
+	size_t length = binary.size();
+	cl_int binaryStatus, clError;
+	cl_program prog = clCreateProgramWithBinary(Context, 1, &Device, &length, &pBinary, &binaryStatus, &clError);
+	if(CL_SUCCESS != clError || CL_SUCCESS != binaryStatus)
+	{
+		// stale or foreign binary, recompile
+		SAFE_RELEASE_PROGRAM(prog);
 		return nullptr;
 	}
-	clError = clBuildProgram(prog, 1, &Device, NULL, NULL, NULL);
-	PrintBuildLog(prog, Device);
 
-	// compile
-	if (clError != CL_SUCCESS) {
-		cerr << "Failed to build CL program.";
+	// binaries still need to be built, but this skips the compiler front end
+	const char* pCompileOptions = CompileOptions.size() > 0 ? CompileOptions.c_str() : nullptr;
+	if(CL_SUCCESS != clBuildProgram(prog, 1, &Device, pCompileOptions, NULL, NULL))
+	{
+		SAFE_RELEASE_PROGRAM(prog);
 		return nullptr;
 	}
 
 	return prog;
 }
 
+void CLUtil::SaveProgramBinary(cl_program Program, unsigned long long Hash)
+{
+	string path = GetProgramBinaryPath(Hash);
+	if(path.empty())
+		return;
+
+	// we always build for exactly one device
+	size_t binarySize = 0;
+	if(CL_SUCCESS != clGetProgramInfo(Program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, NULL) || binarySize == 0)
+		return;
+
+	vector<unsigned char> binary(binarySize);
+	unsigned char* pBinary = &binary[0];
+	if(CL_SUCCESS != clGetProgramInfo(Program, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &pBinary, NULL))
+		return;
+
+	MKDIR(s_ProgramCacheDir.c_str());
+
+	// write to a temporary file first, so concurrent runs never see half a binary
+	string tmpPath = path + ".tmp";
+	{
+		ofstream binaryFile(tmpPath.c_str(), ios::binary | ios::trunc);
+		if(!binaryFile.is_open())
+			return;
+		binaryFile.write((const char*)pBinary, binarySize);
+		if(!binaryFile.good())
+			return;
+	}
+	remove(path.c_str());
+	rename(tmpPath.c_str(), path.c_str());
+}
+
 void CLUtil::PrintBuildLog(cl_program Program, cl_device_id Device)
 {
 	cl_build_status buildStatus;
@@ -102,9 +319,42 @@ void CLUtil::PrintBuildLog(cl_program Program, cl_device_id Device)
 	}
 }
 
+void CLUtil::SetPeakBandwidth(double GBPerSecond)
+{
+	s_PeakBandwidth = GBPerSecond;
+}
+
+double CLUtil::GetPeakBandwidth()
+{
+	return s_PeakBandwidth;
+}
+
+void CLUtil::PrintBandwidth(const std::string& Name, size_t Bytes, double Milliseconds)
+{
+	if(Milliseconds <= 0.0)
+		return;
+
+	double gbPerSecond = 1.0e-6 * double(Bytes) / Milliseconds;
+	cout << "  " << Name << ": " << Milliseconds << " ms, " << gbPerSecond << " GB/s";
+	if(s_PeakBandwidth > 0.0)
+		cout << " (" << 100.0 * gbPerSecond / s_PeakBandwidth << "% of " << s_PeakBandwidth << " GB/s peak)";
+	cout << endl;
+}
+
 double CLUtil::ProfileKernel(cl_command_queue CommandQueue, cl_kernel Kernel, cl_uint Dimensions, 
 		const size_t* pGlobalWorkSize, const size_t* pLocalWorkSize, int NIterations)
 {
+	// with a profiling queue we can measure the pure device time of each launch
+	if (IsProfilingEnabled(CommandQueue)) {
+		KernelProfile profile;
+		if (!ProfileKernelEvents(CommandQueue, Kernel, Dimensions, pGlobalWorkSize, pLocalWorkSize, NIterations, profile))
+			return -1;
+		PrintKernelProfile(profile);
+		cout << "Average execution time of the kernel: " << profile.StartToEnd.Mean << "ms." << endl;
+		CBenchmarkRecorder::ReportTime(profile.KernelName, profile.StartToEnd.Mean);
+		return profile.StartToEnd.Mean;
+	}
+
 	// Measure average execution time of the kernel
 	CTimer timer;
 	cl_int clErr;
@@ -131,9 +381,130 @@ double CLUtil::ProfileKernel(cl_command_queue CommandQueue, cl_kernel Kernel, cl
 
 	cout << "Average execution time of the kernel: " << ms << "ms." << endl;
 
+	if (CBenchmarkRecorder::IsEnabled()) {
+		char name[256] = "";
+		clGetKernelInfo(Kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+		CBenchmarkRecorder::ReportTime(name, ms);
+	}
+
 	return ms;
 }
 
+bool CLUtil::ProfileKernelEvents(cl_command_queue CommandQueue, cl_kernel Kernel, cl_uint Dimensions,
+		const size_t* pGlobalWorkSize, const size_t* pLocalWorkSize, int NIterations, KernelProfile& Profile)
+{
+	char name[256] = "";
+	clGetKernelInfo(Kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+	Profile.KernelName = name;
+	Profile.NIterations = NIterations;
+
+	vector<cl_event> events(NIterations, (cl_event)nullptr);
+	cl_int clErr = clFinish(CommandQueue);
+
+	// the QUEUED timestamp of the first launch is taken when the host enqueues it,
+	// which lets us place the device timestamps on the host timeline of the trace
+	unsigned long long hostQueued = CTimer::GetTimestamp();
+	for(int i = 0; i < NIterations && clErr == CL_SUCCESS; i++)
+		clErr = clEnqueueNDRangeKernel(CommandQueue, Kernel, Dimensions, NULL, pGlobalWorkSize, pLocalWorkSize, 0, NULL, &events[i]);
+	clErr |= clFinish(CommandQueue);
+
+	vector<double> queuedToSubmit, submitToStart, startToEnd;
+	long long deviceToHost = 0;
+	for(int i = 0; i < NIterations && clErr == CL_SUCCESS; i++)
+	{
+		cl_ulong queued, submit, start, end;
+		clErr |= GetEventTimes(events[i], queued, submit, start, end);
+		// nanoseconds to milliseconds
+		queuedToSubmit.push_back(1.0e-6 * double(submit - queued));
+		submitToStart.push_back(1.0e-6 * double(start - submit));
+		startToEnd.push_back(1.0e-6 * double(end - start));
+
+		if(CTraceRecorder::IsEnabled())
+		{
+			if(i == 0)
+				deviceToHost = (long long)hostQueued - (long long)queued;
+			CTraceRecorder::RecordDeviceSpan(Profile.KernelName, (unsigned long long)((long long)start + deviceToHost),
+				(unsigned long long)((long long)end + deviceToHost));
+		}
+	}
+
+	for(size_t i = 0; i < events.size(); i++)
+		if(events[i])
+			clReleaseEvent(events[i]);
+
+	if(clErr != CL_SUCCESS)
+	{
+		cerr<<"Kernel execution failure: "<<GetCLErrorString(clErr)<<endl;
+		return false;
+	}
+
+	Profile.QueuedToSubmit = ComputeLatencyStats(queuedToSubmit);
+	Profile.SubmitToStart  = ComputeLatencyStats(submitToStart);
+	Profile.StartToEnd     = ComputeLatencyStats(startToEnd);
+
+	return true;
+}
+
+bool CLUtil::IsProfilingEnabled(cl_command_queue CommandQueue)
+{
+	cl_command_queue_properties properties = 0;
+	if(clGetCommandQueueInfo(CommandQueue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, NULL) != CL_SUCCESS)
+		return false;
+	return (properties & CL_QUEUE_PROFILING_ENABLE) != 0;
+}
+
+cl_int CLUtil::GetEventTimes(cl_event Event, cl_ulong& Queued, cl_ulong& Submit, cl_ulong& Start, cl_ulong& End)
+{
+	cl_int clErr;
+	clErr  = clGetEventProfilingInfo(Event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &Queued, NULL);
+	clErr |= clGetEventProfilingInfo(Event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &Submit, NULL);
+	clErr |= clGetEventProfilingInfo(Event, CL_PROFILING_COMMAND_START,  sizeof(cl_ulong), &Start,  NULL);
+	clErr |= clGetEventProfilingInfo(Event, CL_PROFILING_COMMAND_END,    sizeof(cl_ulong), &End,    NULL);
+	return clErr;
+}
+
+CLUtil::LatencyStats CLUtil::ComputeLatencyStats(std::vector<double> Samples)
+{
+	LatencyStats stats = {0, 0, 0, 0, 0, 0};
+	if(Samples.empty())
+		return stats;
+
+	sort(Samples.begin(), Samples.end());
+
+	// nearest-rank percentiles: the smallest sample with at least P * n samples up to it
+	size_t n = Samples.size();
+	auto percentile = [&](double P) {
+		size_t rank = (size_t)ceil(P * double(n));
+		return Samples[min(n, max<size_t>(rank, 1)) - 1];
+	};
+
+	double sum = 0;
+	for(size_t i = 0; i < n; i++)
+		sum += Samples[i];
+
+	stats.Min    = Samples.front();
+	stats.Median = percentile(0.5);
+	stats.P95    = percentile(0.95);
+	stats.P99    = percentile(0.99);
+	stats.Max    = Samples.back();
+	stats.Mean   = sum / double(n);
+	return stats;
+}
+
+void CLUtil::PrintKernelProfile(const KernelProfile& Profile)
+{
+	cout<<"  Kernel "<<Profile.KernelName<<" ("<<Profile.NIterations<<" launches, ms):"<<endl;
+	cout<<"                     min       median    p95       p99       max"<<endl;
+
+	const char* labels[3] = { "queued->submit", "submit->start ", "start->end    " };
+	const LatencyStats* stats[3] = { &Profile.QueuedToSubmit, &Profile.SubmitToStart, &Profile.StartToEnd };
+	for(int i = 0; i < 3; i++)
+	{
+		printf("    %s  %-9.4f %-9.4f %-9.4f %-9.4f %-9.4f\n", labels[i],
+			stats[i]->Min, stats[i]->Median, stats[i]->P95, stats[i]->P99, stats[i]->Max);
+	}
+}
+
 #define CL_ERROR(x) case (x): return #x;
 
 const char* CLUtil::GetCLErrorString(cl_int CLErrorCode)
@@ -191,4 +562,106 @@ const char* CLUtil::GetCLErrorString(cl_int CLErrorCode)
 	}
 }
 
+// zero-copy buffers need page-aligned host memory on some implementations (e.g. Intel)
+static const size_t c_HostMemoryAlignment = 4096;
+
+void* CLUtil::AllocHostMemory(size_t Size)
+{
+#ifdef _WIN32
+	return _aligned_malloc(Size, c_HostMemoryAlignment);
+#else
+	void* pMemory = nullptr;
+	if(posix_memalign(&pMemory, c_HostMemoryAlignment, Size) != 0)
+		return nullptr;
+	return pMemory;
+#endif
+}
+
+void CLUtil::FreeHostMemory(void* pMemory)
+{
+#ifdef _WIN32
+	_aligned_free(pMemory);
+#else
+	free(pMemory);
+#endif
+}
+
+ETransferPolicy CLUtil::ResolveTransferPolicy(cl_device_id Device, ETransferPolicy Policy)
+{
+	if(Policy == TRANSFER_DEFAULT)
+		return TRANSFER_COPY;
+	if(Policy != TRANSFER_AUTO)
+		return Policy;
+
+	cl_device_type type = 0;
+	cl_bool unifiedMemory = CL_FALSE;
+	clGetDeviceInfo(Device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+	clGetDeviceInfo(Device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unifiedMemory), &unifiedMemory, NULL);
+
+	return ((type & CL_DEVICE_TYPE_CPU) || unifiedMemory) ? TRANSFER_ZERO_COPY : TRANSFER_COPY;
+}
+
+const char* CLUtil::GetTransferPolicyName(ETransferPolicy Policy)
+{
+	switch(Policy)
+	{
+		case TRANSFER_COPY:			return "copy";
+		case TRANSFER_ZERO_COPY:	return "zero-copy";
+		case TRANSFER_AUTO:			return "auto";
+		default:					return "default";
+	}
+}
+
+cl_int CLUtil::UploadBuffer(cl_command_queue CommandQueue, cl_mem Buffer, size_t Size, const void* pData,
+	ETransferPolicy Policy, cl_bool Blocking)
+{
+	if(Policy != TRANSFER_ZERO_COPY)
+		return clEnqueueWriteBuffer(CommandQueue, Buffer, Blocking, 0, Size, pData, 0, NULL, NULL);
+
+	// the whole region is overwritten, so the device contents must not be copied to the host first
+	// (with CL_MEM_USE_HOST_PTR that copy would overwrite pData before it is uploaded)
+	cl_int clError;
+	void* pMapped = clEnqueueMapBuffer(CommandQueue, Buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, Size, 0, NULL, NULL, &clError);
+	if(clError != CL_SUCCESS)
+		return clError;
+	if(pMapped != pData)
+		memcpy(pMapped, pData, Size);
+	return clEnqueueUnmapMemObject(CommandQueue, Buffer, pMapped, 0, NULL, NULL);
+}
+
+cl_int CLUtil::DownloadBuffer(cl_command_queue CommandQueue, cl_mem Buffer, size_t Size, void* pData,
+	ETransferPolicy Policy)
+{
+	if(Policy != TRANSFER_ZERO_COPY)
+		return clEnqueueReadBuffer(CommandQueue, Buffer, CL_TRUE, 0, Size, pData, 0, NULL, NULL);
+
+	cl_int clError;
+	void* pMapped = clEnqueueMapBuffer(CommandQueue, Buffer, CL_TRUE, CL_MAP_READ, 0, Size, 0, NULL, NULL, &clError);
+	if(clError != CL_SUCCESS)
+		return clError;
+	if(pMapped != pData)
+		memcpy(pData, pMapped, Size);
+	clError = clEnqueueUnmapMemObject(CommandQueue, Buffer, pMapped, 0, NULL, NULL);
+	if(clError != CL_SUCCESS)
+		return clError;
+	// the host array must not be used before the unmap is done
+	return clFinish(CommandQueue);
+}
+
+cl_int CLUtil::ClearBuffer(cl_command_queue CommandQueue, cl_mem Buffer, size_t Size, ETransferPolicy Policy)
+{
+	if(Policy != TRANSFER_ZERO_COPY)
+	{
+		vector<char> zeros(Size, 0);
+		return clEnqueueWriteBuffer(CommandQueue, Buffer, CL_TRUE, 0, Size, &zeros[0], 0, NULL, NULL);
+	}
+
+	cl_int clError;
+	void* pMapped = clEnqueueMapBuffer(CommandQueue, Buffer, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, Size, 0, NULL, NULL, &clError);
+	if(clError != CL_SUCCESS)
+		return clError;
+	memset(pMapped, 0, Size);
+	return clEnqueueUnmapMemObject(CommandQueue, Buffer, pMapped, 0, NULL, NULL);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
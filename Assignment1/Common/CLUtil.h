@@ -29,11 +29,20 @@
     #include <CL/cl.h>
 #endif 
 
+// OpenCL 1.2, not all headers define it
+#ifndef CL_MAP_WRITE_INVALIDATE_REGION
+#define CL_MAP_WRITE_INVALIDATE_REGION	(1 << 2)
+#endif
+
 #include "CommonDefs.h"
 
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 //! Utility class for frequently-needed OpenCL tasks
 // For future: replace this with a nicer OpenCL wrapper
@@ -47,8 +56,32 @@ public:
 	static bool LoadProgramSourceToMemory(const std::string& Path, std::string& SourceCode);
 
 	//! Builds a CL program
+	/*!
+		Builds are cached: identical builds within one run share the same program,
+		and the binaries are stored on disk (see SetProgramCacheDir()) so later runs
+		can skip the compiler. The returned program has to be released by the caller as usual.
+	*/
 	static cl_program BuildCLProgramFromMemory(cl_device_id Device, cl_context Context, const std::string& SourceCode, const std::string& CompileOptions = "");
 
+	//! Sets the directory of the on-disk program binary cache. An empty path disables it.
+	static void SetProgramCacheDir(const std::string& Path);
+
+	//! Releases the cached programs of the given context (or of all contexts if nullptr)
+	static void ReleaseProgramCache(cl_context Context = nullptr);
+
+	//! Releases the objects a library caches for a context (or for all contexts if nullptr)
+	typedef void (*ReleaseHook)(cl_context Context);
+
+	//! Registers a hook which ReleaseCachedObjects() calls
+	/*!
+		Libraries which cache kernels register their release function from a static
+		initializer, so the context owner does not have to know them. Returns true.
+	*/
+	static bool RegisterReleaseHook(ReleaseHook Hook);
+
+	//! Calls the release hooks, then releases the program cache (call it before releasing Context)
+	static void ReleaseCachedObjects(cl_context Context = nullptr);
+
 	static void PrintBuildLog(cl_program Program, cl_device_id Device);
 
 	//! Measures the execution time of a kernel by executing it N times and returning the average time in milliseconds.
@@ -59,13 +92,115 @@ public:
 	static double ProfileKernel(cl_command_queue CommandQueue, cl_kernel Kernel, cl_uint Dimensions, 
 		const size_t* pGlobalWorkSize, const size_t* pLocalWorkSize, int NIterations);
 
+	//! Sets the theoretical memory bandwidth of the device in GB/s, 0 if it is unknown
+	/*!
+		OpenCL does not report the memory clock and bus width, so the value has to be given
+		(--peak-bandwidth or the environment variable CL_PEAK_BANDWIDTH).
+	*/
+	static void SetPeakBandwidth(double GBPerSecond);
+
+	static double GetPeakBandwidth();
+
+	//! Prints the effective bandwidth of Bytes moved in Milliseconds, relative to the peak bandwidth if known
+	static void PrintBandwidth(const std::string& Name, size_t Bytes, double Milliseconds);
+
+	//! Distribution of a set of time intervals in milliseconds
+	struct LatencyStats
+	{
+		double Min, Median, P95, P99, Max, Mean;
+	};
+
+	//! Per-launch device timings of a kernel
+	struct KernelProfile
+	{
+		std::string		KernelName;
+		int				NIterations;
+		LatencyStats	QueuedToSubmit;
+		LatencyStats	SubmitToStart;
+		LatencyStats	StartToEnd;
+	};
+
+	//! Event based version of ProfileKernel(). Requires a queue created with CL_QUEUE_PROFILING_ENABLE.
+	/*!
+		Each launch gets its own event, so the host side launch overhead, the queueing latency
+		and the actual kernel execution time are reported separately.
+		If the queue has profiling enabled, ProfileKernel() uses this and prints the result.
+	*/
+	static bool ProfileKernelEvents(cl_command_queue CommandQueue, cl_kernel Kernel, cl_uint Dimensions,
+		const size_t* pGlobalWorkSize, const size_t* pLocalWorkSize, int NIterations, KernelProfile& Profile);
+
+	static bool IsProfilingEnabled(cl_command_queue CommandQueue);
+
+	//! Reads the four profiling timestamps (in ns) of a finished event
+	static cl_int GetEventTimes(cl_event Event, cl_ulong& Queued, cl_ulong& Submit, cl_ulong& Start, cl_ulong& End);
+
+	static LatencyStats ComputeLatencyStats(std::vector<double> Samples);
+
+	static void PrintKernelProfile(const KernelProfile& Profile);
+
 	static const char* GetCLErrorString(cl_int CLErrorCode);
+
+	//! Allocates host memory aligned for zero-copy buffers (CL_MEM_USE_HOST_PTR)
+	static void* AllocHostMemory(size_t Size);
+
+	static void FreeHostMemory(void* pMemory);
+
+	template<class T>
+	static T* AllocHostArray(size_t Count) { return (T*)AllocHostMemory(Count * sizeof(T)); }
+
+	//! Frees an array of AllocHostArray() and sets the pointer to nullptr
+	template<class T>
+	static void FreeHostArray(T*& pArray) { FreeHostMemory(pArray); pArray = nullptr; }
+
+	//! Replaces TRANSFER_AUTO and TRANSFER_DEFAULT by the policy that fits the device
+	static ETransferPolicy ResolveTransferPolicy(cl_device_id Device, ETransferPolicy Policy);
+
+	static const char* GetTransferPolicyName(ETransferPolicy Policy);
+
+	//! Makes the host data available to the kernels using Buffer
+	/*!
+		Copies pData to the buffer, or maps and unmaps a zero-copy buffer, which on devices
+		sharing the host memory does not move any data. If pData is not the memory of the
+		zero-copy buffer it is copied into the mapped buffer.
+	*/
+	static cl_int UploadBuffer(cl_command_queue CommandQueue, cl_mem Buffer, size_t Size, const void* pData,
+		ETransferPolicy Policy, cl_bool Blocking = CL_FALSE);
+
+	//! Makes the contents of Buffer available in pData, blocking (see UploadBuffer())
+	static cl_int DownloadBuffer(cl_command_queue CommandQueue, cl_mem Buffer, size_t Size, void* pData,
+		ETransferPolicy Policy);
+
+	//! Sets the first Size bytes of Buffer to zero (blocking)
+	/*!
+		The host array of a zero-copy buffer may only be written while it is mapped, so it is
+		cleared through a write-invalidate map instead of being written directly.
+	*/
+	static cl_int ClearBuffer(cl_command_queue CommandQueue, cl_mem Buffer, size_t Size, ETransferPolicy Policy);
+
+protected:
+	typedef std::pair<cl_context, unsigned long long> ProgramCacheKey;
+
+	//! Platform name, device name and driver version of a device
+	static std::string GetDeviceIdentification(cl_device_id Device);
+	static unsigned long long HashString(const std::string& Data);
+
+	static std::string GetProgramBinaryPath(unsigned long long Hash);
+	//! Builds the binary with the options of the source build, e.g. -cl-std=CL2.0 is needed to link it
+	static cl_program LoadProgramBinary(cl_device_id Device, cl_context Context, unsigned long long Hash, const std::string& CompileOptions);
+	static void SaveProgramBinary(cl_program Program, unsigned long long Hash);
+
+	static std::string								s_ProgramCacheDir;
+	static std::map<ProgramCacheKey, cl_program>	s_ProgramCache;
+	static std::mutex								s_ProgramCacheMutex;
+
+	static double									s_PeakBandwidth;
 };
 
 // Some useful shortcuts for handling pointers and validating function calls
 #define V_RETURN_FALSE_CL(expr, errmsg) do {cl_int e=(expr);if(CL_SUCCESS!=e){std::cerr<<"Error: "<<errmsg<<" ["<<CLUtil::GetCLErrorString(e)<<"]"<<std::endl; return false; }} while(0)
 #define V_RETURN_0_CL(expr, errmsg) do {cl_int e=(expr);if(CL_SUCCESS!=e){std::cerr<<"Error: "<<errmsg<<" ["<<CLUtil::GetCLErrorString(e)<<"]"<<std::endl; return 0; }} while(0)
 #define V_RETURN_CL(expr, errmsg) do {cl_int e=(expr);if(CL_SUCCESS!=e){std::cerr<<"Error: "<<errmsg<<" ["<<CLUtil::GetCLErrorString(e)<<"]"<<std::endl; return; }} while(0)
+#define V_RETURN_ERROR_CL(expr, errmsg) do {cl_int e=(expr);if(CL_SUCCESS!=e){std::cerr<<"Error: "<<errmsg<<" ["<<CLUtil::GetCLErrorString(e)<<"]"<<std::endl; return e; }} while(0)
 
 #define SAFE_DELETE(ptr) do {if(ptr){ delete ptr; ptr = NULL; }} while(0)
 #define SAFE_DELETE_ARRAY(x) do {if(x){delete [] x; x = NULL;}} while(0)
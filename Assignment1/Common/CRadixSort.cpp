@@ -0,0 +1,339 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CRadixSort.h"
+
+#include "CLUtil.h"
+#include "CScan.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CRadixSort
+
+std::mutex CRadixSort::s_Mutex;
+std::map<std::pair<cl_command_queue, std::string>, CRadixSort::Entry> CRadixSort::s_Entries;
+static const bool s_ReleaseHookRegistered = CLUtil::RegisterReleaseHook(&CRadixSort::ReleaseKernels);
+
+// chunks of LOCAL_SIZE keys per tile, and the largest local size
+static const size_t c_Items = 8;
+static const size_t c_MaxLocalSize = 256;
+
+// specialized by -D options: K (uint or ulong), RADIX_BITS, LOCAL_SIZE, ITEMS and optionally WITH_VALUES
+static const char* c_RadixSortSource =
+	"#define TILE_SIZE (LOCAL_SIZE * ITEMS)\n"
+	"#define RADIX (1 << RADIX_BITS)\n"
+	"#define DIGIT(key) (uint)(((key) >> shift) & (RADIX - 1))\n"
+	"\n"
+	"// counts the digits of the tile, the counts are stored digit-major\n"
+	"__kernel __attribute__((reqd_work_group_size(LOCAL_SIZE, 1, 1)))\n"
+	"void Histogram(__global const K* keys, ulong n, uint shift, __global uint* histogram)\n"
+	"{\n"
+	"\t__local uint counts[RADIX];\n"
+	"\tuint LID = get_local_id(0);\n"
+	"\tfor(uint d = LID; d < RADIX; d += LOCAL_SIZE)\n"
+	"\t\tcounts[d] = 0;\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"\tulong tileStart = (ulong)get_group_id(0) * TILE_SIZE;\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tulong i = tileStart + k * LOCAL_SIZE + LID;\n"
+	"\t\tif(i < n)\n"
+	"\t\t\tatomic_inc(&counts[DIGIT(keys[i])]);\n"
+	"\t}\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"\tfor(uint d = LID; d < RADIX; d += LOCAL_SIZE)\n"
+	"\t\thistogram[d * get_num_groups(0) + get_group_id(0)] = counts[d];\n"
+	"}\n"
+	"\n"
+	"// exclusive prefix sum of x over the work-group, total receives the sum of all x\n"
+	"uint LocalScan(uint x, __local uint* block, uint* total)\n"
+	"{\n"
+	"\tuint LID = get_local_id(0);\n"
+	"\tuint pout = 0;\n"
+	"\tblock[LID] = x;\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\tfor(uint offset = 1; offset < LOCAL_SIZE; offset <<= 1) {\n"
+	"\t\tuint pin = pout;\n"
+	"\t\tpout = 1 - pout;\n"
+	"\t\tuint sum = block[pin * LOCAL_SIZE + LID];\n"
+	"\t\tif(LID >= offset)\n"
+	"\t\t\tsum += block[pin * LOCAL_SIZE + LID - offset];\n"
+	"\t\tblock[pout * LOCAL_SIZE + LID] = sum;\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t}\n"
+	"\tuint inclusive = block[pout * LOCAL_SIZE + LID];\n"
+	"\t*total = block[pout * LOCAL_SIZE + LOCAL_SIZE - 1];\n"
+	"\t// the block is written again by the next call\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\treturn inclusive - x;\n"
+	"}\n"
+	"\n"
+	"// moves the keys of the tile to their output positions: offsets is the scanned histogram, the\n"
+	"// chunks are sorted by the digit in local memory so that equal digits are written together\n"
+	"__kernel __attribute__((reqd_work_group_size(LOCAL_SIZE, 1, 1)))\n"
+	"void Scatter(__global const K* keysIn, __global K* keysOut,\n"
+	"\t__global const uint* valuesIn, __global uint* valuesOut,\n"
+	"\tulong n, uint shift, __global const uint* offsets)\n"
+	"{\n"
+	"\t__local K localKeys[LOCAL_SIZE];\n"
+	"#ifdef WITH_VALUES\n"
+	"\t__local uint localValues[LOCAL_SIZE];\n"
+	"#endif\n"
+	"\t__local uint block[2 * LOCAL_SIZE];\n"
+	"\t// next output position and start of the run in the sorted chunk of each digit\n"
+	"\t__local uint digitBase[RADIX];\n"
+	"\t__local uint runStart[RADIX];\n"
+	"\n"
+	"\tuint LID = get_local_id(0);\n"
+	"\tfor(uint d = LID; d < RADIX; d += LOCAL_SIZE)\n"
+	"\t\tdigitBase[d] = offsets[d * get_num_groups(0) + get_group_id(0)];\n"
+	"\n"
+	"\tulong tileStart = (ulong)get_group_id(0) * TILE_SIZE;\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tulong chunkStart = tileStart + k * LOCAL_SIZE;\n"
+	"\t\tif(chunkStart >= n)\n"
+	"\t\t\tbreak;\n"
+	"\t\tuint valid = (uint)min((ulong)LOCAL_SIZE, n - chunkStart);\n"
+	"\n"
+	"\t\t// the padding has the largest digit, so it stays behind the valid keys\n"
+	"\t\tK key = LID < valid ? keysIn[chunkStart + LID] : ~(K)0;\n"
+	"#ifdef WITH_VALUES\n"
+	"\t\tuint value = LID < valid ? valuesIn[chunkStart + LID] : 0;\n"
+	"#endif\n"
+	"\n"
+	"\t\t// stable split by each bit of the digit: zeros before ones, each in the old order\n"
+	"\t\tfor(uint b = 0; b < RADIX_BITS; b++) {\n"
+	"\t\t\tuint bit = (DIGIT(key) >> b) & 1;\n"
+	"\t\t\tuint zeros;\n"
+	"\t\t\tuint zerosBefore = LocalScan(1 - bit, block, &zeros);\n"
+	"\t\t\tuint dst = bit ? zeros + LID - zerosBefore : zerosBefore;\n"
+	"\t\t\tlocalKeys[dst] = key;\n"
+	"#ifdef WITH_VALUES\n"
+	"\t\t\tlocalValues[dst] = value;\n"
+	"#endif\n"
+	"\t\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t\t\tkey = localKeys[LID];\n"
+	"#ifdef WITH_VALUES\n"
+	"\t\t\tvalue = localValues[LID];\n"
+	"#endif\n"
+	"\t\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t\t}\n"
+	"\n"
+	"\t\t// the first work-item of each run of equal digits marks its start\n"
+	"\t\tuint digit = DIGIT(key);\n"
+	"\t\tblock[LID] = digit;\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t\tif(LID == 0 || block[LID - 1] != digit)\n"
+	"\t\t\trunStart[digit] = LID;\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"\t\tif(LID < valid) {\n"
+	"\t\t\tulong pos = digitBase[digit] + LID - runStart[digit];\n"
+	"\t\t\tkeysOut[pos] = key;\n"
+	"#ifdef WITH_VALUES\n"
+	"\t\t\tvaluesOut[pos] = value;\n"
+	"#endif\n"
+	"\t\t}\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"\t\t// the last work-item of each run advances the output position of the digit\n"
+	"\t\tif(LID == LOCAL_SIZE - 1 || block[LID + 1] != digit)\n"
+	"\t\t\tdigitBase[digit] += LID + 1 - runStart[digit];\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t}\n"
+	"}\n";
+
+CRadixSort::Entry* CRadixSort::GetEntry(cl_command_queue Queue, size_t KeySize, bool WithValues, unsigned int RadixBits)
+{
+	cl_context context;
+	cl_device_id device;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+
+	// the largest power of two the device allows as local size
+	size_t maxLocalSize = 1;
+	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxLocalSize), &maxLocalSize, NULL);
+	size_t localSize = 1;
+	while(localSize * 2 <= min(maxLocalSize, c_MaxLocalSize))
+		localSize *= 2;
+
+	ostringstream options;
+	options<<"-D K="<<(KeySize == 8 ? "ulong" : "uint")<<" -D RADIX_BITS="<<RadixBits
+		<<" -D LOCAL_SIZE="<<localSize<<" -D ITEMS="<<c_Items;
+	if(WithValues)
+		options<<" -D WITH_VALUES";
+
+	Entry& entry = s_Entries[make_pair(Queue, options.str())];
+	if(entry.HistogramKernel != nullptr)
+		return &entry;
+
+	cl_program program = CLUtil::BuildCLProgramFromMemory(device, context, c_RadixSortSource, options.str());
+	if(program == nullptr)
+	{
+		s_Entries.erase(make_pair(Queue, options.str()));
+		return nullptr;
+	}
+
+	cl_int clError, clError2;
+	entry.HistogramKernel = clCreateKernel(program, "Histogram", &clError2);
+	clError = clError2;
+	entry.ScatterKernel = clCreateKernel(program, "Scatter", &clError2);
+	clError |= clError2;
+	clReleaseProgram(program);
+
+	if(clError != CL_SUCCESS)
+	{
+		cerr<<"Error: failed to create the radix sort kernels ["<<CLUtil::GetCLErrorString(clError)<<"]"<<endl;
+		ReleaseEntry(entry);
+		s_Entries.erase(make_pair(Queue, options.str()));
+		return nullptr;
+	}
+
+	entry.Context = context;
+	entry.LocalSize = localSize;
+	entry.TileSize = localSize * c_Items;
+	return &entry;
+}
+
+cl_int CRadixSort::Reserve(Entry& E, size_t KeySize, bool WithValues, size_t HistogramCount, size_t Count)
+{
+	cl_int clError = CL_SUCCESS, clError2;
+
+	// the old buffers may still be used by enqueued kernels, releasing them only drops our reference
+	if(E.HistogramCapacity < HistogramCount)
+	{
+		SAFE_RELEASE_MEMOBJECT(E.Histogram);
+		E.HistogramCapacity = 0;
+		E.Histogram = clCreateBuffer(E.Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * HistogramCount, NULL, &clError);
+		if(clError != CL_SUCCESS)
+			return clError;
+		E.HistogramCapacity = HistogramCount;
+	}
+
+	// the values of an entry are always sorted with the keys or never, so both are reserved together
+	if(E.TempCapacity < Count)
+	{
+		SAFE_RELEASE_MEMOBJECT(E.TempKeys);
+		SAFE_RELEASE_MEMOBJECT(E.TempValues);
+		E.TempCapacity = 0;
+		E.TempKeys = clCreateBuffer(E.Context, CL_MEM_READ_WRITE, KeySize * Count, NULL, &clError2);
+		clError = clError2;
+		if(WithValues)
+		{
+			E.TempValues = clCreateBuffer(E.Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * Count, NULL, &clError2);
+			clError |= clError2;
+		}
+		if(clError != CL_SUCCESS)
+			return clError;
+		E.TempCapacity = Count;
+	}
+	return CL_SUCCESS;
+}
+
+cl_int CRadixSort::Run(cl_command_queue Queue, cl_mem Keys, cl_mem Values, size_t Count, size_t KeySize,
+	unsigned int KeyBits, unsigned int RadixBits)
+{
+	// the positions are computed with 32 bit integers
+	if((KeySize != 4 && KeySize != 8) || KeyBits == 0 || KeyBits > 8 * KeySize ||
+		RadixBits == 0 || RadixBits > MAX_RADIX_BITS || Count > numeric_limits<cl_uint>::max())
+		return CL_INVALID_VALUE;
+	if(Count < 2)
+		return CL_SUCCESS;
+
+	bool withValues = Values != nullptr;
+	lock_guard<mutex> lock(s_Mutex);
+	Entry* pEntry = GetEntry(Queue, KeySize, withValues, RadixBits);
+	if(pEntry == nullptr)
+		return CL_BUILD_PROGRAM_FAILURE;
+
+	size_t numTiles = (Count + pEntry->TileSize - 1) / pEntry->TileSize;
+	size_t histogramCount = numTiles << RadixBits;
+	cl_int clError = Reserve(*pEntry, KeySize, withValues, histogramCount, Count);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	cl_mem keys[2] = { Keys, pEntry->TempKeys };
+	cl_mem values[2] = { Values, pEntry->TempValues };
+	cl_ulong n = Count;
+	size_t globalWorkSize = numTiles * pEntry->LocalSize;
+	unsigned int numPasses = (KeyBits + RadixBits - 1) / RadixBits;
+	for(unsigned int pass = 0; pass < numPasses; pass++)
+	{
+		cl_mem keysIn = keys[pass % 2], keysOut = keys[1 - pass % 2];
+		cl_mem valuesIn = values[pass % 2], valuesOut = values[1 - pass % 2];
+		cl_uint shift = pass * RadixBits;
+
+		clError = clSetKernelArg(pEntry->HistogramKernel, 0, sizeof(cl_mem), &keysIn);
+		clError |= clSetKernelArg(pEntry->HistogramKernel, 1, sizeof(cl_ulong), &n);
+		clError |= clSetKernelArg(pEntry->HistogramKernel, 2, sizeof(cl_uint), &shift);
+		clError |= clSetKernelArg(pEntry->HistogramKernel, 3, sizeof(cl_mem), &pEntry->Histogram);
+		if(clError != CL_SUCCESS)
+			return clError;
+		clError = clEnqueueNDRangeKernel(Queue, pEntry->HistogramKernel, 1, NULL, &globalWorkSize, &pEntry->LocalSize, 0, NULL, NULL);
+		if(clError != CL_SUCCESS)
+			return clError;
+
+		clError = Scan(Queue, pEntry->Histogram, pEntry->Histogram, histogramCount, SCAN_EXCLUSIVE);
+		if(clError != CL_SUCCESS)
+			return clError;
+
+		clError = clSetKernelArg(pEntry->ScatterKernel, 0, sizeof(cl_mem), &keysIn);
+		clError |= clSetKernelArg(pEntry->ScatterKernel, 1, sizeof(cl_mem), &keysOut);
+		clError |= clSetKernelArg(pEntry->ScatterKernel, 2, sizeof(cl_mem), &valuesIn);
+		clError |= clSetKernelArg(pEntry->ScatterKernel, 3, sizeof(cl_mem), &valuesOut);
+		clError |= clSetKernelArg(pEntry->ScatterKernel, 4, sizeof(cl_ulong), &n);
+		clError |= clSetKernelArg(pEntry->ScatterKernel, 5, sizeof(cl_uint), &shift);
+		clError |= clSetKernelArg(pEntry->ScatterKernel, 6, sizeof(cl_mem), &pEntry->Histogram);
+		if(clError != CL_SUCCESS)
+			return clError;
+		clError = clEnqueueNDRangeKernel(Queue, pEntry->ScatterKernel, 1, NULL, &globalWorkSize, &pEntry->LocalSize, 0, NULL, NULL);
+		if(clError != CL_SUCCESS)
+			return clError;
+	}
+
+	// after an odd number of passes the result is in the temporary buffers
+	if(numPasses % 2 == 1)
+	{
+		clError = clEnqueueCopyBuffer(Queue, pEntry->TempKeys, Keys, 0, 0, KeySize * Count, 0, NULL, NULL);
+		if(clError == CL_SUCCESS && withValues)
+			clError = clEnqueueCopyBuffer(Queue, pEntry->TempValues, Values, 0, 0, sizeof(cl_uint) * Count, 0, NULL, NULL);
+	}
+	return clError;
+}
+
+void CRadixSort::ReleaseEntry(Entry& E)
+{
+	SAFE_RELEASE_KERNEL(E.HistogramKernel);
+	SAFE_RELEASE_KERNEL(E.ScatterKernel);
+	SAFE_RELEASE_MEMOBJECT(E.Histogram);
+	SAFE_RELEASE_MEMOBJECT(E.TempKeys);
+	SAFE_RELEASE_MEMOBJECT(E.TempValues);
+	E.HistogramCapacity = 0;
+	E.TempCapacity = 0;
+}
+
+void CRadixSort::ReleaseKernels(cl_context Context)
+{
+	lock_guard<mutex> lock(s_Mutex);
+	for(auto it = s_Entries.begin(); it != s_Entries.end(); )
+	{
+		if(Context == nullptr || it->second.Context == Context)
+		{
+			ReleaseEntry(it->second);
+			it = s_Entries.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
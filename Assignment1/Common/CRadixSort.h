@@ -0,0 +1,109 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CRADIX_SORT_H
+#define _CRADIX_SORT_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+//! Stable LSD radix sort of 32 or 64 bit keys on the device, optionally with a 32 bit value per key
+/*!
+	Every pass sorts by RadixBits bits of the keys, starting with the lowest:
+	- Histogram: each work-group counts the digits of its tile of LOCAL_SIZE * ITEMS keys.
+	  The counts are stored digit-major (all tiles of digit 0, then of digit 1, ...).
+	- Their exclusive prefix sum (Scan() of CScan.h) is the first output position of
+	  every digit of every tile.
+	- Scatter: the work-group sorts chunks of LOCAL_SIZE keys by the digit in local memory
+	  (one stable split per bit) and writes the runs of equal digits to consecutive addresses.
+	The passes alternate between the input and a temporary buffer, after an odd number of passes
+	the result is copied back. More radix bits need fewer passes but more local work per pass.
+
+	Usage:
+	V_RETURN_CL(RadixSort<cl_uint>(CommandQueue, m_dKeys, m_dValues, n), "...");
+	V_RETURN_CL(RadixSort<cl_ulong>(CommandQueue, m_dKeys, nullptr, n, 40, 8), "...");
+
+	Keys and Values are sorted in-place. If KeyBits is less than the size of the key, the keys
+	have to be smaller than 2^KeyBits. The calls do not block, the queue has to be in-order.
+*/
+class CRadixSort
+{
+public:
+	//! Sorts Count keys of KeySize (4 or 8) bytes and their cl_uint Values, if not nullptr
+	static cl_int Run(cl_command_queue Queue, cl_mem Keys, cl_mem Values, size_t Count, size_t KeySize,
+		unsigned int KeyBits, unsigned int RadixBits);
+
+	//! Releases the cached kernels and buffers of the given context (or of all contexts if nullptr)
+	static void ReleaseKernels(cl_context Context = nullptr);
+
+	//! Largest supported number of radix bits
+	enum { MAX_RADIX_BITS = 8 };
+
+protected:
+	//! Kernels and temporary buffers of one variant on one queue
+	struct Entry
+	{
+		cl_context		Context;
+		cl_kernel		HistogramKernel;
+		cl_kernel		ScatterKernel;
+		size_t			LocalSize;
+		size_t			TileSize;
+		//! digit counts of the tiles and the ping-pong buffers, with their number of elements
+		cl_mem			Histogram;
+		size_t			HistogramCapacity;
+		cl_mem			TempKeys;
+		cl_mem			TempValues;
+		size_t			TempCapacity;
+	};
+
+	//! Returns the cached entry, building it if necessary. The mutex has to be locked.
+	static Entry* GetEntry(cl_command_queue Queue, size_t KeySize, bool WithValues, unsigned int RadixBits);
+
+	//! Makes sure the histogram and the temporary buffers are large enough
+	static cl_int Reserve(Entry& E, size_t KeySize, bool WithValues, size_t HistogramCount, size_t Count);
+
+	static void ReleaseEntry(Entry& E);
+
+	static std::mutex											s_Mutex;
+	//! the temporary buffers are used by the enqueued kernels, so each queue has its own entries
+	static std::map<std::pair<cl_command_queue, std::string>, Entry>	s_Entries;
+};
+
+//! Sorts Count keys of type K (cl_uint or cl_ulong) and their cl_uint Values (may be nullptr) stably
+template<class K>
+cl_int RadixSort(cl_command_queue Queue, cl_mem Keys, cl_mem Values, size_t Count,
+	unsigned int KeyBits = 8 * sizeof(K), unsigned int RadixBits = 4)
+{
+	static_assert(std::is_same<K, cl_uint>::value || std::is_same<K, cl_ulong>::value, "the keys have to be cl_uint or cl_ulong");
+	return CRadixSort::Run(Queue, Keys, Values, Count, sizeof(K), KeyBits, RadixBits);
+}
+
+#endif // _CRADIX_SORT_H
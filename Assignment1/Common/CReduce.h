@@ -0,0 +1,200 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CREDUCE_H
+#define _CREDUCE_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+//! Generic reductions of device arrays
+/*!
+	Reduce<T, Op>() reduces the Count elements of a device buffer to one value. The kernels are
+	specialized for the element type and the operator with -D options, so each combination is
+	compiled once per context and then taken from a cache (see CReduction).
+
+	Every work-item first accumulates many elements (like Reduction_LoadMax of assignment 2),
+	then the work-group reduces them in local memory. The local size is fixed at build time,
+	so the compiler can unroll the tree. The group results of 32 bit integer sums, minima and
+	maxima are combined with global atomics in the same launch, all other combinations
+	(64 bit, floating point, products and arg reductions) run a second pass over the group
+	results, which also keeps floating point sums deterministic.
+
+	Argmin and argmax return the lowest index of the extreme value.
+
+	Usage:
+	ReduceResult<cl_float> maximum;
+	V_RETURN_CL((Reduce<cl_float, REDUCE_MAX>(CommandQueue, m_dData, n, maximum)), "...");
+
+	The call blocks until the result is read back. double requires cl_khr_fp64 (see SupportsDouble()).
+*/
+enum EReduceOp
+{
+	REDUCE_SUM,
+	REDUCE_MIN,
+	REDUCE_MAX,
+	REDUCE_PRODUCT,
+	REDUCE_ARGMIN,
+	REDUCE_ARGMAX,
+	NUM_REDUCE_OPS
+};
+
+//! Result of a reduction, Index is only set by REDUCE_ARGMIN and REDUCE_ARGMAX
+template<class T>
+struct ReduceResult
+{
+	T		Value;
+	size_t	Index;
+};
+
+//! OpenCL name and limits of an element type of reductions
+template<class T> struct ReduceType;
+template<> struct ReduceType<cl_int> { static const char* Name() { return "int"; } static const char* Lowest() { return "INT_MIN"; } static const char* Highest() { return "INT_MAX"; } enum { Atomics = 1 }; };
+template<> struct ReduceType<cl_uint> { static const char* Name() { return "uint"; } static const char* Lowest() { return "0"; } static const char* Highest() { return "UINT_MAX"; } enum { Atomics = 1 }; };
+template<> struct ReduceType<cl_long> { static const char* Name() { return "long"; } static const char* Lowest() { return "LONG_MIN"; } static const char* Highest() { return "LONG_MAX"; } enum { Atomics = 0 }; };
+template<> struct ReduceType<cl_float> { static const char* Name() { return "float"; } static const char* Lowest() { return "-INFINITY"; } static const char* Highest() { return "INFINITY"; } enum { Atomics = 0 }; };
+template<> struct ReduceType<cl_double> { static const char* Name() { return "double"; } static const char* Lowest() { return "-INFINITY"; } static const char* Highest() { return "INFINITY"; } enum { Atomics = 0 }; };
+
+//! Builds, caches and launches the reduction kernels (see Reduce())
+class CReduction
+{
+public:
+	//! Description of the element type for Run()
+	struct TypeInfo
+	{
+		const char*	Name;
+		const char*	Lowest;
+		const char*	Highest;
+		size_t		Size;
+		bool		Atomics;
+	};
+
+	//! Reduces Count elements of Input, pIdentity is the neutral element of Op
+	static cl_int Run(cl_command_queue Queue, cl_mem Input, size_t Count, EReduceOp Op, const TypeInfo& Type,
+		const void* pIdentity, void* pValue, size_t* pIndex);
+
+	static bool SupportsDouble(cl_device_id Device);
+
+	static const char* GetOpName(EReduceOp Op);
+
+	//! Releases the cached kernels and buffers of the given context (or of all contexts if nullptr)
+	static void ReleaseKernels(cl_context Context = nullptr);
+
+protected:
+	//! Kernels and scratch buffers of one element type and operator
+	struct Entry
+	{
+		cl_kernel	ReduceKernel;
+		cl_kernel	FinalKernel;
+		size_t		LocalSize;
+		//! results of the work-groups for the second pass
+		cl_mem		Partials;
+		cl_mem		PartialIndices;
+		cl_mem		Result;
+		cl_mem		ResultIndex;
+	};
+
+	//! Returns the cached entry, building it if necessary. The mutex has to be locked.
+	static Entry* GetEntry(cl_command_queue Queue, EReduceOp Op, const TypeInfo& Type);
+
+	static void ReleaseEntry(Entry& E);
+
+	static std::mutex										s_Mutex;
+	static std::map<std::pair<cl_context, std::string>, Entry>	s_Entries;
+};
+
+//! Neutral element of Op
+template<class T>
+T GetReduceIdentity(EReduceOp Op)
+{
+	switch(Op)
+	{
+	case REDUCE_SUM:
+		return T(0);
+	case REDUCE_PRODUCT:
+		return T(1);
+	case REDUCE_MIN:
+	case REDUCE_ARGMIN:
+		return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+	default:
+		return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+	}
+}
+
+//! Reduces Count elements of the device buffer Input with the operator Op
+template<class T>
+cl_int Reduce(cl_command_queue Queue, cl_mem Input, size_t Count, EReduceOp Op, ReduceResult<T>& Result)
+{
+	CReduction::TypeInfo type = { ReduceType<T>::Name(), ReduceType<T>::Lowest(), ReduceType<T>::Highest(), sizeof(T), ReduceType<T>::Atomics != 0 };
+	T identity = GetReduceIdentity<T>(Op);
+	return CReduction::Run(Queue, Input, Count, Op, type, &identity, &Result.Value, &Result.Index);
+}
+
+template<class T, EReduceOp Op>
+cl_int Reduce(cl_command_queue Queue, cl_mem Input, size_t Count, ReduceResult<T>& Result)
+{
+	return Reduce<T>(Queue, Input, Count, Op, Result);
+}
+
+//! Host version of Reduce(), sums and products of floating point types are accumulated in double
+template<class T>
+ReduceResult<T> ReduceHost(const T* pData, size_t Count, EReduceOp Op)
+{
+	typedef typename std::conditional<std::is_floating_point<T>::value, double, T>::type Accumulator;
+	// signed integer overflow has to wrap like on the device
+	typedef typename std::conditional<std::is_integral<T>::value, typename std::make_unsigned<
+		typename std::conditional<std::is_integral<T>::value, T, int>::type>::type, Accumulator>::type Wrapping;
+
+	ReduceResult<T> result = { GetReduceIdentity<T>(Op), 0 };
+	Wrapping acc = Wrapping(result.Value);
+	for(size_t i = 0; i < Count; i++)
+	{
+		switch(Op)
+		{
+		case REDUCE_SUM: acc = Wrapping(acc + Wrapping(pData[i])); break;
+		case REDUCE_PRODUCT: acc = Wrapping(acc * Wrapping(pData[i])); break;
+		case REDUCE_MIN: case REDUCE_ARGMIN:
+			if(pData[i] < result.Value || i == 0) { result.Value = pData[i]; result.Index = i; }
+			break;
+		default:
+			if(pData[i] > result.Value || i == 0) { result.Value = pData[i]; result.Index = i; }
+			break;
+		}
+	}
+	if(Op == REDUCE_SUM || Op == REDUCE_PRODUCT)
+		result.Value = T(acc);
+	if(Op != REDUCE_ARGMIN && Op != REDUCE_ARGMAX)
+		result.Index = 0;
+	return result;
+}
+
+#endif // _CREDUCE_H
@@ -0,0 +1,360 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CScan.h"
+
+#include "CLUtil.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CScan
+
+std::mutex CScan::s_Mutex;
+std::map<std::pair<cl_command_queue, std::string>, CScan::Entry> CScan::s_Entries;
+static const bool s_ReleaseHookRegistered = CLUtil::RegisterReleaseHook(&CScan::ReleaseKernels);
+
+// bytes of a tile per work-item (8 uints or 2 float4), and the largest local size
+static const size_t c_ItemBytes = 32;
+static const size_t c_MaxLocalSize = 256;
+
+static const char* c_ModeNames[2] = { "inclusive", "exclusive" };
+
+// specialized by -D options: LOCAL_SIZE, ITEMS and optionally SEGMENTED. The element type T,
+// IDENTITY and COMBINE(a, b) are defined by the operator code in front of it (see GetOperatorSource())
+static const char* c_ScanSource =
+	"#define TILE_SIZE (LOCAL_SIZE * ITEMS)\n"
+	"\n"
+	"// scans the tile of the work-group: work-items scan ITEMS consecutive elements, then the\n"
+	"// sums of the work-items are scanned in local memory. With SEGMENTED a set head flag\n"
+	"// starts a new segment, the combined flag tells if a range contains a head.\n"
+	"__kernel __attribute__((reqd_work_group_size(LOCAL_SIZE, 1, 1)))\n"
+	"void ScanTiles(__global const T* input, __global T* output, ulong n,\n"
+	"\t__global const uint* headFlags, __global T* tileSums, __global uint* tileFlags, uint exclusive)\n"
+	"{\n"
+	"\t__local T values[TILE_SIZE];\n"
+	"\t__local T threadSums[LOCAL_SIZE];\n"
+	"#ifdef SEGMENTED\n"
+	"\t__local uchar heads[TILE_SIZE];\n"
+	"\t__local uint threadFlags[LOCAL_SIZE];\n"
+	"#endif\n"
+	"\tuint LID = get_local_id(0);\n"
+	"\tulong tileStart = (ulong)get_group_id(0) * TILE_SIZE;\n"
+	"\n"
+	"\t// coalesced load, the tile is read completely before anything is written (so the scan can run in-place)\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tuint i = k * LOCAL_SIZE + LID;\n"
+	"\t\tvalues[i] = tileStart + i < n ? input[tileStart + i] : IDENTITY;\n"
+	"#ifdef SEGMENTED\n"
+	"\t\theads[i] = tileStart + i < n && headFlags[tileStart + i] != 0;\n"
+	"#endif\n"
+	"\t}\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"\tT acc = IDENTITY;\n"
+	"\tuint flag = 0;\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tuint i = LID * ITEMS + k;\n"
+	"#ifdef SEGMENTED\n"
+	"\t\tif(heads[i]) { acc = IDENTITY; flag = 1; }\n"
+	"#endif\n"
+	"\t\tacc = COMBINE(acc, values[i]);\n"
+	"\t}\n"
+	"\tthreadSums[LID] = acc;\n"
+	"#ifdef SEGMENTED\n"
+	"\tthreadFlags[LID] = flag;\n"
+	"#endif\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"\t// inclusive scan of the sums of the work-items, the earlier operand is always on the left\n"
+	"\tfor(uint offset = 1; offset < LOCAL_SIZE; offset <<= 1) {\n"
+	"\t\tT left = IDENTITY;\n"
+	"\t\tuint leftFlag = 0;\n"
+	"\t\tif(LID >= offset) {\n"
+	"\t\t\tleft = threadSums[LID - offset];\n"
+	"#ifdef SEGMENTED\n"
+	"\t\t\tleftFlag = threadFlags[LID - offset];\n"
+	"#endif\n"
+	"\t\t}\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t\tif(LID >= offset) {\n"
+	"#ifdef SEGMENTED\n"
+	"\t\t\tif(!threadFlags[LID])\n"
+	"\t\t\t\tthreadSums[LID] = COMBINE(left, threadSums[LID]);\n"
+	"\t\t\tthreadFlags[LID] |= leftFlag;\n"
+	"#else\n"
+	"\t\t\tthreadSums[LID] = COMBINE(left, threadSums[LID]);\n"
+	"#endif\n"
+	"\t\t}\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t}\n"
+	"\n"
+	"\t// rescan the elements of the work-item, starting with the sum of the work-items before\n"
+	"\tT running = LID > 0 ? threadSums[LID - 1] : IDENTITY;\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tuint i = LID * ITEMS + k;\n"
+	"#ifdef SEGMENTED\n"
+	"\t\tif(heads[i]) running = IDENTITY;\n"
+	"#endif\n"
+	"\t\tT inclusive = COMBINE(running, values[i]);\n"
+	"\t\tvalues[i] = exclusive ? running : inclusive;\n"
+	"\t\trunning = inclusive;\n"
+	"\t}\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tuint i = k * LOCAL_SIZE + LID;\n"
+	"\t\tif(tileStart + i < n)\n"
+	"\t\t\toutput[tileStart + i] = values[i];\n"
+	"\t}\n"
+	"\n"
+	"\t// the tile as one element of the next level\n"
+	"\tif(LID == 0) {\n"
+	"\t\ttileSums[get_group_id(0)] = threadSums[LOCAL_SIZE - 1];\n"
+	"#ifdef SEGMENTED\n"
+	"\t\ttileFlags[get_group_id(0)] = threadFlags[LOCAL_SIZE - 1];\n"
+	"#endif\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"// combines the scanned sum of all tiles before with the elements of the tile (starting with the\n"
+	"// second tile), with SEGMENTED only the elements before the first head of the tile\n"
+	"__kernel __attribute__((reqd_work_group_size(LOCAL_SIZE, 1, 1)))\n"
+	"void AddCarry(__global T* data, ulong n, __global const T* scannedTileSums, __global const uint* headFlags)\n"
+	"{\n"
+	"\tuint LID = get_local_id(0);\n"
+	"\tuint tile = get_group_id(0) + 1;\n"
+	"\tulong tileStart = (ulong)tile * TILE_SIZE;\n"
+	"\tT carry = scannedTileSums[tile - 1];\n"
+	"\n"
+	"\tuint end = TILE_SIZE;\n"
+	"#ifdef SEGMENTED\n"
+	"\t__local uint firstHead;\n"
+	"\tif(LID == 0) firstHead = TILE_SIZE;\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tuint i = k * LOCAL_SIZE + LID;\n"
+	"\t\tif(tileStart + i < n && headFlags[tileStart + i] != 0)\n"
+	"\t\t\tatomic_min(&firstHead, i);\n"
+	"\t}\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\tend = firstHead;\n"
+	"#endif\n"
+	"\n"
+	"\tfor(uint k = 0; k < ITEMS; k++) {\n"
+	"\t\tuint i = k * LOCAL_SIZE + LID;\n"
+	"\t\tif(i < end && tileStart + i < n)\n"
+	"\t\t\tdata[tileStart + i] = COMBINE(carry, data[tileStart + i]);\n"
+	"\t}\n"
+	"}\n";
+
+const char* CScan::GetModeName(EScanMode Mode)
+{
+	return Mode == SCAN_EXCLUSIVE ? c_ModeNames[1] : c_ModeNames[0];
+}
+
+string CScan::GetOperatorSource(const TypeInfo& Type, const ScanOperator& Op)
+{
+	// functions, so the expressions see a and b only once each. A scalar identity is widened
+	// to vector types by the initialization (a cast between vector types would not be legal).
+	ostringstream source;
+	source<<"// "<<Op.Name<<" of "<<Type.Name<<"\n"
+		<<"#define T "<<Type.Name<<"\n"
+		<<"inline T Identity() { T identity = "<<Op.Identity<<"; return identity; }\n"
+		<<"#define IDENTITY Identity()\n"
+		<<"inline T Combine(T a, T b) { return "<<Op.Combine<<"; }\n"
+		<<"#define COMBINE(a, b) Combine(a, b)\n\n";
+	return source.str();
+}
+
+CScan::Entry* CScan::GetEntry(cl_command_queue Queue, bool Segmented, const TypeInfo& Type, const ScanOperator& Op)
+{
+	cl_context context;
+	cl_device_id device;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+
+	// the largest power of two the device allows as local size
+	size_t maxLocalSize = 1;
+	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxLocalSize), &maxLocalSize, NULL);
+	size_t localSize = 1;
+	while(localSize * 2 <= min(maxLocalSize, c_MaxLocalSize))
+		localSize *= 2;
+
+	size_t items = max(c_ItemBytes / Type.Size, size_t(1));
+	ostringstream options;
+	options<<"-D LOCAL_SIZE="<<localSize<<" -D ITEMS="<<items;
+	if(Segmented)
+		options<<" -D SEGMENTED";
+
+	// every type and operator is a variant of its own
+	string source = GetOperatorSource(Type, Op) + c_ScanSource;
+	string key = options.str() + "\n" + source;
+	Entry& entry = s_Entries[make_pair(Queue, key)];
+	if(entry.ScanKernel != nullptr)
+		return &entry;
+
+	cl_program program = CLUtil::BuildCLProgramFromMemory(device, context, source, options.str());
+	if(program == nullptr)
+	{
+		s_Entries.erase(make_pair(Queue, key));
+		return nullptr;
+	}
+
+	cl_int clError, clError2;
+	entry.ScanKernel = clCreateKernel(program, "ScanTiles", &clError2);
+	clError = clError2;
+	entry.CarryKernel = clCreateKernel(program, "AddCarry", &clError2);
+	clError |= clError2;
+	clReleaseProgram(program);
+
+	if(clError != CL_SUCCESS)
+	{
+		cerr<<"Error: failed to create the scan kernels ["<<CLUtil::GetCLErrorString(clError)<<"]"<<endl;
+		ReleaseEntry(entry);
+		s_Entries.erase(make_pair(Queue, key));
+		return nullptr;
+	}
+
+	entry.Context = context;
+	entry.LocalSize = localSize;
+	entry.TileSize = localSize * items;
+	entry.ElementSize = Type.Size;
+	return &entry;
+}
+
+cl_int CScan::ReserveLevel(Entry& E, size_t Level, size_t Count)
+{
+	if(E.LevelCapacity.size() <= Level)
+	{
+		E.LevelSums.resize(Level + 1, nullptr);
+		E.LevelFlags.resize(Level + 1, nullptr);
+		E.LevelCapacity.resize(Level + 1, 0);
+	}
+	if(E.LevelCapacity[Level] >= Count)
+		return CL_SUCCESS;
+
+	// the old buffers may still be used by enqueued kernels, releasing them only drops our reference
+	SAFE_RELEASE_MEMOBJECT(E.LevelSums[Level]);
+	SAFE_RELEASE_MEMOBJECT(E.LevelFlags[Level]);
+	E.LevelCapacity[Level] = 0;
+
+	cl_int clError, clError2;
+	E.LevelSums[Level] = clCreateBuffer(E.Context, CL_MEM_READ_WRITE, E.ElementSize * Count, NULL, &clError2);
+	clError = clError2;
+	E.LevelFlags[Level] = clCreateBuffer(E.Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * Count, NULL, &clError2);
+	clError |= clError2;
+	if(clError == CL_SUCCESS)
+		E.LevelCapacity[Level] = Count;
+	return clError;
+}
+
+cl_int CScan::Run(cl_command_queue Queue, cl_mem Input, cl_mem Output, size_t Count, EScanMode Mode, cl_mem HeadFlags,
+	const TypeInfo& Type, const ScanOperator& Op)
+{
+	if(Count == 0)
+		return CL_SUCCESS;
+
+	lock_guard<mutex> lock(s_Mutex);
+	Entry* pEntry = GetEntry(Queue, HeadFlags != nullptr, Type, Op);
+	if(pEntry == nullptr)
+		return CL_BUILD_PROGRAM_FAILURE;
+
+	// number of elements on each level, the last level fits into one tile
+	vector<size_t> counts(1, Count);
+	while(counts.back() > pEntry->TileSize)
+		counts.push_back((counts.back() + pEntry->TileSize - 1) / pEntry->TileSize);
+
+	cl_int clError = CL_SUCCESS;
+	for(size_t l = 0; l < counts.size(); l++)
+	{
+		size_t numTiles = (counts[l] + pEntry->TileSize - 1) / pEntry->TileSize;
+		clError = ReserveLevel(*pEntry, l, numTiles);
+		if(clError != CL_SUCCESS)
+			return clError;
+	}
+
+	// up: scan the tiles of each level, the levels above the first are scanned in-place and inclusive
+	for(size_t l = 0; l < counts.size(); l++)
+	{
+		cl_mem input = (l == 0) ? Input : pEntry->LevelSums[l - 1];
+		cl_mem output = (l == 0) ? Output : pEntry->LevelSums[l - 1];
+		cl_mem flags = (l == 0) ? HeadFlags : pEntry->LevelFlags[l - 1];
+		cl_ulong n = counts[l];
+		cl_uint exclusive = (l == 0 && Mode == SCAN_EXCLUSIVE) ? 1 : 0;
+
+		clError = clSetKernelArg(pEntry->ScanKernel, 0, sizeof(cl_mem), &input);
+		clError |= clSetKernelArg(pEntry->ScanKernel, 1, sizeof(cl_mem), &output);
+		clError |= clSetKernelArg(pEntry->ScanKernel, 2, sizeof(cl_ulong), &n);
+		clError |= clSetKernelArg(pEntry->ScanKernel, 3, sizeof(cl_mem), &flags);
+		clError |= clSetKernelArg(pEntry->ScanKernel, 4, sizeof(cl_mem), &pEntry->LevelSums[l]);
+		clError |= clSetKernelArg(pEntry->ScanKernel, 5, sizeof(cl_mem), &pEntry->LevelFlags[l]);
+		clError |= clSetKernelArg(pEntry->ScanKernel, 6, sizeof(cl_uint), &exclusive);
+		if(clError != CL_SUCCESS)
+			return clError;
+
+		size_t globalWorkSize = ((counts[l] + pEntry->TileSize - 1) / pEntry->TileSize) * pEntry->LocalSize;
+		clError = clEnqueueNDRangeKernel(Queue, pEntry->ScanKernel, 1, NULL, &globalWorkSize, &pEntry->LocalSize, 0, NULL, NULL);
+		if(clError != CL_SUCCESS)
+			return clError;
+	}
+
+	// down: the scanned sums of the level above are combined with the tiles, except the first one
+	for(size_t l = counts.size() - 1; l-- > 0; )
+	{
+		cl_mem data = (l == 0) ? Output : pEntry->LevelSums[l - 1];
+		cl_mem flags = (l == 0) ? HeadFlags : pEntry->LevelFlags[l - 1];
+		cl_ulong n = counts[l];
+
+		clError = clSetKernelArg(pEntry->CarryKernel, 0, sizeof(cl_mem), &data);
+		clError |= clSetKernelArg(pEntry->CarryKernel, 1, sizeof(cl_ulong), &n);
+		clError |= clSetKernelArg(pEntry->CarryKernel, 2, sizeof(cl_mem), &pEntry->LevelSums[l]);
+		clError |= clSetKernelArg(pEntry->CarryKernel, 3, sizeof(cl_mem), &flags);
+		if(clError != CL_SUCCESS)
+			return clError;
+
+		size_t globalWorkSize = (counts[l + 1] - 1) * pEntry->LocalSize;
+		clError = clEnqueueNDRangeKernel(Queue, pEntry->CarryKernel, 1, NULL, &globalWorkSize, &pEntry->LocalSize, 0, NULL, NULL);
+		if(clError != CL_SUCCESS)
+			return clError;
+	}
+
+	return CL_SUCCESS;
+}
+
+void CScan::ReleaseEntry(Entry& E)
+{
+	SAFE_RELEASE_KERNEL(E.ScanKernel);
+	SAFE_RELEASE_KERNEL(E.CarryKernel);
+	for(size_t l = 0; l < E.LevelSums.size(); l++)
+	{
+		SAFE_RELEASE_MEMOBJECT(E.LevelSums[l]);
+		SAFE_RELEASE_MEMOBJECT(E.LevelFlags[l]);
+	}
+	E.LevelSums.clear();
+	E.LevelFlags.clear();
+	E.LevelCapacity.clear();
+}
+
+void CScan::ReleaseKernels(cl_context Context)
+{
+	lock_guard<mutex> lock(s_Mutex);
+	for(auto it = s_Entries.begin(); it != s_Entries.end(); )
+	{
+		if(Context == nullptr || it->second.Context == Context)
+		{
+			ReleaseEntry(it->second);
+			it = s_Entries.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,199 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CTHREAD_POOL_H
+#define _CTHREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Work-stealing thread pool for the CPU reference implementations
+/*!
+	ParallelFor() hands out the index range as one task. A thread that executes a range
+	larger than the grain size splits off the upper half into its own queue and continues
+	with the lower half. Idle threads steal the oldest (= largest) ranges from the other
+	queues, so the work is balanced also if the iterations have very different costs.
+	The calling thread takes part in the computation, so calls can be nested.
+
+	Usage:
+	CThreadPool::Get().ParallelFor(0, n, 1024, [&](size_t Begin, size_t End) {
+		for(size_t i = Begin; i < End; i++)
+			...
+	});
+
+	The number of threads defaults to std::thread::hardware_concurrency() and can be
+	set with the environment variable CPU_THREADS or with SetNumThreads()
+	(see the --cpu-threads option of CAssignmentBase).
+*/
+class CThreadPool
+{
+public:
+	//! Body of a parallel loop, called for the index range [Begin, End)
+	typedef std::function<void(size_t Begin, size_t End)> RangeFunction;
+
+	CThreadPool(unsigned int NumThreads);
+
+	~CThreadPool();
+
+	//! The shared pool of the application
+	static CThreadPool& Get();
+
+	//! Changes the size of the shared pool. 0 selects the number of hardware threads.
+	/*!
+		Must not be called while a parallel loop is running.
+	*/
+	static void SetNumThreads(unsigned int NumThreads);
+
+	//! Total number of threads working on a parallel loop, including the calling thread
+	unsigned int GetNumThreads() const { return (unsigned int)m_Threads.size() + 1; }
+
+	//! Runs Body over [Begin, End) in parallel. Ranges smaller than Grain are not split further.
+	void ParallelFor(size_t Begin, size_t End, size_t Grain, const RangeFunction& Body);
+
+	//! Reduces [Begin, End) with Body computing the value of a sub-range and Combine joining two values
+	/*!
+		The range is cut into fixed chunks and the partial results are combined from left to right,
+		so the result does not depend on the number of threads (important for floating point).
+	*/
+	template<typename T, typename RangeReduce, typename Combine>
+	T ParallelReduce(size_t Begin, size_t End, size_t Grain, const T& Identity, RangeReduce Body, Combine Op)
+	{
+		if(End <= Begin)
+			return Identity;
+
+		if(Grain == 0)
+			Grain = 1;
+		size_t nChunks = (End - Begin + Grain - 1) / Grain;
+		std::vector<T> partial(nChunks, Identity);
+
+		ParallelFor(0, nChunks, 1, [&](size_t ChunkBegin, size_t ChunkEnd) {
+			for(size_t c = ChunkBegin; c < ChunkEnd; c++)
+				partial[c] = Body(Begin + c * Grain, std::min(End, Begin + (c + 1) * Grain));
+		});
+
+		T result = Identity;
+		for(size_t c = 0; c < nChunks; c++)
+			result = Op(result, partial[c]);
+		return result;
+	}
+
+	//! Sorts Count elements stably with the comparison Less
+	/*!
+		Every thread sorts chunks with std::stable_sort, then the sorted runs are merged pairwise
+		until one is left. The last merges use fewer threads, so this scales less than linearly.
+	*/
+	template<typename T, typename Compare>
+	void ParallelSort(T* pData, size_t Count, Compare Less)
+	{
+		size_t nChunks = 4 * GetNumThreads();
+		size_t chunkSize = std::max((Count + nChunks - 1) / nChunks, size_t(1 << 12));
+		if(Count <= chunkSize)
+		{
+			std::stable_sort(pData, pData + Count, Less);
+			return;
+		}
+		nChunks = (Count + chunkSize - 1) / chunkSize;
+
+		ParallelFor(0, nChunks, 1, [&](size_t ChunkBegin, size_t ChunkEnd) {
+			for(size_t c = ChunkBegin; c < ChunkEnd; c++)
+				std::stable_sort(pData + c * chunkSize, pData + std::min(Count, (c + 1) * chunkSize), Less);
+		});
+
+		// std::merge takes equal elements from the first run first, which keeps the order stable
+		std::vector<T> buffer(Count);
+		T* pSource = pData;
+		T* pTarget = buffer.data();
+		for(size_t width = chunkSize; width < Count; width *= 2)
+		{
+			size_t nPairs = (Count + 2 * width - 1) / (2 * width);
+			ParallelFor(0, nPairs, 1, [&](size_t PairBegin, size_t PairEnd) {
+				for(size_t p = PairBegin; p < PairEnd; p++)
+				{
+					size_t begin = p * 2 * width;
+					size_t middle = std::min(Count, begin + width);
+					size_t end = std::min(Count, begin + 2 * width);
+					std::merge(pSource + begin, pSource + middle, pSource + middle, pSource + end, pTarget + begin, Less);
+				}
+			});
+			std::swap(pSource, pTarget);
+		}
+
+		if(pSource != pData)
+		{
+			ParallelFor(0, Count, 1 << 16, [&](size_t Begin, size_t End) {
+				std::copy(pSource + Begin, pSource + End, pData + Begin);
+			});
+		}
+	}
+
+protected:
+	struct Job
+	{
+		const RangeFunction*	pBody;
+		size_t					Grain;
+		//! Number of iterations that have not been executed yet
+		std::atomic<size_t>		Remaining;
+	};
+
+	struct Task
+	{
+		Job*	pJob;
+		size_t	Begin;
+		size_t	End;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex			Mutex;
+		std::deque<Task>	Tasks;
+	};
+
+	void WorkerMain(unsigned int Index);
+
+	void Push(unsigned int Queue, const Task& T);
+
+	//! Takes the newest task of the own queue or steals the oldest task of another queue
+	bool Pop(unsigned int Queue, Task& T);
+
+	void Execute(unsigned int Queue, Task T);
+
+	//! Queue of the calling thread. Threads outside the pool share queue 0.
+	unsigned int GetQueueIndex() const;
+
+	std::vector<std::thread>				m_Threads;
+	std::vector<std::unique_ptr<WorkQueue> >	m_Queues;
+
+	std::mutex					m_WakeMutex;
+	std::condition_variable		m_WakeCondition;
+	std::atomic<size_t>			m_NumQueuedTasks;
+	bool						m_Stop;
+
+	static std::unique_ptr<CThreadPool>	s_Pool;
+	static unsigned int					s_NumThreads;
+	static std::mutex					s_PoolMutex;
+};
+
+#endif // _CTHREAD_POOL_H
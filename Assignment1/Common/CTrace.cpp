@@ -0,0 +1,234 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CTrace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdio.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CTraceRecorder
+
+std::atomic<bool> CTraceRecorder::s_Enabled(false);
+size_t CTraceRecorder::s_Capacity = 65536;
+std::mutex CTraceRecorder::s_BuffersMutex;
+std::vector<std::shared_ptr<CTraceRecorder::ThreadBuffer> > CTraceRecorder::s_Buffers;
+CTraceRecorder::ThreadBuffer CTraceRecorder::s_DeviceBuffer;
+
+// nesting level of the CScopedTimer objects of the current thread
+static thread_local unsigned int s_ScopeDepth = 0;
+
+void CTraceRecorder::SetEnabled(bool Enabled)
+{
+	s_Enabled = Enabled;
+}
+
+void CTraceRecorder::SetCapacity(size_t EventsPerThread)
+{
+	lock_guard<mutex> lock(s_BuffersMutex);
+	s_Capacity = max<size_t>(EventsPerThread, 1);
+}
+
+CTraceRecorder::ThreadBuffer& CTraceRecorder::GetThreadBuffer()
+{
+	// the list keeps the buffer alive after the thread has finished, so its spans can still be exported
+	static thread_local shared_ptr<ThreadBuffer> buffer;
+	if(!buffer)
+	{
+		buffer = make_shared<ThreadBuffer>();
+		buffer->Next = 0;
+		buffer->Wrapped = false;
+
+		lock_guard<mutex> lock(s_BuffersMutex);
+		buffer->Events.resize(s_Capacity);
+		buffer->ThreadIndex = (unsigned int)s_Buffers.size();
+		s_Buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+void CTraceRecorder::Push(ThreadBuffer& Buffer, Event& E)
+{
+	lock_guard<mutex> lock(Buffer.Mutex);
+	if(Buffer.Events.empty())
+		Buffer.Events.resize(s_Capacity);
+
+	swap(Buffer.Events[Buffer.Next], E);
+	Buffer.Next++;
+	if(Buffer.Next == Buffer.Events.size())
+	{
+		Buffer.Next = 0;
+		Buffer.Wrapped = true;
+	}
+}
+
+void CTraceRecorder::RecordHostSpan(const std::string& Name, const char* Category,
+	unsigned long long Start, unsigned long long End, unsigned int Depth)
+{
+	if(!s_Enabled)
+		return;
+
+	Event e = { Name, Category, Start, End, Depth };
+	Push(GetThreadBuffer(), e);
+}
+
+void CTraceRecorder::RecordDeviceSpan(const std::string& Name, unsigned long long Start, unsigned long long End)
+{
+	if(!s_Enabled)
+		return;
+
+	Event e = { Name, "device", Start, End, 0 };
+	Push(s_DeviceBuffer, e);
+}
+
+void CTraceRecorder::RecordDeviceEvent(const std::string& Name, cl_event Event, long long DeviceToHostOffset)
+{
+	if(!s_Enabled)
+		return;
+
+	cl_ulong start = 0, end = 0;
+	cl_int clErr;
+	clErr  = clGetEventProfilingInfo(Event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+	clErr |= clGetEventProfilingInfo(Event, CL_PROFILING_COMMAND_END,   sizeof(cl_ulong), &end,   NULL);
+	// silently ignore events of queues without profiling
+	if(clErr != CL_SUCCESS)
+		return;
+
+	RecordDeviceSpan(Name, (unsigned long long)((long long)start + DeviceToHostOffset),
+		(unsigned long long)((long long)end + DeviceToHostOffset));
+}
+
+void CTraceRecorder::Clear()
+{
+	lock_guard<mutex> lock(s_BuffersMutex);
+	for(size_t i = 0; i < s_Buffers.size(); i++)
+	{
+		lock_guard<mutex> bufferLock(s_Buffers[i]->Mutex);
+		s_Buffers[i]->Next = 0;
+		s_Buffers[i]->Wrapped = false;
+	}
+	lock_guard<mutex> deviceLock(s_DeviceBuffer.Mutex);
+	s_DeviceBuffer.Next = 0;
+	s_DeviceBuffer.Wrapped = false;
+}
+
+static string EscapeJSON(const string& Str)
+{
+	string out;
+	for(size_t i = 0; i < Str.size(); i++)
+	{
+		char c = Str[i];
+		if(c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if((unsigned char)c < 0x20)
+		{
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned int)(unsigned char)c);
+			out += buffer;
+		}
+		else
+			out += c;
+	}
+	return out;
+}
+
+bool CTraceRecorder::WriteChromeTrace(const std::string& Path)
+{
+	// copy the spans first, so that recording threads are blocked as short as possible
+	vector<pair<unsigned int, vector<Event> > > threads;
+	vector<Event> deviceEvents;
+	{
+		lock_guard<mutex> lock(s_BuffersMutex);
+		for(size_t i = 0; i < s_Buffers.size(); i++)
+		{
+			ThreadBuffer& buffer = *s_Buffers[i];
+			lock_guard<mutex> bufferLock(buffer.Mutex);
+			vector<Event> events;
+			if(buffer.Wrapped)
+				events.insert(events.end(), buffer.Events.begin() + buffer.Next, buffer.Events.end());
+			events.insert(events.end(), buffer.Events.begin(), buffer.Events.begin() + buffer.Next);
+			threads.push_back(make_pair(buffer.ThreadIndex, events));
+		}
+
+		lock_guard<mutex> deviceLock(s_DeviceBuffer.Mutex);
+		if(s_DeviceBuffer.Wrapped)
+			deviceEvents.insert(deviceEvents.end(), s_DeviceBuffer.Events.begin() + s_DeviceBuffer.Next, s_DeviceBuffer.Events.end());
+		deviceEvents.insert(deviceEvents.end(), s_DeviceBuffer.Events.begin(), s_DeviceBuffer.Events.begin() + s_DeviceBuffer.Next);
+	}
+
+	// timestamps in the trace are relative to the earliest span
+	unsigned long long origin = ~0ull;
+	for(size_t i = 0; i < threads.size(); i++)
+		for(size_t j = 0; j < threads[i].second.size(); j++)
+			origin = min(origin, threads[i].second[j].Start);
+	for(size_t j = 0; j < deviceEvents.size(); j++)
+		origin = min(origin, deviceEvents[j].Start);
+
+	ofstream out(Path.c_str());
+	if(!out.good())
+	{
+		cerr<<"Failed to open trace file "<<Path<<endl;
+		return false;
+	}
+
+	out<<"{\"displayTimeUnit\":\"ns\",\"traceEvents\":["<<endl;
+	out<<"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Host\"}},"<<endl;
+	out<<"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Device\"}}";
+
+	char buffer[128];
+	auto writeSpan = [&](const Event& E, int Pid, unsigned int Tid)
+	{
+		// Chrome expects microseconds
+		snprintf(buffer, sizeof(buffer), "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u",
+			1.0e-3 * double(E.Start - origin), 1.0e-3 * double(E.End - E.Start), Pid, Tid);
+		out<<","<<endl<<"{\"name\":\""<<EscapeJSON(E.Name)<<"\",\"cat\":\""<<(E.Category ? E.Category : "")
+			<<"\",\"ph\":\"X\","<<buffer<<",\"args\":{\"depth\":"<<E.Depth<<"}}";
+	};
+
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		out<<","<<endl<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"<<threads[i].first
+			<<",\"args\":{\"name\":\"Thread "<<threads[i].first<<"\"}}";
+		for(size_t j = 0; j < threads[i].second.size(); j++)
+			writeSpan(threads[i].second[j], 0, threads[i].first);
+	}
+	for(size_t j = 0; j < deviceEvents.size(); j++)
+		writeSpan(deviceEvents[j], 1, 0);
+
+	out<<endl<<"]}"<<endl;
+
+	cout<<"Trace written to "<<Path<<endl;
+	return out.good();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CScopedTimer
+
+CScopedTimer::CScopedTimer(const std::string& Name, const char* Category)
+	: m_Name(Name), m_Category(Category), m_Start(CTimer::GetTimestamp()), m_Depth(s_ScopeDepth++),
+	m_Recording(CTraceRecorder::IsEnabled())
+{
+}
+
+CScopedTimer::~CScopedTimer()
+{
+	s_ScopeDepth--;
+	if(m_Recording)
+		CTraceRecorder::RecordHostSpan(m_Name, m_Category, m_Start, CTimer::GetTimestamp(), m_Depth);
+}
+
+double CScopedTimer::GetElapsedMilliseconds() const
+{
+	return 1.0e-6 * double(CTimer::GetTimestamp() - m_Start);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -1,37 +1,40 @@
+import csv
+import sys
+
 import matplotlib.pyplot as plt
 
-threads = [1<<11, 1<<20, 1<<20, 1<<25]
-worksize=[16,64,256,1024]
-lines = []
-analysis = {t: [] for t in worksize}
-with open("build/log","r") as f:
-    lines = f.readlines()
-for i in range(min(96,len(lines))):
-    line = lines[i]
-    if not line.startswith("Computing GPU result."):
-        continue
-    if line.startswith("Running matrix"):
-        break
-    line = line.split("Executing ")[1].split(" threads in ")
-    thread = int(line[0])
-    groups, size = [int(s) for s in line[1].split(" groups of size ")]
-    time = float(lines[i+1][38:-4])
-    analysis[size].append(time)
+# results of the benchmark runner, e.g.
+#   ./Benchmark --task vecadd --csv benchmark.csv
+# every kernel variant is a measurement of its own, only one of them is plotted
+path = sys.argv[1] if len(sys.argv) > 1 else "build/benchmark.csv"
+measurement = sys.argv[2] if len(sys.argv) > 2 else "VecAdd"
+
+analysis = {}
+threads = []
+with open(path, "r") as f:
+    for row in csv.DictReader(f):
+        if row["task"] != "vecadd" or row["measurement"] != measurement:
+            continue
+        size = int(row["size"])
+        worksize = int(row["local_x"])
+        if size not in threads:
+            threads.append(size)
+        analysis.setdefault(worksize, {})[size] = float(row["median_ms"])
 
+worksize = sorted(analysis)
+threads.sort()
 print(analysis)
 
-x = [e for e in range(1,5)]
-width=0.2
-b = len(worksize)
+x = [e for e in range(1, len(threads) + 1)]
+width = 0.8 / max(len(worksize), 1)
 fig, ax = plt.subplots()
-pos = [-1.5*width, -width/2, width/2, 1.5*width]
-for i in range(4):
-    x_axis = [xi+pos[i] for xi in x]
+for i in range(len(worksize)):
+    x_axis = [xi + (i - (len(worksize) - 1) / 2.0) * width for xi in x]
     print(x_axis)
-    ax.bar(x_axis, analysis[worksize[i]], width, label="Worksize " +str(worksize[i]))
+    ax.bar(x_axis, [analysis[worksize[i]].get(t, 0) for t in threads], width, label="Worksize " + str(worksize[i]))
 
 plt.yscale("log")
-plt.title("Malte Voss: Runtimes of different group sizes for different vector sizes")
+plt.title("Malte Voss: Runtimes of different group sizes for different vector sizes (" + measurement + ")")
 ax.set_ylabel("Execution time [ms]")
 ax.set_xlabel("Vector size")
 ax.set_xticks(x)
@@ -39,4 +42,3 @@ ax.set_xticklabels(threads)
 ax.legend()
 
 plt.show()
-
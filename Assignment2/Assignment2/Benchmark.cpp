@@ -0,0 +1,91 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "../Common/CBenchmark.h"
+
+#include "CReductionTask.h"
+#include "CCompactTask.h"
+#include "CGenericScanTask.h"
+#include "CRadixSortTask.h"
+#include "CScanTask.h"
+#include "CScanLibraryTask.h"
+#include "CTypedReductionTask.h"
+
+#include <iostream>
+
+using namespace std;
+
+// Benchmark runner for the tasks of assignment 2, see CBenchmarkRunner for the options.
+// Each run measures all kernel variants of a task, they are reported as separate measurements.
+int main(int argc, char** argv)
+{
+	CBenchmarkRunner runner;
+
+	runner.RegisterTask("reduction",
+		[](const BenchmarkCase& Case) -> IComputeTask* { return new CReductionTask(Case.Size); },
+		{ 1 << 20, 1 << 22, 1 << 24 }, { 64, 1, 1, 128, 1, 1, 256, 1, 1, 512, 1, 1 });
+
+	// the variant is the element type, all operators are measured (the local size is chosen by CReduction)
+	runner.RegisterTask("reduce_typed",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			EReduceElementType type;
+			if(!CTypedReductionTask::ParseElementType(Case.Variant, type))
+				return nullptr;
+			return new CTypedReductionTask(Case.Size, type);
+		},
+		{ 1 << 20, 1 << 22, 1 << 24 }, { 256, 1, 1 },
+		{ "int32", "uint32", "int64", "float", "double" });
+
+	runner.RegisterTask("scan",
+		[](const BenchmarkCase& Case) -> IComputeTask* { return new CScanTask(Case.Size, Case.LocalWorkSize[0]); },
+		{ 1 << 20, 1 << 22, 1 << 24, 1 << 26 }, { 128, 1, 1, 256, 1, 1, 512, 1, 1 });
+
+	// sizes which are not powers of two, the local size is chosen by CScan
+	runner.RegisterTask("scan_library",
+		[](const BenchmarkCase& Case) -> IComputeTask* { return new CScanLibraryTask(Case.Size); },
+		{ 1000003, (1 << 22) + 17, (1 << 24) - 5 }, { 256, 1, 1 });
+
+	// the variant is the element type and operator
+	runner.RegisterTask("scan_generic",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			EGenericScanCase scanCase;
+			if(!CGenericScanTask::ParseCase(Case.Variant, scanCase))
+				return nullptr;
+			return new CGenericScanTask(Case.Size, scanCase);
+		},
+		{ 1 << 20, 1 << 22, 1 << 24 }, { 256, 1, 1 },
+		{ "int_max", "uint_min", "long_sum", "float_max", "float4_sum", "float2_recurrence" });
+
+	// the variant is the key type, each case times all numbers of radix bits
+	runner.RegisterTask("radix_sort",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			ERadixSortCase sortCase;
+			if(!CRadixSortTask::ParseCase(Case.Variant, sortCase))
+				return nullptr;
+			return new CRadixSortTask(Case.Size, sortCase);
+		},
+		{ 1 << 20, 1 << 22, 1 << 24 }, { 256, 1, 1 },
+		{ "uint", "uint_pairs", "ulong", "ulong_pairs" });
+
+	// the variant selects the element type and how the elements are selected
+	runner.RegisterTask("compact",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			ECompactCase compactCase;
+			if(!CCompactTask::ParseCase(Case.Variant, compactCase))
+				return nullptr;
+			return new CCompactTask(Case.Size, compactCase);
+		},
+		{ 1 << 20, 1 << 22, 1 << 24 }, { 256, 1, 1 },
+		{ "float_sparse", "int_half", "struct12_flags", "struct6_flags" });
+
+	auto success = runner.EnterMainLoop(argc, argv);
+
+#ifdef _MSC_VER
+	cout<<"Press any key..."<<endl;
+	cin.get();
+#endif
+
+	return success ? 0 : 1;
+}
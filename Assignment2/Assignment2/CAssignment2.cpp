@@ -5,8 +5,13 @@ GPU Computing / GPGPU Praktikum source code.
 
 #include "CAssignment2.h"
 
+#include "CCompactTask.h"
 #include "CReductionTask.h"
+#include "CGenericScanTask.h"
+#include "CRadixSortTask.h"
 #include "CScanTask.h"
+#include "CScanLibraryTask.h"
+#include "CTypedReductionTask.h"
 
 #include <iostream>
 
@@ -26,6 +31,14 @@ bool CAssignment2::DoCompute()
 		RunComputeTask(reduction, LocalWorkSize);
 	}
 
+	// the same reduction with all operators on other element types (see CReduce.h)
+	for(int t = 0; t < NUM_REDUCE_ELEMENT_TYPES; t++)
+	{
+		size_t LocalWorkSize[3] = {256, 1, 1};
+		CTypedReductionTask reduction(1024 * 1024 * 16, EReduceElementType(t));
+		RunComputeTask(reduction, LocalWorkSize);
+	}
+
 	// Task 2: parallel prefix sum
 	cout<<"########################################"<<endl;
 	cout<<"Running parallel prefix sum task..."<<endl<<endl;
@@ -35,6 +48,40 @@ bool CAssignment2::DoCompute()
 		RunComputeTask(scan, LocalWorkSize);
 	}
 
+	// the scan of the shared code (see CScan.h) on an odd size, inclusive, exclusive and segmented
+	{
+		size_t LocalWorkSize[3] = {256, 1, 1};
+		CScanLibraryTask scan(10000019);
+		RunComputeTask(scan, LocalWorkSize);
+	}
+
+	// other element types and operators (see Scan<T>() in CScan.h)
+	for(int c = 0; c < NUM_GENERIC_SCAN_CASES; c++)
+	{
+		size_t LocalWorkSize[3] = {256, 1, 1};
+		CGenericScanTask scan((1 << 22) + 3, EGenericScanCase(c));
+		RunComputeTask(scan, LocalWorkSize);
+	}
+
+	// radix sort of keys and key-value pairs, built on the scan (see CRadixSort.h)
+	cout<<"########################################"<<endl;
+	cout<<"Running radix sort task..."<<endl<<endl;
+	for(int c = 0; c < NUM_RADIX_SORT_CASES; c++)
+	{
+		size_t LocalWorkSize[3] = {256, 1, 1};
+		CRadixSortTask sort((1 << 22) + 5, ERadixSortCase(c));
+		RunComputeTask(sort, LocalWorkSize);
+	}
+
+	// stream compaction with predicates and flags, built on the scan (see CCompact.h)
+	cout<<"########################################"<<endl;
+	cout<<"Running stream compaction task..."<<endl<<endl;
+	for(int c = 0; c < NUM_COMPACT_CASES; c++)
+	{
+		size_t LocalWorkSize[3] = {256, 1, 1};
+		CCompactTask compact((1 << 24) + 7, ECompactCase(c));
+		RunComputeTask(compact, LocalWorkSize);
+	}
 
 	return true;
 }
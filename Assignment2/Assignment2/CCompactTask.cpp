@@ -0,0 +1,202 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CCompactTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
+
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CCompactTask
+
+// the elements of the flag cases
+struct CompactStruct12 { cl_float v[3]; };
+struct CompactStruct6 { cl_ushort v[3]; };
+
+CCompactTask::CCompactTask(size_t ArraySize, ECompactCase Case)
+	: m_N(ArraySize), m_Case(Case), m_hInput(NULL), m_hFlags(NULL), m_hResultCPU(NULL), m_hResultGPU(NULL),
+	m_CountCPU(0), m_CountGPU(0), m_dInput(NULL), m_dFlags(NULL), m_dOutput(NULL), m_dCount(NULL)
+{
+}
+
+CCompactTask::~CCompactTask()
+{
+	ReleaseResources();
+}
+
+const char* CCompactTask::GetCaseName(ECompactCase Case)
+{
+	switch(Case)
+	{
+	case COMPACT_FLOAT_SPARSE:		return "float_sparse";
+	case COMPACT_INT_HALF:			return "int_half";
+	case COMPACT_STRUCT12_FLAGS:	return "struct12_flags";
+	default:						return "struct6_flags";
+	}
+}
+
+bool CCompactTask::ParseCase(const std::string& Name, ECompactCase& Case)
+{
+	for(int c = 0; c < NUM_COMPACT_CASES; c++)
+	{
+		if(Name == GetCaseName(ECompactCase(c)))
+		{
+			Case = ECompactCase(c);
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t CCompactTask::GetElementSize() const
+{
+	switch(m_Case)
+	{
+	case COMPACT_STRUCT12_FLAGS:	return sizeof(CompactStruct12);
+	case COMPACT_STRUCT6_FLAGS:		return sizeof(CompactStruct6);
+	default:						return 4;
+	}
+}
+
+bool CCompactTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	//CPU resources
+	m_hInput = new unsigned char[GetElementSize() * m_N];
+	m_hResultCPU = new unsigned char[GetElementSize() * m_N];
+	m_hResultGPU = new unsigned char[GetElementSize() * m_N];
+
+	// random bytes are valid values of all element types, the floats of the sparse case are in [0, 1)
+	for(size_t i = 0; i < GetElementSize() * m_N; i++)
+		m_hInput[i] = (unsigned char)(rand() & 0xff);
+	if(m_Case == COMPACT_FLOAT_SPARSE)
+	{
+		cl_float* input = (cl_float*)m_hInput;
+		for(size_t i = 0; i < m_N; i++)
+			input[i] = float(rand()) / (float(RAND_MAX) + 1.0f);
+	}
+	if(UsesFlags())
+	{
+		m_hFlags = new cl_uint[m_N];
+		for(size_t i = 0; i < m_N; i++)
+			m_hFlags[i] = (rand() % 10 == 0) ? 1 : 0;
+	}
+
+	//device resources, the kernels are built by Compact() on first use
+	cl_int clError, clError2;
+	m_dInput = CreateBuffer(Context, CL_MEM_READ_ONLY, GetElementSize() * m_N, &clError2);
+	clError = clError2;
+	m_dOutput = CreateBuffer(Context, CL_MEM_READ_WRITE, GetElementSize() * m_N, &clError2);
+	clError |= clError2;
+	m_dCount = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint), &clError2);
+	clError |= clError2;
+	if(UsesFlags())
+	{
+		m_dFlags = CreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_uint) * m_N, &clError2);
+		clError |= clError2;
+	}
+	V_RETURN_FALSE_CL(clError, "Error allocating device arrays");
+
+	return true;
+}
+
+void CCompactTask::ReleaseResources()
+{
+	SAFE_DELETE_ARRAY(m_hInput);
+	SAFE_DELETE_ARRAY(m_hFlags);
+	SAFE_DELETE_ARRAY(m_hResultCPU);
+	SAFE_DELETE_ARRAY(m_hResultGPU);
+
+	ReleaseBuffer(m_dInput);
+	ReleaseBuffer(m_dFlags);
+	ReleaseBuffer(m_dOutput);
+	ReleaseBuffer(m_dCount);
+}
+
+template<class T>
+void CCompactTask::ComputeCPUTyped()
+{
+	m_CountCPU = CompactHost<T>((const T*)m_hInput, (T*)m_hResultCPU, m_N, [&](const T&, size_t i) { return m_hFlags[i] != 0; });
+}
+
+void CCompactTask::ComputeCPU()
+{
+	switch(m_Case)
+	{
+	case COMPACT_FLOAT_SPARSE:
+		m_CountCPU = CompactHost<cl_float>((const cl_float*)m_hInput, (cl_float*)m_hResultCPU, m_N, [](cl_float x, size_t) { return x < 0.01f; });
+		break;
+	case COMPACT_INT_HALF:
+		m_CountCPU = CompactHost<cl_int>((const cl_int*)m_hInput, (cl_int*)m_hResultCPU, m_N, [](cl_int x, size_t) { return (x & 1) == 0; });
+		break;
+	case COMPACT_STRUCT12_FLAGS:	ComputeCPUTyped<CompactStruct12>(); break;
+	default:						ComputeCPUTyped<CompactStruct6>(); break;
+	}
+}
+
+cl_int CCompactTask::RunCompact(cl_command_queue CommandQueue, cl_uint* pCount)
+{
+	switch(m_Case)
+	{
+	case COMPACT_FLOAT_SPARSE:	return Compact<cl_float>(CommandQueue, m_dInput, m_dOutput, m_N, "x < 0.01f", m_dCount, pCount);
+	case COMPACT_INT_HALF:		return Compact<cl_int>(CommandQueue, m_dInput, m_dOutput, m_N, "(x & 1) == 0", m_dCount, pCount);
+	default:					return Compact(CommandQueue, m_dInput, m_dFlags, m_dOutput, m_N, GetElementSize(), m_dCount, pCount);
+	}
+}
+
+void CCompactTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	{
+		CScopedTimer timer("WriteBuffers");
+		V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dInput, CL_TRUE, 0, GetElementSize() * m_N, m_hInput, 0, NULL, NULL), "Error copying data from host to device!");
+		if(UsesFlags())
+			V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dFlags, CL_TRUE, 0, sizeof(cl_uint) * m_N, m_hFlags, 0, NULL, NULL), "Error copying data from host to device!");
+	}
+
+	string name = string("compact_") + GetCaseName(m_Case);
+	cout<<"Compacting "<<m_N<<" elements: "<<GetCaseName(m_Case)<<endl;
+
+	// the first call builds the kernels, so it is not timed. The count arrives with the blocking read of the result.
+	V_RETURN_CL(RunCompact(CommandQueue, &m_CountGPU), "Error executing " + name);
+	V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, m_dOutput, CL_TRUE, 0, GetElementSize() * m_N, m_hResultGPU, 0, NULL, NULL), "Error reading data from device!");
+
+	// the count stays on the device while timing
+	const int nIterations = 20;
+	CTimer timer;
+	timer.Start();
+	for(int i = 0; i < nIterations; i++)
+		V_RETURN_CL(RunCompact(CommandQueue, nullptr), "Error executing " + name);
+	V_RETURN_CL(clFinish(CommandQueue), "Error finishing the queue!");
+	timer.Stop();
+	double ms = timer.GetElapsedMilliseconds() / double(nIterations);
+
+	cout<<"  "<<name<<": "<<m_CountGPU<<" kept, "<<ms<<" ms"<<endl;
+	size_t elements, bytes;
+	GetWorkload(elements, bytes);
+	CLUtil::PrintBandwidth(name, bytes, ms);
+	CBenchmarkRecorder::ReportTime(name, ms);
+}
+
+bool CCompactTask::ValidateResults()
+{
+	if(m_CountGPU != m_CountCPU)
+	{
+		cout<<"Validation of the compaction "<<GetCaseName(m_Case)<<" failed: "<<m_CountGPU<<" elements kept instead of "<<m_CountCPU<<"."<<endl;
+		return false;
+	}
+	if(memcmp(m_hResultGPU, m_hResultCPU, GetElementSize() * m_CountCPU) != 0)
+	{
+		cout<<"Validation of the compaction "<<GetCaseName(m_Case)<<" failed."<<endl;
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
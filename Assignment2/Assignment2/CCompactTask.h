@@ -0,0 +1,98 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CCOMPACT_TASK_H
+#define _CCOMPACT_TASK_H
+
+#include "../Common/IComputeTask.h"
+#include "../Common/CCompact.h"
+
+#include <string>
+
+enum ECompactCase
+{
+	//! floats below a threshold selected by a predicate, about 1% survive
+	COMPACT_FLOAT_SPARSE,
+	//! even ints selected by a predicate
+	COMPACT_INT_HALF,
+	//! structs of three floats (12 bytes) selected by flags, about 10% survive
+	COMPACT_STRUCT12_FLAGS,
+	//! structs of three ushorts (6 bytes) selected by flags, about 10% survive
+	COMPACT_STRUCT6_FLAGS,
+	NUM_COMPACT_CASES
+};
+
+//! A2 compaction: Compact() of CCompact.h with predicates and with flags
+/*!
+	The kept elements and their number are compared with CompactHost().
+*/
+class CCompactTask : public IComputeTask
+{
+public:
+	CCompactTask(size_t ArraySize, ECompactCase Case);
+
+	virtual ~CCompactTask();
+
+	static const char* GetCaseName(ECompactCase Case);
+
+	//! Parses the names of GetCaseName(), returns false if the name is unknown
+	static bool ParseCase(const std::string& Name, ECompactCase& Case);
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// the input and the flags are read once, the kept elements are not counted
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_N; Bytes = (GetElementSize() + (UsesFlags() ? sizeof(cl_uint) : 0)) * m_N; }
+
+protected:
+	size_t GetElementSize() const;
+
+	bool UsesFlags() const { return m_Case == COMPACT_STRUCT12_FLAGS || m_Case == COMPACT_STRUCT6_FLAGS; }
+
+	template<class T> void ComputeCPUTyped();
+
+	//! Calls Compact() with the flags or the predicate of the case
+	cl_int RunCompact(cl_command_queue CommandQueue, cl_uint* pCount);
+
+	size_t				m_N;
+	ECompactCase		m_Case;
+
+	unsigned char		*m_hInput;
+	cl_uint				*m_hFlags;
+	unsigned char		*m_hResultCPU;
+	unsigned char		*m_hResultGPU;
+	size_t				m_CountCPU;
+	cl_uint				m_CountGPU;
+
+	cl_mem				m_dInput;
+	cl_mem				m_dFlags;
+	cl_mem				m_dOutput;
+	//! the count written by the device
+	cl_mem				m_dCount;
+};
+
+#endif // _CCOMPACT_TASK_H
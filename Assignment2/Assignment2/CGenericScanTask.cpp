@@ -0,0 +1,271 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CGenericScanTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CGenericScanTask
+
+static float RandomFloat() { return float(rand()) / float(RAND_MAX); }
+
+// random input values, the scales of the recurrence are below 1 so it stays bounded
+static void RandomValue(cl_int& Value, EGenericScanCase) { Value = rand() % 2001 - 1000; }
+static void RandomValue(cl_uint& Value, EGenericScanCase) { Value = cl_uint(rand()) * 7919u; }
+static void RandomValue(cl_long& Value, EGenericScanCase) { Value = (cl_long(rand()) << 20) - (cl_long(rand()) << 12); }
+static void RandomValue(cl_float& Value, EGenericScanCase) { Value = RandomFloat() * 2000.0f - 1000.0f; }
+static void RandomValue(cl_float2& Value, EGenericScanCase) { Value.s[0] = 0.5f + 0.49f * RandomFloat(); Value.s[1] = RandomFloat(); }
+static void RandomValue(cl_float4& Value, EGenericScanCase) { for(int c = 0; c < 4; c++) Value.s[c] = RandomFloat(); }
+
+// the affine map a followed by b, see ScanOperator
+static const ScanOperator c_Recurrence = { "recurrence", "(float2)(a.x * b.x, a.y * b.x + b.y)", "(float2)(1.0f, 0.0f)" };
+
+CGenericScanTask::CGenericScanTask(size_t ArraySize, EGenericScanCase Case)
+	: m_N(ArraySize), m_Case(Case), m_hInput(NULL), m_hResultGPU(NULL), m_dInput(NULL), m_dOutput(NULL)
+{
+	for(int m = 0; m < 2; m++)
+	{
+		m_hResultCPU[m] = NULL;
+		m_Valid[m] = false;
+	}
+}
+
+CGenericScanTask::~CGenericScanTask()
+{
+	ReleaseResources();
+}
+
+const char* CGenericScanTask::GetCaseName(EGenericScanCase Case)
+{
+	switch(Case)
+	{
+	case GENERIC_SCAN_INT_MAX:				return "int_max";
+	case GENERIC_SCAN_UINT_MIN:				return "uint_min";
+	case GENERIC_SCAN_LONG_SUM:				return "long_sum";
+	case GENERIC_SCAN_FLOAT_MAX:			return "float_max";
+	case GENERIC_SCAN_FLOAT4_SUM:			return "float4_sum";
+	default:								return "float2_recurrence";
+	}
+}
+
+bool CGenericScanTask::ParseCase(const std::string& Name, EGenericScanCase& Case)
+{
+	for(int c = 0; c < NUM_GENERIC_SCAN_CASES; c++)
+	{
+		if(Name == GetCaseName(EGenericScanCase(c)))
+		{
+			Case = EGenericScanCase(c);
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t CGenericScanTask::GetElementSize() const
+{
+	switch(m_Case)
+	{
+	case GENERIC_SCAN_LONG_SUM:				return sizeof(cl_long);
+	case GENERIC_SCAN_FLOAT4_SUM:			return sizeof(cl_float4);
+	case GENERIC_SCAN_FLOAT2_RECURRENCE:	return sizeof(cl_float2);
+	default:								return 4;
+	}
+}
+
+double CGenericScanTask::GetTolerance() const
+{
+	return (m_Case == GENERIC_SCAN_FLOAT4_SUM || m_Case == GENERIC_SCAN_FLOAT2_RECURRENCE) ? 1e-3 : 0;
+}
+
+template<class T>
+void CGenericScanTask::FillInput()
+{
+	T* input = (T*)m_hInput;
+	for(size_t i = 0; i < m_N; i++)
+		RandomValue(input[i], m_Case);
+}
+
+bool CGenericScanTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	//CPU resources
+	m_hInput = new unsigned char[GetElementSize() * m_N];
+	m_hResultGPU = new unsigned char[GetElementSize() * m_N];
+	for(int m = 0; m < 2; m++)
+		m_hResultCPU[m] = new unsigned char[GetElementSize() * m_N];
+
+	switch(m_Case)
+	{
+	case GENERIC_SCAN_INT_MAX:				FillInput<cl_int>(); break;
+	case GENERIC_SCAN_UINT_MIN:				FillInput<cl_uint>(); break;
+	case GENERIC_SCAN_LONG_SUM:				FillInput<cl_long>(); break;
+	case GENERIC_SCAN_FLOAT_MAX:			FillInput<cl_float>(); break;
+	case GENERIC_SCAN_FLOAT4_SUM:			FillInput<cl_float4>(); break;
+	default:								FillInput<cl_float2>(); break;
+	}
+
+	//device resources, the kernels are built by Scan() on first use
+	cl_int clError, clError2;
+	m_dInput = CreateBuffer(Context, CL_MEM_READ_ONLY, GetElementSize() * m_N, &clError2);
+	clError = clError2;
+	m_dOutput = CreateBuffer(Context, CL_MEM_READ_WRITE, GetElementSize() * m_N, &clError2);
+	clError |= clError2;
+	V_RETURN_FALSE_CL(clError, "Error allocating device arrays");
+
+	return true;
+}
+
+void CGenericScanTask::ReleaseResources()
+{
+	SAFE_DELETE_ARRAY(m_hInput);
+	SAFE_DELETE_ARRAY(m_hResultGPU);
+	for(int m = 0; m < 2; m++)
+		SAFE_DELETE_ARRAY(m_hResultCPU[m]);
+
+	ReleaseBuffer(m_dInput);
+	ReleaseBuffer(m_dOutput);
+}
+
+template<class T, class F>
+void CGenericScanTask::ComputeCPUTyped(const T& Identity, F Combine)
+{
+	for(int m = 0; m < 2; m++)
+		ScanHost<T>((const T*)m_hInput, (T*)m_hResultCPU[m], m_N, EScanMode(m), Identity, Combine);
+}
+
+void CGenericScanTask::ComputeCPU()
+{
+	switch(m_Case)
+	{
+	case GENERIC_SCAN_INT_MAX:
+		ComputeCPUTyped<cl_int>(numeric_limits<cl_int>::lowest(), [](cl_int a, cl_int b) { return max(a, b); });
+		break;
+	case GENERIC_SCAN_UINT_MIN:
+		ComputeCPUTyped<cl_uint>(numeric_limits<cl_uint>::max(), [](cl_uint a, cl_uint b) { return min(a, b); });
+		break;
+	case GENERIC_SCAN_LONG_SUM:
+		// wraps around like on the device
+		ComputeCPUTyped<cl_long>(0, [](cl_long a, cl_long b) { return cl_long(cl_ulong(a) + cl_ulong(b)); });
+		break;
+	case GENERIC_SCAN_FLOAT_MAX:
+		ComputeCPUTyped<cl_float>(-numeric_limits<cl_float>::infinity(), [](cl_float a, cl_float b) { return max(a, b); });
+		break;
+	case GENERIC_SCAN_FLOAT4_SUM:
+	{
+		cl_float4 zero = {{ 0.0f, 0.0f, 0.0f, 0.0f }};
+		ComputeCPUTyped<cl_float4>(zero, [](const cl_float4& a, const cl_float4& b) {
+			cl_float4 r;
+			for(int c = 0; c < 4; c++)
+				r.s[c] = a.s[c] + b.s[c];
+			return r;
+		});
+		break;
+	}
+	default:
+	{
+		cl_float2 identity = {{ 1.0f, 0.0f }};
+		ComputeCPUTyped<cl_float2>(identity, [](const cl_float2& a, const cl_float2& b) {
+			cl_float2 r;
+			r.s[0] = a.s[0] * b.s[0];
+			r.s[1] = a.s[1] * b.s[0] + b.s[1];
+			return r;
+		});
+		break;
+	}
+	}
+}
+
+bool CGenericScanTask::CheckResult(int Mode) const
+{
+	double tolerance = GetTolerance();
+	if(tolerance == 0)
+		return memcmp(m_hResultCPU[Mode], m_hResultGPU, GetElementSize() * m_N) == 0;
+
+	// the floating point cases consist of floats only
+	const float* expected = (const float*)m_hResultCPU[Mode];
+	const float* result = (const float*)m_hResultGPU;
+	size_t count = GetElementSize() / sizeof(float) * m_N;
+	for(size_t i = 0; i < count; i++)
+	{
+		if(fabs(double(result[i]) - double(expected[i])) > tolerance * max(fabs(double(expected[i])), 1.0))
+		{
+			cout<<"  first mismatch at "<<i<<": "<<result[i]<<" (CPU: "<<expected[i]<<")"<<endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+template<class T>
+void CGenericScanTask::ComputeGPUTyped(cl_command_queue CommandQueue, const ScanOperator& Op)
+{
+	const int nIterations = 20;
+	for(int m = 0; m < 2; m++)
+	{
+		string name = string("scan_") + GetCaseName(m_Case) + "_" + CScan::GetModeName(EScanMode(m));
+
+		// the first call builds the kernels, so it is not timed
+		V_RETURN_CL(Scan<T>(CommandQueue, m_dInput, m_dOutput, m_N, Op, EScanMode(m)), "Error executing " + name);
+		V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, m_dOutput, CL_TRUE, 0, GetElementSize() * m_N, m_hResultGPU, 0, NULL, NULL), "Error reading data from device!");
+		m_Valid[m] = CheckResult(m);
+
+		CTimer timer;
+		timer.Start();
+		for(int i = 0; i < nIterations; i++)
+			V_RETURN_CL(Scan<T>(CommandQueue, m_dInput, m_dOutput, m_N, Op, EScanMode(m)), "Error executing " + name);
+		V_RETURN_CL(clFinish(CommandQueue), "Error finishing the queue!");
+		timer.Stop();
+		double ms = timer.GetElapsedMilliseconds() / double(nIterations);
+
+		cout<<"  "<<name<<": "<<ms<<" ms"<<endl;
+		CLUtil::PrintBandwidth(name, 2 * GetElementSize() * m_N, ms);
+		CBenchmarkRecorder::ReportTime(name, ms);
+	}
+}
+
+void CGenericScanTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	{
+		CScopedTimer timer("WriteBuffers");
+		V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dInput, CL_TRUE, 0, GetElementSize() * m_N, m_hInput, 0, NULL, NULL), "Error copying data from host to device!");
+	}
+
+	cout<<"Scanning "<<m_N<<" elements: "<<GetCaseName(m_Case)<<endl;
+	switch(m_Case)
+	{
+	case GENERIC_SCAN_INT_MAX:				ComputeGPUTyped<cl_int>(CommandQueue, ScanMax<cl_int>()); break;
+	case GENERIC_SCAN_UINT_MIN:				ComputeGPUTyped<cl_uint>(CommandQueue, ScanMin<cl_uint>()); break;
+	case GENERIC_SCAN_LONG_SUM:				ComputeGPUTyped<cl_long>(CommandQueue, ScanSum<cl_long>()); break;
+	case GENERIC_SCAN_FLOAT_MAX:			ComputeGPUTyped<cl_float>(CommandQueue, ScanMax<cl_float>()); break;
+	case GENERIC_SCAN_FLOAT4_SUM:			ComputeGPUTyped<cl_float4>(CommandQueue, ScanSum<cl_float4>()); break;
+	default:								ComputeGPUTyped<cl_float2>(CommandQueue, c_Recurrence); break;
+	}
+}
+
+bool CGenericScanTask::ValidateResults()
+{
+	bool success = true;
+	for(int m = 0; m < 2; m++)
+	{
+		if(!m_Valid[m])
+		{
+			cout<<"Validation of the "<<CScan::GetModeName(EScanMode(m))<<" scan "<<GetCaseName(m_Case)<<" failed."<<endl;
+			success = false;
+		}
+	}
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
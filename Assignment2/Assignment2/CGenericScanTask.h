@@ -0,0 +1,103 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CGENERIC_SCAN_TASK_H
+#define _CGENERIC_SCAN_TASK_H
+
+#include "../Common/IComputeTask.h"
+#include "../Common/CScan.h"
+
+#include <string>
+
+enum EGenericScanCase
+{
+	//! running maxima of ints
+	GENERIC_SCAN_INT_MAX,
+	//! running minima of uints
+	GENERIC_SCAN_UINT_MIN,
+	//! prefix sums of 64 bit integers
+	GENERIC_SCAN_LONG_SUM,
+	//! running maxima of floats
+	GENERIC_SCAN_FLOAT_MAX,
+	//! component-wise prefix sums of float4
+	GENERIC_SCAN_FLOAT4_SUM,
+	//! the linear recurrence y[i] = y[i-1] * s[i] + o[i], as composition of the affine maps (s, o)
+	GENERIC_SCAN_FLOAT2_RECURRENCE,
+	NUM_GENERIC_SCAN_CASES
+};
+
+//! A2/T2 generic: Scan<T>() of CScan.h with one element type and operator
+/*!
+	The inclusive and exclusive scan are compared with ScanHost(). Floating point sums and
+	the recurrence are combined in a different order than on the host, they may differ by
+	a relative error.
+*/
+class CGenericScanTask : public IComputeTask
+{
+public:
+	CGenericScanTask(size_t ArraySize, EGenericScanCase Case);
+
+	virtual ~CGenericScanTask();
+
+	static const char* GetCaseName(EGenericScanCase Case);
+
+	//! Parses the names of GetCaseName(), returns false if the name is unknown
+	static bool ParseCase(const std::string& Name, EGenericScanCase& Case);
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// the input is read and the result is written once by each mode
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_N; Bytes = 2 * GetElementSize() * m_N; }
+
+protected:
+	size_t GetElementSize() const;
+
+	//! Allowed relative error of the results, 0 if they have to be equal
+	double GetTolerance() const;
+
+	template<class T> void FillInput();
+	template<class T, class F> void ComputeCPUTyped(const T& Identity, F Combine);
+	template<class T> void ComputeGPUTyped(cl_command_queue CommandQueue, const ScanOperator& Op);
+
+	//! Compares the result of a mode with the CPU result
+	bool CheckResult(int Mode) const;
+
+	size_t				m_N;
+	EGenericScanCase	m_Case;
+
+	unsigned char		*m_hInput;
+	//! CPU results of the inclusive and exclusive scan
+	unsigned char		*m_hResultCPU[2];
+	unsigned char		*m_hResultGPU;
+	bool				m_Valid[2];
+
+	cl_mem				m_dInput;
+	cl_mem				m_dOutput;
+};
+
+#endif // _CGENERIC_SCAN_TASK_H
@@ -0,0 +1,269 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CRadixSortTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CThreadPool.h"
+#include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
+
+#include <algorithm>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CRadixSortTask
+
+static const unsigned int c_RadixBits[CRadixSortTask::NUM_RADIX_CONFIGS] = { 4, 6, 8 };
+
+// uniformly distributed keys, rand() has only 15 bits on some platforms
+static cl_uint RandomBits16() { return cl_uint(rand()) & 0xffff; }
+static void RandomKey(cl_uint& Key) { Key = (RandomBits16() << 16) | RandomBits16(); }
+static void RandomKey(cl_ulong& Key) { Key = (cl_ulong(RandomBits16()) << 48) | (cl_ulong(RandomBits16()) << 32) | (RandomBits16() << 16) | RandomBits16(); }
+
+CRadixSortTask::CRadixSortTask(size_t ArraySize, ERadixSortCase Case)
+	: m_N(ArraySize), m_Case(Case), m_hKeys(NULL), m_hValues(NULL), m_hKeysCPU(NULL), m_hValuesCPU(NULL),
+	m_hKeysGPU(NULL), m_hValuesGPU(NULL), m_dInputKeys(NULL), m_dInputValues(NULL), m_dKeys(NULL), m_dValues(NULL)
+{
+	for(int c = 0; c < NUM_RADIX_CONFIGS; c++)
+		m_Valid[c] = false;
+}
+
+CRadixSortTask::~CRadixSortTask()
+{
+	ReleaseResources();
+}
+
+const char* CRadixSortTask::GetCaseName(ERadixSortCase Case)
+{
+	switch(Case)
+	{
+	case RADIX_SORT_UINT:			return "uint";
+	case RADIX_SORT_UINT_PAIRS:		return "uint_pairs";
+	case RADIX_SORT_ULONG:			return "ulong";
+	default:						return "ulong_pairs";
+	}
+}
+
+bool CRadixSortTask::ParseCase(const std::string& Name, ERadixSortCase& Case)
+{
+	for(int c = 0; c < NUM_RADIX_SORT_CASES; c++)
+	{
+		if(Name == GetCaseName(ERadixSortCase(c)))
+		{
+			Case = ERadixSortCase(c);
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t CRadixSortTask::GetKeySize() const
+{
+	return (m_Case == RADIX_SORT_ULONG || m_Case == RADIX_SORT_ULONG_PAIRS) ? sizeof(cl_ulong) : sizeof(cl_uint);
+}
+
+template<class K>
+void CRadixSortTask::FillInput()
+{
+	K* keys = (K*)m_hKeys;
+	for(size_t i = 0; i < m_N; i++)
+		RandomKey(keys[i]);
+}
+
+bool CRadixSortTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	//CPU resources
+	m_hKeys = new unsigned char[GetKeySize() * m_N];
+	m_hKeysCPU = new unsigned char[GetKeySize() * m_N];
+	m_hKeysGPU = new unsigned char[GetKeySize() * m_N];
+	if(GetKeySize() == sizeof(cl_ulong))
+		FillInput<cl_ulong>();
+	else
+		FillInput<cl_uint>();
+
+	if(HasValues())
+	{
+		m_hValues = new cl_uint[m_N];
+		m_hValuesCPU = new cl_uint[m_N];
+		m_hValuesGPU = new cl_uint[m_N];
+		for(size_t i = 0; i < m_N; i++)
+			m_hValues[i] = cl_uint(i);
+	}
+
+	//device resources, the kernels are built by RadixSort() on first use
+	cl_int clError, clError2;
+	m_dInputKeys = CreateBuffer(Context, CL_MEM_READ_ONLY, GetKeySize() * m_N, &clError2);
+	clError = clError2;
+	m_dKeys = CreateBuffer(Context, CL_MEM_READ_WRITE, GetKeySize() * m_N, &clError2);
+	clError |= clError2;
+	if(HasValues())
+	{
+		m_dInputValues = CreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_uint) * m_N, &clError2);
+		clError |= clError2;
+		m_dValues = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, &clError2);
+		clError |= clError2;
+	}
+	V_RETURN_FALSE_CL(clError, "Error allocating device arrays");
+
+	return true;
+}
+
+void CRadixSortTask::ReleaseResources()
+{
+	SAFE_DELETE_ARRAY(m_hKeys);
+	SAFE_DELETE_ARRAY(m_hValues);
+	SAFE_DELETE_ARRAY(m_hKeysCPU);
+	SAFE_DELETE_ARRAY(m_hValuesCPU);
+	SAFE_DELETE_ARRAY(m_hKeysGPU);
+	SAFE_DELETE_ARRAY(m_hValuesGPU);
+
+	ReleaseBuffer(m_dInputKeys);
+	ReleaseBuffer(m_dInputValues);
+	ReleaseBuffer(m_dKeys);
+	ReleaseBuffer(m_dValues);
+}
+
+template<class K>
+void CRadixSortTask::ComputeCPUTyped()
+{
+	const K* input = (const K*)m_hKeys;
+	string name = GetCaseName(m_Case);
+	CTimer timer;
+
+	if(HasValues())
+	{
+		vector<pair<K, cl_uint> > pairs(m_N), reference(m_N);
+		for(size_t i = 0; i < m_N; i++)
+			reference[i] = make_pair(input[i], m_hValues[i]);
+		auto less = [](const pair<K, cl_uint>& a, const pair<K, cl_uint>& b) { return a.first < b.first; };
+
+		// std::sort is not stable, it is only timed
+		pairs = reference;
+		timer.Start();
+		sort(pairs.begin(), pairs.end(), less);
+		timer.Stop();
+		cout<<"  std::sort: "<<timer.GetElapsedMilliseconds()<<" ms"<<endl;
+		CBenchmarkRecorder::ReportTime("sort_cpu_std_" + name, timer.GetElapsedMilliseconds());
+
+		timer.Start();
+		CThreadPool::Get().ParallelSort(reference.data(), m_N, less);
+		timer.Stop();
+		cout<<"  parallel sort: "<<timer.GetElapsedMilliseconds()<<" ms"<<endl;
+		CBenchmarkRecorder::ReportTime("sort_cpu_parallel_" + name, timer.GetElapsedMilliseconds());
+
+		K* keys = (K*)m_hKeysCPU;
+		for(size_t i = 0; i < m_N; i++)
+		{
+			keys[i] = reference[i].first;
+			m_hValuesCPU[i] = reference[i].second;
+		}
+	}
+	else
+	{
+		vector<K> keys(input, input + m_N);
+		timer.Start();
+		sort(keys.begin(), keys.end());
+		timer.Stop();
+		cout<<"  std::sort: "<<timer.GetElapsedMilliseconds()<<" ms"<<endl;
+		CBenchmarkRecorder::ReportTime("sort_cpu_std_" + name, timer.GetElapsedMilliseconds());
+
+		K* reference = (K*)m_hKeysCPU;
+		memcpy(reference, input, sizeof(K) * m_N);
+		timer.Start();
+		CThreadPool::Get().ParallelSort(reference, m_N, [](K a, K b) { return a < b; });
+		timer.Stop();
+		cout<<"  parallel sort: "<<timer.GetElapsedMilliseconds()<<" ms"<<endl;
+		CBenchmarkRecorder::ReportTime("sort_cpu_parallel_" + name, timer.GetElapsedMilliseconds());
+	}
+}
+
+void CRadixSortTask::ComputeCPU()
+{
+	if(GetKeySize() == sizeof(cl_ulong))
+		ComputeCPUTyped<cl_ulong>();
+	else
+		ComputeCPUTyped<cl_uint>();
+}
+
+template<class K>
+void CRadixSortTask::ComputeGPUTyped(cl_command_queue CommandQueue)
+{
+	const int nIterations = 10;
+	cl_mem values = HasValues() ? m_dValues : NULL;
+
+	for(int c = 0; c < NUM_RADIX_CONFIGS; c++)
+	{
+		string name = string("radix_sort_") + GetCaseName(m_Case) + "_" + to_string(c_RadixBits[c]) + "bit";
+
+		// the sort is in-place, so every iteration starts with a copy of the input (which is not timed)
+		double ms = 0;
+		for(int i = 0; i <= nIterations; i++)
+		{
+			V_RETURN_CL(clEnqueueCopyBuffer(CommandQueue, m_dInputKeys, m_dKeys, 0, 0, GetKeySize() * m_N, 0, NULL, NULL), "Error copying the keys!");
+			if(HasValues())
+				V_RETURN_CL(clEnqueueCopyBuffer(CommandQueue, m_dInputValues, m_dValues, 0, 0, sizeof(cl_uint) * m_N, 0, NULL, NULL), "Error copying the values!");
+			V_RETURN_CL(clFinish(CommandQueue), "Error finishing the queue!");
+
+			CTimer timer;
+			timer.Start();
+			V_RETURN_CL(RadixSort<K>(CommandQueue, m_dKeys, values, m_N, 8 * sizeof(K), c_RadixBits[c]), "Error executing " + name);
+			V_RETURN_CL(clFinish(CommandQueue), "Error finishing the queue!");
+			timer.Stop();
+
+			// the first sort builds the kernels, so it is not timed
+			if(i > 0)
+				ms += timer.GetElapsedMilliseconds() / double(nIterations);
+		}
+
+		V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, m_dKeys, CL_TRUE, 0, GetKeySize() * m_N, m_hKeysGPU, 0, NULL, NULL), "Error reading data from device!");
+		m_Valid[c] = memcmp(m_hKeysGPU, m_hKeysCPU, GetKeySize() * m_N) == 0;
+		if(HasValues())
+		{
+			V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, m_dValues, CL_TRUE, 0, sizeof(cl_uint) * m_N, m_hValuesGPU, 0, NULL, NULL), "Error reading data from device!");
+			m_Valid[c] = m_Valid[c] && memcmp(m_hValuesGPU, m_hValuesCPU, sizeof(cl_uint) * m_N) == 0;
+		}
+
+		cout<<"  "<<name<<": "<<ms<<" ms, "<<1.0e-3 * double(m_N) / ms<<" Mkeys/s"<<endl;
+		CBenchmarkRecorder::ReportTime(name, ms);
+	}
+}
+
+void CRadixSortTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	{
+		CScopedTimer timer("WriteBuffers");
+		V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dInputKeys, CL_TRUE, 0, GetKeySize() * m_N, m_hKeys, 0, NULL, NULL), "Error copying data from host to device!");
+		if(HasValues())
+			V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dInputValues, CL_TRUE, 0, sizeof(cl_uint) * m_N, m_hValues, 0, NULL, NULL), "Error copying data from host to device!");
+	}
+
+	cout<<"Sorting "<<m_N<<" keys: "<<GetCaseName(m_Case)<<endl;
+	if(GetKeySize() == sizeof(cl_ulong))
+		ComputeGPUTyped<cl_ulong>(CommandQueue);
+	else
+		ComputeGPUTyped<cl_uint>(CommandQueue);
+}
+
+bool CRadixSortTask::ValidateResults()
+{
+	bool success = true;
+	for(int c = 0; c < NUM_RADIX_CONFIGS; c++)
+	{
+		if(!m_Valid[c])
+		{
+			cout<<"Validation of the radix sort "<<GetCaseName(m_Case)<<" with "<<c_RadixBits[c]<<" radix bits failed."<<endl;
+			success = false;
+		}
+	}
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
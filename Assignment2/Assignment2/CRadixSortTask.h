@@ -0,0 +1,101 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CRADIX_SORT_TASK_H
+#define _CRADIX_SORT_TASK_H
+
+#include "../Common/IComputeTask.h"
+#include "../Common/CRadixSort.h"
+
+#include <string>
+
+enum ERadixSortCase
+{
+	RADIX_SORT_UINT,
+	//! uint keys with a uint value each
+	RADIX_SORT_UINT_PAIRS,
+	RADIX_SORT_ULONG,
+	RADIX_SORT_ULONG_PAIRS,
+	NUM_RADIX_SORT_CASES
+};
+
+//! A2 sorting: RadixSort() of CRadixSort.h with several numbers of radix bits
+/*!
+	The CPU sorts the same data with std::sort and with CThreadPool::ParallelSort(), whose
+	stable result is the reference. The values are the original positions of the keys, so
+	the comparison also checks that the device sort is stable.
+*/
+class CRadixSortTask : public IComputeTask
+{
+public:
+	CRadixSortTask(size_t ArraySize, ERadixSortCase Case);
+
+	virtual ~CRadixSortTask();
+
+	static const char* GetCaseName(ERadixSortCase Case);
+
+	//! Parses the names of GetCaseName(), returns false if the name is unknown
+	static bool ParseCase(const std::string& Name, ERadixSortCase& Case);
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// the keys (and values) are read and written once by each pass
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_N; Bytes = 2 * (GetKeySize() + (HasValues() ? sizeof(cl_uint) : 0)) * m_N; }
+
+	//! Numbers of radix bits which are timed
+	enum { NUM_RADIX_CONFIGS = 3 };
+
+protected:
+	size_t GetKeySize() const;
+
+	bool HasValues() const { return m_Case == RADIX_SORT_UINT_PAIRS || m_Case == RADIX_SORT_ULONG_PAIRS; }
+
+	template<class K> void FillInput();
+	template<class K> void ComputeCPUTyped();
+	template<class K> void ComputeGPUTyped(cl_command_queue CommandQueue);
+
+	size_t				m_N;
+	ERadixSortCase		m_Case;
+
+	unsigned char		*m_hKeys;
+	cl_uint				*m_hValues;
+	//! stable CPU result and the result of the last GPU sort
+	unsigned char		*m_hKeysCPU;
+	cl_uint				*m_hValuesCPU;
+	unsigned char		*m_hKeysGPU;
+	cl_uint				*m_hValuesGPU;
+	bool				m_Valid[NUM_RADIX_CONFIGS];
+
+	//! the unsorted input, which is copied to the sorted buffers before each sort
+	cl_mem				m_dInputKeys;
+	cl_mem				m_dInputValues;
+	cl_mem				m_dKeys;
+	cl_mem				m_dValues;
+};
+
+#endif // _CRADIX_SORT_TASK_H
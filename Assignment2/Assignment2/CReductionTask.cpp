@@ -6,29 +6,43 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CReductionTask.h"
 
 #include "../Common/CLUtil.h"
+#include "../Common/CThreadPool.h"
 #include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
+
+#include <string.h>
 
 using namespace std;
 
 ///////////////////////////////////////////////////////////////////////////////
 // CReductionTask
 
-string g_kernelNames[6] = {
+string g_kernelNames[CReductionTask::NUM_VARIANTS] = {
 	"interleavedAddressing",
 	"sequentialAddressing",
 	"kernelDecomposition",
 	"kernelDecompositionUnroll",
 	"kernelDecompositionAtomics",
-	"kernelLoadMax"
+	"kernelLoadMax",
+	"kernelSinglePass"
 };
 
+// elements each work-item of the single-pass kernel adds up before the work-group reduces them,
+// and the maximum number of work-groups (which the last one adds up)
+#define SINGLE_PASS_ELEMENTS_PER_ITEM	16
+#define SINGLE_PASS_MAX_GROUPS			1024
+
 CReductionTask::CReductionTask(size_t ArraySize)
 	: m_N(ArraySize), m_hInput(NULL), 
 	m_dPingArray(NULL),
 	m_dPongArray(NULL),
+	m_dGroupsDone(NULL),
 	m_Program(NULL), 
-	m_InterleavedAddressingKernel(NULL), m_SequentialAddressingKernel(NULL), m_DecompKernel(NULL), m_DecompUnrollKernel(NULL), m_DecompAtomicsKernel(NULL)
+	m_InterleavedAddressingKernel(NULL), m_SequentialAddressingKernel(NULL), m_DecompKernel(NULL), m_DecompUnrollKernel(NULL), m_DecompAtomicsKernel(NULL),
+	m_LoadMaxKernel(NULL), m_SinglePassKernel(NULL)
 {
+	memset(m_TunedLocalWorkSize, 0, sizeof(m_TunedLocalWorkSize));
 }
 
 CReductionTask::~CReductionTask()
@@ -48,9 +62,13 @@ bool CReductionTask::InitResources(cl_device_id Device, cl_context Context)
 
 	//device resources
 	cl_int clError, clError2;
-	m_dPingArray = clCreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, NULL, &clError2);
+	m_dPingArray = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, &clError2);
 	clError = clError2;
-	m_dPongArray = clCreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, NULL, &clError2);
+	m_dPongArray = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, &clError2);
+	clError |= clError2;
+	// the counter starts at zero, afterwards the kernel resets it
+	cl_uint groupsDone = 0;
+	m_dGroupsDone = clCreateBuffer(Context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_uint), &groupsDone, &clError2);
 	clError |= clError2;
 	V_RETURN_FALSE_CL(clError, "Error allocating device arrays");
 
@@ -58,7 +76,8 @@ bool CReductionTask::InitResources(cl_device_id Device, cl_context Context)
 	string programCode;
 
 	CLUtil::LoadProgramSourceToMemory("../Assignment2/Reduction.cl", programCode);
-	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode);
+	// the SIMD width of the device limits the unrolled steps of DecompUnroll
+	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode, GetDeviceCaps().GetBuildOptions());
 	if(m_Program == nullptr) return false;
 
 	//create kernels
@@ -80,6 +99,41 @@ bool CReductionTask::InitResources(cl_device_id Device, cl_context Context)
 	m_LoadMaxKernel = clCreateKernel(m_Program, "Reduction_LoadMax", &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create kernel: Reduction_LoadMax.");
 
+	m_SinglePassKernel = clCreateKernel(m_Program, "Reduction_SinglePass", &clError);
+	V_RETURN_FALSE_CL(clError, "Failed to create kernel: Reduction_SinglePass.");
+
+	// a candidate only counts if it computes the right sum
+	cl_uint expected = 0;
+	for(unsigned int i = 0; i < m_N; i++)
+		expected += m_hInput[i];
+
+	// most variants are multi-pass, so each candidate is timed as a whole reduction
+	cl_kernel kernels[NUM_VARIANTS] = {m_InterleavedAddressingKernel, m_SequentialAddressingKernel,
+		m_DecompKernel, m_DecompUnrollKernel, m_DecompAtomicsKernel, m_LoadMaxKernel, m_SinglePassKernel};
+	for(unsigned int task = 0; task < NUM_VARIANTS; task++) {
+		CAutoTuner::Request request(g_kernelNames[task], kernels[task], 1, m_N / 2);
+		request.Divisible = true;
+		request.Measure = [this, Context, task, expected](cl_command_queue Queue, const size_t Candidate[3]) {
+			size_t localWorkSize[3] = {Candidate[0], Candidate[1], Candidate[2]};
+			if(clEnqueueWriteBuffer(Queue, m_dPingArray, CL_TRUE, 0, m_N * sizeof(cl_uint), m_hInput, 0, NULL, NULL) != CL_SUCCESS)
+				return -1.0;
+
+			CTimer timer;
+			timer.Start();
+			if(RunReduction(Context, Queue, localWorkSize, task) != CL_SUCCESS || clFinish(Queue) != CL_SUCCESS)
+				return -1.0;
+			timer.Stop();
+
+			cl_uint result = 0;
+			if(clEnqueueReadBuffer(Queue, m_dPingArray, CL_TRUE, 0, sizeof(cl_uint), &result, 0, NULL, NULL) != CL_SUCCESS
+				|| result != expected)
+				return -1.0;
+
+			return timer.GetElapsedMilliseconds();
+		};
+		TuneLocalWorkSize(request, m_TunedLocalWorkSize[task]);
+	}
+
 	return true;
 }
 
@@ -89,8 +143,9 @@ void CReductionTask::ReleaseResources()
 	SAFE_DELETE_ARRAY(m_hInput);
 
 	// device resources
-	SAFE_RELEASE_MEMOBJECT(m_dPingArray);
-	SAFE_RELEASE_MEMOBJECT(m_dPongArray);
+	ReleaseBuffer(m_dPingArray);
+	ReleaseBuffer(m_dPongArray);
+	SAFE_RELEASE_MEMOBJECT(m_dGroupsDone);
 
 	SAFE_RELEASE_KERNEL(m_InterleavedAddressingKernel);
 	SAFE_RELEASE_KERNEL(m_SequentialAddressingKernel);
@@ -98,6 +153,7 @@ void CReductionTask::ReleaseResources()
 	SAFE_RELEASE_KERNEL(m_DecompUnrollKernel);
 	SAFE_RELEASE_KERNEL(m_DecompAtomicsKernel);
 	SAFE_RELEASE_KERNEL(m_LoadMaxKernel);
+	SAFE_RELEASE_KERNEL(m_SinglePassKernel);
 
 	SAFE_RELEASE_PROGRAM(m_Program);
 }
@@ -110,6 +166,7 @@ void CReductionTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueu
 	ExecuteTask(Context, CommandQueue, LocalWorkSize, 3);
 	ExecuteTask(Context, CommandQueue, LocalWorkSize, 4);
 	ExecuteTask(Context, CommandQueue, LocalWorkSize, 5);
+	ExecuteTask(Context, CommandQueue, LocalWorkSize, 6);
 
 	TestPerformance(Context, CommandQueue, LocalWorkSize, 0);
 	TestPerformance(Context, CommandQueue, LocalWorkSize, 1);
@@ -117,6 +174,7 @@ void CReductionTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueu
 	TestPerformance(Context, CommandQueue, LocalWorkSize, 3);
 	TestPerformance(Context, CommandQueue, LocalWorkSize, 4);
 	TestPerformance(Context, CommandQueue, LocalWorkSize, 5);
+	TestPerformance(Context, CommandQueue, LocalWorkSize, 6);
 
 }
 
@@ -127,10 +185,15 @@ void CReductionTask::ComputeCPU()
 
 	unsigned int nIterations = 10;
 	for(unsigned int j = 0; j < nIterations; j++) {
-		m_resultCPU = m_hInput[0];
-		for(unsigned int i = 1; i < m_N; i++) {
-			m_resultCPU += m_hInput[i]; 
-		}
+		m_resultCPU = CThreadPool::Get().ParallelReduce(0, m_N, 1 << 16, 0u,
+			[&](size_t Begin, size_t End) {
+				unsigned int sum = 0;
+				for(size_t i = Begin; i < End; i++) {
+					sum += m_hInput[i];
+				}
+				return sum;
+			},
+			[](unsigned int a, unsigned int b) { return a + b; });
 	}
 
 	timer.Stop();
@@ -144,7 +207,7 @@ bool CReductionTask::ValidateResults()
 {
 	bool success = true;
 
-	for(int i = 0; i < 6; i++)
+	for(int i = 0; i < NUM_VARIANTS; i++)
 		if(m_resultGPU[i] != m_resultCPU)
 		{
 			cout<<"Validation of reduction kernel "<<g_kernelNames[i]<<" failed." << endl;
@@ -154,7 +217,7 @@ bool CReductionTask::ValidateResults()
 	return success;
 }
 
-void CReductionTask::Reduction_InterleavedAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+cl_int CReductionTask::Reduction_InterleavedAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	// log can be computed by right-shifting
 	cl_int clError;
@@ -165,7 +228,7 @@ void CReductionTask::Reduction_InterleavedAddressing(cl_context Context, cl_comm
 		// set second argument: stride
 		uint stride = 1 << (i-1);
 		clError |= clSetKernelArg(m_InterleavedAddressingKernel, 1, sizeof(int), &stride);
-		V_RETURN_CL(clError, "Failed to set kernel args: InterleavedAddressing");
+		V_RETURN_ERROR_CL(clError, "Failed to set kernel args: InterleavedAddressing");
 
 		size_t globalWorkSize = (size_t) (m_N >> i);		// number of threads
 
@@ -175,11 +238,13 @@ void CReductionTask::Reduction_InterleavedAddressing(cl_context Context, cl_comm
 		clError = clEnqueueNDRangeKernel(CommandQueue, m_InterleavedAddressingKernel, 1, NULL,
 										&globalWorkSize, &myLocalWorkSize,
 										0, NULL, NULL);	
-		V_RETURN_CL(clError, "Failed to execute Kernel: InterleavedAddressing");							
+		V_RETURN_ERROR_CL(clError, "Failed to execute Kernel: InterleavedAddressing");							
 	}
+
+	return CL_SUCCESS;
 }
 
-void CReductionTask::Reduction_SequentialAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+cl_int CReductionTask::Reduction_SequentialAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	// log can be computed by right-shifting
 	cl_int clError;
@@ -190,7 +255,7 @@ void CReductionTask::Reduction_SequentialAddressing(cl_context Context, cl_comma
 		// set second argument: stride
 		uint stride = 1 << (i-1);
 		clError |= clSetKernelArg(m_SequentialAddressingKernel, 1, sizeof(int), &stride);
-		V_RETURN_CL(clError, "Failed to set kernel args: SequentialAddressing");
+		V_RETURN_ERROR_CL(clError, "Failed to set kernel args: SequentialAddressing");
 
 		size_t globalWorkSize = (size_t) (m_N >> i);		// number of threads
 
@@ -200,11 +265,13 @@ void CReductionTask::Reduction_SequentialAddressing(cl_context Context, cl_comma
 		clError = clEnqueueNDRangeKernel(CommandQueue, m_SequentialAddressingKernel, 1, NULL,
 										&globalWorkSize, &myLocalWorkSize,
 										0, NULL, NULL);	
-		V_RETURN_CL(clError, "Failed to execute Kernel: SequentialAddressing");
+		V_RETURN_ERROR_CL(clError, "Failed to execute Kernel: SequentialAddressing");
 	}
+
+	return CL_SUCCESS;
 }
 
-void CReductionTask::Reduction_Decomp(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+cl_int CReductionTask::Reduction_Decomp(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	// starting iteration parameters	
 	cl_int clError;
@@ -229,22 +296,24 @@ void CReductionTask::Reduction_Decomp(cl_context Context, cl_command_queue Comma
 		clError = clSetKernelArg(m_DecompKernel, 2, sizeof(uint), (void*) &m_N);
 		// set third argument: pointer of localBlock
 		clError = clSetKernelArg(m_DecompKernel, 3, myLocalWorkSize * sizeof(uint), NULL);
-		V_RETURN_CL(clError, "Failed to set kernel args: Decomp");
+		V_RETURN_ERROR_CL(clError, "Failed to set kernel args: Decomp");
 		///////////////////////////////////////////////////////////////////////////////////////////
 
 		// RUN KERNEL /////////////////////////////////////////////////////////////////////////////
 		clError = clEnqueueNDRangeKernel(CommandQueue, m_DecompKernel, 1, NULL,
 										&globalWorkSize, &myLocalWorkSize,
 										0, NULL, NULL);	
-		V_RETURN_CL(clError, "Failed to execute Kernel: Decomp");
+		V_RETURN_ERROR_CL(clError, "Failed to execute Kernel: Decomp");
 		///////////////////////////////////////////////////////////////////////////////////////////
 		// ping pong:
 		swap(m_dPingArray, m_dPongArray);
 	} while (nWorkGroups != 1);
 	// ping is the last output array, as they are being swapped at the end of each iteration
+
+	return CL_SUCCESS;
 }
 
-void CReductionTask::Reduction_DecompUnroll(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+cl_int CReductionTask::Reduction_DecompUnroll(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	// starting iteration parameters	
 	cl_int clError;
@@ -270,22 +339,24 @@ void CReductionTask::Reduction_DecompUnroll(cl_context Context, cl_command_queue
 		clError = clSetKernelArg(m_DecompUnrollKernel, 2, sizeof(uint), (void*) &n);
 		// set forth argument: pointer of localBlock
 		clError = clSetKernelArg(m_DecompUnrollKernel, 3, myLocalWorkSize * sizeof(uint), NULL);
-		V_RETURN_CL(clError, "Failed to set kernel args: DecompUnroll");
+		V_RETURN_ERROR_CL(clError, "Failed to set kernel args: DecompUnroll");
 		///////////////////////////////////////////////////////////////////////////////////////////
 
 		// RUN KERNEL /////////////////////////////////////////////////////////////////////////////
 		clError = clEnqueueNDRangeKernel(CommandQueue, m_DecompUnrollKernel, 1, NULL,
 										&globalWorkSize, &myLocalWorkSize,
 										0, NULL, NULL);	
-		V_RETURN_CL(clError, "Failed to execute Kernel: DecompUnroll");
+		V_RETURN_ERROR_CL(clError, "Failed to execute Kernel: DecompUnroll");
 		///////////////////////////////////////////////////////////////////////////////////////////
 		// ping pong:
 		swap(m_dPingArray, m_dPongArray);
 	} while (nWorkGroups != 1);
 	// ping is the last output array, as they are being swapped at the end of each iteration
+
+	return CL_SUCCESS;
 }
 
-void CReductionTask::Reduction_DecompAtomics(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+cl_int CReductionTask::Reduction_DecompAtomics(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	cl_int clError;
 	size_t myLocalWorkSize = LocalWorkSize[0];
@@ -310,22 +381,24 @@ void CReductionTask::Reduction_DecompAtomics(cl_context Context, cl_command_queu
 		clError = clSetKernelArg(m_DecompAtomicsKernel, 2, sizeof(uint), (void*) &n);
 		// set forth argument: localSum
 		clError = clSetKernelArg(m_DecompAtomicsKernel, 3, sizeof(uint), NULL);
-		V_RETURN_CL(clError, "Failed to set kernel args: DecompAtomics");
+		V_RETURN_ERROR_CL(clError, "Failed to set kernel args: DecompAtomics");
 		///////////////////////////////////////////////////////////////////////////////////////////
 
 		// RUN KERNEL /////////////////////////////////////////////////////////////////////////////
 		clError = clEnqueueNDRangeKernel(CommandQueue, m_DecompAtomicsKernel, 1, NULL,
 										&globalWorkSize, &myLocalWorkSize,
 										0, NULL, NULL);	
-		V_RETURN_CL(clError, "Failed to execute Kernel: DecompAtomics");
+		V_RETURN_ERROR_CL(clError, "Failed to execute Kernel: DecompAtomics");
 		///////////////////////////////////////////////////////////////////////////////////////////
 		// ping pong:
 		swap(m_dPingArray, m_dPongArray);
 	} while (nWorkGroups != 1);
 	// ping is the last output array, as they are being swapped at the end of each iteration
+
+	return CL_SUCCESS;
 }
 
-void CReductionTask::Reduction_LoadMax(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+cl_int CReductionTask::Reduction_LoadMax(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	/* 
 	Idea of this approach:
@@ -338,13 +411,8 @@ void CReductionTask::Reduction_LoadMax(cl_context Context, cl_command_queue Comm
 	
 	These steps are iterated
 	*/
-	// cl_ulong localMemorySize;
-	// clGetDeviceIDs(...)
-	// clGetDeviceInfo(m_CLDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMemorySize, &bufferSize);
-	int localMemorySize = 49152;	// in byte
-	localMemorySize = 32768;		// better use this: a whole power of 2
-
-	localMemorySize /= sizeof(uint);	// in number of uint
+	// a whole power of 2 of the device's local memory, in number of uint
+	int localMemorySize = (int)GetDeviceCaps().GetLocalMemoryElements(sizeof(uint));
 
 	// cout << "Local memory fits " << localMemorySize << " uint's" << endl;
 
@@ -371,14 +439,14 @@ void CReductionTask::Reduction_LoadMax(cl_context Context, cl_command_queue Comm
 		clError = clSetKernelArg(m_LoadMaxKernel, 2, sizeof(uint), (void*) &maxElements);
 		// set forth argument: localSum
 		clError = clSetKernelArg(m_LoadMaxKernel, 3, sizeof(uint), NULL);
-		V_RETURN_CL(clError, "Failed to set kernel args: LoadMax");
+		V_RETURN_ERROR_CL(clError, "Failed to set kernel args: LoadMax");
 		///////////////////////////////////////////////////////////////////////////////////////////
 
 		// RUN KERNEL /////////////////////////////////////////////////////////////////////////////
 		clError = clEnqueueNDRangeKernel(CommandQueue, m_LoadMaxKernel, 1, NULL,
 										&globalWorkSize, &myLocalWorkSize,
 										0, NULL, NULL);	
-		V_RETURN_CL(clError, "Failed to execute Kernel: LoadMax");
+		V_RETURN_ERROR_CL(clError, "Failed to execute Kernel: LoadMax");
 		///////////////////////////////////////////////////////////////////////////////////////////
 		// ping pong:
 		swap(m_dPingArray, m_dPongArray);
@@ -386,35 +454,79 @@ void CReductionTask::Reduction_LoadMax(cl_context Context, cl_command_queue Comm
 		nToReduce /= localMemorySize;		// number of outputs = number of to be reduced elements in the next step
 	} while (nToReduce >= 1);
 	// ping is the last output array, as they are being swapped at the end of each iteration
+
+	return CL_SUCCESS;
 }
 
-void CReductionTask::ExecuteTask(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task)
+cl_int CReductionTask::Reduction_SinglePass(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
-	//write input data to the GPU
-	V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dPingArray, CL_FALSE, 0, m_N * sizeof(cl_uint), m_hInput, 0, NULL, NULL), "Error copying data from host to device!");
+	/*
+	All levels in one launch: every work-group reduces its part of the array and writes the
+	result to the pong array. The last work-group which is done (counted with an atomic
+	counter) then adds up these results, so the host does not have to wait for the levels.
+	*/
+	cl_int clError;
+	size_t myLocalWorkSize = min((size_t)m_N, LocalWorkSize[0]);
+	size_t nGroups = (m_N + myLocalWorkSize * SINGLE_PASS_ELEMENTS_PER_ITEM - 1) / (myLocalWorkSize * SINGLE_PASS_ELEMENTS_PER_ITEM);
+	nGroups = min(nGroups, (size_t)SINGLE_PASS_MAX_GROUPS);
+	size_t globalWorkSize = nGroups * myLocalWorkSize;
+
+	// SET KERNEL ARGUMENTS ///////////////////////////////////////////////////////////////////
+	clError = clSetKernelArg(m_SinglePassKernel, 0, sizeof(cl_mem), (void*) &m_dPingArray);
+	clError |= clSetKernelArg(m_SinglePassKernel, 1, sizeof(cl_mem), (void*) &m_dPongArray);
+	clError |= clSetKernelArg(m_SinglePassKernel, 2, sizeof(uint), (void*) &m_N);
+	clError |= clSetKernelArg(m_SinglePassKernel, 3, sizeof(cl_mem), (void*) &m_dGroupsDone);
+	clError |= clSetKernelArg(m_SinglePassKernel, 4, myLocalWorkSize * sizeof(uint), NULL);
+	V_RETURN_ERROR_CL(clError, "Failed to set kernel args: SinglePass");
+	///////////////////////////////////////////////////////////////////////////////////////////
+
+	clError = clEnqueueNDRangeKernel(CommandQueue, m_SinglePassKernel, 1, NULL,
+									&globalWorkSize, &myLocalWorkSize,
+									0, NULL, NULL);
+	V_RETURN_ERROR_CL(clError, "Failed to execute Kernel: SinglePass");
+
+	// the result is in the pong array, like after the last level of the other variants
+	swap(m_dPingArray, m_dPongArray);
+
+	return CL_SUCCESS;
+}
 
-	//run selected task
+cl_int CReductionTask::RunReduction(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task)
+{
 	switch (Task){
 		case 0:
-			Reduction_InterleavedAddressing(Context, CommandQueue, LocalWorkSize);
-			break;
+			return Reduction_InterleavedAddressing(Context, CommandQueue, LocalWorkSize);
 		case 1:
-			Reduction_SequentialAddressing(Context, CommandQueue, LocalWorkSize);
-			break;
+			return Reduction_SequentialAddressing(Context, CommandQueue, LocalWorkSize);
 		case 2:
-			Reduction_Decomp(Context, CommandQueue, LocalWorkSize);
-			break;
+			return Reduction_Decomp(Context, CommandQueue, LocalWorkSize);
 		case 3:
-			Reduction_DecompUnroll(Context, CommandQueue, LocalWorkSize);
-			break;
+			return Reduction_DecompUnroll(Context, CommandQueue, LocalWorkSize);
 		case 4:
-			Reduction_DecompAtomics(Context, CommandQueue, LocalWorkSize);
-			break;
+			return Reduction_DecompAtomics(Context, CommandQueue, LocalWorkSize);
 		case 5:
-			Reduction_LoadMax(Context, CommandQueue, LocalWorkSize);
-			break;
-
+			return Reduction_LoadMax(Context, CommandQueue, LocalWorkSize);
+		case 6:
+			return Reduction_SinglePass(Context, CommandQueue, LocalWorkSize);
+		default:
+			return CL_INVALID_VALUE;
 	}
+}
+
+size_t* CReductionTask::GetLocalWorkSize(size_t LocalWorkSize[3], unsigned int Task)
+{
+	return m_TunedLocalWorkSize[Task][0] > 0 ? m_TunedLocalWorkSize[Task] : LocalWorkSize;
+}
+
+void CReductionTask::ExecuteTask(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task)
+{
+	CScopedTimer taskTimer(string("ExecuteTask ") + g_kernelNames[Task]);
+
+	//write input data to the GPU
+	V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dPingArray, CL_FALSE, 0, m_N * sizeof(cl_uint), m_hInput, 0, NULL, NULL), "Error copying data from host to device!");
+
+	//run selected task
+	V_RETURN_CL(RunReduction(Context, CommandQueue, GetLocalWorkSize(LocalWorkSize, Task), Task), "Error running the reduction!");
 
 	//read back the results synchronously.
 	m_resultGPU[Task] = 0;
@@ -426,6 +538,8 @@ void CReductionTask::ExecuteTask(cl_context Context, cl_command_queue CommandQue
 void CReductionTask::TestPerformance(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task)
 {
 	cout << "Testing performance of task " << g_kernelNames[Task] << endl;
+	CScopedTimer taskTimer(string("TestPerformance ") + g_kernelNames[Task]);
+	LocalWorkSize = GetLocalWorkSize(LocalWorkSize, Task);
 
 	//write input data to the GPU
 	V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dPingArray, CL_FALSE, 0, m_N * sizeof(cl_uint), m_hInput, 0, NULL, NULL), "Error copying data from host to device!");
@@ -439,26 +553,7 @@ void CReductionTask::TestPerformance(cl_context Context, cl_command_queue Comman
 	unsigned int nIterations = 100;
 	for(unsigned int i = 0; i < nIterations; i++) {
 		//run selected task
-		switch (Task){
-			case 0:
-				Reduction_InterleavedAddressing(Context, CommandQueue, LocalWorkSize);
-				break;
-			case 1:
-				Reduction_SequentialAddressing(Context, CommandQueue, LocalWorkSize);
-				break;
-			case 2:
-				Reduction_Decomp(Context, CommandQueue, LocalWorkSize);
-				break;
-			case 3:
-				Reduction_DecompUnroll(Context, CommandQueue, LocalWorkSize);
-				break;
-			case 4:
-				Reduction_DecompAtomics(Context, CommandQueue, LocalWorkSize);
-				break;
-			case 5:
-				Reduction_LoadMax(Context, CommandQueue, LocalWorkSize);
-				break;
-		}
+		V_RETURN_CL(RunReduction(Context, CommandQueue, LocalWorkSize, Task), "Error running the reduction!");
 	}
 
 	//wait until the command queue is empty again
@@ -468,6 +563,7 @@ void CReductionTask::TestPerformance(cl_context Context, cl_command_queue Comman
 
 	double ms = timer.GetElapsedMilliseconds() / double(nIterations);
 	cout << "  average time: " << ms << " ms, throughput: " << 1.0e-6 * (double)m_N / ms << " Gelem/s" <<endl;
+	CBenchmarkRecorder::ReportTime(g_kernelNames[Task], ms);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -26,6 +26,8 @@
 class CReductionTask : public IComputeTask
 {
 public:
+	enum { NUM_VARIANTS = 7 };
+
 	CReductionTask(size_t ArraySize);
 
 	virtual ~CReductionTask();
@@ -42,14 +44,23 @@ public:
 
 	virtual bool ValidateResults();
 
+	// the input is read once
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_N; Bytes = sizeof(cl_uint) * m_N; }
+
 protected:
 
-	void Reduction_InterleavedAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
-	void Reduction_SequentialAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
-	void Reduction_Decomp(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
-	void Reduction_DecompUnroll(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
-	void Reduction_DecompAtomics(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
-	void Reduction_LoadMax(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+	cl_int Reduction_InterleavedAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+	cl_int Reduction_SequentialAddressing(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+	cl_int Reduction_Decomp(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+	cl_int Reduction_DecompUnroll(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+	cl_int Reduction_DecompAtomics(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+	cl_int Reduction_LoadMax(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+	cl_int Reduction_SinglePass(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	//! Runs the variant Task without transfers, returns the first error
+	cl_int RunReduction(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task);
+	//! The tuned local work size of the variant Task, or LocalWorkSize if it was not tuned
+	size_t* GetLocalWorkSize(size_t LocalWorkSize[3], unsigned int Task);
 
 	void ExecuteTask(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int task);
 	void TestPerformance(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int task);
@@ -63,10 +74,15 @@ protected:
 	unsigned int		*m_hInput;
 	// results
 	unsigned int		m_resultCPU;
-	unsigned int		m_resultGPU[6];
+	unsigned int		m_resultGPU[NUM_VARIANTS];
+
+	// local work size per variant found by the autotuner, zero if not tuned
+	size_t				m_TunedLocalWorkSize[NUM_VARIANTS][3];
 
 	cl_mem				m_dPingArray;
 	cl_mem				m_dPongArray;
+	// number of work-groups of the single-pass kernel which are done, reset by the last one
+	cl_mem				m_dGroupsDone;
 
 	//OpenCL program and kernels
 	cl_program			m_Program;
@@ -76,6 +92,7 @@ protected:
 	cl_kernel			m_DecompUnrollKernel;
 	cl_kernel			m_DecompAtomicsKernel;
 	cl_kernel			m_LoadMaxKernel;
+	cl_kernel			m_SinglePassKernel;
 
 };
 
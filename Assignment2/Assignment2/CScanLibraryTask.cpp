@@ -0,0 +1,153 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CScanLibraryTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
+
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CScanLibraryTask
+
+CScanLibraryTask::CScanLibraryTask(size_t ArraySize)
+	: m_N(ArraySize), m_hInput(NULL), m_hHeadFlags(NULL), m_hResultGPU(NULL),
+	m_dInput(NULL), m_dHeadFlags(NULL), m_dOutput(NULL)
+{
+	for(int v = 0; v < NUM_VARIANTS; v++)
+	{
+		m_hResultCPU[v] = NULL;
+		m_Valid[v] = false;
+	}
+}
+
+CScanLibraryTask::~CScanLibraryTask()
+{
+	ReleaseResources();
+}
+
+const char* CScanLibraryTask::GetVariantName(int Variant)
+{
+	static const char* names[NUM_VARIANTS] = {
+		"scan_inclusive", "scan_exclusive", "scan_segmented_inclusive", "scan_segmented_exclusive"
+	};
+	return names[Variant];
+}
+
+bool CScanLibraryTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	//CPU resources
+	m_hInput = new cl_uint[m_N];
+	m_hHeadFlags = new cl_uint[m_N];
+	m_hResultGPU = new cl_uint[m_N];
+	for(int v = 0; v < NUM_VARIANTS; v++)
+		m_hResultCPU[v] = new cl_uint[m_N];
+
+	// segments of about 1000 elements, so they cross the tiles of the kernels
+	for(size_t i = 0; i < m_N; i++)
+	{
+		m_hInput[i] = rand() & 15;
+		m_hHeadFlags[i] = (rand() % 1000 == 0) ? 1 : 0;
+	}
+
+	//device resources, the kernels are built by Scan() on first use
+	cl_int clError, clError2;
+	m_dInput = CreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_uint) * m_N, &clError2);
+	clError = clError2;
+	m_dHeadFlags = CreateBuffer(Context, CL_MEM_READ_ONLY, sizeof(cl_uint) * m_N, &clError2);
+	clError |= clError2;
+	m_dOutput = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, &clError2);
+	clError |= clError2;
+	V_RETURN_FALSE_CL(clError, "Error allocating device arrays");
+
+	return true;
+}
+
+void CScanLibraryTask::ReleaseResources()
+{
+	SAFE_DELETE_ARRAY(m_hInput);
+	SAFE_DELETE_ARRAY(m_hHeadFlags);
+	SAFE_DELETE_ARRAY(m_hResultGPU);
+	for(int v = 0; v < NUM_VARIANTS; v++)
+		SAFE_DELETE_ARRAY(m_hResultCPU[v]);
+
+	ReleaseBuffer(m_dInput);
+	ReleaseBuffer(m_dHeadFlags);
+	ReleaseBuffer(m_dOutput);
+}
+
+void CScanLibraryTask::ComputeCPU()
+{
+	CTimer timer;
+	timer.Start();
+
+	for(int v = 0; v < NUM_VARIANTS; v++)
+		ScanHost(m_hInput, m_hResultCPU[v], m_N, EScanMode(v % 2), v >= 2 ? m_hHeadFlags : nullptr);
+
+	timer.Stop();
+	cout << "  average time: " << timer.GetElapsedMilliseconds() / NUM_VARIANTS << " ms per variant" << endl;
+}
+
+cl_int CScanLibraryTask::RunVariant(cl_command_queue CommandQueue, int Variant)
+{
+	if(Variant >= 2)
+		return SegmentedScan(CommandQueue, m_dInput, m_dHeadFlags, m_dOutput, m_N, EScanMode(Variant % 2));
+	return Scan(CommandQueue, m_dInput, m_dOutput, m_N, EScanMode(Variant % 2));
+}
+
+void CScanLibraryTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	{
+		CScopedTimer timer("WriteBuffers");
+		V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dInput, CL_FALSE, 0, m_N * sizeof(cl_uint), m_hInput, 0, NULL, NULL), "Error copying data from host to device!");
+		V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dHeadFlags, CL_TRUE, 0, m_N * sizeof(cl_uint), m_hHeadFlags, 0, NULL, NULL), "Error copying data from host to device!");
+	}
+
+	cout << endl << "Scanning " << m_N << " elements" << endl;
+
+	const int nIterations = 20;
+	for(int v = 0; v < NUM_VARIANTS; v++)
+	{
+		string name = GetVariantName(v);
+
+		// the first call builds the kernels, so it is not timed
+		V_RETURN_CL(RunVariant(CommandQueue, v), "Error executing " + name);
+		V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, m_dOutput, CL_TRUE, 0, m_N * sizeof(cl_uint), m_hResultGPU, 0, NULL, NULL), "Error reading data from device!");
+		m_Valid[v] = (memcmp(m_hResultCPU[v], m_hResultGPU, m_N * sizeof(cl_uint)) == 0);
+
+		CTimer timer;
+		timer.Start();
+		for(int i = 0; i < nIterations; i++)
+			V_RETURN_CL(RunVariant(CommandQueue, v), "Error executing " + name);
+		V_RETURN_CL(clFinish(CommandQueue), "Error finishing the queue!");
+		timer.Stop();
+		double ms = timer.GetElapsedMilliseconds() / double(nIterations);
+
+		cout << "  " << name << ": " << ms << " ms, throughput: " << 1.0e-6 * (double)m_N / ms << " Gelem/s" << endl;
+		CLUtil::PrintBandwidth(name, 2 * sizeof(cl_uint) * m_N, ms);
+		CBenchmarkRecorder::ReportTime(name, ms);
+	}
+}
+
+bool CScanLibraryTask::ValidateResults()
+{
+	bool success = true;
+	for(int v = 0; v < NUM_VARIANTS; v++)
+	{
+		if(!m_Valid[v])
+		{
+			cout << "Validation of " << GetVariantName(v) << " failed." << endl;
+			success = false;
+		}
+	}
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
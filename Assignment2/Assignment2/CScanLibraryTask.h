@@ -0,0 +1,74 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CSCAN_LIBRARY_TASK_H
+#define _CSCAN_LIBRARY_TASK_H
+
+#include "../Common/IComputeTask.h"
+#include "../Common/CScan.h"
+
+//! A2/T2 library: Scan() and SegmentedScan() of CScan.h on an array of any length
+/*!
+	Runs the inclusive and exclusive scan, both plain and segmented, and compares them
+	with ScanHost(). The array size does not have to be a power of two.
+*/
+class CScanLibraryTask : public IComputeTask
+{
+public:
+	enum { NUM_VARIANTS = 4 };
+
+	CScanLibraryTask(size_t ArraySize);
+
+	virtual ~CScanLibraryTask();
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// the input is read and the result is written once (the head flags are not counted)
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_N; Bytes = 2 * sizeof(cl_uint) * m_N; }
+
+protected:
+	//! The variants 0 and 1 are the inclusive and exclusive scan, 2 and 3 the same segmented
+	static const char* GetVariantName(int Variant);
+
+	cl_int RunVariant(cl_command_queue CommandQueue, int Variant);
+
+	size_t				m_N;
+
+	cl_uint				*m_hInput;
+	//! a set flag starts a new segment
+	cl_uint				*m_hHeadFlags;
+	cl_uint				*m_hResultCPU[NUM_VARIANTS];
+	cl_uint				*m_hResultGPU;
+	bool				m_Valid[NUM_VARIANTS];
+
+	cl_mem				m_dInput;
+	cl_mem				m_dHeadFlags;
+	cl_mem				m_dOutput;
+};
+
+#endif // _CSCAN_LIBRARY_TASK_H
@@ -6,31 +6,36 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CScanTask.h"
 
 #include "../Common/CLUtil.h"
+#include "../Common/CThreadPool.h"
 #include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
 
+#include <sstream>
 #include <string.h>
 
 using namespace std;
 
-// number of banks in the local memory. This can be used to avoid bank conflicts
-// but we also need to allocate more local memory for that.
-#define NUM_BANKS	32
-
 ///////////////////////////////////////////////////////////////////////////////
 // CScanTask
 
 // only useful for debug info
-const string g_kernelNames[2] = 
+const string g_kernelNames[3] = 
 {
 	"scanNaive",
-	"scanWorkEfficient"
+	"scanWorkEfficient",
+	"scanDecoupledLookBack"
 };
 
+// elements per work-item of the decoupled look-back (LOOKBACK_ITEMS in Scan.cl)
+#define LOOKBACK_ITEMS	8
+
 CScanTask::CScanTask(size_t ArraySize, size_t MinLocalWorkSize)
-	: m_N(ArraySize), m_hArray(NULL), m_hResultCPU(NULL), m_hResultGPU(NULL),
-	m_dPingArray(NULL), m_dPongArray(NULL),
+	: m_N(ArraySize), m_hArray(NULL), m_hResultCPU(NULL), m_hResultGPU(NULL), m_DeviceValidation(false),
+	m_dPingArray(NULL), m_dPongArray(NULL), m_dLevelArrays(NULL),
+	m_UseLookBack(false), m_MaxTiles(0), m_LookBackEpoch(0), m_dTileFlags(NULL), m_dTileValues(NULL), m_dTileCounter(NULL),
 	m_Program(NULL), 
-	m_ScanNaiveKernel(NULL), m_ScanWorkEfficientKernel(NULL), m_ScanWorkEfficientAddKernel(NULL)
+	m_ScanNaiveKernel(NULL), m_ScanWorkEfficientKernel(NULL), m_ScanWorkEfficientAddKernel(NULL), m_ScanLookBackKernel(NULL)
 {
 	// compute the number of levels that we need for the work-efficient algorithm
 
@@ -55,6 +60,14 @@ CScanTask::~CScanTask()
 
 bool CScanTask::InitResources(cl_device_id Device, cl_context Context)
 {
+	// the kernels of the assignment process whole blocks of 2 * local size elements,
+	// Scan() of CScan.h handles any size
+	if (m_N % (2 * m_MinLocalWorkSize) != 0) {
+		cerr << "Error: the array size " << m_N << " is not a multiple of " << 2 * m_MinLocalWorkSize
+			<< ", use Scan() of CScan.h for other sizes." << endl;
+		return false;
+	}
+
 	//CPU resources
 	m_hArray	 = new unsigned int[m_N];
 	m_hResultCPU = new unsigned int[m_N];
@@ -68,26 +81,57 @@ bool CScanTask::InitResources(cl_device_id Device, cl_context Context)
 	//device resources
 	// ping-pong buffers
 	cl_int clError, clError2;
-	m_dPingArray = clCreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, NULL, &clError2);
+	m_dPingArray = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, &clError2);
 	clError = clError2;
-	m_dPongArray = clCreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, NULL, &clError2);
+	m_dPongArray = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_N, &clError2);
 	clError |= clError2;
 
 	// level buffer
 	m_dLevelArrays = new cl_mem[m_nLevels];
 	unsigned int N = m_N;
 	for (unsigned int i = 0; i < m_nLevels; i++) {
-		m_dLevelArrays[i] = clCreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * N, NULL, &clError2);
+		m_dLevelArrays[i] = CreateBuffer(Context, CL_MEM_READ_WRITE, sizeof(cl_uint) * N, &clError2);
 		clError |= clError2;
 		N = max(N / (2 * m_MinLocalWorkSize), m_MinLocalWorkSize);
 	}
 	V_RETURN_FALSE_CL(clError, "Error allocating device arrays");
 
+	// the look-back spins on the flags of other work-groups, which needs device wide release/acquire ordering:
+	// OpenCL C 2.x has it, on NVIDIA and AMD GPUs mem_fence() orders device wide as well
+	const CDeviceCaps& caps = GetDeviceCaps();
+	string options = caps.GetBuildOptions();
+	ostringstream lookBackOptions;
+	lookBackOptions << " -D LOOKBACK_ITEMS=" << LOOKBACK_ITEMS;
+	if (caps.OpenCLCVersion >= 200 && caps.OpenCLCVersion < 300) {
+		m_UseLookBack = true;
+		lookBackOptions << " -cl-std=CL2.0 -D LOOKBACK_CL20";
+	} else {
+		m_UseLookBack = (caps.Type & CL_DEVICE_TYPE_GPU) && (caps.Vendor.find("NVIDIA") != string::npos ||
+			caps.Vendor.find("AMD") != string::npos || caps.Vendor.find("Advanced Micro Devices") != string::npos);
+	}
+	options += lookBackOptions.str();
+	if (!m_UseLookBack)
+		cout << "The device does not guarantee the memory ordering of the decoupled look-back, "
+			<< g_kernelNames[2] << " uses the hierarchical scan." << endl;
+
+	// the smallest tiles give the most tiles
+	m_MaxTiles = (m_N + m_MinLocalWorkSize * LOOKBACK_ITEMS - 1) / (m_MinLocalWorkSize * LOOKBACK_ITEMS);
+	vector<cl_uint> zeros(m_MaxTiles, 0);
+	m_dTileFlags = clCreateBuffer(Context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_uint) * m_MaxTiles, &zeros[0], &clError2);
+	clError = clError2;
+	m_dTileValues = CreateBuffer(Context, CL_MEM_READ_WRITE, 2 * sizeof(cl_uint) * m_MaxTiles, &clError2);
+	clError |= clError2;
+	m_dTileCounter = clCreateBuffer(Context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_uint), &zeros[0], &clError2);
+	clError |= clError2;
+	V_RETURN_FALSE_CL(clError, "Error allocating the tile states");
+	m_LookBackEpoch = 0;
+
 	//load and compile kernels
 	string programCode;
 
 	CLUtil::LoadProgramSourceToMemory("../Assignment2/Scan.cl", programCode);
-	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode);
+	// the bank count and the SIMD width of the device
+	m_Program = CLUtil::BuildCLProgramFromMemory(Device, Context, programCode, options);
 	if(m_Program == nullptr) return false;
 
 	//create kernels
@@ -100,6 +144,9 @@ bool CScanTask::InitResources(cl_device_id Device, cl_context Context)
 	m_ScanWorkEfficientAddKernel = clCreateKernel(m_Program, "Scan_WorkEfficientAdd", &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create kernel.");
 
+	m_ScanLookBackKernel = clCreateKernel(m_Program, "Scan_DecoupledLookBack", &clError);
+	V_RETURN_FALSE_CL(clError, "Failed to create kernel.");
+
 	return true;
 }
 
@@ -112,18 +159,23 @@ void CScanTask::ReleaseResources()
 	SAFE_DELETE_ARRAY(m_hResultGPU);
 
 	// device resources
-	SAFE_RELEASE_MEMOBJECT(m_dPingArray);
-	SAFE_RELEASE_MEMOBJECT(m_dPongArray);
+	ReleaseBuffer(m_dPingArray);
+	ReleaseBuffer(m_dPongArray);
 
 	if(m_dLevelArrays)
 		for (unsigned int i = 0; i < m_nLevels; i++) {
-			SAFE_RELEASE_MEMOBJECT(m_dLevelArrays[i]);
+			ReleaseBuffer(m_dLevelArrays[i]);
 		}
 	SAFE_DELETE_ARRAY(m_dLevelArrays);
+	SAFE_RELEASE_MEMOBJECT(m_dTileFlags);
+	ReleaseBuffer(m_dTileValues);
+	SAFE_RELEASE_MEMOBJECT(m_dTileCounter);
+	m_Validator.Release();
 
 	SAFE_RELEASE_KERNEL(m_ScanNaiveKernel);
 	SAFE_RELEASE_KERNEL(m_ScanWorkEfficientKernel);
 	SAFE_RELEASE_KERNEL(m_ScanWorkEfficientAddKernel);
+	SAFE_RELEASE_KERNEL(m_ScanLookBackKernel);
 
 	SAFE_RELEASE_PROGRAM(m_Program);
 }
@@ -132,13 +184,18 @@ void CScanTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, si
 {
 	cout << endl;
 
+	// the CPU result is uploaded once, then only the comparison results are read back
+	m_DeviceValidation = CDeviceValidator::IsEnabled() && m_Validator.SetGolden(CommandQueue, m_hResultCPU, m_N);
+
 	ValidateTask(Context, CommandQueue, LocalWorkSize, 0);
 	ValidateTask(Context, CommandQueue, LocalWorkSize, 1);
+	ValidateTask(Context, CommandQueue, LocalWorkSize, 2);
 
 	cout << endl;
 
 	TestPerformance(Context, CommandQueue, LocalWorkSize, 0);
 	TestPerformance(Context, CommandQueue, LocalWorkSize, 1);
+	TestPerformance(Context, CommandQueue, LocalWorkSize, 2);
 
 	cout << endl;
 }
@@ -150,11 +207,38 @@ void CScanTask::ComputeCPU()
 
 	unsigned int nIterations = 1;
 	for(unsigned int j = 0; j < nIterations; j++) {
+		// scan-then-propagate: sum up each block, scan the block sums,
+		// then scan each block again starting at the sum of all blocks before it
+		const size_t blockSize = 1 << 16;
+		size_t nBlocks = (m_N + blockSize - 1) / blockSize;
+		vector<unsigned int> blockOffsets(nBlocks, 0);
+
+		CThreadPool::Get().ParallelFor(0, nBlocks, 1, [&](size_t Begin, size_t End) {
+			for(size_t b = Begin; b < End; b++) {
+				unsigned int sum = 0;
+				for(size_t i = b * blockSize; i < min<size_t>(m_N, (b + 1) * blockSize); i++) {
+					sum += m_hArray[i];
+				}
+				blockOffsets[b] = sum;
+			}
+		});
+
 		unsigned int sum = 0;
-		for(unsigned int i = 0; i < m_N; i++) {
-			sum += m_hArray[i];
-			m_hResultCPU[i] = sum; 
+		for(size_t b = 0; b < nBlocks; b++) {
+			unsigned int blockSum = blockOffsets[b];
+			blockOffsets[b] = sum;
+			sum += blockSum;
 		}
+
+		CThreadPool::Get().ParallelFor(0, nBlocks, 1, [&](size_t Begin, size_t End) {
+			for(size_t b = Begin; b < End; b++) {
+				unsigned int running = blockOffsets[b];
+				for(size_t i = b * blockSize; i < min<size_t>(m_N, (b + 1) * blockSize); i++) {
+					running += m_hArray[i];
+					m_hResultCPU[i] = running;
+				}
+			}
+		});
 	}
 
 	timer.Stop();
@@ -166,7 +250,7 @@ bool CScanTask::ValidateResults()
 {
 	bool success = true;
 
-	for(int i = 0; i < 2; i++)
+	for(int i = 0; i < (int)ARRAYLEN(m_bValidationResults); i++)
 		if(!m_bValidationResults[i])
 		{
 			cout<<"Validation of reduction kernel "<<g_kernelNames[i]<<" failed." << endl;
@@ -223,6 +307,16 @@ void CScanTask::Scan_Naive(cl_context Context, cl_command_queue CommandQueue, si
 
 }
 
+size_t CScanTask::GetLocalBlockSize(size_t LocalWorkSize) const
+{
+	size_t size = 2 * LocalWorkSize;		// number of elements to store
+	// one pad per NUM_BANKS elements, see OFFSET() in Scan.cl. Without banks there is no padding.
+	cl_uint numBanks = GetDeviceCaps().NumLocalBanks;
+	if (numBanks > 0)
+		size += size/numBanks;				// number of pads
+	return size;
+}
+
 void CScanTask::Scan_WorkEfficient(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
 	cl_int clError;
@@ -240,8 +334,7 @@ void CScanTask::Scan_WorkEfficient(cl_context Context, cl_command_queue CommandQ
 	// unsigned int k = m_nLevels > 1 ? 1 : 0;		// pass back to level 0 if local PPS is enough
 	clError = clSetKernelArg(m_ScanWorkEfficientKernel, 1, sizeof(cl_mem), (void*) &m_dLevelArrays[1]);
 	// set third argument: local block
-	size_t size = 2 * myLocalWorkSize;		// number of elements to store
-	size += size/NUM_BANKS;					// number of pads
+	size_t size = GetLocalBlockSize(myLocalWorkSize);
 	// cout << "LocalBlock size: " << size << endl;
 	clError = clSetKernelArg(m_ScanWorkEfficientKernel, 2, size * sizeof(uint), NULL);
 	V_RETURN_CL(clError, "Failed to set kernel args: ScanWorkEfficient");
@@ -271,8 +364,7 @@ void CScanTask::Scan_WorkEfficient(cl_context Context, cl_command_queue CommandQ
 		// if i = k: just perform a local PPS. This is the top level
 		clError = clSetKernelArg(m_ScanWorkEfficientKernel, 1, sizeof(cl_mem), (void*) &m_dLevelArrays[i+1]);
 		// set third argument: local block
-		size_t size = 2 * myLocalWorkSize;		// number of elements to store
-		size += size/NUM_BANKS;					// number of pads
+		size_t size = GetLocalBlockSize(myLocalWorkSize);
 		// cout << "LocalBlock size: " << size << endl;
 		clError = clSetKernelArg(m_ScanWorkEfficientKernel, 2, size * sizeof(uint), NULL);
 		V_RETURN_CL(clError, "Failed to set kernel args: ScanWorkEfficient (Group PPS)");
@@ -309,8 +401,7 @@ void CScanTask::Scan_WorkEfficient(cl_context Context, cl_command_queue CommandQ
 		// set second argument: pointer of out array 
 		clError = clSetKernelArg(m_ScanWorkEfficientAddKernel, 1, sizeof(cl_mem), (void*) &m_dLevelArrays[i-1]);
 		// set third argument: local block
-		// size_t size = 2 * myLocalWorkSize;		// number of elements to store
-		// size += size/NUM_BANKS;					// number of pads
+		// size_t size = GetLocalBlockSize(myLocalWorkSize);
 		// cout << "LocalBlock size: " << size << endl;
 		// no need for a local block
 		clError = clSetKernelArg(m_ScanWorkEfficientAddKernel, 2, 1, NULL);
@@ -333,21 +424,80 @@ void CScanTask::Scan_WorkEfficient(cl_context Context, cl_command_queue CommandQ
 
 }
 
+void CScanTask::Scan_DecoupledLookBack(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	if (!m_UseLookBack) {
+		// the tiles could read stale prefixes of each other, use the multi-level scan
+		Scan_WorkEfficient(Context, CommandQueue, LocalWorkSize);
+		return;
+	}
+
+	// one work-group per tile, the tile states are allocated for the smallest local work size
+	cl_int clError;
+	size_t myLocalWorkSize = max(LocalWorkSize[0], m_MinLocalWorkSize);
+	size_t tileSize = myLocalWorkSize * LOOKBACK_ITEMS;
+	size_t nTiles = (m_N + tileSize - 1) / tileSize;
+	size_t globalWorkSize = nTiles * myLocalWorkSize;
+
+	// a new epoch invalidates the flags of the previous run (the flags keep 30 bits of it)
+	m_LookBackEpoch = (m_LookBackEpoch + 1) & 0x3FFFFFFF;
+	if (m_LookBackEpoch == 0)
+		m_LookBackEpoch = 1;
+
+	// SET KERNEL ARGUMENTS ///////////////////////////////////////////////////////////////////
+	// in-place on the ping array
+	clError = clSetKernelArg(m_ScanLookBackKernel, 0, sizeof(cl_mem), (void*) &m_dPingArray);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 1, sizeof(cl_mem), (void*) &m_dPingArray);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 2, sizeof(uint), (void*) &m_N);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 3, sizeof(cl_mem), (void*) &m_dTileFlags);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 4, sizeof(cl_mem), (void*) &m_dTileValues);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 5, sizeof(cl_mem), (void*) &m_dTileCounter);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 6, sizeof(cl_uint), (void*) &m_LookBackEpoch);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 7, tileSize * sizeof(uint), NULL);
+	clError |= clSetKernelArg(m_ScanLookBackKernel, 8, myLocalWorkSize * sizeof(uint), NULL);
+	V_RETURN_CL(clError, "Failed to set kernel args: ScanDecoupledLookBack");
+	///////////////////////////////////////////////////////////////////////////////////////////
+
+	// RUN KERNEL /////////////////////////////////////////////////////////////////////////////
+	clError = clEnqueueNDRangeKernel(CommandQueue, m_ScanLookBackKernel, 1, NULL,
+									&globalWorkSize, &myLocalWorkSize,
+									0, NULL, NULL);	
+	V_RETURN_CL(clError, "Failed to execute Kernel: ScanDecoupledLookBack");
+	///////////////////////////////////////////////////////////////////////////////////////////
+}
+
 void CScanTask::ValidateTask(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task)
 {
+	CScopedTimer taskTimer(string("ValidateTask ") + g_kernelNames[Task]);
+
 	//run selected task
+	cl_mem result = NULL;
 	switch (Task){
 		case 0:
 			V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dPingArray, CL_FALSE, 0, m_N * sizeof(cl_uint), m_hArray, 0, NULL, NULL), "Error copying data from host to device!");
 			Scan_Naive(Context, CommandQueue, LocalWorkSize);
-			V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, m_dPingArray, CL_TRUE, 0, m_N * sizeof(cl_uint), m_hResultGPU, 0, NULL, NULL), "Error reading data from device!");
+			result = m_dPingArray;
 			break;
 		case 1:
 			V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dLevelArrays[0], CL_FALSE, 0, m_N * sizeof(cl_uint), m_hArray, 0, NULL, NULL), "Error copying data from host to device!");
 			Scan_WorkEfficient(Context, CommandQueue, LocalWorkSize);
-			V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, m_dLevelArrays[0], CL_TRUE, 0, m_N * sizeof(cl_uint), m_hResultGPU, 0, NULL, NULL), "Error reading data from device!");
+			result = m_dLevelArrays[0];
 			break;
+		case 2:
+			result = m_UseLookBack ? m_dPingArray : m_dLevelArrays[0];
+			V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, result, CL_FALSE, 0, m_N * sizeof(cl_uint), m_hArray, 0, NULL, NULL), "Error copying data from host to device!");
+			Scan_DecoupledLookBack(Context, CommandQueue, LocalWorkSize);
+			break;
+	}
+
+	if (m_DeviceValidation) {
+		CDeviceValidator::Result r;
+		V_RETURN_CL(m_Validator.Compare(CommandQueue, result, r), "Error comparing the result on the device!");
+		CDeviceValidator::PrintResult(g_kernelNames[Task], r);
+		m_bValidationResults[Task] = r.IsValid();
+		return;
 	}
+	V_RETURN_CL(clEnqueueReadBuffer(CommandQueue, result, CL_TRUE, 0, m_N * sizeof(cl_uint), m_hResultGPU, 0, NULL, NULL), "Error reading data from device!");
 
 	// validate results
 	// for (uint i = 0; i<2*LocalWorkSize[0]; i++) cout << m_hResultGPU[i] << ", ";		// debug
@@ -357,6 +507,7 @@ void CScanTask::ValidateTask(cl_context Context, cl_command_queue CommandQueue,
 void CScanTask::TestPerformance(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task)
 {
 	cout << "Testing performance of task " << g_kernelNames[Task] << endl;
+	CScopedTimer taskTimer(string("TestPerformance ") + g_kernelNames[Task]);
 
 	//write input data to the GPU
 	V_RETURN_CL(clEnqueueWriteBuffer(CommandQueue, m_dPingArray, CL_FALSE, 0, m_N * sizeof(cl_uint), m_hArray, 0, NULL, NULL), "Error copying data from host to device!");
@@ -377,6 +528,9 @@ void CScanTask::TestPerformance(cl_context Context, cl_command_queue CommandQueu
 			case 1:
 				Scan_WorkEfficient(Context, CommandQueue, LocalWorkSize);
 				break;
+			case 2:
+				Scan_DecoupledLookBack(Context, CommandQueue, LocalWorkSize);
+				break;
 		}
 	}
 
@@ -387,6 +541,7 @@ void CScanTask::TestPerformance(cl_context Context, cl_command_queue CommandQueu
 
 	double ms = timer.GetElapsedMilliseconds() / double(nIterations);
 	cout << "  average time: " << ms << " ms, throughput: " << 1.0e-6 * (double)m_N / ms << " Gelem/s" <<endl;
+	CBenchmarkRecorder::ReportTime(g_kernelNames[Task], ms);
 }
 
 
@@ -21,6 +21,7 @@
 #define _CSCAN_TASK_H
 
 #include "../Common/IComputeTask.h"
+#include "../Common/CDeviceValidator.h"
 
 //! A2 / T2 Parallel prefix sum (scan)
 class CScanTask : public IComputeTask
@@ -42,11 +43,23 @@ public:
 
 	virtual bool ValidateResults();
 
+	// the input is read and the result is written once
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_N; Bytes = 2 * sizeof(cl_uint) * m_N; }
+
 protected:
 
 	void Scan_Naive(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
 	void Scan_WorkEfficient(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
 
+	//! Single pass with decoupled look-back, falls back to Scan_WorkEfficient if the device does not support it
+	/*!
+		Works in-place on m_dPingArray, or on m_dLevelArrays[0] for the fallback.
+	*/
+	void Scan_DecoupledLookBack(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	//! Number of uints in the local block of Scan_WorkEfficient, including the pads against bank conflicts
+	size_t GetLocalBlockSize(size_t LocalWorkSize) const;
+
 	void ValidateTask(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task);
 	void TestPerformance(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3], unsigned int Task);
 
@@ -57,7 +70,11 @@ protected:
 
 	unsigned int		*m_hResultCPU;
 	unsigned int		*m_hResultGPU;
-	bool				m_bValidationResults[2];
+	bool				m_bValidationResults[3];
+
+	// compares the results on the device instead of reading them back (see CDeviceValidator)
+	CDeviceValidator	m_Validator;
+	bool				m_DeviceValidation;
 
 	// ping-pong arrays for the naive scan
 	cl_mem				m_dPingArray;
@@ -68,11 +85,21 @@ protected:
 	unsigned int		m_nLevels;
 	cl_mem				*m_dLevelArrays;
 
+	// tile states of the decoupled look-back: a flag, the aggregate and the inclusive prefix for each tile,
+	// and the counter which numbers the tiles. The flags carry the epoch of the run, see Scan.cl.
+	bool				m_UseLookBack;
+	size_t				m_MaxTiles;
+	cl_uint				m_LookBackEpoch;
+	cl_mem				m_dTileFlags;
+	cl_mem				m_dTileValues;
+	cl_mem				m_dTileCounter;
+
 	//OpenCL program and kernels
 	cl_program			m_Program;
 	cl_kernel			m_ScanNaiveKernel;
 	cl_kernel			m_ScanWorkEfficientKernel;
 	cl_kernel			m_ScanWorkEfficientAddKernel;
+	cl_kernel			m_ScanLookBackKernel;
 };
 
 #endif // _CSCAN_TASK_H
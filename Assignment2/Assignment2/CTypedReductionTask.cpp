@@ -0,0 +1,245 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CTypedReductionTask.h"
+
+#include "../Common/CLUtil.h"
+#include "../Common/CTimer.h"
+#include "../Common/CTrace.h"
+#include "../Common/CBenchmark.h"
+
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CTypedReductionTask
+
+// random input values
+static void RandomValue(cl_int& Value) { Value = rand() % 2001 - 1000; }
+static void RandomValue(cl_uint& Value) { Value = cl_uint(rand()) * 7919u; }
+static void RandomValue(cl_long& Value) { Value = (cl_long(rand()) << 20) - (cl_long(rand()) << 12); }
+static void RandomValue(cl_float& Value) { Value = 0.5f + float(rand()) / float(RAND_MAX); }
+static void RandomValue(cl_double& Value) { Value = 0.5 + double(rand()) / double(RAND_MAX); }
+
+// The product of the whole array is 0 for every type (a zero or enough even factors, or an underflow),
+// so it is validated on a prefix of odd integers, whose product wraps around without becoming 0,
+// and of floating point values close to 1.
+static const size_t c_ProductCount = 64;
+static void RandomFactor(cl_int& Value) { Value = (rand() % 1000) * 2 - 999; }
+static void RandomFactor(cl_uint& Value) { Value = (cl_uint(rand()) * 7919u) | 1u; }
+static void RandomFactor(cl_long& Value) { Value = ((cl_long(rand()) << 20) - (cl_long(rand()) << 12)) | 1; }
+static void RandomFactor(cl_float& Value) { Value = 1.0f + 1e-3f * (2.0f * float(rand()) / float(RAND_MAX) - 1.0f); }
+static void RandomFactor(cl_double& Value) { Value = 1.0 + 1e-3 * (2.0 * double(rand()) / double(RAND_MAX) - 1.0); }
+
+//! Number of elements whose result is validated
+static size_t GetValidatedCount(EReduceOp Op, size_t N)
+{
+	return Op == REDUCE_PRODUCT ? min(N, c_ProductCount) : N;
+}
+
+// allowed relative error of floating point sums and products
+template<class T> static double GetTolerance() { return 0; }
+template<> double GetTolerance<cl_float>() { return 1e-4; }
+template<> double GetTolerance<cl_double>() { return 1e-10; }
+
+CTypedReductionTask::CTypedReductionTask(size_t ArraySize, EReduceElementType ElementType)
+	: m_N(ArraySize), m_ElementType(ElementType), m_Supported(true), m_hInput(NULL), m_dInput(NULL)
+{
+	memset(m_CPUValue, 0, sizeof(m_CPUValue));
+	memset(m_CPUIndex, 0, sizeof(m_CPUIndex));
+	for(int op = 0; op < NUM_REDUCE_OPS; op++)
+		m_Valid[op] = false;
+}
+
+CTypedReductionTask::~CTypedReductionTask()
+{
+	ReleaseResources();
+}
+
+const char* CTypedReductionTask::GetElementTypeName(EReduceElementType ElementType)
+{
+	switch(ElementType)
+	{
+	case REDUCE_ELEMENT_INT32:	return "int32";
+	case REDUCE_ELEMENT_UINT32:	return "uint32";
+	case REDUCE_ELEMENT_INT64:	return "int64";
+	case REDUCE_ELEMENT_DOUBLE:	return "double";
+	default:					return "float";
+	}
+}
+
+bool CTypedReductionTask::ParseElementType(const std::string& Name, EReduceElementType& ElementType)
+{
+	for(int t = 0; t < NUM_REDUCE_ELEMENT_TYPES; t++)
+	{
+		if(Name == GetElementTypeName(EReduceElementType(t)))
+		{
+			ElementType = EReduceElementType(t);
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t CTypedReductionTask::GetElementSize() const
+{
+	return (m_ElementType == REDUCE_ELEMENT_INT64 || m_ElementType == REDUCE_ELEMENT_DOUBLE) ? 8 : 4;
+}
+
+template<class T>
+void CTypedReductionTask::FillInput()
+{
+	T* input = (T*)m_hInput;
+	for(size_t i = 0; i < m_N; i++)
+		RandomValue(input[i]);
+	for(size_t i = 0; i < GetValidatedCount(REDUCE_PRODUCT, m_N); i++)
+		RandomFactor(input[i]);
+}
+
+bool CTypedReductionTask::InitResources(cl_device_id Device, cl_context Context)
+{
+	m_Supported = (m_ElementType != REDUCE_ELEMENT_DOUBLE) || CReduction::SupportsDouble(Device);
+	if(!m_Supported)
+		cout<<"The device does not support double precision, the reduction of doubles is skipped."<<endl;
+
+	//CPU resources (aligned for zero-copy buffers)
+	m_hInput = CLUtil::AllocHostArray<unsigned char>(GetElementSize() * m_N);
+	switch(m_ElementType)
+	{
+	case REDUCE_ELEMENT_INT32:	FillInput<cl_int>(); break;
+	case REDUCE_ELEMENT_UINT32:	FillInput<cl_uint>(); break;
+	case REDUCE_ELEMENT_INT64:	FillInput<cl_long>(); break;
+	case REDUCE_ELEMENT_DOUBLE:	FillInput<cl_double>(); break;
+	default:					FillInput<cl_float>(); break;
+	}
+
+	//device resources, the kernels are built by Reduce() on first use
+	cl_int clError;
+	m_dInput = CreateHostBuffer(Context, CL_MEM_READ_ONLY, GetElementSize() * m_N, m_hInput, &clError);
+	V_RETURN_FALSE_CL(clError, "Error allocating device arrays");
+
+	return true;
+}
+
+void CTypedReductionTask::ReleaseResources()
+{
+	ReleaseBuffer(m_dInput);
+
+	//CPU resources (after the buffer, which might use them)
+	CLUtil::FreeHostArray(m_hInput);
+}
+
+template<class T>
+void CTypedReductionTask::ComputeCPUTyped()
+{
+	for(int op = 0; op < NUM_REDUCE_OPS; op++)
+	{
+		ReduceResult<T> result = ReduceHost((const T*)m_hInput, GetValidatedCount(EReduceOp(op), m_N), EReduceOp(op));
+		memcpy(&m_CPUValue[op], &result.Value, sizeof(T));
+		m_CPUIndex[op] = result.Index;
+	}
+}
+
+void CTypedReductionTask::ComputeCPU()
+{
+	switch(m_ElementType)
+	{
+	case REDUCE_ELEMENT_INT32:	ComputeCPUTyped<cl_int>(); break;
+	case REDUCE_ELEMENT_UINT32:	ComputeCPUTyped<cl_uint>(); break;
+	case REDUCE_ELEMENT_INT64:	ComputeCPUTyped<cl_long>(); break;
+	case REDUCE_ELEMENT_DOUBLE:	ComputeCPUTyped<cl_double>(); break;
+	default:					ComputeCPUTyped<cl_float>(); break;
+	}
+}
+
+template<class T>
+void CTypedReductionTask::ComputeGPUTyped(cl_command_queue CommandQueue)
+{
+	const int nIterations = 20;
+	for(int op = 0; op < NUM_REDUCE_OPS; op++)
+	{
+		string name = string("reduce_") + GetElementTypeName(m_ElementType) + "_" + CReduction::GetOpName(EReduceOp(op));
+
+		// the first call builds the kernels, so it is not timed
+		ReduceResult<T> result;
+		V_RETURN_CL(Reduce<T>(CommandQueue, m_dInput, m_N, EReduceOp(op), result), "Error executing reduction " + name);
+
+		CTimer timer;
+		timer.Start();
+		for(int i = 0; i < nIterations; i++)
+			V_RETURN_CL(Reduce<T>(CommandQueue, m_dInput, m_N, EReduceOp(op), result), "Error executing reduction " + name);
+		timer.Stop();
+		double ms = timer.GetElapsedMilliseconds() / double(nIterations);
+
+		size_t validated = GetValidatedCount(EReduceOp(op), m_N);
+		if(validated != m_N)
+			V_RETURN_CL(Reduce<T>(CommandQueue, m_dInput, validated, EReduceOp(op), result), "Error executing reduction " + name);
+
+		T expected;
+		memcpy(&expected, &m_CPUValue[op], sizeof(T));
+		if(op == REDUCE_SUM || op == REDUCE_PRODUCT)
+		{
+			double error = fabs(double(result.Value) - double(expected));
+			m_Valid[op] = (expected == result.Value) || error <= GetTolerance<T>() * max(fabs(double(expected)), 1.0);
+		}
+		else
+			m_Valid[op] = (expected == result.Value) && (m_CPUIndex[op] == result.Index);
+
+		cout<<"  "<<name<<": "<<result.Value;
+		if(validated != m_N)
+			cout<<" of the first "<<validated<<" elements";
+		if(op == REDUCE_ARGMIN || op == REDUCE_ARGMAX)
+			cout<<" at "<<result.Index;
+		cout<<" (CPU: "<<expected;
+		if(op == REDUCE_ARGMIN || op == REDUCE_ARGMAX)
+			cout<<" at "<<m_CPUIndex[op];
+		cout<<"), "<<ms<<" ms"<<endl;
+		CLUtil::PrintBandwidth(name, GetElementSize() * m_N, ms);
+		CBenchmarkRecorder::ReportTime(name, ms);
+	}
+}
+
+void CTypedReductionTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
+{
+	if(!m_Supported)
+		return;
+
+	{
+		CScopedTimer timer("WriteBuffers");
+		cl_int clErr = CLUtil::UploadBuffer(CommandQueue, m_dInput, GetElementSize() * m_N, m_hInput, m_TransferPolicy, CL_TRUE);
+		V_RETURN_CL(clErr, "Error copying data from host to device!");
+	}
+
+	cout<<"Reducing "<<m_N<<" elements of type "<<GetElementTypeName(m_ElementType)<<endl;
+	switch(m_ElementType)
+	{
+	case REDUCE_ELEMENT_INT32:	ComputeGPUTyped<cl_int>(CommandQueue); break;
+	case REDUCE_ELEMENT_UINT32:	ComputeGPUTyped<cl_uint>(CommandQueue); break;
+	case REDUCE_ELEMENT_INT64:	ComputeGPUTyped<cl_long>(CommandQueue); break;
+	case REDUCE_ELEMENT_DOUBLE:	ComputeGPUTyped<cl_double>(CommandQueue); break;
+	default:					ComputeGPUTyped<cl_float>(CommandQueue); break;
+	}
+}
+
+bool CTypedReductionTask::ValidateResults()
+{
+	if(!m_Supported)
+		return true;
+
+	bool success = true;
+	for(int op = 0; op < NUM_REDUCE_OPS; op++)
+	{
+		if(!m_Valid[op])
+		{
+			cout<<"Validation of the "<<GetElementTypeName(m_ElementType)<<" "<<CReduction::GetOpName(EReduceOp(op))<<" reduction failed."<<endl;
+			success = false;
+		}
+	}
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
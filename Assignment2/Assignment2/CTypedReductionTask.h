@@ -0,0 +1,92 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CTYPED_REDUCTION_TASK_H
+#define _CTYPED_REDUCTION_TASK_H
+
+#include "../Common/IComputeTask.h"
+#include "../Common/CReduce.h"
+
+#include <string>
+
+enum EReduceElementType
+{
+	REDUCE_ELEMENT_INT32,
+	REDUCE_ELEMENT_UINT32,
+	REDUCE_ELEMENT_INT64,
+	REDUCE_ELEMENT_FLOAT,
+	//! skipped if the device has no cl_khr_fp64
+	REDUCE_ELEMENT_DOUBLE,
+	NUM_REDUCE_ELEMENT_TYPES
+};
+
+//! A2/T1 generic: all operators of Reduce<T, Op>() (see CReduce.h) on one element type
+/*!
+	Every operator is timed and compared with ReduceHost(). Sums and products of floating
+	point types are summed up in a different order than on the host, they may differ
+	by a relative error.
+*/
+class CTypedReductionTask : public IComputeTask
+{
+public:
+	CTypedReductionTask(size_t ArraySize, EReduceElementType ElementType);
+
+	virtual ~CTypedReductionTask();
+
+	static const char* GetElementTypeName(EReduceElementType ElementType);
+
+	//! Parses the names of GetElementTypeName(), returns false if the name is unknown
+	static bool ParseElementType(const std::string& Name, EReduceElementType& ElementType);
+
+	// IComputeTask
+	virtual bool InitResources(cl_device_id Device, cl_context Context);
+
+	virtual void ReleaseResources();
+
+	virtual void ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3]);
+
+	virtual void ComputeCPU();
+
+	virtual bool ValidateResults();
+
+	// the input is read once by each operator
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_N; Bytes = GetElementSize() * m_N; }
+
+protected:
+	size_t GetElementSize() const;
+
+	template<class T> void FillInput();
+	template<class T> void ComputeCPUTyped();
+	template<class T> void ComputeGPUTyped(cl_command_queue CommandQueue);
+
+	size_t				m_N;
+	EReduceElementType	m_ElementType;
+	//! false if the device cannot compute with the element type
+	bool				m_Supported;
+
+	unsigned char		*m_hInput;
+	cl_mem				m_dInput;
+
+	//! CPU results per operator, the values are stored in the bytes of a cl_ulong
+	cl_ulong			m_CPUValue[NUM_REDUCE_OPS];
+	size_t				m_CPUIndex[NUM_REDUCE_OPS];
+	bool				m_Valid[NUM_REDUCE_OPS];
+};
+
+#endif // _CTYPED_REDUCTION_TASK_H
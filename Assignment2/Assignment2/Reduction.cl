@@ -1,4 +1,11 @@
 
+// work-items of one SIMD group run in lockstep, the host passes the device's width (see CDeviceCaps::GetBuildOptions())
+#ifndef SIMD_GROUP_SIZE
+#define SIMD_GROUP_SIZE		32
+#endif
+// the last steps of DecompUnroll need no barriers if they stay within one SIMD group
+#define UNROLL_LIMIT		min(SIMD_GROUP_SIZE, 32)
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 __kernel void Reduction_InterleavedAddressing(__global uint* array, uint stride) 
 {
@@ -58,7 +65,7 @@ __kernel void Reduction_DecompUnroll(const __global uint* inArray, __global uint
 	// second part: reduce localBlock
 	// implementation is like sequential addressing
 	int stride;
-	for (int i = 1; (numOfThreads >> i) > 32; i++) {
+	for (int i = 1; (numOfThreads >> i) > UNROLL_LIMIT; i++) {
 		stride = numOfThreads >> i;	// half the number of threads in each step
 		if (LID < stride) {			// workItem used for reduction
 			localBlock[ LID ] += localBlock[ LID + stride];
@@ -66,14 +73,15 @@ __kernel void Reduction_DecompUnroll(const __global uint* inArray, __global uint
 		barrier(CLK_LOCAL_MEM_FENCE);	// wait until reduction step is complete
 	}
 	
-	int max_stride = numOfThreads / 2;
-	// unroll the loop
-	if (LID < 32 && 32 <= max_stride) localBlock[ LID ] += localBlock[ LID + 32];
-	if (LID < 16 && 16 <= max_stride) localBlock[ LID ] += localBlock[ LID + 16];
-	if (LID <  8 &&  8 <= max_stride) localBlock[ LID ] += localBlock[ LID +  8];
-	if (LID <  4 &&  4 <= max_stride) localBlock[ LID ] += localBlock[ LID +  4];
-	if (LID <  2 &&  2 <= max_stride) localBlock[ LID ] += localBlock[ LID +  2];
-	if (LID <  1 &&  1 <= max_stride) localBlock[ LID ] += localBlock[ LID +  1];
+	int max_stride = min(numOfThreads / 2, UNROLL_LIMIT);
+	// unroll the loop (volatile, so the SIMD group sees the values of the previous step)
+	volatile __local uint* simdBlock = localBlock;
+	if (LID < 32 && 32 <= max_stride) simdBlock[ LID ] += simdBlock[ LID + 32];
+	if (LID < 16 && 16 <= max_stride) simdBlock[ LID ] += simdBlock[ LID + 16];
+	if (LID <  8 &&  8 <= max_stride) simdBlock[ LID ] += simdBlock[ LID +  8];
+	if (LID <  4 &&  4 <= max_stride) simdBlock[ LID ] += simdBlock[ LID +  4];
+	if (LID <  2 &&  2 <= max_stride) simdBlock[ LID ] += simdBlock[ LID +  2];
+	if (LID <  1 &&  1 <= max_stride) simdBlock[ LID ] += simdBlock[ LID +  1];
 
 
 	// write back
@@ -121,4 +129,57 @@ __kernel void Reduction_LoadMax(const __global uint* inArray, __global uint* out
 	if (LID == 0) outArray[groupID] = *localSum;
 	//if (0 == (LID|groupID)) printf("localSum: %i\n", *localSum);
 	//if (0 == LID) printf("localSum: %i\n", *localSum);
-}
\ No newline at end of file
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the whole reduction in one launch: the last work-group which is done adds up the results of all groups
+__kernel void Reduction_SinglePass(const __global uint* inArray, volatile __global uint* groupSums, uint N, __global uint* groupsDone, __local uint* localBlock)
+{
+	int LID = get_local_id(0);
+	int numOfThreads = get_local_size(0);
+	int numGroups = get_num_groups(0);
+	__local int isLastGroup;
+
+	// every work-item adds up a strided range first (like LoadMax)
+	uint workItemSum = 0;
+	for (uint i = get_global_id(0); i < N; i += get_global_size(0))
+		workItemSum += inArray[i];
+	localBlock[ LID ] = workItemSum;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int stride = numOfThreads >> 1; stride > 0; stride >>= 1) {
+		if (LID < stride)
+			localBlock[ LID ] += localBlock[ LID + stride ];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (LID == 0) {
+		groupSums[ get_group_id(0) ] = localBlock[ 0 ];
+		// the sum has to be visible to the other groups before this group counts as done
+		mem_fence(CLK_GLOBAL_MEM_FENCE);
+		isLastGroup = (atomic_inc(groupsDone) == numGroups - 1);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (!isLastGroup)
+		return;
+
+	// the last group adds up the sums of all groups (volatile, so they are read from memory)
+	workItemSum = 0;
+	for (int i = LID; i < numGroups; i += numOfThreads)
+		workItemSum += groupSums[ i ];
+	localBlock[ LID ] = workItemSum;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int stride = numOfThreads >> 1; stride > 0; stride >>= 1) {
+		if (LID < stride)
+			localBlock[ LID ] += localBlock[ LID + stride ];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (LID == 0) {
+		groupSums[ 0 ] = localBlock[ 0 ];
+		// ready for the next launch
+		*groupsDone = 0;
+	}
+}
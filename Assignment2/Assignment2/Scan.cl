@@ -18,12 +18,19 @@ __kernel void Scan_Naive(const __global uint* inArray, __global uint* outArray,
 // Why did we not have conflicts in the Reduction? Because of the sequential addressing (here we use interleaved => we have conflicts).
 
 #define UNROLL
+// the host passes the values of the device (see CDeviceCaps::GetBuildOptions()), these are the defaults
+#ifndef NUM_BANKS
 #define NUM_BANKS			32
 #define NUM_BANKS_LOG		5
+#endif
+#ifndef SIMD_GROUP_SIZE
 #define SIMD_GROUP_SIZE		32
+#endif
 
-// Bank conflicts
+// Bank conflicts, not if the local memory has no banks
+#if NUM_BANKS > 0
 #define AVOID_BANK_CONFLICTS
+#endif
 #ifdef AVOID_BANK_CONFLICTS
 	// TO DO: define your conflict-free macro here
 	#define OFFSET(A) (((A)/NUM_BANKS + (A)))
@@ -134,4 +141,117 @@ __kernel void Scan_WorkEfficientAdd(__global uint* higherLevelArray, __global ui
 		array[subArrayStart + LID] += group_pps;
 		array[subArrayStart + local_size + LID] += group_pps;
 	}
-}
\ No newline at end of file
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Single-pass scan with decoupled look-back (Merrill & Garland): every element is read and written once.
+
+// elements per work-item, a tile has get_local_size(0) * LOOKBACK_ITEMS elements
+#ifndef LOOKBACK_ITEMS
+#define LOOKBACK_ITEMS		8
+#endif
+
+// the values of a tile have to be visible device wide before its flag. OpenCL C 2.0 has fences with
+// device scope, on older devices the host only uses this kernel if mem_fence() orders device wide.
+#ifdef LOOKBACK_CL20
+	#define RELEASE_FENCE()	atomic_work_item_fence(CLK_GLOBAL_MEM_FENCE, memory_order_release, memory_scope_device)
+	#define ACQUIRE_FENCE()	atomic_work_item_fence(CLK_GLOBAL_MEM_FENCE, memory_order_acquire, memory_scope_device)
+#else
+	#define RELEASE_FENCE()	mem_fence(CLK_GLOBAL_MEM_FENCE)
+	#define ACQUIRE_FENCE()	mem_fence(CLK_GLOBAL_MEM_FENCE)
+#endif
+
+// state in the lower 2 bits of a tile flag, the upper bits hold the epoch of the run which wrote it.
+// Flags of an older run count as not published, so they need not be cleared between runs.
+#define TILE_AGGREGATE		1
+#define TILE_PREFIX			2
+
+__kernel void Scan_DecoupledLookBack(const __global uint* inArray, __global uint* outArray, uint N,
+	volatile __global uint* tileFlags, volatile __global uint* tileValues, volatile __global uint* tileCounter,
+	uint epoch, __local uint* localBlock, __local uint* threadSums)
+{
+	int LID = get_local_id(0);
+	int local_size = get_local_size(0);
+	__local uint tile;
+	__local uint tilePrefix;
+
+	// tiles are numbered in the order the groups start, so a group only waits for groups which are already running
+	if (LID == 0) tile = atomic_inc(tileCounter);
+	barrier(CLK_LOCAL_MEM_FENCE);
+	uint myTile = tile;
+	uint tileStart = myTile * local_size * LOOKBACK_ITEMS;
+
+	// coalesced load of the tile (it is read completely before anything is written, so the scan works in-place)
+	for (int k = 0; k < LOOKBACK_ITEMS; k++) {
+		uint i = k * local_size + LID;
+		localBlock[i] = tileStart + i < N ? inArray[tileStart + i] : 0;
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// each work-item scans its consecutive elements
+	uint sum = 0;
+	for (int k = 0; k < LOOKBACK_ITEMS; k++) {
+		sum += localBlock[LID * LOOKBACK_ITEMS + k];
+		localBlock[LID * LOOKBACK_ITEMS + k] = sum;
+	}
+	threadSums[LID] = sum;
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// inclusive scan of the sums of the work-items
+	for (int offset = 1; offset < local_size; offset <<= 1) {
+		uint add = LID >= offset ? threadSums[LID - offset] : 0;
+		barrier(CLK_LOCAL_MEM_FENCE);
+		threadSums[LID] += add;
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	// publish the aggregate of the tile, then sum up the tiles before it until one with a prefix
+	// tileValues[2*t] is the aggregate of tile t, tileValues[2*t + 1] its inclusive prefix
+	if (LID == 0) {
+		uint aggregate = threadSums[local_size - 1];
+		uint exclusive = 0;
+		if (myTile == 0) {
+			tileValues[1] = aggregate;
+			RELEASE_FENCE();
+			atomic_xchg(&tileFlags[0], (epoch << 2) | TILE_PREFIX);
+		} else {
+			tileValues[2 * myTile] = aggregate;
+			RELEASE_FENCE();
+			atomic_xchg(&tileFlags[myTile], (epoch << 2) | TILE_AGGREGATE);
+
+			int predecessor = myTile - 1;
+			while (true) {
+				uint flag = atomic_or(&tileFlags[predecessor], 0);
+				if ((flag >> 2) != epoch)
+					continue;			// not published yet
+				ACQUIRE_FENCE();
+				if ((flag & 3) == TILE_PREFIX) {
+					exclusive += tileValues[2 * predecessor + 1];
+					break;
+				}
+				exclusive += tileValues[2 * predecessor];
+				predecessor--;
+			}
+
+			tileValues[2 * myTile + 1] = exclusive + aggregate;
+			RELEASE_FENCE();
+			atomic_xchg(&tileFlags[myTile], (epoch << 2) | TILE_PREFIX);
+		}
+		tilePrefix = exclusive;
+
+		// all tiles have been taken when the last one starts, ready for the next run
+		if (myTile == get_num_groups(0) - 1)
+			atomic_xchg(tileCounter, 0);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// coalesced store: element + sum of the work-items before its owner + sum of the tiles before
+	uint prefix = tilePrefix;
+	for (int k = 0; k < LOOKBACK_ITEMS; k++) {
+		uint i = k * local_size + LID;
+		uint owner = i / LOOKBACK_ITEMS;
+		if (tileStart + i < N)
+			outArray[tileStart + i] = localBlock[i] + (owner > 0 ? threadSums[owner - 1] : 0) + prefix;
+	}
+}
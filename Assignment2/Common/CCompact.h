@@ -0,0 +1,125 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CCOMPACT_H
+#define _CCOMPACT_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include "CScan.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+//! Stream compaction: copies the selected elements of a device array to the front of another one
+/*!
+	The elements are selected by a flag per element (1 keeps it, 0 drops it) or by a predicate,
+	an OpenCL expression of the element x, e.g. "x > 0.5f". The inclusive prefix sum of the flags
+	(Scan() of CScan.h) gives every kept element its position. The scatter kernel copies the
+	elements in words of up to 16 bytes, so elements of any size (e.g. structs) can be compacted
+	with flags. The kept elements stay in their order.
+
+	The number of kept elements is written by the scatter kernel to CountBuffer (one cl_uint),
+	so it can be used by later kernels without waiting for the host. If pCount is not nullptr,
+	it is also read with a non-blocking read on the same queue, it is valid after the next
+	clFinish() or blocking call.
+
+	Usage:
+	V_RETURN_CL(Compact(CommandQueue, m_dParticles, m_dAlive, m_dOutput, n, sizeof(Particle), m_dCount), "...");
+	V_RETURN_CL(Compact<cl_float>(CommandQueue, m_dInput, m_dOutput, n, "x > 0.5f", nullptr, &m_Count), "...");
+
+	The calls do not block, the queue has to be in-order. Input and Output must not overlap.
+*/
+class CCompact
+{
+public:
+	//! Compacts Count elements of ElementSize bytes, selected by Flags or (if Flags is nullptr) by Predicate on elements of type TypeName
+	static cl_int Run(cl_command_queue Queue, cl_mem Input, cl_mem Flags, cl_mem Output, size_t Count, size_t ElementSize,
+		const char* TypeName, const std::string& Predicate, cl_mem CountBuffer, cl_uint* pCount);
+
+	//! Releases the cached kernels and buffers of the given context (or of all contexts if nullptr)
+	static void ReleaseKernels(cl_context Context = nullptr);
+
+protected:
+	//! Kernels and temporary buffers of one variant on one queue
+	struct Entry
+	{
+		cl_context		Context;
+		//! only built for predicates
+		cl_kernel		FlagsKernel;
+		cl_kernel		ScatterKernel;
+		//! the flags computed by the predicate and the scanned flags, with their number of elements
+		cl_mem			Flags;
+		cl_mem			Positions;
+		size_t			Capacity;
+		//! receives the count if the caller has no buffer for it
+		cl_mem			Count;
+	};
+
+	//! Returns the cached entry, building it if necessary. The mutex has to be locked.
+	static Entry* GetEntry(cl_command_queue Queue, size_t ElementSize, const char* TypeName, const std::string& Predicate);
+
+	//! Makes sure the temporary buffers can hold Count elements
+	static cl_int Reserve(Entry& E, size_t Count);
+
+	static void ReleaseEntry(Entry& E);
+
+	static std::mutex											s_Mutex;
+	//! the temporary buffers are used by the enqueued kernels, so each queue has its own entries
+	static std::map<std::pair<cl_command_queue, std::string>, Entry>	s_Entries;
+};
+
+//! Compacts Count elements of ElementSize bytes of Input, keeping those whose cl_uint flag is 1
+inline cl_int Compact(cl_command_queue Queue, cl_mem Input, cl_mem Flags, cl_mem Output, size_t Count, size_t ElementSize,
+	cl_mem CountBuffer, cl_uint* pCount = nullptr)
+{
+	return CCompact::Run(Queue, Input, Flags, Output, Count, ElementSize, nullptr, "", CountBuffer, pCount);
+}
+
+//! Compacts Count elements of type T (see ScanType), keeping those for which the expression Predicate of x is true
+template<class T>
+cl_int Compact(cl_command_queue Queue, cl_mem Input, cl_mem Output, size_t Count, const std::string& Predicate,
+	cl_mem CountBuffer, cl_uint* pCount = nullptr)
+{
+	return CCompact::Run(Queue, Input, nullptr, Output, Count, sizeof(T), ScanType<T>::Name(), Predicate, CountBuffer, pCount);
+}
+
+//! Host version of Compact(), returns the number of kept elements
+template<class T, class F>
+size_t CompactHost(const T* pInput, T* pOutput, size_t Count, F Keep)
+{
+	size_t n = 0;
+	for(size_t i = 0; i < Count; i++)
+	{
+		if(Keep(pInput[i], i))
+			pOutput[n++] = pInput[i];
+	}
+	return n;
+}
+
+#endif // _CCOMPACT_H
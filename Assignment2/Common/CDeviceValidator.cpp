@@ -0,0 +1,196 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CDeviceValidator.h"
+
+#include "CLUtil.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CDeviceValidator
+
+bool CDeviceValidator::s_Enabled = false;
+
+// the comparison runs in a grid-stride loop over at most this many work-items,
+// so the atomics at the end of a work-item stay cheap
+static const size_t c_MaxLocalWorkSize = 256;
+static const size_t c_MaxWorkItems = 256 * 256;
+
+static const cl_uint c_InitialStatistics[3] = { 0, 0xFFFFFFFF, 0 };
+
+CDeviceValidator::CDeviceValidator()
+	: m_Count(0), m_Tolerance(0), m_dGolden(NULL), m_dStatistics(NULL), m_CompareKernel(NULL), m_ClearKernel(NULL),
+	m_CompareLocalWorkSize(1), m_ClearLocalWorkSize(1)
+{
+}
+
+CDeviceValidator::~CDeviceValidator()
+{
+	Release();
+}
+
+void CDeviceValidator::SetEnabled(bool Enabled)
+{
+	s_Enabled = Enabled;
+}
+
+size_t CDeviceValidator::GetLocalWorkSize(cl_kernel Kernel, cl_device_id Device)
+{
+	// a power of two, so c_MaxWorkItems stays a multiple of it
+	size_t kernelMax = 1;
+	clGetKernelWorkGroupInfo(Kernel, Device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernelMax), &kernelMax, NULL);
+	size_t localWorkSize = c_MaxLocalWorkSize;
+	while(localWorkSize > 1 && localWorkSize > kernelMax)
+		localWorkSize /= 2;
+	return localWorkSize;
+}
+
+string CDeviceValidator::GetSource(const char* TypeName)
+{
+	ostringstream source;
+	source << "typedef " << TypeName << " T;\n"
+		"\n"
+		"__kernel void CompareResults(__global const T* result, __global const T* golden, uint n, float tolerance,\n"
+		"\t__global uint* statistics)\n"
+		"{\n"
+		"\tuint mismatches = 0, first = 0xFFFFFFFF;\n"
+		"\tfloat maxError = 0;\n"
+		"\tfor(uint i = get_global_id(0); i < n; i += get_global_size(0)) {\n"
+		"\t\tT r = result[i], g = golden[i];\n"
+		"\t\tfloat error = (float)(r > g ? r - g : g - r);\n"
+		"\t\t// integers are compared exactly, also above 2^24 where the float error is rounded\n"
+		"\t\tbool mismatch = tolerance > 0 ? !(error <= tolerance) : (r != g);\n"
+		"\t\tif(mismatch) {\n"
+		"\t\t\tmismatches++;\n"
+		"\t\t\tfirst = min(first, i);\n"
+		"\t\t}\n"
+		"\t\tmaxError = fmax(maxError, error);\n"
+		"\t}\n"
+		"\tif(mismatches > 0) {\n"
+		"\t\tatomic_add(&statistics[0], mismatches);\n"
+		"\t\tatomic_min(&statistics[1], first);\n"
+		"\t}\n"
+		"\t// the bits of non-negative floats are ordered like their values\n"
+		"\tif(maxError > 0)\n"
+		"\t\tatomic_max(&statistics[2], as_uint(maxError));\n"
+		"}\n"
+		"\n"
+		"__kernel void ClearResults(__global T* result, uint n)\n"
+		"{\n"
+		"\tfor(uint i = get_global_id(0); i < n; i += get_global_size(0))\n"
+		"\t\tresult[i] = 0;\n"
+		"}\n";
+	return source.str();
+}
+
+bool CDeviceValidator::SetGolden(cl_command_queue Queue, const char* TypeName, size_t ElementSize, const void* pGolden, size_t Count, float Tolerance)
+{
+	Release();
+
+	cl_context context;
+	cl_device_id device;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+
+	cl_program program = CLUtil::BuildCLProgramFromMemory(device, context, GetSource(TypeName));
+	if(program == nullptr)
+		return false;
+
+	cl_int clError, clError2;
+	m_CompareKernel = clCreateKernel(program, "CompareResults", &clError2);
+	clError = clError2;
+	m_ClearKernel = clCreateKernel(program, "ClearResults", &clError2);
+	clError |= clError2;
+	clReleaseProgram(program);
+	V_RETURN_FALSE_CL(clError, "Failed to create the validation kernels");
+	m_CompareLocalWorkSize = GetLocalWorkSize(m_CompareKernel, device);
+	m_ClearLocalWorkSize = GetLocalWorkSize(m_ClearKernel, device);
+
+	m_dGolden = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, ElementSize * max<size_t>(Count, 1), (void*)pGolden, &clError2);
+	clError = clError2;
+	m_dStatistics = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(c_InitialStatistics), NULL, &clError2);
+	clError |= clError2;
+	V_RETURN_FALSE_CL(clError, "Failed to create the validation buffers");
+
+	m_Count = Count;
+	m_Tolerance = Tolerance;
+	return true;
+}
+
+cl_int CDeviceValidator::Compare(cl_command_queue Queue, cl_mem Buffer, Result& R)
+{
+	R.Mismatches = 0;
+	R.FirstMismatch = 0;
+	R.MaxAbsError = 0;
+	if(m_CompareKernel == nullptr)
+		return CL_INVALID_KERNEL;
+
+	cl_uint count = (cl_uint)m_Count;
+	cl_int clError = clEnqueueWriteBuffer(Queue, m_dStatistics, CL_FALSE, 0, sizeof(c_InitialStatistics), c_InitialStatistics, 0, NULL, NULL);
+	clError |= clSetKernelArg(m_CompareKernel, 0, sizeof(cl_mem), &Buffer);
+	clError |= clSetKernelArg(m_CompareKernel, 1, sizeof(cl_mem), &m_dGolden);
+	clError |= clSetKernelArg(m_CompareKernel, 2, sizeof(cl_uint), &count);
+	clError |= clSetKernelArg(m_CompareKernel, 3, sizeof(cl_float), &m_Tolerance);
+	clError |= clSetKernelArg(m_CompareKernel, 4, sizeof(cl_mem), &m_dStatistics);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	size_t localWorkSize = m_CompareLocalWorkSize;
+	size_t globalWorkSize = min(CLUtil::GetGlobalWorkSize(max<size_t>(m_Count, 1), localWorkSize), c_MaxWorkItems);
+	clError = clEnqueueNDRangeKernel(Queue, m_CompareKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	cl_uint statistics[3];
+	clError = clEnqueueReadBuffer(Queue, m_dStatistics, CL_TRUE, 0, sizeof(statistics), statistics, 0, NULL, NULL);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	R.Mismatches = statistics[0];
+	R.FirstMismatch = statistics[0] > 0 ? statistics[1] : 0;
+	memcpy(&R.MaxAbsError, &statistics[2], sizeof(float));
+	return CL_SUCCESS;
+}
+
+cl_int CDeviceValidator::Clear(cl_command_queue Queue, cl_mem Buffer)
+{
+	if(m_ClearKernel == nullptr)
+		return CL_INVALID_KERNEL;
+
+	cl_uint count = (cl_uint)m_Count;
+	cl_int clError = clSetKernelArg(m_ClearKernel, 0, sizeof(cl_mem), &Buffer);
+	clError |= clSetKernelArg(m_ClearKernel, 1, sizeof(cl_uint), &count);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	size_t localWorkSize = m_ClearLocalWorkSize;
+	size_t globalWorkSize = min(CLUtil::GetGlobalWorkSize(max<size_t>(m_Count, 1), localWorkSize), c_MaxWorkItems);
+	return clEnqueueNDRangeKernel(Queue, m_ClearKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+}
+
+void CDeviceValidator::PrintResult(const std::string& Name, const Result& R)
+{
+	if(R.IsValid())
+		return;
+	cout<<Name<<": "<<R.Mismatches<<" elements differ, the first one at index "<<R.FirstMismatch
+		<<", largest absolute error "<<R.MaxAbsError<<endl;
+}
+
+void CDeviceValidator::Release()
+{
+	SAFE_RELEASE_KERNEL(m_CompareKernel);
+	SAFE_RELEASE_KERNEL(m_ClearKernel);
+	SAFE_RELEASE_MEMOBJECT(m_dGolden);
+	SAFE_RELEASE_MEMOBJECT(m_dStatistics);
+	m_Count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
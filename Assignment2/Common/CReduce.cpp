@@ -0,0 +1,317 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CReduce.h"
+
+#include "CLUtil.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CReduction
+
+std::mutex CReduction::s_Mutex;
+std::map<std::pair<cl_context, std::string>, CReduction::Entry> CReduction::s_Entries;
+static const bool s_ReleaseHookRegistered = CLUtil::RegisterReleaseHook(&CReduction::ReleaseKernels);
+
+// elements accumulated by a work-item before the tree, and the maximum number of
+// work-groups (and so of group results for the second pass)
+static const size_t c_ElementsPerItem = 16;
+static const size_t c_MaxGroups = 1024;
+static const size_t c_MaxLocalSize = 256;
+
+static const char* c_OpMacros[NUM_REDUCE_OPS] = {
+	"OP_SUM", "OP_MIN", "OP_MAX", "OP_PRODUCT", "OP_ARGMIN", "OP_ARGMAX"
+};
+
+static const char* c_OpNames[NUM_REDUCE_OPS] = {
+	"sum", "min", "max", "product", "argmin", "argmax"
+};
+
+// specialized by -D options: T, one of the OP_* macros, T_LOWEST, T_HIGHEST, LOCAL_SIZE
+// and optionally USE_ATOMICS and USE_FP64
+static const char* c_ReduceSource =
+	"#ifdef USE_FP64\n"
+	"#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+	"#endif\n"
+	"\n"
+	"#if defined(OP_ARGMIN) || defined(OP_ARGMAX)\n"
+	"#define WITH_INDEX\n"
+	"#endif\n"
+	"\n"
+	"#if defined(OP_SUM)\n"
+	"#define IDENTITY ((T)0)\n"
+	"#define COMBINE(a, b) ((a) + (b))\n"
+	"#define ATOMIC_COMBINE atomic_add\n"
+	"#elif defined(OP_PRODUCT)\n"
+	"#define IDENTITY ((T)1)\n"
+	"#define COMBINE(a, b) ((a) * (b))\n"
+	"#elif defined(OP_MIN) || defined(OP_ARGMIN)\n"
+	"#define IDENTITY ((T)T_HIGHEST)\n"
+	"#define BETTER(a, b) ((a) < (b))\n"
+	"#define ATOMIC_COMBINE atomic_min\n"
+	"#else\n"
+	"#define IDENTITY ((T)T_LOWEST)\n"
+	"#define BETTER(a, b) ((a) > (b))\n"
+	"#define ATOMIC_COMBINE atomic_max\n"
+	"#endif\n"
+	"\n"
+	"#ifndef COMBINE\n"
+	"#define COMBINE(a, b) (BETTER(b, a) ? (b) : (a))\n"
+	"#endif\n"
+	"\n"
+	"// combines the element (v, vi) into (acc, accIndex), of equal values the lower index wins\n"
+	"#ifdef WITH_INDEX\n"
+	"#define ACCUMULATE(acc, accIndex, v, vi) if(BETTER(v, acc) || ((v) == (acc) && (vi) < (accIndex))) { acc = (v); accIndex = (vi); }\n"
+	"#else\n"
+	"#define ACCUMULATE(acc, accIndex, v, vi) acc = COMBINE(acc, v);\n"
+	"#endif\n"
+	"\n"
+	"// LOCAL_SIZE is known at build time, so the loop can be unrolled\n"
+	"inline void ReduceGroup(__local T* values, __local uint* indices, T acc, uint accIndex)\n"
+	"{\n"
+	"\tuint LID = get_local_id(0);\n"
+	"\tvalues[LID] = acc;\n"
+	"\tindices[LID] = accIndex;\n"
+	"\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t#pragma unroll\n"
+	"\tfor(uint s = LOCAL_SIZE / 2; s > 0; s >>= 1) {\n"
+	"\t\tif(LID < s) {\n"
+	"\t\t\tACCUMULATE(values[LID], indices[LID], values[LID + s], indices[LID + s])\n"
+	"\t\t}\n"
+	"\t\tbarrier(CLK_LOCAL_MEM_FENCE);\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"__kernel __attribute__((reqd_work_group_size(LOCAL_SIZE, 1, 1)))\n"
+	"void Reduce(__global const T* input, uint n, __global T* outValues, __global uint* outIndices)\n"
+	"{\n"
+	"\t__local T values[LOCAL_SIZE];\n"
+	"\t__local uint indices[LOCAL_SIZE];\n"
+	"\n"
+	"\t// every work-item accumulates a strided range first, neighbours read neighbouring elements\n"
+	"\tT acc = IDENTITY;\n"
+	"\tuint accIndex = 0xFFFFFFFF;\n"
+	"\tfor(uint i = get_global_id(0); i < n; i += get_global_size(0)) {\n"
+	"\t\tT v = input[i];\n"
+	"\t\tACCUMULATE(acc, accIndex, v, i)\n"
+	"\t}\n"
+	"\tReduceGroup(values, indices, acc, accIndex);\n"
+	"\n"
+	"\tif(get_local_id(0) == 0) {\n"
+	"#ifdef USE_ATOMICS\n"
+	"\t\tATOMIC_COMBINE(outValues, values[0]);\n"
+	"#else\n"
+	"\t\toutValues[get_group_id(0)] = values[0];\n"
+	"\t\toutIndices[get_group_id(0)] = indices[0];\n"
+	"#endif\n"
+	"\t}\n"
+	"}\n"
+	"\n"
+	"// second pass with a single work-group over the results of the groups\n"
+	"__kernel __attribute__((reqd_work_group_size(LOCAL_SIZE, 1, 1)))\n"
+	"void ReduceFinal(__global const T* inValues, __global const uint* inIndices, uint n, __global T* outValues, __global uint* outIndices)\n"
+	"{\n"
+	"\t__local T values[LOCAL_SIZE];\n"
+	"\t__local uint indices[LOCAL_SIZE];\n"
+	"\n"
+	"\tT acc = IDENTITY;\n"
+	"\tuint accIndex = 0xFFFFFFFF;\n"
+	"\tfor(uint i = get_local_id(0); i < n; i += LOCAL_SIZE) {\n"
+	"\t\tT v = inValues[i];\n"
+	"\t\tACCUMULATE(acc, accIndex, v, inIndices[i])\n"
+	"\t}\n"
+	"\tReduceGroup(values, indices, acc, accIndex);\n"
+	"\n"
+	"\tif(get_local_id(0) == 0) {\n"
+	"\t\toutValues[0] = values[0];\n"
+	"\t\toutIndices[0] = indices[0];\n"
+	"\t}\n"
+	"}\n";
+
+bool CReduction::SupportsDouble(cl_device_id Device)
+{
+	size_t size = 0;
+	clGetDeviceInfo(Device, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+	vector<char> extensions(size + 1, 0);
+	clGetDeviceInfo(Device, CL_DEVICE_EXTENSIONS, size, extensions.data(), NULL);
+	return string(extensions.data()).find("cl_khr_fp64") != string::npos;
+}
+
+const char* CReduction::GetOpName(EReduceOp Op)
+{
+	return (Op >= 0 && Op < NUM_REDUCE_OPS) ? c_OpNames[Op] : "unknown";
+}
+
+CReduction::Entry* CReduction::GetEntry(cl_command_queue Queue, EReduceOp Op, const TypeInfo& Type)
+{
+	cl_context context;
+	cl_device_id device;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+
+	bool fp64 = string(Type.Name) == "double";
+	if(fp64 && !SupportsDouble(device))
+	{
+		cerr<<"Error: the device does not support double precision (cl_khr_fp64)."<<endl;
+		return nullptr;
+	}
+
+	// the largest power of two the device allows as local size
+	size_t maxLocalSize = 1;
+	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxLocalSize), &maxLocalSize, NULL);
+	size_t localSize = 1;
+	while(localSize * 2 <= min(maxLocalSize, c_MaxLocalSize))
+		localSize *= 2;
+
+	bool atomics = Type.Atomics && (Op == REDUCE_SUM || Op == REDUCE_MIN || Op == REDUCE_MAX);
+
+	ostringstream options;
+	options<<"-D T="<<Type.Name<<" -D "<<c_OpMacros[Op]<<" -D T_LOWEST="<<Type.Lowest<<" -D T_HIGHEST="<<Type.Highest
+		<<" -D LOCAL_SIZE="<<localSize;
+	if(atomics)
+		options<<" -D USE_ATOMICS";
+	if(fp64)
+		options<<" -D USE_FP64";
+
+	Entry& entry = s_Entries[make_pair(context, options.str())];
+	if(entry.ReduceKernel != nullptr)
+		return &entry;
+
+	cl_program program = CLUtil::BuildCLProgramFromMemory(device, context, c_ReduceSource, options.str());
+	if(program == nullptr)
+	{
+		s_Entries.erase(make_pair(context, options.str()));
+		return nullptr;
+	}
+
+	cl_int clError, clError2;
+	entry.ReduceKernel = clCreateKernel(program, "Reduce", &clError2);
+	clError = clError2;
+	entry.FinalKernel = clCreateKernel(program, "ReduceFinal", &clError2);
+	clError |= clError2;
+	// the kernels keep the program alive
+	clReleaseProgram(program);
+
+	entry.LocalSize = localSize;
+	entry.Partials = clCreateBuffer(context, CL_MEM_READ_WRITE, Type.Size * c_MaxGroups, NULL, &clError2);
+	clError |= clError2;
+	entry.PartialIndices = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint) * c_MaxGroups, NULL, &clError2);
+	clError |= clError2;
+	entry.Result = clCreateBuffer(context, CL_MEM_READ_WRITE, Type.Size, NULL, &clError2);
+	clError |= clError2;
+	entry.ResultIndex = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &clError2);
+	clError |= clError2;
+
+	if(clError != CL_SUCCESS)
+	{
+		cerr<<"Error: failed to create the reduction kernels ["<<CLUtil::GetCLErrorString(clError)<<"]"<<endl;
+		ReleaseEntry(entry);
+		s_Entries.erase(make_pair(context, options.str()));
+		return nullptr;
+	}
+	return &entry;
+}
+
+cl_int CReduction::Run(cl_command_queue Queue, cl_mem Input, size_t Count, EReduceOp Op, const TypeInfo& Type,
+	const void* pIdentity, void* pValue, size_t* pIndex)
+{
+	*pIndex = 0;
+	if(Count == 0)
+	{
+		memcpy(pValue, pIdentity, Type.Size);
+		return CL_SUCCESS;
+	}
+
+	// the scratch buffers of an entry are shared by all calls
+	lock_guard<mutex> lock(s_Mutex);
+	Entry* pEntry = GetEntry(Queue, Op, Type);
+	if(pEntry == nullptr)
+		return CL_BUILD_PROGRAM_FAILURE;
+
+	bool atomics = Type.Atomics && (Op == REDUCE_SUM || Op == REDUCE_MIN || Op == REDUCE_MAX);
+	size_t localSize = pEntry->LocalSize;
+	size_t numGroups = min((Count + localSize * c_ElementsPerItem - 1) / (localSize * c_ElementsPerItem), c_MaxGroups);
+	// a single group can write the result directly
+	bool singlePass = atomics || numGroups == 1;
+
+	cl_int clError = CL_SUCCESS;
+	if(atomics)
+		clError = clEnqueueWriteBuffer(Queue, pEntry->Result, CL_TRUE, 0, Type.Size, pIdentity, 0, NULL, NULL);
+
+	cl_uint n = (cl_uint)Count;
+	cl_mem values = singlePass ? pEntry->Result : pEntry->Partials;
+	cl_mem indices = singlePass ? pEntry->ResultIndex : pEntry->PartialIndices;
+	clError |= clSetKernelArg(pEntry->ReduceKernel, 0, sizeof(cl_mem), &Input);
+	clError |= clSetKernelArg(pEntry->ReduceKernel, 1, sizeof(cl_uint), &n);
+	clError |= clSetKernelArg(pEntry->ReduceKernel, 2, sizeof(cl_mem), &values);
+	clError |= clSetKernelArg(pEntry->ReduceKernel, 3, sizeof(cl_mem), &indices);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	size_t globalWorkSize = numGroups * localSize;
+	clError = clEnqueueNDRangeKernel(Queue, pEntry->ReduceKernel, 1, NULL, &globalWorkSize, &localSize, 0, NULL, NULL);
+	if(clError != CL_SUCCESS)
+		return clError;
+
+	if(!singlePass)
+	{
+		cl_uint numPartials = (cl_uint)numGroups;
+		clError = clSetKernelArg(pEntry->FinalKernel, 0, sizeof(cl_mem), &pEntry->Partials);
+		clError |= clSetKernelArg(pEntry->FinalKernel, 1, sizeof(cl_mem), &pEntry->PartialIndices);
+		clError |= clSetKernelArg(pEntry->FinalKernel, 2, sizeof(cl_uint), &numPartials);
+		clError |= clSetKernelArg(pEntry->FinalKernel, 3, sizeof(cl_mem), &pEntry->Result);
+		clError |= clSetKernelArg(pEntry->FinalKernel, 4, sizeof(cl_mem), &pEntry->ResultIndex);
+		if(clError != CL_SUCCESS)
+			return clError;
+
+		clError = clEnqueueNDRangeKernel(Queue, pEntry->FinalKernel, 1, NULL, &localSize, &localSize, 0, NULL, NULL);
+		if(clError != CL_SUCCESS)
+			return clError;
+	}
+
+	bool withIndex = (Op == REDUCE_ARGMIN || Op == REDUCE_ARGMAX);
+	clError = clEnqueueReadBuffer(Queue, pEntry->Result, withIndex ? CL_FALSE : CL_TRUE, 0, Type.Size, pValue, 0, NULL, NULL);
+	if(clError != CL_SUCCESS || !withIndex)
+		return clError;
+
+	cl_uint index = 0;
+	clError = clEnqueueReadBuffer(Queue, pEntry->ResultIndex, CL_TRUE, 0, sizeof(cl_uint), &index, 0, NULL, NULL);
+	*pIndex = index;
+	return clError;
+}
+
+void CReduction::ReleaseEntry(Entry& E)
+{
+	SAFE_RELEASE_KERNEL(E.ReduceKernel);
+	SAFE_RELEASE_KERNEL(E.FinalKernel);
+	SAFE_RELEASE_MEMOBJECT(E.Partials);
+	SAFE_RELEASE_MEMOBJECT(E.PartialIndices);
+	SAFE_RELEASE_MEMOBJECT(E.Result);
+	SAFE_RELEASE_MEMOBJECT(E.ResultIndex);
+}
+
+void CReduction::ReleaseKernels(cl_context Context)
+{
+	lock_guard<mutex> lock(s_Mutex);
+	for(auto it = s_Entries.begin(); it != s_Entries.end(); )
+	{
+		if(Context == nullptr || it->first.first == Context)
+		{
+			ReleaseEntry(it->second);
+			it = s_Entries.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
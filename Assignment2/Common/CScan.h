@@ -0,0 +1,192 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CSCAN_H
+#define _CSCAN_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Prefix sums (and scans with other operators) of device arrays of any length
+/*!
+	Scan() writes the inclusive or exclusive prefix sums of Count uints to Output, Count does not
+	have to be a multiple of anything and may exceed 2^32 (the kernels use 64 bit offsets).
+	SegmentedScan() restarts the sum at every element whose head flag is not 0.
+
+	Scan<T>() scans other element types (see ScanType) with any associative operator, given as
+	OpenCL code (see ScanOperator). The operator does not have to be commutative.
+
+	Each work-group scans a tile of LOCAL_SIZE * ITEMS elements and writes the tile's sum
+	(and for segmented scans whether the tile contains a head) to the next level, which is
+	scanned the same way until one tile is left. Then the scanned tile sums are added to the
+	tiles below. The kernels are compiled once per queue and variant and then taken from a
+	cache (see CScan), like the reductions of CReduce.h.
+
+	Usage:
+	V_RETURN_CL(Scan(CommandQueue, m_dInput, m_dOutput, n, SCAN_EXCLUSIVE), "...");
+	V_RETURN_CL(Scan<cl_float>(CommandQueue, m_dInput, m_dOutput, n, ScanMax<cl_float>()), "...");
+
+	The calls do not block, the queue has to be in-order. Input and Output may be the same buffer.
+*/
+enum EScanMode
+{
+	SCAN_INCLUSIVE,
+	SCAN_EXCLUSIVE
+};
+
+//! An associative operator of scans
+/*!
+	Combine is an OpenCL expression of the earlier operand a and the later operand b of type T,
+	Identity the neutral element, e.g. "max(a, b)" and "-INFINITY" for running maxima. The
+	composition of affine maps x -> x * s + o, stored as float2 (s, o), solves linear recurrences:
+	"(float2)(a.x * b.x, a.y * b.x + b.y)" with identity "(float2)(1.0f, 0.0f)".
+*/
+struct ScanOperator
+{
+	std::string	Name;
+	std::string	Combine;
+	std::string	Identity;
+};
+
+//! OpenCL name and limits of an element type of scans
+template<class T> struct ScanType;
+template<> struct ScanType<cl_int> { static const char* Name() { return "int"; } static const char* Lowest() { return "INT_MIN"; } static const char* Highest() { return "INT_MAX"; } };
+template<> struct ScanType<cl_uint> { static const char* Name() { return "uint"; } static const char* Lowest() { return "0"; } static const char* Highest() { return "UINT_MAX"; } };
+template<> struct ScanType<cl_long> { static const char* Name() { return "long"; } static const char* Lowest() { return "LONG_MIN"; } static const char* Highest() { return "LONG_MAX"; } };
+template<> struct ScanType<cl_float> { static const char* Name() { return "float"; } static const char* Lowest() { return "-INFINITY"; } static const char* Highest() { return "INFINITY"; } };
+template<> struct ScanType<cl_float2> { static const char* Name() { return "float2"; } static const char* Lowest() { return "-INFINITY"; } static const char* Highest() { return "INFINITY"; } };
+template<> struct ScanType<cl_float4> { static const char* Name() { return "float4"; } static const char* Lowest() { return "-INFINITY"; } static const char* Highest() { return "INFINITY"; } };
+
+//! The operators of sums, minima and maxima (component-wise for vector types)
+template<class T> ScanOperator ScanSum() { ScanOperator op = { "sum", "a + b", "0" }; return op; }
+template<class T> ScanOperator ScanMin() { ScanOperator op = { "min", "min(a, b)", ScanType<T>::Highest() }; return op; }
+template<class T> ScanOperator ScanMax() { ScanOperator op = { "max", "max(a, b)", ScanType<T>::Lowest() }; return op; }
+
+//! Builds, caches and launches the scan kernels (see Scan())
+class CScan
+{
+public:
+	//! Description of the element type for Run()
+	struct TypeInfo
+	{
+		const char*	Name;
+		size_t		Size;
+	};
+
+	//! Scans Count elements of Input to Output, HeadFlags (one cl_uint per element) selects a segmented scan if not nullptr
+	static cl_int Run(cl_command_queue Queue, cl_mem Input, cl_mem Output, size_t Count, EScanMode Mode, cl_mem HeadFlags,
+		const TypeInfo& Type, const ScanOperator& Op);
+
+	static const char* GetModeName(EScanMode Mode);
+
+	//! Releases the cached kernels and buffers of the given context (or of all contexts if nullptr)
+	static void ReleaseKernels(cl_context Context = nullptr);
+
+protected:
+	//! Kernels and the level buffers of one variant on one queue
+	struct Entry
+	{
+		cl_context			Context;
+		cl_kernel			ScanKernel;
+		cl_kernel			CarryKernel;
+		size_t				LocalSize;
+		size_t				TileSize;
+		size_t				ElementSize;
+		//! tile sums and tile flags of each level, LevelCapacity is their number of elements
+		std::vector<cl_mem>	LevelSums;
+		std::vector<cl_mem>	LevelFlags;
+		std::vector<size_t>	LevelCapacity;
+	};
+
+	//! Defines T, IDENTITY and COMBINE() for the kernels
+	static std::string GetOperatorSource(const TypeInfo& Type, const ScanOperator& Op);
+
+	//! Returns the cached entry, building it if necessary. The mutex has to be locked.
+	static Entry* GetEntry(cl_command_queue Queue, bool Segmented, const TypeInfo& Type, const ScanOperator& Op);
+
+	//! Makes sure the level buffers can hold Count tiles on the given level
+	static cl_int ReserveLevel(Entry& E, size_t Level, size_t Count);
+
+	static void ReleaseEntry(Entry& E);
+
+	static std::mutex											s_Mutex;
+	//! the level buffers are used by the enqueued kernels, so each queue has its own entries
+	static std::map<std::pair<cl_command_queue, std::string>, Entry>	s_Entries;
+};
+
+//! Scans Count elements of type T with the operator Op
+template<class T>
+cl_int Scan(cl_command_queue Queue, cl_mem Input, cl_mem Output, size_t Count, const ScanOperator& Op, EScanMode Mode = SCAN_INCLUSIVE)
+{
+	CScan::TypeInfo type = { ScanType<T>::Name(), sizeof(T) };
+	return CScan::Run(Queue, Input, Output, Count, Mode, nullptr, type, Op);
+}
+
+template<class T>
+cl_int SegmentedScan(cl_command_queue Queue, cl_mem Input, cl_mem HeadFlags, cl_mem Output, size_t Count, const ScanOperator& Op, EScanMode Mode = SCAN_INCLUSIVE)
+{
+	CScan::TypeInfo type = { ScanType<T>::Name(), sizeof(T) };
+	return CScan::Run(Queue, Input, Output, Count, Mode, HeadFlags, type, Op);
+}
+
+//! Prefix sums of uints
+inline cl_int Scan(cl_command_queue Queue, cl_mem Input, cl_mem Output, size_t Count, EScanMode Mode = SCAN_INCLUSIVE)
+{
+	return Scan<cl_uint>(Queue, Input, Output, Count, ScanSum<cl_uint>(), Mode);
+}
+
+inline cl_int SegmentedScan(cl_command_queue Queue, cl_mem Input, cl_mem HeadFlags, cl_mem Output, size_t Count, EScanMode Mode = SCAN_INCLUSIVE)
+{
+	return SegmentedScan<cl_uint>(Queue, Input, HeadFlags, Output, Count, ScanSum<cl_uint>(), Mode);
+}
+
+//! Host version of Scan<T>(), Combine(a, b) has to do the same as the operator of the device
+template<class T, class F>
+void ScanHost(const T* pInput, T* pOutput, size_t Count, EScanMode Mode, const T& Identity, F Combine, const cl_uint* pHeadFlags = nullptr)
+{
+	T running = Identity;
+	for(size_t i = 0; i < Count; i++)
+	{
+		if(pHeadFlags && pHeadFlags[i] != 0)
+			running = Identity;
+		T inclusive = Combine(running, pInput[i]);
+		pOutput[i] = (Mode == SCAN_EXCLUSIVE) ? running : inclusive;
+		running = inclusive;
+	}
+}
+
+//! Host version of Scan() and SegmentedScan(), pInput and pOutput may be the same array
+inline void ScanHost(const cl_uint* pInput, cl_uint* pOutput, size_t Count, EScanMode Mode, const cl_uint* pHeadFlags = nullptr)
+{
+	ScanHost<cl_uint>(pInput, pOutput, Count, Mode, 0, [](cl_uint a, cl_uint b) { return a + b; }, pHeadFlags);
+}
+
+#endif // _CSCAN_H
@@ -32,11 +32,10 @@
 
 #elif defined (__APPLE__) || defined(MACOSX)
 
-#include <sys/time.h>
+#include <mach/mach_time.h>
 
 #else
 
-#include <sys/time.h>
 #include <time.h>
 
 #endif
@@ -47,14 +46,18 @@
 	Not suitable for measuring the execution of DEVICE code
 	without synchronization with the HOST.
 
-	NOTE: This class is not thread-safe (like most other classes in these
-	examples), but we are not doing CPU multithreading in the praktikum...
+	The timestamps come from a monotonic clock with nanosecond resolution
+	(QueryPerformanceCounter, mach_absolute_time or CLOCK_MONOTONIC), so intervals
+	are not affected by adjustments of the wall clock.
+
+	NOTE: A single CTimer object must not be shared between threads.
+	GetTimestamp() itself can be called from any thread.
 */
 class CTimer
 {
 public:
 
-	CTimer(){};
+	CTimer() : m_StartTime(0), m_EndTime(0) {};
 
 	~CTimer(){};
 
@@ -65,15 +68,16 @@ public:
 	//! Returns the elapsed time between Start() and Stop() in ms.
 	double GetElapsedMilliseconds();
 
+	//! Returns the elapsed time between Start() and Stop() in ns.
+	unsigned long long GetElapsedNanoseconds();
+
+	//! Current value of the monotonic clock in ns. The origin is arbitrary (usually system boot).
+	static unsigned long long GetTimestamp();
+
 protected:
 
-#ifdef WIN32
-	LARGE_INTEGER		m_StartTime;
-	LARGE_INTEGER		m_EndTime;
-#else
-	struct timeval		m_StartTime;
-	struct timeval		m_EndTime;
-#endif
+	unsigned long long	m_StartTime;
+	unsigned long long	m_EndTime;
 };
 
 #endif // _CTIMER_H
@@ -0,0 +1,143 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CTRACE_H
+#define _CTRACE_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include "CTimer.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//! Collects named time spans of the HOST threads and of the DEVICE into a single timeline
+/*!
+	Every thread records into its own ring buffer, so recording does not contend with other
+	threads. If a buffer is full, the oldest spans are overwritten.
+
+	Recording is disabled by default and is switched on with SetEnabled()
+	(see the --trace option of CAssignmentBase). WriteChromeTrace() exports everything recorded
+	so far in the Chrome trace event format, which can be opened in chrome://tracing or Perfetto.
+*/
+class CTraceRecorder
+{
+public:
+	struct Event
+	{
+		std::string		Name;
+		const char*		Category;
+		//! Timestamps in ns of the CTimer clock
+		unsigned long long	Start;
+		unsigned long long	End;
+		unsigned int	Depth;
+	};
+
+	static void SetEnabled(bool Enabled);
+
+	static bool IsEnabled() { return s_Enabled; }
+
+	//! Number of spans that are kept per thread. Only affects threads that have not recorded yet.
+	static void SetCapacity(size_t EventsPerThread);
+
+	//! Records a span of the calling HOST thread
+	static void RecordHostSpan(const std::string& Name, const char* Category,
+		unsigned long long Start, unsigned long long End, unsigned int Depth);
+
+	//! Records a span on the DEVICE timeline. The timestamps must already be in the HOST clock domain.
+	static void RecordDeviceSpan(const std::string& Name, unsigned long long Start, unsigned long long End);
+
+	//! Records the execution (start to end) of a finished profiling event
+	/*!
+		DeviceToHostOffset is added to the device timestamps to move them into the HOST clock domain.
+		It can be obtained by taking a CTimer::GetTimestamp() right before enqueueing a command
+		and subtracting the CL_PROFILING_COMMAND_QUEUED value of its event.
+	*/
+	static void RecordDeviceEvent(const std::string& Name, cl_event Event, long long DeviceToHostOffset);
+
+	//! Writes all recorded spans as Chrome trace event JSON
+	static bool WriteChromeTrace(const std::string& Path);
+
+	//! Discards all recorded spans
+	static void Clear();
+
+protected:
+	struct ThreadBuffer
+	{
+		std::mutex			Mutex;
+		std::vector<Event>	Events;
+		size_t				Next;
+		bool				Wrapped;
+		unsigned int		ThreadIndex;
+	};
+
+	static ThreadBuffer& GetThreadBuffer();
+
+	static void Push(ThreadBuffer& Buffer, Event& E);
+
+	static std::atomic<bool>	s_Enabled;
+	static size_t				s_Capacity;
+	static std::mutex			s_BuffersMutex;
+	static std::vector<std::shared_ptr<ThreadBuffer> >	s_Buffers;
+	static ThreadBuffer			s_DeviceBuffer;
+};
+
+//! Measures the lifetime of a scope and records it as a span in the CTraceRecorder
+/*!
+	Scoped timers can be nested, the trace viewer shows inner spans below their parents.
+
+	Usage:
+	{
+		CScopedTimer timer("ComputeCPU");
+		...
+	}
+
+	GetElapsedMilliseconds() can be used to print the time so far, also if tracing is disabled.
+*/
+class CScopedTimer
+{
+public:
+	CScopedTimer(const std::string& Name, const char* Category = "host");
+
+	~CScopedTimer();
+
+	double GetElapsedMilliseconds() const;
+
+protected:
+	CScopedTimer(const CScopedTimer&);
+	CScopedTimer& operator=(const CScopedTimer&);
+
+	std::string			m_Name;
+	const char*			m_Category;
+	unsigned long long	m_Start;
+	unsigned int		m_Depth;
+	bool				m_Recording;
+};
+
+#endif // _CTRACE_H
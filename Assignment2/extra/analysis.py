@@ -1,30 +1,31 @@
+import csv
+import sys
+
 import matplotlib.pyplot as plt
 
-f = open("log", 'r')
-lines = f.readlines()
-f.close()
+# results of the benchmark runner, e.g.
+#   ./Benchmark --task reduction --size 16777216 --local 64,128,256,512 --csv benchmark.csv
+path = sys.argv[1] if len(sys.argv) > 1 else "benchmark.csv"
+
+labels = ["interleavedAddressing", "sequentialAddressing", "kernelDecomposition",
+"kernelDecompositionUnroll", "kernelDecompositionAtomics"]
 
-lws="LocalWorkSize "
 d = {}
-for i in range(len(lines)):
-    if lines[i].startswith(lws):
-        size = int(lines[i][len(lws):-2])
-        metrics = []
-        for j in range(1,6):
-            metrics.append(float(lines[i+2*j].split(" ")[-2]))
-        d[size] = metrics
+with open(path, "r") as f:
+    for row in csv.DictReader(f):
+        if row["task"] != "reduction" or row["measurement"] not in labels:
+            continue
+        size = int(row["local_x"])
+        d.setdefault(size, [0.0] * len(labels))[labels.index(row["measurement"])] = float(row["gelem_per_s"])
 
 print(d)
 
-labels = ["interleavedAddressing", "sequentialAddressing", "kernelDecomposition", 
-"kernelDecompositionUnroll", "kernelDecompositionAtomics"]
-
-for size in list(d):
+for size in sorted(d):
     plt.plot(d[size], label=str(size))
 
-plt.xticks([e for e in range(5)], labels = labels, rotation=10,ha="center",
+plt.xticks([e for e in range(len(labels))], labels = labels, rotation=10,ha="center",
              rotation_mode="anchor")
-plt.ylabel="Gelem/s"
-plt.title="Different work-group sizes running the reduction approaches"
+plt.ylabel("Gelem/s")
+plt.title("Different work-group sizes running the reduction approaches")
 plt.legend()
-plt.show()
\ No newline at end of file
+plt.show()
@@ -0,0 +1,96 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "../Common/CBenchmark.h"
+
+#include "CConvolution3x3Task.h"
+#include "CConvolutionSeparableTask.h"
+#include "CConvolutionBilateralTask.h"
+#include "CHistogramTask.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Benchmark runner for the tasks of assignment 3, see CBenchmarkRunner for the options.
+// The problem size is given by the input images, so the tasks only accept the size 0.
+int main(int argc, char** argv)
+{
+	CBenchmarkRunner runner;
+
+	runner.RegisterTask("conv3x3",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			if(Case.Size != 0)
+				return nullptr;
+			size_t tileSize[2] = { Case.LocalWorkSize[0], Case.LocalWorkSize[1] };
+			float convKernel[3][3] = {
+				{ -1.0f / 8.0f, -1.0f / 8.0f, -1.0f / 8.0f },
+				{ -1.0f / 8.0f,  1.0f,        -1.0f / 8.0f },
+				{ -1.0f / 8.0f, -1.0f / 8.0f, -1.0f / 8.0f },
+			};
+			return new CConvolution3x3Task("../Assignment3/Images/input.pfm", tileSize, convKernel, true, 0.0f);
+		},
+		{ 0 }, { 16, 16, 1, 32, 8, 1, 32, 16, 1 }, { "edge" });
+
+	// the variants are the filters of CAssignment3, both passes use the local work size of the case
+	runner.RegisterTask("separable",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			if(Case.Size != 0)
+				return nullptr;
+			size_t groupSize[2] = { Case.LocalWorkSize[0], Case.LocalWorkSize[1] };
+			vector<float> convKernel;
+			int radius;
+			if(Case.Variant == "box_4x4")
+			{
+				radius = 4;
+				convKernel.assign(9, 1.0f / 9.0f);
+			}
+			else if(Case.Variant == "box_8x8")
+			{
+				radius = 8;
+				convKernel.assign(17, 1.0f / 17.0f);
+			}
+			else if(Case.Variant == "gauss_3x3")
+			{
+				radius = 3;
+				convKernel = { 0.000817774f, 0.0286433f, 0.235018f, 0.471041f, 0.235018f, 0.0286433f, 0.000817774f };
+			}
+			else
+				return nullptr;
+			return new CConvolutionSeparableTask(Case.Variant, "../Assignment3/Images/input.pfm", groupSize, groupSize,
+				4, 4, radius, convKernel.data(), convKernel.data());
+		},
+		{ 0 }, { 16, 16, 1, 32, 8, 1, 32, 16, 1 }, { "box_4x4", "box_8x8", "gauss_3x3" });
+
+	runner.RegisterTask("bilateral",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			if(Case.Size != 0)
+				return nullptr;
+			size_t groupSize[2] = { Case.LocalWorkSize[0], Case.LocalWorkSize[1] };
+			float convKernel[9] = { 0.010284844f, 0.0417071f, 0.113371652f, 0.206576619f, 0.252313252f,
+				0.206576619f, 0.113371652f, 0.0417071f, 0.010284844f };
+			return new CConvolutionBilateralTask("../Assignment3/Images/color.pfm", "../Assignment3/Images/normals.pfm",
+				"../Assignment3/Images/depth.pfm", groupSize, groupSize, 4, 4, 4, convKernel, convKernel);
+		},
+		{ 0 }, { 32, 4, 1, 32, 8, 1 });
+
+	runner.RegisterTask("histogram",
+		[](const BenchmarkCase& Case) -> IComputeTask* {
+			if(Case.Size != 0 || (Case.Variant != "global" && Case.Variant != "local"))
+				return nullptr;
+			return new CHistogramTask(0.25f, 0.26f, Case.Variant == "local", "../Assignment3/Images/input.pfm");
+		},
+		{ 0 }, { 16, 16, 1, 32, 8, 1 }, { "global", "local" });
+
+	auto success = runner.EnterMainLoop(argc, argv);
+
+#ifdef _MSC_VER
+	cout<<"Press any key..."<<endl;
+	cin.get();
+#endif
+
+	return success ? 0 : 1;
+}
@@ -6,6 +6,7 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CConvolution3x3Task.h"
 
 #include "../Common/CLUtil.h"
+#include "../Common/CThreadPool.h"
 #include "../Common/CTimer.h"
 
 using namespace std;
@@ -104,25 +105,15 @@ void CConvolution3x3Task::ComputeGPU(cl_context Context, cl_command_queue Comman
 	// is more time consuming than the previous tasks
 	const int nIterations = 1000;
 
-	//do 1 or 3 convolution steps, based on the number of color channels to process
-	unsigned int numChannels = m_Monochrome ? 1 : 3;
-
-	size_t dataSize = m_Pitch * m_Height * sizeof(cl_float);
-
-	//perform the convolution and measure the performance
-	double runTime = 0.0f;
-	for(unsigned int iChannel = 0; iChannel < numChannels; iChannel++)	
-		runTime += ConvolutionChannelGPU(iChannel, Context, CommandQueue, nIterations);
-
+	//perform the convolution of the 1 or 3 color channels as independent chains and measure the performance
+	double runTime = ProfileRunsGPU(CommandQueue, nIterations, "convolution_3x3");
+	if(runTime < 0)
+		return;
 
 	cout<<"  Average GPU time: "<<runTime<<" ms, throughput: "<< 1.0e-6 * m_Width * m_Height / runTime << " Gpixels/s" <<endl;
 
-	for(unsigned int iChannel = 0; iChannel < numChannels; iChannel++)
-	{
-		//copy the results back to the CPU
-		V_RETURN_CL( clEnqueueReadBuffer(CommandQueue, m_dResultChannels[iChannel], CL_TRUE, 0, dataSize,
-									m_hGPUResultChannels[iChannel], 0, NULL, NULL), "Error reading back results from the device!" );
-	}
+	//copy the results of the last run back to the CPU
+	V_RETURN_CL(ReadResultChannels(CommandQueue), "Error reading back results from the device!");
 
 
 	SaveImage("../Assignment3/Images/GPUResult3x3.pfm", m_hGPUResultChannels);
@@ -157,26 +148,28 @@ double CConvolution3x3Task::ConvolutionChannelCPU(unsigned int Channel)
 	for(int iter = 0; iter < nIterations; iter++)
 	{
 
-		for(unsigned int y = 0; y < m_Height; y++)
-		{
-			for(unsigned int x = 0; x < m_Width; x++)
+		CThreadPool::Get().ParallelFor(0, m_Height, 4, [&](size_t Begin, size_t End) {
+			for(unsigned int y = (unsigned int)Begin; y < (unsigned int)End; y++)
 			{
-				float value = 0;
-				//apply convolution kernel
-				for(int offsetY = -1; offsetY < 2; offsetY ++)
+				for(unsigned int x = 0; x < m_Width; x++)
 				{
-					int sy = y + offsetY;
-					if(sy >= 0 && sy < int(m_Height))
-						for(int offsetX = -1; offsetX < 2; offsetX++)
-						{
-							int sx = x + offsetX;
-							if(sx >= 0 && sx < int(m_Width))
-								value += m_hSourceChannels[Channel][sy * m_Pitch + sx] * m_hConvolutionKernel[1 + offsetY][1 + offsetX];
-						}
+					float value = 0;
+					//apply convolution kernel
+					for(int offsetY = -1; offsetY < 2; offsetY ++)
+					{
+						int sy = y + offsetY;
+						if(sy >= 0 && sy < int(m_Height))
+							for(int offsetX = -1; offsetX < 2; offsetX++)
+							{
+								int sx = x + offsetX;
+								if(sx >= 0 && sx < int(m_Width))
+									value += m_hSourceChannels[Channel][sy * m_Pitch + sx] * m_hConvolutionKernel[1 + offsetY][1 + offsetX];
+							}
+					}
+					m_hCPUResultChannels[Channel][y * m_Pitch + x] = value * m_KernelWeight + m_Offset;		
 				}
-				m_hCPUResultChannels[Channel][y * m_Pitch + x] = value * m_KernelWeight + m_Offset;		
 			}
-		}
+		});
 
 	}
 
@@ -185,17 +178,22 @@ double CConvolution3x3Task::ConvolutionChannelCPU(unsigned int Channel)
 	return timer.GetElapsedMilliseconds();
 }
 
-double CConvolution3x3Task::ConvolutionChannelGPU(unsigned int Channel, cl_context Context, 
-												cl_command_queue CommandQueue, int NIterations)
+CEventGraph::NodeId CConvolution3x3Task::EnqueueChannelGPU(CEventGraph& Graph, unsigned int Channel,
+	const CEventGraph::Dependencies& Deps)
 {
 	size_t globalWorkSize[2] = {CLUtil::GetGlobalWorkSize(m_Width, m_TileSize[0]), CLUtil::GetGlobalWorkSize(m_Height, m_TileSize[1])};
-	
+
+	// the arguments are captured when the kernel is enqueued, so the next channel can set its own
 	cl_int clErr;
 	clErr  = clSetKernelArg(m_ConvolutionKernel, 0, sizeof(cl_mem), (void*)&m_dResultChannels[Channel]);
 	clErr |= clSetKernelArg(m_ConvolutionKernel, 1, sizeof(cl_mem), (void*)&m_dSourceChannels[Channel]);
-	V_RETURN_0_CL(clErr, "Error setting kernel arguments!");
+	if(clErr != CL_SUCCESS)
+	{
+		cerr<<"Error setting kernel arguments: "<<CLUtil::GetCLErrorString(clErr)<<endl;
+		return -1;
+	}
 
-	return CLUtil::ProfileKernel(CommandQueue, m_ConvolutionKernel, 2, globalWorkSize, m_TileSize, NIterations);
+	return Graph.EnqueueKernel(m_ConvolutionKernel, 2, globalWorkSize, m_TileSize, Deps);
 }
 
 
@@ -51,8 +51,9 @@ protected:
 	
 	// the return value is the run time in milliseconds
 	double ConvolutionChannelCPU(unsigned int Channel);
-	//the last parameter is for timing, and the returned value is the average run time in milliseconds
-	double ConvolutionChannelGPU(unsigned int Channel, cl_context Context, cl_command_queue CommandQueue, int NIterations);
+
+	virtual CEventGraph::NodeId EnqueueChannelGPU(CEventGraph& Graph, unsigned int Channel,
+		const CEventGraph::Dependencies& Deps);
 
 	size_t			m_TileSize[2];
 
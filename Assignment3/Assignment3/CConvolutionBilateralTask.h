@@ -59,8 +59,9 @@ protected:
 
 	// the return value is the run time in milliseconds
 	double ConvolutionChannelCPU(unsigned int Channel);
-	// the return value is the run time in milliseconds
-	double ConvolutionChannelGPU(unsigned int Channel, cl_context Context, cl_command_queue CommandQueue, int NIterations);
+
+	// the discontinuity kernels and then the channels
+	virtual bool EnqueueRunGPU(CEventGraph& Graph, CEventGraph::Dependencies& ChannelNodes);
 
 	// These helper methods are used to build the discontinuity buffer
 	inline bool IsNormalDiscontinuity(const cl_float4 &n1, const cl_float4 &n2) {
@@ -88,6 +89,7 @@ protected:
 	// kernels for discontinuity detection
 	cl_kernel		m_HorizontalDiscKernel;
 	cl_kernel		m_VerticalDiscKernel;
+	size_t			m_DiscLocalWorkSize[2];
 
 };
 
@@ -6,6 +6,7 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CConvolutionSeparableTask.h"
 
 #include "../Common/CLUtil.h"
+#include "../Common/CThreadPool.h"
 #include "../Common/CTimer.h"
 
 #include <sstream>
@@ -44,7 +45,8 @@ CConvolutionSeparableTask::CConvolutionSeparableTask(
 	memcpy(m_hKernelHorizontal, pKernelHorizontal, kernelSize * sizeof(float));
 	memcpy(m_hKernelVertical, pKernelVertical, kernelSize * sizeof(float));
 
-	m_dGPUWorkingBuffer = nullptr;
+	for(int i = 0; i < 3; i++)
+		m_dGPUWorkingBuffers[i] = nullptr;
 	m_hCPUWorkingBuffer = nullptr;
 
 	m_FileNamePostfix = "Separable_" + OutFileName;
@@ -79,8 +81,11 @@ bool CConvolutionSeparableTask::InitResources(cl_device_id Device, cl_context Co
 	clError |= clErr;
 	V_RETURN_FALSE_CL(clError, "Error allocating device kernel constants.");
 
-	m_dGPUWorkingBuffer = clCreateBuffer(Context, CL_MEM_READ_WRITE, m_Pitch * m_Height * sizeof(cl_float), NULL, &clError);
-	V_RETURN_FALSE_CL(clError, "Error allocating device working array");
+	for(int i = 0; i < 3; i++)
+	{
+		m_dGPUWorkingBuffers[i] = CreateBuffer(Context, CL_MEM_READ_WRITE, m_Pitch * m_Height * sizeof(cl_float), &clError);
+		V_RETURN_FALSE_CL(clError, "Error allocating device working array");
+	}
 
 	m_hCPUWorkingBuffer = new float[m_Height * m_Pitch];
 
@@ -136,7 +141,8 @@ void CConvolutionSeparableTask::ReleaseResources()
 {
 	SAFE_DELETE_ARRAY( m_hCPUWorkingBuffer );
 
-	SAFE_RELEASE_MEMOBJECT(m_dGPUWorkingBuffer);
+	for(int i = 0; i < 3; i++)
+		ReleaseBuffer(m_dGPUWorkingBuffers[i]);
 	SAFE_RELEASE_MEMOBJECT(m_dKernelHorizontal);
 	SAFE_RELEASE_MEMOBJECT(m_dKernelVertical);
 
@@ -147,27 +153,17 @@ void CConvolutionSeparableTask::ReleaseResources()
 
 void CConvolutionSeparableTask::ComputeGPU(cl_context Context, cl_command_queue CommandQueue, size_t LocalWorkSize[3])
 {
-	size_t dataSize = m_Pitch * m_Height * sizeof(cl_float);
 	int nIterations = 100;
 
-	unsigned int numChannels = 3;
-
-	double runTime = 0.0f;
-	for(unsigned int iChannel = 0; iChannel < numChannels; iChannel++)
-	{
-		runTime += ConvolutionChannelGPU(iChannel, Context, CommandQueue, nIterations);
-	}
+	//the channels are independent chains of the two passes, which can overlap
+	double runTime = ProfileRunsGPU(CommandQueue, nIterations, "convolution_separable");
+	if(runTime < 0)
+		return;
 
 	cout<<"  Average GPU time: "<<runTime<<" ms, throughput: "<< 1.0e-6 * m_Width * m_Height / runTime << " Gpixels/s" <<endl;
 
-	for(unsigned int iChannel = 0; iChannel < numChannels; iChannel++)
-	{
-		//copy the results back to the CPU
-		//(this time the data is in the same buffer as the input was, because of the 2 convolution passes)
-		V_RETURN_CL( clEnqueueReadBuffer(CommandQueue, m_dResultChannels[iChannel], CL_TRUE, 0, dataSize,
-									m_hGPUResultChannels[iChannel], 0, NULL, NULL), "Error reading back results from the device!" );
-
-	}
+	//copy the results of the last run back to the CPU
+	V_RETURN_CL(ReadResultChannels(CommandQueue), "Error reading back results from the device!");
 	
 	SaveImage("../Assignment3/Images/GPUResultSeparable_" + m_OutFileName + ".pfm", m_hGPUResultChannels);
 }
@@ -191,68 +187,72 @@ double CConvolutionSeparableTask::ConvolutionChannelCPU(unsigned int Channel)
 	timer.Start();
 
 	//horizontal pass
-	for(int y = 0; y < (int)m_Height; y++)
-		for(int x = 0; x < (int)m_Width; x++)
-		{
-			float value = 0;
-			//apply horizontal kernel
-			for(int k = -m_KernelRadius; k <= m_KernelRadius; k++)
+	CThreadPool::Get().ParallelFor(0, m_Height, 4, [&](size_t Begin, size_t End) {
+		for(int y = (int)Begin; y < (int)End; y++)
+			for(int x = 0; x < (int)m_Width; x++)
 			{
-				int sx = x + k;
-				if(sx >= 0 && sx < (int)m_Width)
-					value += m_hSourceChannels[Channel][y * m_Pitch + sx] * m_hKernelHorizontal[m_KernelRadius - k];
+				float value = 0;
+				//apply horizontal kernel
+				for(int k = -m_KernelRadius; k <= m_KernelRadius; k++)
+				{
+					int sx = x + k;
+					if(sx >= 0 && sx < (int)m_Width)
+						value += m_hSourceChannels[Channel][y * m_Pitch + sx] * m_hKernelHorizontal[m_KernelRadius - k];
+				}
+				m_hCPUWorkingBuffer[y * m_Pitch + x] = value;
 			}
-			m_hCPUWorkingBuffer[y * m_Pitch + x] = value;
-		}
+	});
 
 	//vertical pass
-	for(int x = 0; x < (int)m_Width; x++)
-		for(int y = 0; y < (int)m_Height; y++)
-		{
-			float value = 0;
-			//apply horizontal kernel
-			for(int k = -m_KernelRadius; k <= m_KernelRadius; k++)
+	CThreadPool::Get().ParallelFor(0, m_Width, 4, [&](size_t Begin, size_t End) {
+		for(int x = (int)Begin; x < (int)End; x++)
+			for(int y = 0; y < (int)m_Height; y++)
 			{
-				int sy = y + k;
-				if(sy >= 0 && sy < (int)m_Height)
-					value += m_hCPUWorkingBuffer[sy * m_Pitch + x] * m_hKernelVertical[m_KernelRadius - k];
+				float value = 0;
+				//apply horizontal kernel
+				for(int k = -m_KernelRadius; k <= m_KernelRadius; k++)
+				{
+					int sy = y + k;
+					if(sy >= 0 && sy < (int)m_Height)
+						value += m_hCPUWorkingBuffer[sy * m_Pitch + x] * m_hKernelVertical[m_KernelRadius - k];
+				}
+				m_hCPUResultChannels[Channel][y * m_Pitch + x] = value;
 			}
-			m_hCPUResultChannels[Channel][y * m_Pitch + x] = value;
-		}
+	});
 
 	timer.Stop();
 
 	return timer.GetElapsedMilliseconds();
 }
 
-double CConvolutionSeparableTask::ConvolutionChannelGPU(unsigned int Channel, cl_context Context, cl_command_queue CommandQueue, int NIterations)
+CEventGraph::NodeId CConvolutionSeparableTask::EnqueueChannelGPU(CEventGraph& Graph, unsigned int Channel,
+	const CEventGraph::Dependencies& Deps)
 {
+	// the arguments are captured when the kernels are enqueued, so the next channel can set its own
 	cl_int clErr;
-
-	clErr  = clSetKernelArg(m_HorizontalKernel, 0, sizeof(cl_mem), (void*)&m_dGPUWorkingBuffer);
+	clErr  = clSetKernelArg(m_HorizontalKernel, 0, sizeof(cl_mem), (void*)&m_dGPUWorkingBuffers[Channel]);
 	clErr |= clSetKernelArg(m_HorizontalKernel, 1, sizeof(cl_mem), (void*)&m_dSourceChannels[Channel]);
-	V_RETURN_0_CL(clErr, "Error setting horizontal kernel arguments");
-
-	clErr  = clSetKernelArg(m_VerticalKernel, 0, sizeof(cl_mem), (void*)&m_dResultChannels[Channel]);
-	clErr |= clSetKernelArg(m_VerticalKernel, 1, sizeof(cl_mem), (void*)&m_dGPUWorkingBuffer);
-	V_RETURN_0_CL(clErr, "Error setting vertical kernel arguments");
-
+	clErr |= clSetKernelArg(m_VerticalKernel, 0, sizeof(cl_mem), (void*)&m_dResultChannels[Channel]);
+	clErr |= clSetKernelArg(m_VerticalKernel, 1, sizeof(cl_mem), (void*)&m_dGPUWorkingBuffers[Channel]);
+	if(clErr != CL_SUCCESS)
+	{
+		cerr<<"Error setting kernel arguments: "<<CLUtil::GetCLErrorString(clErr)<<endl;
+		return -1;
+	}
 
-	double runTime;	
-	
 	size_t globalWorkSizeH[2] = {
 		CLUtil::GetGlobalWorkSize(m_Width / m_StepsHorizontal, m_LocalSizeHorizontal[0]),
 		CLUtil::GetGlobalWorkSize(m_Height, m_LocalSizeHorizontal[1])
-	};	
-	runTime = CLUtil::ProfileKernel(CommandQueue, m_HorizontalKernel, 2, globalWorkSizeH, m_LocalSizeHorizontal, NIterations);
+	};
+	CEventGraph::NodeId horizontal = Graph.EnqueueKernel(m_HorizontalKernel, 2, globalWorkSizeH, m_LocalSizeHorizontal, Deps);
+	if(horizontal < 0)
+		return -1;
 
 	size_t globalWorkSizeV[2] = {
 		CLUtil::GetGlobalWorkSize(m_Width, m_LocalSizeVertical[0]),
 		CLUtil::GetGlobalWorkSize(m_Height / m_StepsVertical, m_LocalSizeVertical[1])
 	};
-	runTime += CLUtil::ProfileKernel(CommandQueue, m_VerticalKernel, 2, globalWorkSizeV, m_LocalSizeVertical, NIterations);
-	
-	return runTime;
+	return Graph.EnqueueKernel(m_VerticalKernel, 2, globalWorkSizeV, m_LocalSizeVertical, { horizontal });
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -55,8 +55,10 @@ public:
 protected:
 	// the return value is the run time in milliseconds
 	double ConvolutionChannelCPU(unsigned int Channel);
-	// the return value is the run time in milliseconds
-	double ConvolutionChannelGPU(unsigned int Channel, cl_context Context, cl_command_queue CommandQueue, int NIterations);
+
+	// also used by the bilateral filter, its kernels take the same image arguments
+	virtual CEventGraph::NodeId EnqueueChannelGPU(CEventGraph& Graph, unsigned int Channel,
+		const CEventGraph::Dependencies& Deps);
 
 	std::string m_OutFileName;
 
@@ -72,8 +74,8 @@ protected:
 	float*			m_hKernelVertical = nullptr;
 	int				m_KernelRadius = 0;
 
-	// device data
-	cl_mem			m_dGPUWorkingBuffer;
+	// device data, one intermediate buffer per channel, so the channels can overlap
+	cl_mem			m_dGPUWorkingBuffers[3];
 	float*			m_hCPUWorkingBuffer;
 
 	//kernel coefficients
@@ -6,6 +6,7 @@ GPU Computing / GPGPU Praktikum source code.
 #include "CConvolutionTaskBase.h"
 
 #include "../Common/CLUtil.h"
+#include "../Common/CBenchmark.h"
 
 #include "Pfm.h"
 
@@ -49,12 +50,12 @@ bool CConvolutionTaskBase::InitResources(cl_device_id , cl_context Context)
 
 	cout<<"Size of image: "<<m_Width<<" x "<<m_Height<<endl;
 
-	//allocate data for the float channels
+	//allocate data for the float channels (the ones shared with the device are aligned for zero-copy buffers)
 	for(int i = 0; i < 3; i++)
 	{
-		m_hSourceChannels[i] = new float[m_Height * m_Pitch];
+		m_hSourceChannels[i] = CLUtil::AllocHostArray<float>(m_Height * m_Pitch);
 		m_hCPUResultChannels[i] = new float[m_Height * m_Pitch];
-		m_hGPUResultChannels[i] = new float[m_Height * m_Pitch];
+		m_hGPUResultChannels[i] = CLUtil::AllocHostArray<float>(m_Height * m_Pitch);
 	}
 
 	//extract R, G, B channels
@@ -92,10 +93,11 @@ bool CConvolutionTaskBase::InitResources(cl_device_id , cl_context Context)
 	cl_int clError;
 	for(int i = 0; i < 3; i++)
 	{
-		m_dSourceChannels[i] = clCreateBuffer(Context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, dataSize, m_hSourceChannels[i], &clError);
+		cl_mem_flags hostFlags = (m_TransferPolicy == TRANSFER_ZERO_COPY) ? CL_MEM_USE_HOST_PTR : CL_MEM_COPY_HOST_PTR;
+		m_dSourceChannels[i] = clCreateBuffer(Context, CL_MEM_READ_ONLY | hostFlags, dataSize, m_hSourceChannels[i], &clError);
 		V_RETURN_FALSE_CL(clError, "Error allocating device input array");
 
-		m_dResultChannels[i] = clCreateBuffer(Context, CL_MEM_WRITE_ONLY, dataSize, NULL, &clError);
+		m_dResultChannels[i] = CreateHostBuffer(Context, CL_MEM_WRITE_ONLY, dataSize, m_hGPUResultChannels[i], &clError);
 		V_RETURN_FALSE_CL(clError, "Error allocating device output array");
 	}
 
@@ -106,12 +108,13 @@ void CConvolutionTaskBase::ReleaseResources()
 {
 	for(int i = 0; i < 3; i++)
 	{
-		SAFE_DELETE_ARRAY( m_hSourceChannels[i] );
-		SAFE_DELETE_ARRAY( m_hCPUResultChannels[i] );
-		SAFE_DELETE_ARRAY( m_hGPUResultChannels[i] );
-
 		SAFE_RELEASE_MEMOBJECT( m_dSourceChannels[i] );
-		SAFE_RELEASE_MEMOBJECT( m_dResultChannels[i] );
+		ReleaseBuffer( m_dResultChannels[i] );
+
+		//after the buffers, which might use them
+		CLUtil::FreeHostArray( m_hSourceChannels[i] );
+		SAFE_DELETE_ARRAY( m_hCPUResultChannels[i] );
+		CLUtil::FreeHostArray( m_hGPUResultChannels[i] );
 	}
 }
 
@@ -290,6 +293,74 @@ void CConvolutionTaskBase::SaveIntImage(const std::string& FileName, int* Channe
 	}
 }
 
+bool CConvolutionTaskBase::EnqueueChannelsGPU(CEventGraph& Graph, const CEventGraph::Dependencies& Deps,
+	CEventGraph::Dependencies& ChannelNodes)
+{
+	unsigned int numChannels = m_Monochrome ? 1 : 3;
+	CEventGraph::Dependencies nodes;
+
+	for(unsigned int iChannel = 0; iChannel < numChannels; iChannel++)
+	{
+		//a channel overwrites its buffers, so it waits for the same channel of the previous run
+		CEventGraph::Dependencies deps = Deps;
+		if(iChannel < ChannelNodes.size())
+			deps.push_back(ChannelNodes[iChannel]);
+
+		CEventGraph::NodeId convolved = EnqueueChannelGPU(Graph, iChannel, deps);
+		if(convolved < 0)
+			return false;
+		nodes.push_back(convolved);
+	}
+
+	ChannelNodes = nodes;
+	return true;
+}
+
+bool CConvolutionTaskBase::EnqueueRunGPU(CEventGraph& Graph, CEventGraph::Dependencies& ChannelNodes)
+{
+	return EnqueueChannelsGPU(Graph, CEventGraph::Dependencies(), ChannelNodes);
+}
+
+double CConvolutionTaskBase::ProfileRunsGPU(cl_command_queue CommandQueue, int NIterations, const std::string& Name)
+{
+	CEventGraph graph(CommandQueue);
+	CEventGraph::Dependencies channelNodes;
+	for(int i = 0; i < NIterations; i++)
+	{
+		if(!EnqueueRunGPU(graph, channelNodes))
+			return -1;
+	}
+
+	cl_int clError = graph.Finish();
+	if(clError != CL_SUCCESS)
+	{
+		cerr<<"Error executing "<<Name<<": "<<CLUtil::GetCLErrorString(clError)<<endl;
+		return -1;
+	}
+	graph.PrintSummary("  All runs");
+	graph.PrintKernelProfiles();
+
+	double ms = graph.GetRunMilliseconds() / double(NIterations);
+	CBenchmarkRecorder::ReportTime(Name, ms);
+	return ms;
+}
+
+cl_int CConvolutionTaskBase::ReadResultChannels(cl_command_queue CommandQueue)
+{
+	unsigned int numChannels = m_Monochrome ? 1 : 3;
+	size_t dataSize = m_Pitch * m_Height * sizeof(cl_float);
+
+	for(unsigned int iChannel = 0; iChannel < numChannels; iChannel++)
+	{
+		cl_int clError = CLUtil::DownloadBuffer(CommandQueue, m_dResultChannels[iChannel], dataSize,
+			m_hGPUResultChannels[iChannel], m_TransferPolicy);
+		if(clError != CL_SUCCESS)
+			return clError;
+	}
+
+	return CL_SUCCESS;
+}
+
 float CConvolutionTaskBase::RGBToGrayScale(float R, float G, float B)
 {
 	return 0.3f * R + 0.59f * G + 0.11f * B;
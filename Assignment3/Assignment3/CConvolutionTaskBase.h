@@ -21,6 +21,7 @@
 #define _CCONVOLUTION_TASK_BASE_H
 
 #include "../Common/IComputeTask.h"
+#include "../Common/CEventGraph.h"
 
 #include <string>
 
@@ -44,11 +45,44 @@ public:
 
 	virtual bool ValidateResults();
 
+	// every channel is read and written once, the image size is known after InitResources()
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const
+	{
+		Elements = size_t(m_Width) * m_Height;
+		Bytes = 2 * sizeof(float) * Elements * (m_Monochrome ? 1 : 3);
+	}
+
 protected:
 
 	void SaveImage(const std::string& FileName, float* Channels[3]);
 	void SaveIntImage(const std::string& FileName, int* Channel);
 
+	//! Enqueues the convolution of one channel after Deps and returns the node of its last command (-1 on failure)
+	virtual CEventGraph::NodeId EnqueueChannelGPU(CEventGraph& Graph, unsigned int Channel,
+		const CEventGraph::Dependencies& Deps) = 0;
+
+	//! Enqueues the convolution of all channels after Deps
+	/*!
+		The channels only share read-only data, so each of them is an independent chain
+		and they can overlap if the graph runs out of order. ChannelNodes holds the last node of
+		each channel of the previous run (or is empty) and is replaced by those of this run.
+	*/
+	bool EnqueueChannelsGPU(CEventGraph& Graph, const CEventGraph::Dependencies& Deps, CEventGraph::Dependencies& ChannelNodes);
+
+	//! Enqueues one run of the whole filter, by default EnqueueChannelsGPU()
+	virtual bool EnqueueRunGPU(CEventGraph& Graph, CEventGraph::Dependencies& ChannelNodes);
+
+	//! Enqueues NIterations runs into one graph and returns the average time of a run (-1 on failure)
+	/*!
+		The channels of a run overlap if the out-of-order mode is enabled (--out-of-order), so the
+		time includes its benefit. The launch times of the kernels are printed per kernel.
+		The results of the last run stay in m_dResultChannels (see ReadResultChannels()).
+	*/
+	double ProfileRunsGPU(cl_command_queue CommandQueue, int NIterations, const std::string& Name);
+
+	//! Copies the results of the last run to m_hGPUResultChannels
+	cl_int ReadResultChannels(cl_command_queue CommandQueue);
+
 	// helper functions:
 	
 	// one grayscale floating point value out of RGB
@@ -72,7 +106,7 @@ protected:
 	float*			m_hCPUResultChannels[3] /*= { nullptr, nullptr, nullptr }*/; //the convolved image
 	float*			m_hGPUResultChannels[3] /*= { nullptr, nullptr, nullptr }*/; //the convolved image
 
-	//we process exactly one channel on the GPU in the same time
+	//every channel has its own buffers, so the channels can be processed at the same time
 	cl_mem			m_dSourceChannels[3] /*= { nullptr, nullptr, nullptr}*/;
 	cl_mem			m_dResultChannels[3] /*= { nullptr, nullptr, nullptr}*/;
 
@@ -1,6 +1,9 @@
 #include "CHistogramTask.h"
 #include "../Common/CLUtil.h"
+#include "../Common/CEventGraph.h"
+#include "../Common/CThreadPool.h"
 #include "../Common/CTimer.h"
+#include "../Common/CBenchmark.h"
 #include "Pfm.h"
 #include <string.h>
 #include <cassert>
@@ -54,6 +57,9 @@ InitResources(cl_device_id dev, cl_context ctx)
 	m_d_hist = clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, NUM_HIST_BINS * sizeof(int),
 			zeroes.data(), &err);
 	V_RETURN_FALSE_CL(err, "Failed to allocate device memory");
+	m_d_hist_back = clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, NUM_HIST_BINS * sizeof(int),
+			zeroes.data(), &err);
+	V_RETURN_FALSE_CL(err, "Failed to allocate device memory");
 
 
 	std::string src;
@@ -100,6 +106,15 @@ InitResources(cl_device_id dev, cl_context ctx)
 	err = clSetKernelArg(m_kernel_set_to_val, 2, sizeof(int), &zero);
 	V_RETURN_FALSE_CL(err, "Error setting kernel Arg 2");
 
+	// the histogram is cleared before every run in ComputeGPU(), so tuning may accumulate into it
+	CAutoTuner::Request request(m_use_local_memory ? "histogram_local" : "histogram_global",
+		m_kernel_histogram, 2, m_img_width, m_img_height);
+	if(m_use_local_memory) {
+		// every bin of the local histogram is cleared and written back by one work-item
+		request.Prepare = [](const size_t lws[3]) { return lws[0] * lws[1] >= NUM_HIST_BINS; };
+	}
+	TuneLocalWorkSize(request, m_tuned_lws);
+
 	return true;
 }
 
@@ -108,6 +123,7 @@ ReleaseResources()
 {
 	 SAFE_RELEASE_MEMOBJECT(m_d_pixels);
 	 SAFE_RELEASE_MEMOBJECT(m_d_hist);
+	 SAFE_RELEASE_MEMOBJECT(m_d_hist_back);
 	 SAFE_RELEASE_KERNEL(m_kernel_histogram);
 	 SAFE_RELEASE_KERNEL(m_kernel_set_to_val);
 }
@@ -140,6 +156,9 @@ print_histogram(const std::vector<int> &h)
 void CHistogramTask::
 ComputeGPU(cl_context ctx, cl_command_queue cmdq, size_t lws[3])
 {
+	if(m_tuned_lws[0] > 0)
+		lws = m_tuned_lws;
+
 	size_t local_size_clear = 256;
 	size_t global_size_clear = ((NUM_HIST_BINS + local_size_clear - 1) / local_size_clear) * local_size_clear;
 	size_t global_size[2] = {
@@ -147,29 +166,41 @@ ComputeGPU(cl_context ctx, cl_command_queue cmdq, size_t lws[3])
 		((m_img_height + lws[1] - 1) / lws[1]) * lws[1]
 	};
 
-	CTimer timer;
-	clFinish(cmdq);
-	timer.Start();
+	m_histogram_gpu.resize(NUM_HIST_BINS);
 
+	// the iterations alternate between two histograms: each one clears and fills its buffer
+	// after the iteration before the previous one, so two histogram kernels can run at the same
+	// time in the out-of-order mode of the graph
+	cl_mem hists[2] = { m_d_hist, m_d_hist_back };
+	CEventGraph::NodeId last[2] = { -1, -1 };
 	const int num_iterations = 100;
+	CEventGraph graph(cmdq);
 	for(int i = 0; i < num_iterations; i++) {
-		clEnqueueNDRangeKernel(cmdq, m_kernel_set_to_val, 1, NULL, &global_size_clear, &local_size_clear, 0, NULL, NULL);
-
-		clEnqueueNDRangeKernel(cmdq, m_kernel_histogram, 2, NULL, global_size, lws, 0, NULL, NULL);
+		cl_mem hist = hists[i % 2];
+		CEventGraph::Dependencies deps;
+		if(last[i % 2] >= 0)
+			deps.push_back(last[i % 2]);
+		// the arguments are captured when the kernels are enqueued
+		cl_int err = clSetKernelArg(m_kernel_set_to_val, 0, sizeof(cl_mem), &hist);
+		err |= clSetKernelArg(m_kernel_histogram, 0, sizeof(cl_mem), &hist);
+		V_RETURN_CL(err, "Error setting the histogram argument");
+		CEventGraph::NodeId cleared = graph.EnqueueKernel(m_kernel_set_to_val, 1, &global_size_clear, &local_size_clear, deps);
+		last[i % 2] = graph.EnqueueKernel(m_kernel_histogram, 2, global_size, lws, { cleared });
 	}
-	clFinish(cmdq);
-	timer.Stop();
+	V_RETURN_CL(graph.Finish(), "Error computing the histogram on the device!");
+
+	// only the kernels are timed, the result of the last iteration is read afterwards
+	double ms = graph.GetRunMilliseconds() / double(num_iterations);
+	V_RETURN_CL(clEnqueueReadBuffer(cmdq, hists[(num_iterations - 1) % 2], CL_TRUE, 0, sizeof(int) * NUM_HIST_BINS,
+		m_histogram_gpu.data(), 0, nullptr, nullptr), "Error reading the histogram from the device!");
 
 	const char *prefix = m_use_local_memory
 		? "  Histogram GPU time (using local memory): "
 		: "  Histogram GPU time (no local memory): ";
-	std::cout << prefix << timer.GetElapsedMilliseconds() / float(num_iterations) << " ms\n";
-
-	m_histogram_gpu.resize(NUM_HIST_BINS);
-
-	clEnqueueReadBuffer(cmdq, m_d_hist, CL_TRUE, 0, sizeof(int) * NUM_HIST_BINS,
-			m_histogram_gpu.data(), 0, nullptr, nullptr);
-
+	std::cout << prefix << ms << " ms\n";
+	graph.PrintSummary("  All iterations");
+	graph.PrintKernelProfiles();
+	CBenchmarkRecorder::ReportTime(m_use_local_memory ? "histogram_local" : "histogram_global", ms);
 }
 
 void CHistogramTask::
@@ -178,13 +209,24 @@ ComputeCPU()
 	m_histogram.assign(NUM_HIST_BINS, 0);
 	CTimer timer;
 	timer.Start();
-	for(int y = 0; y < m_img_height; y++) {
-		for(int x = 0; x < m_img_width; x++) {
-			float p = m_pixels[y * m_img_stride + x] * float(NUM_HIST_BINS);
-			int h_idx = std::min<int>(NUM_HIST_BINS - 1, std::max<int>(0, int(p)));
-			m_histogram[h_idx]++;
-		}
-	}
+	// every block of rows gets its own histogram, they are summed up afterwards
+	m_histogram = CThreadPool::Get().ParallelReduce(0, m_img_height, 16, m_histogram,
+		[&](size_t y_begin, size_t y_end) {
+			std::vector<int> hist(NUM_HIST_BINS, 0);
+			for(int y = int(y_begin); y < int(y_end); y++) {
+				for(int x = 0; x < m_img_width; x++) {
+					float p = m_pixels[y * m_img_stride + x] * float(NUM_HIST_BINS);
+					int h_idx = std::min<int>(NUM_HIST_BINS - 1, std::max<int>(0, int(p)));
+					hist[h_idx]++;
+				}
+			}
+			return hist;
+		},
+		[](std::vector<int> a, const std::vector<int>& b) {
+			for(size_t i = 0; i < a.size(); i++)
+				a[i] += b[i];
+			return a;
+		});
 	timer.Stop();
 
 	std::cout << "  Histogram CPU time: " << timer.GetElapsedMilliseconds() << " ms\n";
@@ -17,6 +17,10 @@ public:
 	virtual void ComputeGPU(cl_context ctx, cl_command_queue cmdq, size_t lws[3]) override;
 	virtual void ComputeCPU() override;
 	virtual bool ValidateResults() override;
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const override {
+		Elements = size_t(m_img_width) * m_img_height;
+		Bytes = sizeof(float) * Elements;
+	}
 
 protected:
 	float m_min_val = 0.0f, m_max_val = 1.0f;
@@ -27,7 +31,11 @@ protected:
 	cl_program m_program = nullptr;
 	cl_kernel m_kernel_histogram = nullptr, m_kernel_set_to_val = nullptr;
 	cl_mem m_d_pixels = nullptr;
-	cl_mem m_d_hist = nullptr;
+	// consecutive iterations fill different histograms, so they do not have to wait for each other
+	cl_mem m_d_hist = nullptr, m_d_hist_back = nullptr;
+
+	// local work size found by the autotuner, zero if not tuned
+	size_t m_tuned_lws[3] = { 0, 0, 0 };
 
 	std::vector<int> m_histogram, m_histogram_gpu;
 	std::vector<float> m_pixels;
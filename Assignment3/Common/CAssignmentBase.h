@@ -23,6 +23,12 @@
 #include "IComputeTask.h"
 
 #include "CommonDefs.h"
+#include "CBufferPool.h"
+#include "CAutoTuner.h"
+#include "CDeviceCaps.h"
+
+#include <string>
+#include <vector>
 
 //! Base class for all assignments
 /*! 
@@ -49,16 +55,96 @@ public:
 	virtual bool DoCompute() = 0;
 
 protected:	
+	//! Evaluates the command line options common to all assignments (see EnterMainLoop())
+	/*!
+		--no-profiling	create the command queue without CL_QUEUE_PROFILING_ENABLE
+		--trace <file>	record host phases and kernel executions and write them
+						as Chrome trace (chrome://tracing) to <file> when the assignment ends
+		--cpu-threads <n>	number of threads for the CPU reference implementations (0: all hardware threads)
+		--out-of-order		let independent commands of a task overlap (see CEventGraph)
+		--no-buffer-pool	tasks create and release their device buffers themselves instead of
+							reusing them from m_BufferPool
+		--transfer <policy>	copy, zero-copy or auto: how tasks move their host arrays to the device
+							(default: copy, tasks can choose their own, see ETransferPolicy)
+		--autotune			tasks use the fastest local work sizes of the tuning database and
+							measure the missing ones (see CAutoTuner)
+		--retune			like --autotune, but measures all local work sizes again
+		--tuning-db <file>	the tuning database (default: autotune.txt)
+		--peak-bandwidth <GB/s>	theoretical memory bandwidth of the device, bandwidth reports
+								are given relative to it (CL_PEAK_BANDWIDTH)
+		--device-validation	tasks compare their results with the CPU result on the device
+							instead of reading them back (see CDeviceValidator)
+
+		Device selection (the environment variables are used if the option is not given):
+		--device-type <type>	gpu, cpu, accelerator or all (CL_DEVICE_TYPE)
+								default: a GPU, any other device if there is none
+		--platform <name>		only use platforms whose name contains <name> (CL_PLATFORM)
+		--device <index>		index of the device among the matching ones (CL_DEVICE)
+								default: the GPU with most dedicated memory
+		--list-devices			print all devices with their capabilities and exit
+	*/
+	virtual bool ParseCommandLine(int argc, char** argv);
+
+	//! Sets the device type from a string, see ParseCommandLine()
+	bool SetDeviceType(const std::string& Type);
+
+	//! Collects the devices that match the selection options, in platform order
+	bool GetMatchingDevices(std::vector<cl_device_id>& Devices);
+
+	//! Chooses m_CLDevice and m_CLPlatform according to the selection options
+	bool SelectDevice();
+
+	//! Prints the capabilities of all devices and their index for --device
+	void ListDevices();
+
+	//! Prints information on m_CLPlatform and m_CLDevice
+	void PrintDeviceInfo();
+
+	//! Writes the recorded CTraceRecorder spans, if --trace was given
+	void WriteTrace();
+
+	//! Properties used to create m_CLCommandQueue
+	cl_command_queue_properties GetCommandQueueProperties() const;
+
 	virtual bool InitCLContext();
 
 	virtual void ReleaseCLContext();
 
 	virtual bool RunComputeTask(IComputeTask& Task, size_t LocalWorkSize[3]);
 
+	//! Hands the buffer pool, the transfer policy and the device capabilities to a task, before its InitResources()
+	void PrepareTask(IComputeTask& Task);
+
 	cl_platform_id		m_CLPlatform;
 	cl_device_id		m_CLDevice;
 	cl_context			m_CLContext;
 	cl_command_queue	m_CLCommandQueue;
+
+	//! Queried in InitCLContext(), the tasks derive their kernel parameters from it
+	CDeviceCaps			m_DeviceCaps;
+
+	//! The command queue records event timestamps, so CLUtil::ProfileKernel() reports device times
+	bool				m_ProfilingEnabled;
+
+	std::string			m_TraceFile;
+
+	//! Device buffers released by a task are reused by the next one
+	CBufferPool			m_BufferPool;
+	bool				m_BufferPoolEnabled;
+
+	//! Used for the tasks which do not select a transfer policy themselves
+	ETransferPolicy		m_TransferPolicy;
+
+	CAutoTuner			m_AutoTuner;
+	std::string			m_TuningDatabase;
+
+	//! Device selection, see ParseCommandLine(). A device type of 0 means GPU with fallback to all devices.
+	cl_device_type		m_DeviceType;
+	std::string			m_PlatformFilter;
+	int					m_DeviceIndex;
+	bool				m_ListDevices;
+	//! Only devices supporting this extension are considered (e.g. for OpenGL interop)
+	std::string			m_RequiredExtension;
 };
 
 #endif // _CASSIGNMENT_BASE_H
@@ -0,0 +1,277 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CAutoTuner.h"
+
+#include "CLUtil.h"
+#include "CTimer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CAutoTuner
+
+// launches of each candidate after an untimed one
+static const int c_NIterations = 10;
+
+CAutoTuner::Request::Request(const std::string& Name, cl_kernel Kernel, cl_uint Dimensions,
+	size_t SizeX, size_t SizeY, size_t SizeZ)
+	: Name(Name), Kernel(Kernel), Dimensions(Dimensions), Divisible(false)
+{
+	ProblemSize[0] = SizeX;
+	ProblemSize[1] = SizeY;
+	ProblemSize[2] = SizeZ;
+}
+
+CAutoTuner::CAutoTuner()
+	: m_Enabled(false), m_Retune(false), m_Modified(false), m_Context(nullptr), m_Device(nullptr), m_Queue(nullptr)
+{
+}
+
+CAutoTuner::~CAutoTuner()
+{
+	Release();
+}
+
+bool CAutoTuner::Init(cl_context Context, cl_device_id Device, const std::string& DatabasePath)
+{
+	if(!m_Enabled)
+		return true;
+
+	m_Context = Context;
+	m_Device = Device;
+	m_DatabasePath = DatabasePath;
+
+	char name[256] = "", driver[256] = "";
+	clGetDeviceInfo(Device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+	clGetDeviceInfo(Device, CL_DRIVER_VERSION, sizeof(driver) - 1, driver, NULL);
+	m_DeviceName = string(name) + ", driver " + driver;
+
+	// a missing database is not an error, it is created when the first result is saved
+	Load(m_DatabasePath);
+	return true;
+}
+
+void CAutoTuner::Release()
+{
+	if(m_Modified && !m_DatabasePath.empty())
+		Save(m_DatabasePath);
+	m_Modified = false;
+
+	if(m_Queue)
+	{
+		clReleaseCommandQueue(m_Queue);
+		m_Queue = nullptr;
+	}
+	m_Context = nullptr;
+	m_Device = nullptr;
+}
+
+std::string CAutoTuner::GetKey(const Request& R) const
+{
+	stringstream key;
+	key<<m_DeviceName<<"\t"<<R.Name<<"\t"<<R.ProblemSize[0]<<"x"<<R.ProblemSize[1]<<"x"<<R.ProblemSize[2];
+	return key.str();
+}
+
+bool CAutoTuner::Load(const std::string& Path)
+{
+	ifstream file(Path.c_str());
+	if(!file)
+		return false;
+
+	// device <TAB> name <TAB> problem size <TAB> local work size <TAB> ms
+	string line;
+	while(getline(file, line))
+	{
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		vector<string> fields;
+		stringstream stream(line);
+		string field;
+		while(getline(stream, field, '\t'))
+			fields.push_back(field);
+		if(fields.size() != 5)
+			continue;
+
+		Entry entry;
+		char x1, x2;
+		stringstream local(fields[3]);
+		if(!(local>>entry.LocalWorkSize[0]>>x1>>entry.LocalWorkSize[1]>>x2>>entry.LocalWorkSize[2]))
+			continue;
+		entry.Milliseconds = atof(fields[4].c_str());
+
+		m_Entries[fields[0] + "\t" + fields[1] + "\t" + fields[2]] = entry;
+	}
+	return true;
+}
+
+bool CAutoTuner::Save(const std::string& Path) const
+{
+	ofstream file(Path.c_str());
+	if(!file)
+	{
+		cerr<<"Could not write the tuning database "<<Path<<"."<<endl;
+		return false;
+	}
+
+	file<<"# device\tkernel\tproblem size\tlocal work size\tms"<<endl;
+	for(map<string, Entry>::const_iterator it = m_Entries.begin(); it != m_Entries.end(); ++it)
+	{
+		const Entry& e = it->second;
+		file<<it->first<<"\t"<<e.LocalWorkSize[0]<<"x"<<e.LocalWorkSize[1]<<"x"<<e.LocalWorkSize[2]<<"\t"<<e.Milliseconds<<endl;
+	}
+	return true;
+}
+
+void CAutoTuner::GetCandidates(const Request& R, std::vector<size_t>& Candidates) const
+{
+	Candidates.clear();
+
+	size_t maxGroupSize = 0, preferredMultiple = 1;
+	size_t maxItems[3] = {1, 1, 1};
+	clGetKernelWorkGroupInfo(R.Kernel, m_Device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxGroupSize), &maxGroupSize, NULL);
+	clGetKernelWorkGroupInfo(R.Kernel, m_Device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(preferredMultiple), &preferredMultiple, NULL);
+	clGetDeviceInfo(m_Device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxItems), maxItems, NULL);
+	if(preferredMultiple == 0)
+		preferredMultiple = 1;
+
+	// the third dimension is not tuned, none of the kernels uses it
+	size_t maxY = R.Dimensions > 1 ? maxItems[1] : 1;
+	for(size_t x = 1; x <= maxItems[0] && x <= maxGroupSize; x *= 2)
+	{
+		for(size_t y = 1; y <= maxY && x * y <= maxGroupSize; y *= 2)
+		{
+			// smaller groups than the preferred multiple leave SIMD lanes idle
+			if((x * y) % preferredMultiple != 0)
+				continue;
+			// no group needs to be larger than the problem
+			if(x > 1 && x / 2 >= R.ProblemSize[0])
+				continue;
+			if(y > 1 && y / 2 >= R.ProblemSize[1])
+				continue;
+			if(R.Divisible && (R.ProblemSize[0] % x != 0 || R.ProblemSize[1] % y != 0))
+				continue;
+
+			Candidates.push_back(x);
+			Candidates.push_back(y);
+			Candidates.push_back(1);
+		}
+	}
+}
+
+double CAutoTuner::MeasureCandidate(const Request& R, const size_t LocalWorkSize[3])
+{
+	if(R.Prepare && !R.Prepare(LocalWorkSize))
+		return -1;
+
+	if(R.Measure)
+	{
+		vector<double> times;
+		for(int i = 0; i <= c_NIterations; i++)
+		{
+			double ms = R.Measure(m_Queue, LocalWorkSize);
+			if(ms < 0)
+				return -1;
+			if(i > 0)
+				times.push_back(ms);
+		}
+		return CLUtil::ComputeLatencyStats(times).Median;
+	}
+
+	size_t globalWorkSize[3];
+	for(int d = 0; d < 3; d++)
+		globalWorkSize[d] = CLUtil::GetGlobalWorkSize(R.ProblemSize[d], LocalWorkSize[d]);
+
+	// the first launch may include a compilation for the work-group size
+	cl_int clError = clEnqueueNDRangeKernel(m_Queue, R.Kernel, R.Dimensions, NULL, globalWorkSize, LocalWorkSize, 0, NULL, NULL);
+	if(clError != CL_SUCCESS || clFinish(m_Queue) != CL_SUCCESS)
+		return -1;
+
+	CLUtil::KernelProfile profile;
+	if(!CLUtil::ProfileKernelEvents(m_Queue, R.Kernel, R.Dimensions, globalWorkSize, LocalWorkSize, c_NIterations, profile))
+		return -1;
+	return profile.StartToEnd.Median;
+}
+
+bool CAutoTuner::GetLocalWorkSize(const Request& R, size_t LocalWorkSize[3])
+{
+	if(!m_Enabled || !m_Device)
+		return false;
+
+	string key = GetKey(R);
+	map<string, Entry>::const_iterator it = m_Entries.find(key);
+	if(it != m_Entries.end() && !m_Retune)
+	{
+		const Entry& e = it->second;
+		if(R.Prepare && !R.Prepare(e.LocalWorkSize))
+			return false;
+		for(int d = 0; d < 3; d++)
+			LocalWorkSize[d] = e.LocalWorkSize[d];
+		cout<<"Tuned local work size of "<<R.Name<<": "<<LocalWorkSize[0]<<"x"<<LocalWorkSize[1]<<"x"<<LocalWorkSize[2]<<endl;
+		return true;
+	}
+
+	// the tuner has its own queue, the task's queue may not record event times
+	if(!m_Queue)
+	{
+		cl_int clError;
+		m_Queue = clCreateCommandQueue(m_Context, m_Device, CL_QUEUE_PROFILING_ENABLE, &clError);
+		if(clError != CL_SUCCESS)
+		{
+			cerr<<"Could not create the command queue of the tuner: "<<CLUtil::GetCLErrorString(clError)<<endl;
+			m_Queue = nullptr;
+			return false;
+		}
+	}
+
+	vector<size_t> candidates;
+	GetCandidates(R, candidates);
+	cout<<"Tuning the local work size of "<<R.Name<<" ("<<candidates.size() / 3<<" candidates)..."<<endl;
+
+	Entry best;
+	best.Milliseconds = -1;
+	for(size_t i = 0; i + 2 < candidates.size(); i += 3)
+	{
+		double ms = MeasureCandidate(R, &candidates[i]);
+		if(ms < 0)
+			continue;
+
+		cout<<"  "<<candidates[i]<<"x"<<candidates[i + 1]<<"x"<<candidates[i + 2]<<": "<<ms<<" ms"<<endl;
+		if(best.Milliseconds < 0 || ms < best.Milliseconds)
+		{
+			best.Milliseconds = ms;
+			copy(&candidates[i], &candidates[i] + 3, best.LocalWorkSize);
+		}
+	}
+
+	if(best.Milliseconds < 0)
+	{
+		cerr<<"No local work size worked for "<<R.Name<<", keeping the default one."<<endl;
+		return false;
+	}
+
+	// the arguments of the last candidate might still be set
+	if(R.Prepare)
+		R.Prepare(best.LocalWorkSize);
+
+	m_Entries[key] = best;
+	m_Modified = true;
+
+	for(int d = 0; d < 3; d++)
+		LocalWorkSize[d] = best.LocalWorkSize[d];
+	cout<<"Tuned local work size of "<<R.Name<<": "<<LocalWorkSize[0]<<"x"<<LocalWorkSize[1]<<"x"<<LocalWorkSize[2]
+		<<" ("<<best.Milliseconds<<" ms)"<<endl;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
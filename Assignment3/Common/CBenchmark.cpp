@@ -0,0 +1,616 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CBenchmark.h"
+
+#include "CTrace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdlib.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CBenchmarkRecorder
+
+std::atomic<bool> CBenchmarkRecorder::s_Enabled(false);
+std::mutex CBenchmarkRecorder::s_Mutex;
+std::vector<CBenchmarkRecorder::Report> CBenchmarkRecorder::s_Reports;
+
+void CBenchmarkRecorder::SetEnabled(bool Enabled)
+{
+	s_Enabled = Enabled;
+}
+
+void CBenchmarkRecorder::ReportTime(const std::string& Measurement, double Milliseconds)
+{
+	if(!s_Enabled)
+		return;
+
+	Report report;
+	report.Measurement = Measurement;
+	report.Milliseconds = Milliseconds;
+
+	lock_guard<mutex> lock(s_Mutex);
+	s_Reports.push_back(report);
+}
+
+void CBenchmarkRecorder::TakeReports(std::vector<Report>& Reports)
+{
+	lock_guard<mutex> lock(s_Mutex);
+	Reports.insert(Reports.end(), s_Reports.begin(), s_Reports.end());
+	s_Reports.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CBenchmarkOptions
+
+CBenchmarkOptions::CBenchmarkOptions()
+	: Warmup(1), Repeat(5)
+{
+}
+
+std::vector<std::string> CBenchmarkOptions::SplitList(const std::string& Str)
+{
+	vector<string> items;
+	stringstream stream(Str);
+	string item;
+	while(getline(stream, item, ','))
+		if(!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+bool CBenchmarkOptions::ParseLocalWorkSize(const std::string& Str, size_t LocalWorkSize[3])
+{
+	LocalWorkSize[0] = LocalWorkSize[1] = LocalWorkSize[2] = 1;
+
+	stringstream stream(Str);
+	string item;
+	int dim = 0;
+	while(getline(stream, item, 'x'))
+	{
+		if(dim == 3 || item.empty() || item.find_first_not_of("0123456789") != string::npos)
+			return false;
+		LocalWorkSize[dim++] = (size_t)strtoull(item.c_str(), NULL, 10);
+	}
+	return dim > 0 && LocalWorkSize[0] > 0 && LocalWorkSize[1] > 0 && LocalWorkSize[2] > 0;
+}
+
+bool CBenchmarkOptions::ParseOption(int argc, char** argv, int& i, bool& Error)
+{
+	string arg = argv[i];
+	bool hasValue = i + 1 < argc;
+
+	if(arg == "--task" && hasValue)
+	{
+		vector<string> items = SplitList(argv[++i]);
+		Tasks.insert(Tasks.end(), items.begin(), items.end());
+	}
+	else if(arg == "--variant" && hasValue)
+	{
+		vector<string> items = SplitList(argv[++i]);
+		Variants.insert(Variants.end(), items.begin(), items.end());
+	}
+	else if(arg == "--size" && hasValue)
+	{
+		vector<string> items = SplitList(argv[++i]);
+		for(size_t j = 0; j < items.size(); j++)
+		{
+			if(items[j].find_first_not_of("0123456789") != string::npos)
+			{
+				cerr<<"Invalid problem size: "<<items[j]<<endl;
+				Error = true;
+			}
+			Sizes.push_back((size_t)strtoull(items[j].c_str(), NULL, 10));
+		}
+	}
+	else if(arg == "--local" && hasValue)
+	{
+		vector<string> items = SplitList(argv[++i]);
+		for(size_t j = 0; j < items.size(); j++)
+		{
+			size_t localWorkSize[3];
+			if(!ParseLocalWorkSize(items[j], localWorkSize))
+			{
+				cerr<<"Invalid local work size: "<<items[j]<<" (expected e.g. 256 or 32x16)"<<endl;
+				Error = true;
+			}
+			LocalWorkSizes.insert(LocalWorkSizes.end(), localWorkSize, localWorkSize + 3);
+		}
+	}
+	else if(arg == "--warmup" && hasValue)
+		Warmup = (unsigned int)atoi(argv[++i]);
+	else if(arg == "--repeat" && hasValue)
+	{
+		int repeat = atoi(argv[++i]);
+		if(repeat < 1)
+		{
+			cerr<<"At least one repetition is required."<<endl;
+			Error = true;
+		}
+		Repeat = (unsigned int)max(repeat, 1);
+	}
+	else if(arg == "--csv" && hasValue)
+		CSVFile = argv[++i];
+	else if(arg == "--json" && hasValue)
+		JSONFile = argv[++i];
+	else
+		return false;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CBenchmarkTable
+
+void CBenchmarkTable::Add(const BenchmarkCase& Case, const std::string& Measurement, size_t Elements, size_t Bytes,
+	const std::vector<double>& Samples, bool Valid)
+{
+	Row row;
+	row.Case = Case;
+	row.Measurement = Measurement;
+	row.Elements = Elements;
+	row.Bytes = Bytes;
+	row.Samples = Samples.size();
+	row.Time = CLUtil::ComputeLatencyStats(Samples);
+	row.Valid = Valid;
+	m_Rows.push_back(row);
+}
+
+void CBenchmarkTable::Add(const BenchmarkCase& Case, const std::vector<CBenchmarkRecorder::Report>& Reports,
+	size_t Elements, size_t Bytes, bool Valid)
+{
+	// keep the order in which the measurements were first reported
+	vector<string> order;
+	map<string, vector<double> > samples;
+	for(size_t i = 0; i < Reports.size(); i++)
+	{
+		vector<double>& s = samples[Reports[i].Measurement];
+		if(s.empty())
+			order.push_back(Reports[i].Measurement);
+		s.push_back(Reports[i].Milliseconds);
+	}
+
+	for(size_t i = 0; i < order.size(); i++)
+		Add(Case, order[i], Elements, Bytes, samples[order[i]], Valid);
+}
+
+double CBenchmarkTable::GetGElementsPerSecond(const Row& R)
+{
+	return R.Time.Median > 0 ? 1.0e-6 * double(R.Elements) / R.Time.Median : 0.0;
+}
+
+double CBenchmarkTable::GetGBytesPerSecond(const Row& R)
+{
+	return R.Time.Median > 0 ? 1.0e-6 * double(R.Bytes) / R.Time.Median : 0.0;
+}
+
+static string FormatLocalWorkSize(const size_t LocalWorkSize[3])
+{
+	stringstream str;
+	str<<LocalWorkSize[0];
+	if(LocalWorkSize[1] > 1 || LocalWorkSize[2] > 1)
+		str<<"x"<<LocalWorkSize[1];
+	if(LocalWorkSize[2] > 1)
+		str<<"x"<<LocalWorkSize[2];
+	return str.str();
+}
+
+void CBenchmarkTable::Print() const
+{
+	cout<<endl<<"Benchmark results on "<<m_Device<<" (median of the runs):"<<endl;
+	cout<<left<<setw(14)<<"task"<<setw(12)<<"variant"<<setw(36)<<"measurement"<<right<<setw(12)<<"size"
+		<<setw(10)<<"local"<<setw(12)<<"ms"<<setw(12)<<"Gelem/s"<<setw(10)<<"GB/s"<<"  valid"<<endl;
+
+	for(size_t i = 0; i < m_Rows.size(); i++)
+	{
+		const Row& r = m_Rows[i];
+		cout<<left<<setw(14)<<r.Case.Task<<setw(12)<<r.Case.Variant<<setw(36)<<r.Measurement<<right<<setw(12)<<r.Case.Size
+			<<setw(10)<<FormatLocalWorkSize(r.Case.LocalWorkSize)<<setw(12)<<r.Time.Median
+			<<setw(12)<<GetGElementsPerSecond(r)<<setw(10)<<GetGBytesPerSecond(r)<<"  "<<(r.Valid ? "yes" : "NO")<<endl;
+	}
+}
+
+// strings are quoted, as device names may contain commas
+static string QuoteCSV(const std::string& Str)
+{
+	string quoted = "\"";
+	for(size_t i = 0; i < Str.size(); i++)
+	{
+		if(Str[i] == '"')
+			quoted += '"';
+		quoted += Str[i];
+	}
+	return quoted + "\"";
+}
+
+static string QuoteJSON(const std::string& Str)
+{
+	string quoted = "\"";
+	for(size_t i = 0; i < Str.size(); i++)
+	{
+		if(Str[i] == '"' || Str[i] == '\\')
+			quoted += '\\';
+		if((unsigned char)Str[i] >= 0x20)
+			quoted += Str[i];
+	}
+	return quoted + "\"";
+}
+
+bool CBenchmarkTable::WriteCSV(const std::string& Path) const
+{
+	ofstream file(Path.c_str());
+	if(!file)
+	{
+		cerr<<"Could not write the benchmark results to "<<Path<<"."<<endl;
+		return false;
+	}
+
+	file<<setprecision(9);
+	file<<"device,task,variant,measurement,size,local_x,local_y,local_z,transfer,elements,bytes,samples,"
+		<<"min_ms,median_ms,mean_ms,max_ms,gelem_per_s,gb_per_s,valid"<<endl;
+
+	for(size_t i = 0; i < m_Rows.size(); i++)
+	{
+		const Row& r = m_Rows[i];
+		file<<QuoteCSV(m_Device)<<","<<QuoteCSV(r.Case.Task)<<","<<QuoteCSV(r.Case.Variant)<<","<<QuoteCSV(r.Measurement)<<","
+			<<r.Case.Size<<","<<r.Case.LocalWorkSize[0]<<","<<r.Case.LocalWorkSize[1]<<","<<r.Case.LocalWorkSize[2]<<","
+			<<QuoteCSV(r.Case.Transfer)<<","<<r.Elements<<","<<r.Bytes<<","<<r.Samples<<","
+			<<r.Time.Min<<","<<r.Time.Median<<","<<r.Time.Mean<<","<<r.Time.Max<<","
+			<<GetGElementsPerSecond(r)<<","<<GetGBytesPerSecond(r)<<","<<(r.Valid ? 1 : 0)<<endl;
+	}
+
+	cout<<"Benchmark results written to "<<Path<<endl;
+	return true;
+}
+
+bool CBenchmarkTable::WriteJSON(const std::string& Path) const
+{
+	ofstream file(Path.c_str());
+	if(!file)
+	{
+		cerr<<"Could not write the benchmark results to "<<Path<<"."<<endl;
+		return false;
+	}
+
+	file<<setprecision(9);
+	file<<"{"<<endl<<"\"device\": "<<QuoteJSON(m_Device)<<","<<endl<<"\"results\": ["<<endl;
+
+	for(size_t i = 0; i < m_Rows.size(); i++)
+	{
+		const Row& r = m_Rows[i];
+		file<<"{\"task\": "<<QuoteJSON(r.Case.Task)<<", \"variant\": "<<QuoteJSON(r.Case.Variant)
+			<<", \"measurement\": "<<QuoteJSON(r.Measurement)<<", \"size\": "<<r.Case.Size
+			<<", \"local\": ["<<r.Case.LocalWorkSize[0]<<", "<<r.Case.LocalWorkSize[1]<<", "<<r.Case.LocalWorkSize[2]<<"]"
+			<<", \"transfer\": "<<QuoteJSON(r.Case.Transfer)
+			<<", \"elements\": "<<r.Elements<<", \"bytes\": "<<r.Bytes<<", \"samples\": "<<r.Samples
+			<<", \"min_ms\": "<<r.Time.Min<<", \"median_ms\": "<<r.Time.Median<<", \"mean_ms\": "<<r.Time.Mean<<", \"max_ms\": "<<r.Time.Max
+			<<", \"gelem_per_s\": "<<GetGElementsPerSecond(r)<<", \"gb_per_s\": "<<GetGBytesPerSecond(r)
+			<<", \"valid\": "<<(r.Valid ? "true" : "false")<<"}"<<(i + 1 < m_Rows.size() ? "," : "")<<endl;
+	}
+
+	file<<"]"<<endl<<"}"<<endl;
+
+	cout<<"Benchmark results written to "<<Path<<endl;
+	return true;
+}
+
+bool CBenchmarkTable::Write(const CBenchmarkOptions& Options) const
+{
+	bool success = true;
+	if(!Options.CSVFile.empty())
+		success &= WriteCSV(Options.CSVFile);
+	if(!Options.JSONFile.empty())
+		success &= WriteJSON(Options.JSONFile);
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CBenchmarkRunner
+
+CBenchmarkRunner::CBenchmarkRunner()
+	: m_ListTasks(false)
+{
+}
+
+void CBenchmarkRunner::RegisterTask(const std::string& Name, TaskFactory Factory, const std::vector<size_t>& Sizes,
+	const std::vector<size_t>& LocalWorkSizes, const std::vector<std::string>& Variants)
+{
+	TaskEntry entry;
+	entry.Name = Name;
+	entry.Factory = Factory;
+	entry.Sizes = Sizes;
+	entry.LocalWorkSizes = LocalWorkSizes;
+	entry.Variants = Variants;
+	m_Tasks.push_back(entry);
+}
+
+bool CBenchmarkRunner::EnterMainLoop(int argc, char** argv)
+{
+	if(!ParseCommandLine(argc, argv))
+		return false;
+
+	if(m_ListTasks)
+	{
+		ListTasks();
+		return true;
+	}
+
+	if(m_ListDevices)
+	{
+		ListDevices();
+		return true;
+	}
+
+	if(!InitCLContext())
+		return false;
+
+	bool success = DoCompute();
+
+	ReleaseCLContext();
+
+	WriteTrace();
+
+	return success;
+}
+
+bool CBenchmarkRunner::ExpandConfigFiles(const std::vector<std::string>& Args, std::vector<std::string>& Expanded)
+{
+	for(size_t i = 0; i < Args.size(); i++)
+	{
+		if(Args[i] != "--config")
+		{
+			Expanded.push_back(Args[i]);
+			continue;
+		}
+
+		if(i + 1 == Args.size())
+		{
+			cerr<<"--config requires a file name."<<endl;
+			return false;
+		}
+
+		const string& path = Args[++i];
+		ifstream file(path.c_str());
+		if(!file)
+		{
+			cerr<<"Could not open the benchmark config "<<path<<"."<<endl;
+			return false;
+		}
+
+		vector<string> options;
+		string line, token;
+		while(getline(file, line))
+		{
+			line = line.substr(0, line.find('#'));
+			stringstream stream(line);
+			while(stream>>token)
+				options.push_back(token);
+		}
+
+		// configs can include other configs
+		if(!ExpandConfigFiles(options, Expanded))
+			return false;
+	}
+	return true;
+}
+
+bool CBenchmarkRunner::ParseCommandLine(int argc, char** argv)
+{
+	vector<string> args(argv + 1, argv + argc), expanded;
+	if(!ExpandConfigFiles(args, expanded))
+		return false;
+
+	// the options of the base class are evaluated there
+	m_Options = CBenchmarkOptions();
+	m_ListTasks = false;
+	vector<string> baseArgs(1, argc > 0 ? argv[0] : "");
+	vector<char*> expandedArgv(1, argc > 0 ? argv[0] : nullptr);
+	for(size_t i = 0; i < expanded.size(); i++)
+		expandedArgv.push_back(&expanded[i][0]);
+
+	bool error = false;
+	for(int i = 1; i < (int)expandedArgv.size(); i++)
+	{
+		if(m_Options.ParseOption((int)expandedArgv.size(), &expandedArgv[0], i, error))
+			continue;
+
+		if(expanded[i - 1] == "--list-tasks")
+			m_ListTasks = true;
+		else
+			baseArgs.push_back(expanded[i - 1]);
+	}
+	if(error)
+		return false;
+
+	for(size_t i = 0; i < m_Options.Tasks.size(); i++)
+	{
+		bool found = false;
+		for(size_t j = 0; j < m_Tasks.size(); j++)
+			found |= m_Tasks[j].Name == m_Options.Tasks[i];
+		if(!found)
+		{
+			cerr<<"Unknown benchmark task: "<<m_Options.Tasks[i]<<" (see --list-tasks)"<<endl;
+			return false;
+		}
+	}
+
+	vector<char*> baseArgv;
+	for(size_t i = 0; i < baseArgs.size(); i++)
+		baseArgv.push_back(&baseArgs[i][0]);
+	return CAssignmentBase::ParseCommandLine((int)baseArgv.size(), &baseArgv[0]);
+}
+
+void CBenchmarkRunner::GetCases(std::vector<BenchmarkCase>& Cases) const
+{
+	for(size_t t = 0; t < m_Tasks.size(); t++)
+	{
+		const TaskEntry& task = m_Tasks[t];
+		if(!m_Options.Tasks.empty() && find(m_Options.Tasks.begin(), m_Options.Tasks.end(), task.Name) == m_Options.Tasks.end())
+			continue;
+
+		const vector<string>& variants = m_Options.Variants.empty() ? task.Variants : m_Options.Variants;
+		const vector<size_t>& sizes = m_Options.Sizes.empty() ? task.Sizes : m_Options.Sizes;
+		const vector<size_t>& localWorkSizes = m_Options.LocalWorkSizes.empty() ? task.LocalWorkSizes : m_Options.LocalWorkSizes;
+
+		for(size_t v = 0; v < variants.size(); v++)
+		{
+			// selected variants only apply to the tasks which know them
+			if(!m_Options.Variants.empty() && find(task.Variants.begin(), task.Variants.end(), variants[v]) == task.Variants.end())
+				continue;
+
+			for(size_t s = 0; s < sizes.size(); s++)
+			{
+				for(size_t l = 0; l + 2 < localWorkSizes.size(); l += 3)
+				{
+					BenchmarkCase c;
+					c.Task = task.Name;
+					c.Variant = variants[v];
+					c.Size = sizes[s];
+					c.LocalWorkSize[0] = localWorkSizes[l];
+					c.LocalWorkSize[1] = localWorkSizes[l + 1];
+					c.LocalWorkSize[2] = localWorkSizes[l + 2];
+					Cases.push_back(c);
+				}
+			}
+		}
+	}
+}
+
+void CBenchmarkRunner::ListTasks() const
+{
+	for(size_t t = 0; t < m_Tasks.size(); t++)
+	{
+		const TaskEntry& task = m_Tasks[t];
+		cout<<task.Name<<endl<<"  variants:";
+		for(size_t i = 0; i < task.Variants.size(); i++)
+			cout<<" "<<task.Variants[i];
+		cout<<endl<<"  sizes:";
+		for(size_t i = 0; i < task.Sizes.size(); i++)
+			cout<<" "<<task.Sizes[i];
+		cout<<endl<<"  local work sizes:";
+		for(size_t i = 0; i + 2 < task.LocalWorkSizes.size(); i += 3)
+			cout<<" "<<FormatLocalWorkSize(&task.LocalWorkSizes[i]);
+		cout<<endl;
+	}
+}
+
+bool CBenchmarkRunner::DoCompute()
+{
+	char deviceName[256] = "";
+	clGetDeviceInfo(m_CLDevice, CL_DEVICE_NAME, sizeof(deviceName) - 1, deviceName, NULL);
+	m_Table.SetDevice(deviceName);
+
+	vector<BenchmarkCase> cases;
+	GetCases(cases);
+	if(cases.empty())
+	{
+		cerr<<"The selected options do not leave any benchmark case."<<endl;
+		return false;
+	}
+
+	CBenchmarkRecorder::SetEnabled(true);
+
+	bool success = true;
+	for(size_t i = 0; i < cases.size(); i++)
+	{
+		const BenchmarkCase& c = cases[i];
+		cout<<endl<<"########################################"<<endl;
+		cout<<"Benchmark "<<i + 1<<"/"<<cases.size()<<": "<<c.Task<<" ("<<c.Variant<<"), size "<<c.Size
+			<<", local work size "<<FormatLocalWorkSize(c.LocalWorkSize)<<endl<<endl;
+
+		for(size_t t = 0; t < m_Tasks.size(); t++)
+			if(m_Tasks[t].Name == c.Task)
+				success &= RunCase(c, m_Tasks[t].Factory);
+	}
+
+	CBenchmarkRecorder::SetEnabled(false);
+
+	m_Table.Print();
+	success &= m_Table.Write(m_Options);
+
+	return success;
+}
+
+bool CBenchmarkRunner::RunCase(const BenchmarkCase& Case, const TaskFactory& Factory)
+{
+	IComputeTask* pTask = Factory(Case);
+	if(!pTask)
+	{
+		cerr<<"The task "<<Case.Task<<" does not support this case, skipping it."<<endl;
+		return true;
+	}
+
+	CScopedTimer caseTimer("Benchmark " + Case.Task + " " + Case.Variant);
+
+	PrepareTask(*pTask);
+
+	if(!pTask->InitResources(m_CLDevice, m_CLContext))
+	{
+		cerr<<"Error during resource allocation, skipping the case."<<endl;
+		pTask->ReleaseResources();
+		delete pTask;
+		return false;
+	}
+
+	size_t elements = 0, bytes = 0;
+	pTask->GetWorkload(elements, bytes);
+
+	vector<CBenchmarkRecorder::Report> reports;
+	vector<double> cpuTimes, gpuTimes;
+
+	CTimer timer;
+	timer.Start();
+	pTask->ComputeCPU();
+	timer.Stop();
+	cpuTimes.push_back(timer.GetElapsedMilliseconds());
+
+	// the reports of the reference implementation are not part of the GPU results
+	CBenchmarkRecorder::TakeReports(reports);
+	reports.clear();
+
+	size_t localWorkSize[3] = {Case.LocalWorkSize[0], Case.LocalWorkSize[1], Case.LocalWorkSize[2]};
+	for(unsigned int run = 0; run < m_Options.Warmup + m_Options.Repeat; run++)
+	{
+		clFinish(m_CLCommandQueue);
+		timer.Start();
+		pTask->ComputeGPU(m_CLContext, m_CLCommandQueue, localWorkSize);
+		clFinish(m_CLCommandQueue);
+		timer.Stop();
+
+		if(run < m_Options.Warmup)
+		{
+			vector<CBenchmarkRecorder::Report> warmup;
+			CBenchmarkRecorder::TakeReports(warmup);
+			continue;
+		}
+
+		gpuTimes.push_back(timer.GetElapsedMilliseconds());
+		CBenchmarkRecorder::TakeReports(reports);
+	}
+
+	bool valid = pTask->ValidateResults();
+	cout<<(valid ? "GOLD TEST PASSED!" : "INVALID RESULTS!")<<endl;
+
+	// copy and zero-copy runs of the same case are told apart by the policy PrepareTask() resolved
+	BenchmarkCase run = Case;
+	run.Transfer = CLUtil::GetTransferPolicyName(pTask->GetTransferPolicy());
+	m_Table.Add(run, reports, elements, bytes, valid);
+	m_Table.Add(run, "ComputeGPU", elements, bytes, gpuTimes, valid);
+	m_Table.Add(run, "ComputeCPU", elements, bytes, cpuTimes, valid);
+
+	pTask->ReleaseResources();
+	delete pTask;
+
+	return valid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
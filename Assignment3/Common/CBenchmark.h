@@ -0,0 +1,228 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CBENCHMARK_H
+#define _CBENCHMARK_H
+
+#include "CAssignmentBase.h"
+#include "CLUtil.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//! Collects the times which the tasks measure themselves, e.g. in CLUtil::ProfileKernel()
+/*!
+	Reporting is disabled by default. The benchmark runner enables it and takes the reports
+	after each call of IComputeTask::ComputeGPU(), so the tasks do not need to know about it.
+*/
+class CBenchmarkRecorder
+{
+public:
+	struct Report
+	{
+		std::string		Measurement;
+		double			Milliseconds;
+	};
+
+	static void SetEnabled(bool Enabled);
+
+	static bool IsEnabled() { return s_Enabled; }
+
+	//! Adds a time in ms (of a single execution) under the name of what was measured
+	static void ReportTime(const std::string& Measurement, double Milliseconds);
+
+	//! Moves all reports since the last call into Reports
+	static void TakeReports(std::vector<Report>& Reports);
+
+protected:
+	static std::atomic<bool>	s_Enabled;
+	static std::mutex			s_Mutex;
+	static std::vector<Report>	s_Reports;
+};
+
+//! One point of the parameter grid
+struct BenchmarkCase
+{
+	std::string		Task;
+	std::string		Variant;
+	//! Problem size, its meaning is defined by the task (0 if the task has a fixed size)
+	size_t			Size;
+	size_t			LocalWorkSize[3];
+	//! Resolved transfer policy of the run (see CLUtil::GetTransferPolicyName()), set by the runner
+	std::string		Transfer;
+};
+
+//! Parameter grid and output files of a benchmark run
+/*!
+	The options are given on the command line or in a config file (see CBenchmarkRunner).
+	Every list option can be repeated or given as a comma separated list:
+
+	--task <name>		only run these tasks (default: all registered ones)
+	--variant <name>	only run these variants (default: the ones registered for the task)
+	--size <n>			problem sizes (default: the ones registered for the task)
+	--local <x[xy[xz]]>	local work sizes, e.g. 256 or 32x16 (default: the ones registered for the task)
+	--warmup <n>		untimed runs before the measurement (default: 1)
+	--repeat <n>		timed runs per case (default: 5)
+	--csv <file>		write the results as CSV
+	--json <file>		write the results as JSON
+*/
+class CBenchmarkOptions
+{
+public:
+	CBenchmarkOptions();
+
+	//! Evaluates the option at argv[i] and advances i past its value
+	/*!
+		Returns false if argv[i] is no benchmark option. Invalid values set Error.
+	*/
+	bool ParseOption(int argc, char** argv, int& i, bool& Error);
+
+	//! Parses a local work size like 32x16
+	static bool ParseLocalWorkSize(const std::string& Str, size_t LocalWorkSize[3]);
+
+	//! Splits a comma separated list
+	static std::vector<std::string> SplitList(const std::string& Str);
+
+	std::vector<std::string>	Tasks;
+	std::vector<std::string>	Variants;
+	std::vector<size_t>			Sizes;
+	//! three entries per local work size
+	std::vector<size_t>			LocalWorkSizes;
+
+	unsigned int				Warmup;
+	unsigned int				Repeat;
+
+	std::string					CSVFile;
+	std::string					JSONFile;
+};
+
+//! The measurements of a benchmark run and their export
+/*!
+	Each row is one measurement (a kernel, a task variant or the whole ComputeGPU() call) of a case.
+	The throughput is computed from the median time and the workload of the task
+	(see IComputeTask::GetWorkload()), it is 0 if the task does not define one.
+*/
+class CBenchmarkTable
+{
+public:
+	struct Row
+	{
+		BenchmarkCase			Case;
+		std::string				Measurement;
+		size_t					Elements;
+		size_t					Bytes;
+		size_t					Samples;
+		CLUtil::LatencyStats	Time;
+		bool					Valid;
+	};
+
+	void SetDevice(const std::string& Device) { m_Device = Device; }
+
+	//! Adds a row from the times of the single runs in ms
+	void Add(const BenchmarkCase& Case, const std::string& Measurement, size_t Elements, size_t Bytes,
+		const std::vector<double>& Samples, bool Valid);
+
+	//! Adds the reports of CBenchmarkRecorder, grouped by their measurement
+	void Add(const BenchmarkCase& Case, const std::vector<CBenchmarkRecorder::Report>& Reports,
+		size_t Elements, size_t Bytes, bool Valid);
+
+	const std::vector<Row>& GetRows() const { return m_Rows; }
+
+	//! Prints a summary table to cout
+	void Print() const;
+
+	bool WriteCSV(const std::string& Path) const;
+
+	bool WriteJSON(const std::string& Path) const;
+
+	//! Writes the files requested in the options
+	bool Write(const CBenchmarkOptions& Options) const;
+
+	//! Throughput of a row in Gelem/s and GB/s
+	static double GetGElementsPerSecond(const Row& R);
+	static double GetGBytesPerSecond(const Row& R);
+
+protected:
+	std::string			m_Device;
+	std::vector<Row>	m_Rows;
+};
+
+//! Runs registered compute tasks over a parameter grid and exports the results
+/*!
+	Usage: create a runner in a main(), register the tasks of the assignment and call EnterMainLoop().
+	The factory creates a task for a case, or returns nullptr if it cannot handle the case.
+
+	For every case the task is initialized once and its CPU reference is computed once.
+	Then ComputeGPU() is called Warmup + Repeat times and the times reported by the task
+	(CBenchmarkRecorder) and the time of each whole ComputeGPU() call are recorded.
+	Finally the results are validated and the resources are released.
+
+	In addition to the options of CBenchmarkOptions and CAssignmentBase:
+	--config <file>		reads further options from <file>. They are separated by whitespace,
+						a '#' starts a comment which ends at the end of the line.
+	--list-tasks		prints the registered tasks with their default grid and exits
+*/
+class CBenchmarkRunner : public CAssignmentBase
+{
+public:
+	typedef std::function<IComputeTask*(const BenchmarkCase& Case)> TaskFactory;
+
+	CBenchmarkRunner();
+
+	//! Adds a task with its default grid. LocalWorkSizes has three entries per local work size.
+	void RegisterTask(const std::string& Name, TaskFactory Factory, const std::vector<size_t>& Sizes,
+		const std::vector<size_t>& LocalWorkSizes, const std::vector<std::string>& Variants = std::vector<std::string>(1, "default"));
+
+	virtual bool EnterMainLoop(int argc, char** argv);
+
+	virtual bool DoCompute();
+
+protected:
+	struct TaskEntry
+	{
+		std::string					Name;
+		TaskFactory					Factory;
+		std::vector<size_t>			Sizes;
+		std::vector<size_t>			LocalWorkSizes;
+		std::vector<std::string>	Variants;
+	};
+
+	virtual bool ParseCommandLine(int argc, char** argv);
+
+	//! Replaces --config <file> by the options in the file
+	static bool ExpandConfigFiles(const std::vector<std::string>& Args, std::vector<std::string>& Expanded);
+
+	//! All cases of the grid, in the order of registration
+	void GetCases(std::vector<BenchmarkCase>& Cases) const;
+
+	//! Returns false if the case could not run or its results are invalid
+	bool RunCase(const BenchmarkCase& Case, const TaskFactory& Factory);
+
+	void ListTasks() const;
+
+	std::vector<TaskEntry>	m_Tasks;
+	CBenchmarkOptions		m_Options;
+	CBenchmarkTable			m_Table;
+	bool					m_ListTasks;
+};
+
+#endif // _CBENCHMARK_H
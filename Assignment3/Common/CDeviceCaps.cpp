@@ -0,0 +1,192 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CDeviceCaps.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+
+using namespace std;
+
+// vendor specific queries, not all headers define them
+#ifndef CL_DEVICE_WARP_SIZE_NV
+#define CL_DEVICE_WARP_SIZE_NV			0x4003
+#endif
+#ifndef CL_DEVICE_WAVEFRONT_WIDTH_AMD
+#define CL_DEVICE_WAVEFRONT_WIDTH_AMD	0x4043
+#endif
+#ifndef CL_DEVICE_SUB_GROUP_SIZES_INTEL
+#define CL_DEVICE_SUB_GROUP_SIZES_INTEL	0x4108
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// CDeviceCaps
+
+static const char* c_ProbeKernel = "__kernel void Probe(__global uint* a) { a[get_global_id(0)] = 0; }";
+
+static string QueryDeviceString(cl_device_id Device, cl_device_info Info)
+{
+	size_t size = 0;
+	if(clGetDeviceInfo(Device, Info, 0, NULL, &size) != CL_SUCCESS || size == 0)
+		return "";
+	vector<char> buffer(size);
+	clGetDeviceInfo(Device, Info, size, &buffer[0], NULL);
+	return string(&buffer[0]);
+}
+
+static cl_uint Log2(size_t Value)
+{
+	cl_uint log = 0;
+	while(Value > 1)
+	{
+		Value >>= 1;
+		log++;
+	}
+	return log;
+}
+
+CDeviceCaps::CDeviceCaps()
+	: Type(CL_DEVICE_TYPE_GPU), OpenCLCVersion(120), ComputeUnits(1), GlobalMemSize(0), MaxAllocSize(0), LocalMemSize(32768),
+	DedicatedLocalMem(true), MaxWorkGroupSize(1024), PreferredWorkGroupMultiple(32), SIMDWidth(1), NumLocalBanks(32)
+{
+}
+
+bool CDeviceCaps::Query(cl_device_id Device, cl_context Context)
+{
+	cl_int clError;
+	Name = QueryDeviceString(Device, CL_DEVICE_NAME);
+	Vendor = QueryDeviceString(Device, CL_DEVICE_VENDOR);
+	Extensions = QueryDeviceString(Device, CL_DEVICE_EXTENSIONS);
+
+	// "OpenCL C <major>.<minor> <vendor specific>"
+	int major = 1, minor = 0;
+	string version = QueryDeviceString(Device, CL_DEVICE_OPENCL_C_VERSION);
+	if(sscanf(version.c_str(), "OpenCL C %d.%d", &major, &minor) == 2)
+		OpenCLCVersion = cl_uint(100 * major + 10 * minor);
+	else
+		OpenCLCVersion = 100;
+
+	cl_device_local_mem_type localMemType = CL_LOCAL;
+	clError = clGetDeviceInfo(Device, CL_DEVICE_TYPE, sizeof(Type), &Type, NULL);
+	clError |= clGetDeviceInfo(Device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(ComputeUnits), &ComputeUnits, NULL);
+	clError |= clGetDeviceInfo(Device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(GlobalMemSize), &GlobalMemSize, NULL);
+	clError |= clGetDeviceInfo(Device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(MaxAllocSize), &MaxAllocSize, NULL);
+	clError |= clGetDeviceInfo(Device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(LocalMemSize), &LocalMemSize, NULL);
+	clError |= clGetDeviceInfo(Device, CL_DEVICE_LOCAL_MEM_TYPE, sizeof(localMemType), &localMemType, NULL);
+	clError |= clGetDeviceInfo(Device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(MaxWorkGroupSize), &MaxWorkGroupSize, NULL);
+	if(clError != CL_SUCCESS)
+	{
+		cerr<<"Error: Failed to query the device capabilities."<<endl;
+		return false;
+	}
+	DedicatedLocalMem = (localMemType == CL_LOCAL);
+
+	// the preferred multiple is a property of kernels, a trivial one shows the device's value
+	PreferredWorkGroupMultiple = 0;
+	cl_program program = clCreateProgramWithSource(Context, 1, &c_ProbeKernel, NULL, &clError);
+	if(clError == CL_SUCCESS && clBuildProgram(program, 1, &Device, NULL, NULL, NULL) == CL_SUCCESS)
+	{
+		cl_kernel kernel = clCreateKernel(program, "Probe", &clError);
+		if(clError == CL_SUCCESS)
+		{
+			clGetKernelWorkGroupInfo(kernel, Device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+				sizeof(PreferredWorkGroupMultiple), &PreferredWorkGroupMultiple, NULL);
+			clReleaseKernel(kernel);
+		}
+	}
+	if(program)
+		clReleaseProgram(program);
+
+	SubGroupSizes.clear();
+	if(HasExtension("cl_intel_required_subgroup_size"))
+	{
+		size_t size = 0;
+		if(clGetDeviceInfo(Device, CL_DEVICE_SUB_GROUP_SIZES_INTEL, 0, NULL, &size) == CL_SUCCESS && size > 0)
+		{
+			SubGroupSizes.resize(size / sizeof(size_t));
+			clGetDeviceInfo(Device, CL_DEVICE_SUB_GROUP_SIZES_INTEL, size, &SubGroupSizes[0], NULL);
+		}
+	}
+
+	// the kernels drop barriers within SIMDWidth work-items, so only sizes which are guaranteed
+	// to run in lockstep count: warps and wavefronts of GPUs, and the smallest sub-group size a
+	// kernel may be compiled for. The preferred multiple is not such a guarantee (CPUs report
+	// their vector width), so everything else runs with barriers.
+	cl_uint width = 0;
+	if(Type & CL_DEVICE_TYPE_GPU)
+	{
+		if(HasExtension("cl_nv_device_attribute_query"))
+			clGetDeviceInfo(Device, CL_DEVICE_WARP_SIZE_NV, sizeof(width), &width, NULL);
+		else if(HasExtension("cl_amd_device_attribute_query"))
+			clGetDeviceInfo(Device, CL_DEVICE_WAVEFRONT_WIDTH_AMD, sizeof(width), &width, NULL);
+	}
+	if(width > 0)
+		SIMDWidth = width;
+	else if((Type & CL_DEVICE_TYPE_GPU) && !SubGroupSizes.empty())
+		SIMDWidth = *min_element(SubGroupSizes.begin(), SubGroupSizes.end());
+	else
+		SIMDWidth = 1;
+	if(PreferredWorkGroupMultiple == 0)
+		PreferredWorkGroupMultiple = SIMDWidth;
+
+	// the bank count cannot be queried: NVIDIA and AMD GPUs have 32 banks, Intel GPUs 16
+	if(!DedicatedLocalMem)
+		NumLocalBanks = 0;
+	else if(Vendor.find("Intel") != string::npos)
+		NumLocalBanks = 16;
+	else
+		NumLocalBanks = 32;
+
+	return true;
+}
+
+bool CDeviceCaps::HasExtension(const string& Extension) const
+{
+	// the extensions are separated by spaces, compare whole names only
+	istringstream stream(Extensions);
+	string name;
+	while(stream >> name)
+	{
+		if(name == Extension)
+			return true;
+	}
+	return false;
+}
+
+size_t CDeviceCaps::GetLocalMemoryElements(size_t ElementSize) const
+{
+	size_t elements = size_t(LocalMemSize / ElementSize);
+	return elements > 0 ? size_t(1) << Log2(elements) : 0;
+}
+
+string CDeviceCaps::GetBuildOptions() const
+{
+	ostringstream options;
+	options<<"-D DEVICE_LOCAL_MEM_SIZE="<<LocalMemSize
+		<<" -D DEVICE_SIMD_WIDTH="<<SIMDWidth
+		<<" -D SIMD_GROUP_SIZE="<<SIMDWidth
+		<<" -D NUM_BANKS="<<NumLocalBanks
+		<<" -D NUM_BANKS_LOG="<<Log2(NumLocalBanks);
+	return options.str();
+}
+
+void CDeviceCaps::Print() const
+{
+	cout<<"Device capabilities:"<<endl;
+	cout<<"  OpenCL C "<<OpenCLCVersion / 100<<"."<<(OpenCLCVersion / 10) % 10<<", compute units: "<<ComputeUnits<<", max work-group size: "<<MaxWorkGroupSize
+		<<", preferred multiple: "<<PreferredWorkGroupMultiple<<", SIMD width: "<<SIMDWidth<<endl;
+	cout<<"  Local memory: "<<(LocalMemSize >> 10)<<" KB"<<(DedicatedLocalMem ? "" : " (in global memory)")
+		<<", banks: "<<NumLocalBanks<<endl;
+	cout<<"  Global memory: "<<(GlobalMemSize >> 20)<<" MB, max allocation: "<<(MaxAllocSize >> 20)<<" MB"<<endl;
+	if(!SubGroupSizes.empty())
+	{
+		cout<<"  Sub-group sizes:";
+		for(size_t i = 0; i < SubGroupSizes.size(); i++)
+			cout<<" "<<SubGroupSizes[i];
+		cout<<endl;
+	}
+}
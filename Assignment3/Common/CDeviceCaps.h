@@ -0,0 +1,90 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CDEVICE_CAPS_H
+#define _CDEVICE_CAPS_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include <string>
+#include <vector>
+
+//! Capabilities of the OpenCL device, queried once in CAssignmentBase::InitCLContext()
+/*!
+	The tasks get them with IComputeTask::GetDeviceCaps() and derive their kernel parameters
+	from them instead of assuming the values of one particular GPU. GetBuildOptions()
+	passes the values to the kernels as defines.
+
+	A default constructed object describes the GPU the kernels were written for
+	(32 KB local memory, 32 banks), it is used if nothing was queried. Its SIMD width is 1,
+	so the kernels keep all barriers on an unknown device.
+*/
+struct CDeviceCaps
+{
+	CDeviceCaps();
+
+	//! Queries all capabilities. The context is needed to compile a probe kernel
+	//! for the preferred work-group size multiple.
+	bool Query(cl_device_id Device, cl_context Context);
+
+	bool HasExtension(const std::string& Extension) const;
+
+	//! Largest power of two of elements with ElementSize bytes which fits into the local memory
+	size_t GetLocalMemoryElements(size_t ElementSize) const;
+
+	//! Defines for the kernels: DEVICE_LOCAL_MEM_SIZE, DEVICE_SIMD_WIDTH, NUM_BANKS, NUM_BANKS_LOG
+	//! and SIMD_GROUP_SIZE (the same as DEVICE_SIMD_WIDTH, used by the scan kernels)
+	std::string GetBuildOptions() const;
+
+	void Print() const;
+
+	std::string		Name;
+	std::string		Vendor;
+	std::string		Extensions;
+	cl_device_type	Type;
+	//! OpenCL C version of the device as 100 * major + 10 * minor, e.g. 120 for OpenCL C 1.2
+	cl_uint			OpenCLCVersion;
+
+	cl_uint			ComputeUnits;
+	cl_ulong		GlobalMemSize;
+	cl_ulong		MaxAllocSize;
+	cl_ulong		LocalMemSize;
+	//! false if the local memory is emulated in global memory (CPUs), then padding against bank conflicts is useless
+	bool			DedicatedLocalMem;
+
+	size_t			MaxWorkGroupSize;
+	//! CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE of a simple kernel
+	size_t			PreferredWorkGroupMultiple;
+	//! sub-group sizes the device supports (cl_intel_subgroups), empty if unknown
+	std::vector<size_t>	SubGroupSizes;
+
+	//! Number of work-items which are guaranteed to execute in lockstep (warp / wavefront / smallest sub-group size of a GPU, 1 otherwise)
+	size_t			SIMDWidth;
+	//! Number of local memory banks, 0 if the local memory has no banks
+	cl_uint			NumLocalBanks;
+};
+
+#endif // _CDEVICE_CAPS_H
@@ -0,0 +1,285 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CEXPRESSION_H
+#define _CEXPRESSION_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! Fused elementwise array expressions
+/*!
+	An expression like A + Reverse(B) * 2 is not evaluated when it is written, it only builds
+	a tree of small objects. EvaluateExpression() turns the tree into the source of a single
+	kernel which computes one element of the target per work-item, so no temporary device
+	buffers are needed for the intermediate results.
+
+	Usage:
+	CDeviceArray<cl_int> A(m_dA, n), B(m_dB, n), C(m_dC, n);
+	V_RETURN_CL(EvaluateExpression(CommandQueue, C, A + Reverse(B) * 2), "...");
+
+	Scalars are passed as kernel arguments, so expressions which only differ in their
+	constants share one kernel. The programs are built through CLUtil (and its program
+	cache), the kernels are cached per context and generated source.
+
+	All arrays of an expression must have the size of the target. The target may also
+	be an operand, unless it is read at other positions (e.g. C = Reverse(C)).
+*/
+
+//! OpenCL name of an element type of expressions
+template<class T> struct CLTypeName;
+template<> struct CLTypeName<cl_int> { static const char* Get() { return "int"; } };
+template<> struct CLTypeName<cl_uint> { static const char* Get() { return "uint"; } };
+template<> struct CLTypeName<cl_float> { static const char* Get() { return "float"; } };
+
+//! Collects the kernel parameters while the code of an expression is generated
+class CExpressionBuilder
+{
+public:
+	CExpressionBuilder(size_t Size);
+
+	//! Returns the code reading element Index of Buffer
+	std::string ReadBuffer(cl_mem Buffer, size_t Size, const char* TypeName, const std::string& Index);
+
+	//! Returns the name of the kernel parameter passing the value
+	std::string AddScalar(const void* pValue, size_t ValueSize, const char* TypeName);
+
+	//! Name of the element index in the generated code
+	static const char* GetIndex() { return "i"; }
+
+	//! Name of the number of elements in the generated code
+	static const char* GetSize() { return "n"; }
+
+	//! Source of the kernel computing Target[i] = Code
+	std::string GetSource(const char* TypeName, const std::string& Code) const;
+
+	//! Returns the cached kernel for the code with the arguments set, or nullptr on failure
+	cl_kernel PrepareKernel(cl_command_queue Queue, cl_mem Target, const char* TypeName, const std::string& Code);
+
+	//! Launches a prepared kernel over all elements (LocalWorkSize 0: chosen by the driver)
+	cl_int EnqueueKernel(cl_command_queue Queue, cl_kernel Kernel, size_t LocalWorkSize) const;
+
+	//! Releases the cached kernels of the given context (or of all contexts if nullptr)
+	static void ReleaseKernels(cl_context Context = nullptr);
+
+protected:
+	struct Parameter
+	{
+		std::string					Declaration;
+		cl_mem						Buffer;
+		//! read at other positions than the element which is written
+		bool						Shifted;
+		std::vector<unsigned char>	Value;
+	};
+
+	size_t					m_Size;
+	bool					m_SizeMismatch;
+	std::vector<Parameter>	m_Parameters;
+
+	static std::mutex											s_KernelsMutex;
+	static std::map<std::pair<cl_context, std::string>, cl_kernel>	s_Kernels;
+};
+
+//! Base of all expression nodes, E::ValueType is the element type
+template<class E>
+struct CExpression
+{
+	const E& Get() const { return static_cast<const E&>(*this); }
+};
+
+//! View of a device buffer with Size elements of type T, it does not own the buffer
+template<class T>
+class CDeviceArray : public CExpression<CDeviceArray<T> >
+{
+public:
+	typedef T ValueType;
+
+	CDeviceArray(cl_mem Buffer, size_t Size) : m_Buffer(Buffer), m_Size(Size) {}
+
+	cl_mem GetBuffer() const { return m_Buffer; }
+
+	size_t GetSize() const { return m_Size; }
+
+	std::string Generate(CExpressionBuilder& Builder, const std::string& Index) const
+	{
+		return Builder.ReadBuffer(m_Buffer, m_Size, CLTypeName<T>::Get(), Index);
+	}
+
+protected:
+	cl_mem	m_Buffer;
+	size_t	m_Size;
+};
+
+//! A constant, passed as kernel argument
+template<class T>
+class CScalarExpr : public CExpression<CScalarExpr<T> >
+{
+public:
+	typedef T ValueType;
+
+	CScalarExpr(T Value) : m_Value(Value) {}
+
+	std::string Generate(CExpressionBuilder& Builder, const std::string& Index) const
+	{
+		return Builder.AddScalar(&m_Value, sizeof(T), CLTypeName<T>::Get());
+	}
+
+protected:
+	T	m_Value;
+};
+
+//! Element n - 1 - i of the operand
+template<class E>
+class CReverseExpr : public CExpression<CReverseExpr<E> >
+{
+public:
+	typedef typename E::ValueType ValueType;
+
+	CReverseExpr(const E& Operand) : m_Operand(Operand) {}
+
+	std::string Generate(CExpressionBuilder& Builder, const std::string& Index) const
+	{
+		return m_Operand.Generate(Builder, std::string("(") + CExpressionBuilder::GetSize() + " - 1 - " + Index + ")");
+	}
+
+protected:
+	E	m_Operand;
+};
+
+template<class E>
+class CNegateExpr : public CExpression<CNegateExpr<E> >
+{
+public:
+	typedef typename E::ValueType ValueType;
+
+	CNegateExpr(const E& Operand) : m_Operand(Operand) {}
+
+	std::string Generate(CExpressionBuilder& Builder, const std::string& Index) const
+	{
+		return "(-" + m_Operand.Generate(Builder, Index) + ")";
+	}
+
+protected:
+	E	m_Operand;
+};
+
+//! An infix operator (e.g. "+") or a function of two arguments (e.g. "min")
+template<class L, class R>
+class CBinaryExpr : public CExpression<CBinaryExpr<L, R> >
+{
+public:
+	typedef typename L::ValueType ValueType;
+	static_assert(std::is_same<ValueType, typename R::ValueType>::value, "Both operands must have the same element type");
+
+	CBinaryExpr(const L& Left, const R& Right, const char* Operator, bool Function)
+		: m_Left(Left), m_Right(Right), m_Operator(Operator), m_Function(Function) {}
+
+	std::string Generate(CExpressionBuilder& Builder, const std::string& Index) const
+	{
+		std::string left = m_Left.Generate(Builder, Index);
+		std::string right = m_Right.Generate(Builder, Index);
+		if(m_Function)
+			return std::string(m_Operator) + "(" + left + ", " + right + ")";
+		return "(" + left + " " + m_Operator + " " + right + ")";
+	}
+
+protected:
+	L			m_Left;
+	R			m_Right;
+	const char*	m_Operator;
+	bool		m_Function;
+};
+
+// Operators for two expressions and for an expression and a scalar (converted to its element type)
+#define EXPRESSION_BINARY_OPERATOR(OP, NAME, FUNCTION) \
+	template<class L, class R> \
+	CBinaryExpr<L, R> OP(const CExpression<L>& Left, const CExpression<R>& Right) \
+	{ return CBinaryExpr<L, R>(Left.Get(), Right.Get(), NAME, FUNCTION); } \
+	template<class L> \
+	CBinaryExpr<L, CScalarExpr<typename L::ValueType> > OP(const CExpression<L>& Left, typename L::ValueType Right) \
+	{ return CBinaryExpr<L, CScalarExpr<typename L::ValueType> >(Left.Get(), Right, NAME, FUNCTION); } \
+	template<class R> \
+	CBinaryExpr<CScalarExpr<typename R::ValueType>, R> OP(typename R::ValueType Left, const CExpression<R>& Right) \
+	{ return CBinaryExpr<CScalarExpr<typename R::ValueType>, R>(Left, Right.Get(), NAME, FUNCTION); }
+
+EXPRESSION_BINARY_OPERATOR(operator+, "+", false)
+EXPRESSION_BINARY_OPERATOR(operator-, "-", false)
+EXPRESSION_BINARY_OPERATOR(operator*, "*", false)
+EXPRESSION_BINARY_OPERATOR(operator/, "/", false)
+EXPRESSION_BINARY_OPERATOR(Min, "min", true)
+EXPRESSION_BINARY_OPERATOR(Max, "max", true)
+
+#undef EXPRESSION_BINARY_OPERATOR
+
+template<class E>
+CNegateExpr<E> operator-(const CExpression<E>& Operand)
+{
+	return CNegateExpr<E>(Operand.Get());
+}
+
+template<class E>
+CReverseExpr<E> Reverse(const CExpression<E>& Operand)
+{
+	return CReverseExpr<E>(Operand.Get());
+}
+
+//! Returns the fused kernel computing Target[i] = Expr for all elements of Target, nullptr on failure
+/*!
+	The kernel belongs to the cache (see CExpressionBuilder::ReleaseKernels()), do not release it.
+	Its arguments stay valid until the next expression with the same code is prepared.
+	The kernel has one work-item per element, e.g. for CLUtil::ProfileKernel().
+*/
+template<class T, class E>
+cl_kernel PrepareExpression(cl_command_queue Queue, const CDeviceArray<T>& Target, const CExpression<E>& Expr)
+{
+	static_assert(std::is_same<T, typename E::ValueType>::value, "The expression must have the element type of the target");
+
+	CExpressionBuilder builder(Target.GetSize());
+	std::string code = Expr.Get().Generate(builder, CExpressionBuilder::GetIndex());
+	return builder.PrepareKernel(Queue, Target.GetBuffer(), CLTypeName<T>::Get(), code);
+}
+
+//! Enqueues the computation of Target[i] = Expr for all elements of Target
+template<class T, class E>
+cl_int EvaluateExpression(cl_command_queue Queue, const CDeviceArray<T>& Target, const CExpression<E>& Expr, size_t LocalWorkSize = 0)
+{
+	static_assert(std::is_same<T, typename E::ValueType>::value, "The expression must have the element type of the target");
+
+	CExpressionBuilder builder(Target.GetSize());
+	std::string code = Expr.Get().Generate(builder, CExpressionBuilder::GetIndex());
+	cl_kernel kernel = builder.PrepareKernel(Queue, Target.GetBuffer(), CLTypeName<T>::Get(), code);
+	if(kernel == nullptr)
+		return CL_INVALID_KERNEL;
+	return builder.EnqueueKernel(Queue, kernel, LocalWorkSize);
+}
+
+#endif // _CEXPRESSION_H
@@ -0,0 +1,193 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CThreadPool.h"
+
+#include <stdlib.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CThreadPool
+
+std::unique_ptr<CThreadPool> CThreadPool::s_Pool;
+unsigned int CThreadPool::s_NumThreads = 0;
+std::mutex CThreadPool::s_PoolMutex;
+
+// the pool (if any) the current thread is a worker of and the index of its queue
+static thread_local const CThreadPool* s_pWorkerPool = nullptr;
+static thread_local unsigned int s_WorkerQueue = 0;
+
+CThreadPool::CThreadPool(unsigned int NumThreads)
+	: m_NumQueuedTasks(0), m_Stop(false)
+{
+	if(NumThreads == 0)
+		NumThreads = max(1u, thread::hardware_concurrency());
+
+	// queue 0 belongs to the threads calling ParallelFor(), the others to the workers
+	for(unsigned int i = 0; i < NumThreads; i++)
+		m_Queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+
+	for(unsigned int i = 1; i < NumThreads; i++)
+		m_Threads.push_back(thread(&CThreadPool::WorkerMain, this, i));
+}
+
+CThreadPool::~CThreadPool()
+{
+	{
+		lock_guard<mutex> lock(m_WakeMutex);
+		m_Stop = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for(size_t i = 0; i < m_Threads.size(); i++)
+		m_Threads[i].join();
+}
+
+CThreadPool& CThreadPool::Get()
+{
+	lock_guard<mutex> lock(s_PoolMutex);
+	if(!s_Pool)
+	{
+		unsigned int numThreads = s_NumThreads;
+		const char* env = getenv("CPU_THREADS");
+		if(numThreads == 0 && env)
+			numThreads = (unsigned int)atoi(env);
+		s_Pool.reset(new CThreadPool(numThreads));
+	}
+	return *s_Pool;
+}
+
+void CThreadPool::SetNumThreads(unsigned int NumThreads)
+{
+	lock_guard<mutex> lock(s_PoolMutex);
+	s_NumThreads = NumThreads;
+	// the pool is created again with the new size on the next Get()
+	s_Pool.reset();
+}
+
+void CThreadPool::ParallelFor(size_t Begin, size_t End, size_t Grain, const RangeFunction& Body)
+{
+	if(End <= Begin)
+		return;
+
+	if(Grain == 0)
+		Grain = 1;
+
+	if(m_Threads.empty() || End - Begin <= Grain)
+	{
+		Body(Begin, End);
+		return;
+	}
+
+	Job job;
+	job.pBody = &Body;
+	job.Grain = Grain;
+	job.Remaining = End - Begin;
+
+	unsigned int queue = GetQueueIndex();
+	Task first = { &job, Begin, End };
+	Execute(queue, first);
+
+	// help with the remaining work (also of other loops) until our loop is done
+	while(job.Remaining.load() > 0)
+	{
+		Task t;
+		if(Pop(queue, t))
+			Execute(queue, t);
+		else
+			this_thread::yield();
+	}
+}
+
+void CThreadPool::WorkerMain(unsigned int Index)
+{
+	s_pWorkerPool = this;
+	s_WorkerQueue = Index;
+
+	for(;;)
+	{
+		Task t;
+		if(Pop(Index, t))
+		{
+			Execute(Index, t);
+			continue;
+		}
+
+		unique_lock<mutex> lock(m_WakeMutex);
+		m_WakeCondition.wait(lock, [this]() { return m_Stop || m_NumQueuedTasks.load() > 0; });
+		if(m_Stop)
+			return;
+	}
+}
+
+void CThreadPool::Push(unsigned int Queue, const Task& T)
+{
+	{
+		// taking the lock makes sure a worker cannot miss the notification between its check and its wait
+		lock_guard<mutex> lock(m_WakeMutex);
+		m_NumQueuedTasks++;
+	}
+	{
+		lock_guard<mutex> lock(m_Queues[Queue]->Mutex);
+		m_Queues[Queue]->Tasks.push_back(T);
+	}
+	m_WakeCondition.notify_one();
+}
+
+bool CThreadPool::Pop(unsigned int Queue, Task& T)
+{
+	// own queue: newest task, its data is most likely still in the cache
+	{
+		WorkQueue& q = *m_Queues[Queue];
+		lock_guard<mutex> lock(q.Mutex);
+		if(!q.Tasks.empty())
+		{
+			T = q.Tasks.back();
+			q.Tasks.pop_back();
+			m_NumQueuedTasks--;
+			return true;
+		}
+	}
+
+	// other queues: oldest task, which is the largest range
+	for(size_t i = 1; i < m_Queues.size(); i++)
+	{
+		WorkQueue& q = *m_Queues[(Queue + i) % m_Queues.size()];
+		lock_guard<mutex> lock(q.Mutex);
+		if(!q.Tasks.empty())
+		{
+			T = q.Tasks.front();
+			q.Tasks.pop_front();
+			m_NumQueuedTasks--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CThreadPool::Execute(unsigned int Queue, Task T)
+{
+	// split until the range is small enough, leaving the upper halves for thieves
+	while(T.End - T.Begin > T.pJob->Grain)
+	{
+		size_t mid = T.Begin + (T.End - T.Begin) / 2;
+		Task upper = { T.pJob, mid, T.End };
+		Push(Queue, upper);
+		T.End = mid;
+	}
+
+	(*T.pJob->pBody)(T.Begin, T.End);
+
+	T.pJob->Remaining -= T.End - T.Begin;
+}
+
+unsigned int CThreadPool::GetQueueIndex() const
+{
+	return (s_pWorkerPool == this) ? s_WorkerQueue : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
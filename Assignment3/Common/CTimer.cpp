@@ -10,38 +10,46 @@ GPU Computing / GPGPU Praktikum source code.
 
 void CTimer::Start()
 {
-#ifdef _WIN32
-	QueryPerformanceCounter(&m_StartTime);
-#else
-	gettimeofday(&m_StartTime, NULL);
-#endif
+	m_StartTime = GetTimestamp();
 }
 
 void CTimer::Stop()
 {
-#ifdef _WIN32
-	QueryPerformanceCounter(&m_EndTime);
-#else
-	gettimeofday(&m_EndTime, NULL);
-#endif
+	m_EndTime = GetTimestamp();
 }
 
 double CTimer::GetElapsedMilliseconds()
+{
+	return 1.0e-6 * double(m_EndTime - m_StartTime);
+}
+
+unsigned long long CTimer::GetElapsedNanoseconds()
+{
+	return m_EndTime - m_StartTime;
+}
+
+unsigned long long CTimer::GetTimestamp()
 {
 #ifdef _WIN32
-	LARGE_INTEGER freq;
-	if(QueryPerformanceFrequency(&freq))
-	{
-		return 1000.0 * double(m_EndTime.QuadPart - m_StartTime.QuadPart) / double(freq.QuadPart);
-	}
-	else
-	{
-		return -1;
-	}
+	static LARGE_INTEGER freq = { 0 };
+	if(freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	// split the conversion to avoid overflowing 64 bit
+	unsigned long long seconds = counter.QuadPart / freq.QuadPart;
+	unsigned long long remainder = counter.QuadPart % freq.QuadPart;
+	return seconds * 1000000000ull + remainder * 1000000000ull / freq.QuadPart;
+#elif defined (__APPLE__) || defined(MACOSX)
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if(timebase.denom == 0)
+		mach_timebase_info(&timebase);
+	return mach_absolute_time() * timebase.numer / timebase.denom;
 #else
-	double delta = ((double)m_EndTime.tv_sec + 1.0e-6 * (double)m_EndTime.tv_usec) - 
-		((double)m_StartTime.tv_sec + 1.0e-6 * (double)m_StartTime.tv_usec);
-	return 1000.0 * delta;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
 #endif
 }
 
@@ -10,6 +10,8 @@ GPU Computing / GPGPU Praktikum source code.
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include "GLCommon.h"
 
@@ -20,12 +22,30 @@ GPU Computing / GPGPU Praktikum source code.
 #include <GL/glx.h>
 #endif
 
+#if defined (__APPLE__) || defined(MACOSX)
+   #define GL_SHARING_EXTENSION "cl_APPLE_gl_sharing"
+#else
+   #define GL_SHARING_EXTENSION "cl_khr_gl_sharing"
+#endif
+
 
 using namespace std;
 
 ///////////////////////////////////////////////////////////////////////////////
 // CAssignment4
 
+// tasks which can be selected with --task, with their default size and local work size
+static const struct
+{
+	const char*	Name;
+	size_t		Size;
+	size_t		LocalWorkSize[3];
+} c_Tasks[] =
+{
+	{ "particles", 1024 * 192, { 192, 1, 1 } },
+	{ "cloth", 64, { 16, 16, 1 } },
+};
+
 CAssignment4* CAssignment4::s_pSingletonInstance = NULL;
 
 CAssignment4* CAssignment4::GetSingleton()
@@ -37,33 +57,96 @@ CAssignment4* CAssignment4::GetSingleton()
 }
 
 CAssignment4::CAssignment4()
-	: m_Window(nullptr), m_WindowWidth(1024), m_WindowHeight(768), m_PrevTime(-1.0)
+	: m_Window(nullptr), m_WindowWidth(1024), m_WindowHeight(768), m_pCurrentTask(nullptr), m_Headless(false), m_PrevTime(-1.0)
 {
+	// the simulation renders directly from the CL buffers
+	m_RequiredExtension = GL_SHARING_EXTENSION;
+
 	// select task here...
-	// This time you have to do it during compile time
+	// (or with --task, the task is created in EnterMainLoop())
 	
 #if 0
-	cout<<"########################################"<<endl;
-	cout<<"TASK 1: Particle System"<<endl<<endl;
+	m_TaskName = "particles";
+#else
+	m_TaskName = "cloth";
+#endif
 
-	std::string meshPath = "../Assignment4/Assets/cubeJump.obj";
-	// Uncomment this to test your application with more triangles!
-	// meshPath = "../Assignment4/Assets/cubeMonkey.obj";
+	// a frame is short, so the headless benchmark needs more of them than the other runners
+	m_BenchmarkOptions.Warmup = 10;
+	m_BenchmarkOptions.Repeat = 100;
+}
 
-	m_LocalWorkSize[0] = 192;
-	m_LocalWorkSize[1] = 1;
-	m_LocalWorkSize[2] = 1;
-	m_pCurrentTask = new CParticleSystemTask(meshPath, 1024 * 192, m_LocalWorkSize);
-#else
-	cout<<"########################################"<<endl;
-	cout<<"TASK 2: Cloth Simulation"<<endl<<endl;
+IGUIEnabledComputeTask* CAssignment4::CreateTask(const std::string& Name, size_t Size, size_t LocalWorkSize[3])
+{
+	for(size_t i = 0; i < sizeof(c_Tasks) / sizeof(c_Tasks[0]); i++)
+	{
+		if(Name != c_Tasks[i].Name)
+			continue;
+
+		if(Size == 0)
+			Size = c_Tasks[i].Size;
+		if(LocalWorkSize[0] == 0)
+			for(int d = 0; d < 3; d++)
+				LocalWorkSize[d] = c_Tasks[i].LocalWorkSize[d];
+	}
 
-	m_LocalWorkSize[0] = 16;
-	m_LocalWorkSize[1] = 16;
-	m_LocalWorkSize[2] = 1;
-	m_pCurrentTask = new CClothSimulationTask(64, 64);
-#endif
+	if(Name == "particles")
+	{
+		cout<<"########################################"<<endl;
+		cout<<"TASK 1: Particle System"<<endl<<endl;
+
+		std::string meshPath = "../Assignment4/Assets/cubeJump.obj";
+		// Uncomment this to test your application with more triangles!
+		// meshPath = "../Assignment4/Assets/cubeMonkey.obj";
+
+		return new CParticleSystemTask(meshPath, (unsigned int)Size, LocalWorkSize);
+	}
+	else if(Name == "cloth")
+	{
+		cout<<"########################################"<<endl;
+		cout<<"TASK 2: Cloth Simulation"<<endl<<endl;
+
+		return new CClothSimulationTask((unsigned int)Size, (unsigned int)Size);
+	}
 
+	cerr<<"Unknown task: "<<Name<<" (expected particles or cloth)"<<endl;
+	return nullptr;
+}
+
+bool CAssignment4::ParseCommandLine(int argc, char** argv)
+{
+	// the options of the base class are evaluated there
+	vector<char*> baseArgv(1, argv[0]);
+	bool error = false;
+	for(int i = 1; i < argc; i++)
+	{
+		if(m_BenchmarkOptions.ParseOption(argc, argv, i, error))
+			continue;
+
+		if(string(argv[i]) == "--headless")
+			m_Headless = true;
+		else
+			baseArgv.push_back(argv[i]);
+	}
+	if(error)
+		return false;
+
+	for(size_t i = 0; i < m_BenchmarkOptions.Tasks.size(); i++)
+	{
+		bool found = false;
+		for(size_t j = 0; j < sizeof(c_Tasks) / sizeof(c_Tasks[0]); j++)
+			found |= m_BenchmarkOptions.Tasks[i] == c_Tasks[j].Name;
+		if(!found)
+		{
+			cerr<<"Unknown task: "<<m_BenchmarkOptions.Tasks[i]<<" (expected particles or cloth)"<<endl;
+			return false;
+		}
+	}
+
+	if(!m_BenchmarkOptions.Tasks.empty())
+		m_TaskName = m_BenchmarkOptions.Tasks[0];
+
+	return CAssignmentBase::ParseCommandLine((int)baseArgv.size(), &baseArgv[0]);
 }
 
 CAssignment4::~CAssignment4()
@@ -78,11 +161,38 @@ CAssignment4::~CAssignment4()
 bool CAssignment4::EnterMainLoop(int argc, char** argv)
 {
 
+	if(!ParseCommandLine(argc, argv))
+		return false;
+
+	if(m_ListDevices)
+	{
+		ListDevices();
+		return true;
+	}
+
+	bool success = true;
+
 	// create CL context with GL context sharing
-	if(InitGL(argc, argv) && InitCLContext())
+	if(!InitGL(argc, argv) || !InitCLContext())
+	{
+		cerr<<"Failed to create GL and CL context, terminating..."<<endl;
+		success = false;
+	}
+	else if(m_Headless)
+		success = RunHeadless();
+	else
 	{
+		// the first --size and --local are used, 0 selects the defaults of the task
+		const vector<size_t>& localWorkSizes = m_BenchmarkOptions.LocalWorkSizes;
+		for(int d = 0; d < 3; d++)
+			m_LocalWorkSize[d] = localWorkSizes.empty() ? 0 : localWorkSizes[d];
+		m_pCurrentTask = CreateTask(m_TaskName, m_BenchmarkOptions.Sizes.empty() ? 0 : m_BenchmarkOptions.Sizes[0], m_LocalWorkSize);
+
 		if(m_pCurrentTask)
+		{
+			m_pCurrentTask->SetDeviceCaps(&m_DeviceCaps);
 			m_pCurrentTask->InitResources(m_CLDevice, m_CLContext);
+		}
 		
 		// the main event loop...
 		while(!glfwWindowShouldClose(m_Window))
@@ -96,84 +206,123 @@ bool CAssignment4::EnterMainLoop(int argc, char** argv)
 		if(m_pCurrentTask)
 			m_pCurrentTask->ReleaseResources();
 	}
-	else
-	{
-		cerr<<"Failed to create GL and CL context, terminating..."<<endl;
-
-	}
 
 	ReleaseCLContext();
 	CleanupGL();
 
-	return true;
+	WriteTrace();
+
+	return success;
 }
 
-bool CAssignment4::DoCompute()
+bool CAssignment4::RunHeadless()
 {
-	if(m_pCurrentTask)
-		m_pCurrentTask->ComputeGPU(m_CLContext, m_CLCommandQueue, m_LocalWorkSize);
+	char deviceName[256] = "";
+	clGetDeviceInfo(m_CLDevice, CL_DEVICE_NAME, sizeof(deviceName) - 1, deviceName, NULL);
 
-	return true;
-}
+	CBenchmarkTable table;
+	table.SetDevice(deviceName);
 
-#define PRINT_INFO(title, buffer, bufferSize, maxBufferSize, expr) { expr; buffer[bufferSize] = '\0'; std::cout << title << ": " << buffer << std::endl; }
+	// a fixed time step makes the runs comparable
+	const float timeStep = 1.0f / 60.0f;
+	const unsigned int nFrames = m_BenchmarkOptions.Warmup + m_BenchmarkOptions.Repeat;
 
-bool CAssignment4::InitCLContext()
-{
-	// 1. get all platform IDs
+	CBenchmarkRecorder::SetEnabled(true);
 
-	std::vector<cl_platform_id> platformIds;
-	const cl_uint c_MaxPlatforms = 16;
-	platformIds.resize(c_MaxPlatforms);
-	
-	cl_uint countPlatforms;
-	V_RETURN_FALSE_CL(clGetPlatformIDs(c_MaxPlatforms, &platformIds[0], &countPlatforms), "Failed to get CL platform ID");
-	platformIds.resize(countPlatforms);
+	bool success = true;
+	for(size_t t = 0; t < sizeof(c_Tasks) / sizeof(c_Tasks[0]); t++)
+	{
+		const vector<string>& tasks = m_BenchmarkOptions.Tasks;
+		if(!tasks.empty() && find(tasks.begin(), tasks.end(), c_Tasks[t].Name) == tasks.end())
+			continue;
+
+		vector<size_t> sizes = m_BenchmarkOptions.Sizes;
+		if(sizes.empty())
+			sizes.push_back(c_Tasks[t].Size);
+		vector<size_t> localWorkSizes = m_BenchmarkOptions.LocalWorkSizes;
+		if(localWorkSizes.empty())
+			localWorkSizes.assign(c_Tasks[t].LocalWorkSize, c_Tasks[t].LocalWorkSize + 3);
+
+		for(size_t s = 0; s < sizes.size(); s++)
+		{
+			for(size_t l = 0; l + 2 < localWorkSizes.size(); l += 3)
+			{
+				BenchmarkCase c;
+				c.Task = c_Tasks[t].Name;
+				c.Variant = "default";
+				c.Size = sizes[s];
+				for(int d = 0; d < 3; d++)
+					c.LocalWorkSize[d] = m_LocalWorkSize[d] = localWorkSizes[l + d];
+
+				m_pCurrentTask = CreateTask(c.Task, c.Size, m_LocalWorkSize);
+				m_pCurrentTask->SetDeviceCaps(&m_DeviceCaps);
+				c.Transfer = CLUtil::GetTransferPolicyName(m_pCurrentTask->GetTransferPolicy());
+				if(!m_pCurrentTask->InitResources(m_CLDevice, m_CLContext))
+				{
+					cerr<<"Error during resource allocation, skipping the case."<<endl;
+					success = false;
+				}
+				else
+				{
+					vector<CBenchmarkRecorder::Report> reports;
+					vector<double> frameTimes;
+					CTimer timer;
+					for(unsigned int frame = 0; frame < nFrames; frame++)
+					{
+						m_pCurrentTask->OnIdle(frame * timeStep, timeStep);
+
+						clFinish(m_CLCommandQueue);
+						timer.Start();
+						DoCompute();
+						clFinish(m_CLCommandQueue);
+						timer.Stop();
+
+						vector<CBenchmarkRecorder::Report> frameReports;
+						CBenchmarkRecorder::TakeReports(frameReports);
+						if(frame < m_BenchmarkOptions.Warmup)
+							continue;
+
+						frameTimes.push_back(timer.GetElapsedMilliseconds());
+						reports.insert(reports.end(), frameReports.begin(), frameReports.end());
+					}
+
+					size_t elements = 0, bytes = 0;
+					m_pCurrentTask->GetWorkload(elements, bytes);
+
+					// without a reference the rows are marked valid if the frames ran
+					table.Add(c, reports, elements, bytes, true);
+					table.Add(c, "ComputeGPU", elements, bytes, frameTimes, true);
+				}
+
+				m_pCurrentTask->ReleaseResources();
+				delete m_pCurrentTask;
+				m_pCurrentTask = nullptr;
+			}
+		}
+	}
 
-	// 2. find all available GPU devices
-	std::vector<cl_device_id> deviceIds;
-	const int maxDevices = 16;
-	deviceIds.resize(maxDevices);
-	int countAllDevices = 0;
+	CBenchmarkRecorder::SetEnabled(false);
 
+	table.Print();
+	success &= table.Write(m_BenchmarkOptions);
 
-	cl_device_type deviceType = CL_DEVICE_TYPE_GPU;
+	return success;
+}
 
-	for (size_t i = 1; i < platformIds.size(); i++)
-	{
-		// Getting the available devices.
-		cl_uint countDevices;
-		clGetDeviceIDs(platformIds[i], deviceType, 1, &deviceIds[countAllDevices], &countDevices);
-		countAllDevices += countDevices;
-	}
-	deviceIds.resize(countAllDevices);
+bool CAssignment4::DoCompute()
+{
+	if(m_pCurrentTask)
+		m_pCurrentTask->ComputeGPU(m_CLContext, m_CLCommandQueue, m_LocalWorkSize);
 
-	if (countAllDevices == 0)
-	{
-		std::cout << "No device of the selected type with OpenCL support was found.";
+	return true;
+}
+
+bool CAssignment4::InitCLContext()
+{
+	if(!SelectDevice())
 		return false;
-	}
-	// Choosing the first available device.
-	m_CLDevice = deviceIds[0];
-	clGetDeviceInfo(m_CLDevice, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &m_CLPlatform, NULL);
-
-	// Printing platform and device data.
-	const int maxBufferSize = 1024;
-	char buffer[maxBufferSize];
-	size_t bufferSize;
-	std::cout << "OpenCL platform:" << std::endl << std::endl;
-	PRINT_INFO("Name", buffer, bufferSize, maxBufferSize, clGetPlatformInfo(m_CLPlatform, CL_PLATFORM_NAME, maxBufferSize, (void*)buffer, &bufferSize));
-	PRINT_INFO("Vendor", buffer, bufferSize, maxBufferSize, clGetPlatformInfo(m_CLPlatform, CL_PLATFORM_VENDOR, maxBufferSize, (void*)buffer, &bufferSize));
-	PRINT_INFO("Version", buffer, bufferSize, maxBufferSize, clGetPlatformInfo(m_CLPlatform, CL_PLATFORM_VERSION, maxBufferSize, (void*)buffer, &bufferSize));
-	PRINT_INFO("Profile", buffer, bufferSize, maxBufferSize, clGetPlatformInfo(m_CLPlatform, CL_PLATFORM_PROFILE, maxBufferSize, (void*)buffer, &bufferSize));
-	std::cout << std::endl << "Device:" << std::endl << std::endl;
-	PRINT_INFO("Name", buffer, bufferSize, maxBufferSize, clGetDeviceInfo(m_CLDevice, CL_DEVICE_NAME, maxBufferSize, (void*)buffer, &bufferSize));
-	PRINT_INFO("Vendor", buffer, bufferSize, maxBufferSize, clGetDeviceInfo(m_CLDevice, CL_DEVICE_VENDOR, maxBufferSize, (void*)buffer, &bufferSize));
-	PRINT_INFO("Driver version", buffer, bufferSize, maxBufferSize, clGetDeviceInfo(m_CLDevice, CL_DRIVER_VERSION, maxBufferSize, (void*)buffer, &bufferSize));
-	cl_ulong localMemorySize;
-	clGetDeviceInfo(m_CLDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &localMemorySize, &bufferSize);
-	std::cout << "Local memory size: " << localMemorySize << " Byte" << std::endl;
-	std::cout << std::endl << "******************************" << std::endl << std::endl;
+
+	PrintDeviceInfo();
         
 	cl_int clError;
 
@@ -215,9 +364,13 @@ bool CAssignment4::InitCLContext()
 	// from the CPU into this queue. This way the host program can continue the execution until some results
 	// from that device are needed.
 
-	m_CLCommandQueue = clCreateCommandQueue(m_CLContext, m_CLDevice, 0, &clError);
+	m_CLCommandQueue = clCreateCommandQueue(m_CLContext, m_CLDevice, GetCommandQueueProperties(), &clError);
 	V_RETURN_FALSE_CL(clError, "Failed to create the command queue in the context");
 
+	if(!m_DeviceCaps.Query(m_CLDevice, m_CLContext))
+		return false;
+	m_DeviceCaps.Print();
+
 	return true;
 }
 
@@ -226,6 +379,10 @@ bool CAssignment4::InitGL(int , char** )
 	if (!glfwInit())
 		exit(EXIT_FAILURE);
 
+	// the headless benchmark only needs the GL context for the shared buffers
+	if(m_Headless)
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
 	m_Window = glfwCreateWindow(m_WindowWidth, m_WindowHeight, "CL Visual Computing Demo", NULL, NULL);
 	if (!m_Window)
 	{
@@ -23,9 +23,12 @@
 #include "../Common/CAssignmentBase.h"
 #include "../Common/IGUIEnabledComputeTask.h"
 #include "../Common/CTimer.h"
+#include "../Common/CBenchmark.h"
 
 #include "GLCommon.h"
 
+#include <string>
+
 //! Assignment4
 class CAssignment4 : public CAssignmentBase
 {
@@ -60,6 +63,29 @@ protected:
 	// for OpenCL - OpenGL interop
 	virtual bool InitCLContext();
 
+	//! Additional options:
+	/*!
+		--task <name>	particles or cloth (default: chosen in the constructor)
+		--size <n>		number of particles, or the resolution of the cloth
+		--local <x[xy]>	local work size of the task
+		--headless		runs the benchmark instead of the interactive simulation, see RunHeadless()
+
+		In headless mode the other options of CBenchmarkOptions are available, all of them
+		take lists of values then.
+	*/
+	virtual bool ParseCommandLine(int argc, char** argv);
+
+	//! Creates a task with its default size and local work size for Size = 0 and LocalWorkSize[0] = 0
+	IGUIEnabledComputeTask* CreateTask(const std::string& Name, size_t Size, size_t LocalWorkSize[3]);
+
+	//! Simulates --warmup + --repeat frames of every case in a hidden window and reports the times of ComputeGPU()
+	/*!
+		Nothing is rendered and the simulation advances by a fixed time step per frame.
+		The tasks do not have a CPU reference, so the results are not validated.
+		An OpenGL context is still required for the CL-GL interop buffers.
+	*/
+	bool RunHeadless();
+
 	virtual void Render();
 
 	virtual void OnKeyboard(GLFWwindow* pWindow, int Key, int ScanCode, int Action, int Mods);
@@ -78,6 +104,10 @@ protected:
 
 	IGUIEnabledComputeTask*	m_pCurrentTask;
 	size_t			m_LocalWorkSize[3];
+	std::string		m_TaskName;
+
+	bool			m_Headless;
+	CBenchmarkOptions	m_BenchmarkOptions;
 
 	static CAssignment4*	s_pSingletonInstance;
 
@@ -49,6 +49,8 @@ public:
 	virtual void ComputeCPU() {};
 	virtual bool ValidateResults() {return false;};
 
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = size_t(m_ClothResX) * m_ClothResY; Bytes = 0; }
+
 	// IGUIEnabledComputeTask
 	virtual void Render();
 
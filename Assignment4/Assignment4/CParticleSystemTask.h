@@ -54,6 +54,8 @@ public:
 	virtual void ComputeCPU() {};
 	virtual bool ValidateResults() {return false;};
 
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = m_nParticles; Bytes = 0; }
+
 	// IGUIEnabledComputeTask
 	virtual void Render();
 
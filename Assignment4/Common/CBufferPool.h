@@ -0,0 +1,116 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CBUFFER_POOL_H
+#define _CBUFFER_POOL_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+//! Keeps released device buffers, so later allocations of a similar size can reuse them
+/*!
+	Sizes are rounded up to size classes (four per power of two), so a buffer wastes at most
+	25% of its memory. A request is served by the smallest free buffer with the same flags
+	which is at least as large as the rounded size and at most twice as large.
+
+	Released buffers stay allocated on the device until more than GetMaxPooledBytes()
+	are pooled; then the oldest ones are released.
+
+	Pooled buffers are not initialized. The flags must not contain CL_MEM_USE_HOST_PTR or
+	CL_MEM_COPY_HOST_PTR, upload the data with clEnqueueWriteBuffer() instead.
+
+	A buffer can be reused as soon as it is released, so commands using it have to be
+	enqueued before the release and the next user has to be ordered after them
+	(which is the case on an in-order queue).
+*/
+class CBufferPool
+{
+public:
+	struct Statistics
+	{
+		size_t	Hits;
+		size_t	Misses;
+		//! memory of the buffers currently handed out
+		size_t	BytesLive;
+		//! maximum of BytesLive
+		size_t	HighWaterBytes;
+		//! memory of the released buffers kept for reuse
+		size_t	BytesPooled;
+	};
+
+	CBufferPool();
+
+	//! Releases the pooled buffers. Buffers still handed out stay valid.
+	~CBufferPool();
+
+	//! Returns a buffer of at least Size bytes
+	cl_mem Acquire(cl_context Context, cl_mem_flags Flags, size_t Size, cl_int* pError = nullptr);
+
+	//! Returns the buffer to the pool and sets it to nullptr. Buffers not from this pool are released.
+	void Release(cl_mem& Buffer);
+
+	//! Releases all pooled buffers
+	void Clear();
+
+	void SetMaxPooledBytes(size_t MaxBytes);
+
+	size_t GetMaxPooledBytes() const { return m_MaxPooledBytes; }
+
+	Statistics GetStatistics() const;
+
+	void PrintStatistics() const;
+
+	//! The size which is actually allocated for a request of Size bytes
+	static size_t GetSizeClass(size_t Size);
+
+protected:
+	struct Entry
+	{
+		cl_mem			Buffer;
+		cl_mem_flags	Flags;
+		size_t			Size;
+	};
+
+	CBufferPool(const CBufferPool&);
+	CBufferPool& operator=(const CBufferPool&);
+
+	//! Releases the oldest pooled buffers until at most MaxBytes are pooled. The mutex has to be locked.
+	void Trim(size_t MaxBytes);
+
+	mutable std::mutex			m_Mutex;
+	cl_context					m_Context;
+	//! released buffers, oldest first
+	std::vector<Entry>			m_Free;
+	//! buffers handed out
+	std::map<cl_mem, Entry>		m_Live;
+	size_t						m_MaxPooledBytes;
+	Statistics					m_Statistics;
+};
+
+#endif // _CBUFFER_POOL_H
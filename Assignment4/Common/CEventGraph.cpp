@@ -0,0 +1,368 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CEventGraph.h"
+
+#include "CBenchmark.h"
+#include "CLUtil.h"
+#include "CTrace.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CEventGraph
+
+bool CEventGraph::s_OutOfOrderEnabled = false;
+std::mutex CEventGraph::s_QueuesMutex;
+std::map<std::pair<cl_context, cl_device_id>, CEventGraph::QueueSet> CEventGraph::s_Queues;
+
+// number of in-order queues used if the device cannot execute out of order
+static const unsigned int c_NumLanes = 3;
+
+CEventGraph::CEventGraph(cl_command_queue Queue)
+	: CEventGraph(Queue, s_OutOfOrderEnabled)
+{
+}
+
+CEventGraph::CEventGraph(cl_command_queue Queue, bool Concurrent)
+	: m_OutOfOrder(false), m_NextLane(0), m_Error(CL_SUCCESS), m_Finished(false), m_FirstEnqueueTime(0)
+{
+	// the timer is started when the graph is ready, so the waits of the construction are not timed
+	if(!Concurrent)
+	{
+		m_Queues.push_back(Queue);
+		m_Timer.Start();
+		return;
+	}
+
+	cl_context context;
+	cl_device_id device;
+	cl_command_queue_properties properties;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, NULL);
+
+	lock_guard<mutex> lock(s_QueuesMutex);
+	QueueSet& set = s_Queues[make_pair(context, device)];
+	if(set.Queues.empty())
+	{
+		cl_command_queue_properties supported = 0;
+		clGetDeviceInfo(device, CL_DEVICE_QUEUE_PROPERTIES, sizeof(supported), &supported, NULL);
+		set.OutOfOrder = (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+
+		unsigned int numQueues = set.OutOfOrder ? 1 : c_NumLanes;
+		cl_command_queue_properties queueProperties = properties & CL_QUEUE_PROFILING_ENABLE;
+		if(set.OutOfOrder)
+			queueProperties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+
+		for(unsigned int i = 0; i < numQueues; i++)
+		{
+			cl_int clError;
+			cl_command_queue q = clCreateCommandQueue(context, device, queueProperties, &clError);
+			if(clError != CL_SUCCESS)
+			{
+				cerr<<"Failed to create an additional command queue: "<<CLUtil::GetCLErrorString(clError)<<endl;
+				break;
+			}
+			set.Queues.push_back(q);
+		}
+
+		if(set.Queues.empty())
+			cerr<<"Falling back to the in-order queue."<<endl;
+		else if(set.OutOfOrder)
+			cout<<"Using an out-of-order command queue for independent commands."<<endl;
+		else
+			cout<<"Device has no out-of-order queues, using "<<set.Queues.size()<<" in-order queues for independent commands."<<endl;
+	}
+
+	if(set.Queues.empty())
+	{
+		m_Queues.push_back(Queue);
+		m_Timer.Start();
+		return;
+	}
+
+	// the graph runs on other queues, so we have to make sure the commands before are done
+	clFinish(Queue);
+	m_Queues = set.Queues;
+	m_OutOfOrder = set.OutOfOrder;
+	m_Timer.Start();
+}
+
+CEventGraph::~CEventGraph()
+{
+	if(!m_Finished)
+		Finish();
+
+	for(size_t i = 0; i < m_Nodes.size(); i++)
+		if(m_Nodes[i].Event)
+			clReleaseEvent(m_Nodes[i].Event);
+}
+
+void CEventGraph::SetOutOfOrderEnabled(bool Enabled)
+{
+	s_OutOfOrderEnabled = Enabled;
+}
+
+void CEventGraph::ReleaseQueues(cl_context Context)
+{
+	lock_guard<mutex> lock(s_QueuesMutex);
+	for(auto it = s_Queues.begin(); it != s_Queues.end(); )
+	{
+		if(Context == nullptr || it->first.first == Context)
+		{
+			for(size_t i = 0; i < it->second.Queues.size(); i++)
+				clReleaseCommandQueue(it->second.Queues[i]);
+			it = s_Queues.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+unsigned int CEventGraph::SelectLane(const Dependencies& Deps)
+{
+	// a chain stays on one queue, which saves the synchronization between queues
+	for(size_t i = 0; i < Deps.size(); i++)
+		if(Deps[i] >= 0 && Deps[i] < (NodeId)m_Nodes.size())
+			return m_Nodes[Deps[i]].Lane;
+
+	unsigned int lane = m_NextLane;
+	m_NextLane = (m_NextLane + 1) % m_Queues.size();
+	return lane;
+}
+
+bool CEventGraph::GetWaitList(const Dependencies& Deps, std::vector<cl_event>& WaitList) const
+{
+	WaitList.clear();
+	for(size_t i = 0; i < Deps.size(); i++)
+	{
+		if(Deps[i] < 0 || Deps[i] >= (NodeId)m_Nodes.size())
+			return false;
+		WaitList.push_back(m_Nodes[Deps[i]].Event);
+	}
+	return true;
+}
+
+CEventGraph::NodeId CEventGraph::AddNode(cl_int Error, cl_event Event, unsigned int Lane, const std::string& Name)
+{
+	if(Error != CL_SUCCESS)
+	{
+		cerr<<"Failed to enqueue "<<Name<<": "<<CLUtil::GetCLErrorString(Error)<<endl;
+		if(m_Error == CL_SUCCESS)
+			m_Error = Error;
+		return -1;
+	}
+
+	Node node = { Event, Lane, Name, false };
+	m_Nodes.push_back(node);
+	return (NodeId)m_Nodes.size() - 1;
+}
+
+CEventGraph::NodeId CEventGraph::EnqueueWriteBuffer(cl_mem Buffer, size_t Offset, size_t Size, const void* pData,
+	const Dependencies& Deps)
+{
+	vector<cl_event> waitList;
+	if(!GetWaitList(Deps, waitList))
+		return AddNode(CL_INVALID_EVENT_WAIT_LIST, NULL, 0, "WriteBuffer");
+
+	if(m_Nodes.empty())
+		m_FirstEnqueueTime = CTimer::GetTimestamp();
+
+	unsigned int lane = SelectLane(Deps);
+	cl_event event = NULL;
+	cl_int clError = clEnqueueWriteBuffer(m_Queues[lane], Buffer, CL_FALSE, Offset, Size, pData,
+		(cl_uint)waitList.size(), waitList.empty() ? NULL : &waitList[0], &event);
+	return AddNode(clError, event, lane, "WriteBuffer");
+}
+
+CEventGraph::NodeId CEventGraph::EnqueueReadBuffer(cl_mem Buffer, size_t Offset, size_t Size, void* pData,
+	const Dependencies& Deps)
+{
+	vector<cl_event> waitList;
+	if(!GetWaitList(Deps, waitList))
+		return AddNode(CL_INVALID_EVENT_WAIT_LIST, NULL, 0, "ReadBuffer");
+
+	if(m_Nodes.empty())
+		m_FirstEnqueueTime = CTimer::GetTimestamp();
+
+	unsigned int lane = SelectLane(Deps);
+	cl_event event = NULL;
+	cl_int clError = clEnqueueReadBuffer(m_Queues[lane], Buffer, CL_FALSE, Offset, Size, pData,
+		(cl_uint)waitList.size(), waitList.empty() ? NULL : &waitList[0], &event);
+	return AddNode(clError, event, lane, "ReadBuffer");
+}
+
+CEventGraph::NodeId CEventGraph::EnqueueKernel(cl_kernel Kernel, cl_uint Dimensions, const size_t* pGlobalWorkSize,
+	const size_t* pLocalWorkSize, const Dependencies& Deps)
+{
+	char name[256] = "";
+	clGetKernelInfo(Kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name) - 1, name, NULL);
+
+	vector<cl_event> waitList;
+	if(!GetWaitList(Deps, waitList))
+		return AddNode(CL_INVALID_EVENT_WAIT_LIST, NULL, 0, name);
+
+	if(m_Nodes.empty())
+		m_FirstEnqueueTime = CTimer::GetTimestamp();
+
+	unsigned int lane = SelectLane(Deps);
+	cl_event event = NULL;
+	cl_int clError = clEnqueueNDRangeKernel(m_Queues[lane], Kernel, Dimensions, NULL, pGlobalWorkSize, pLocalWorkSize,
+		(cl_uint)waitList.size(), waitList.empty() ? NULL : &waitList[0], &event);
+	NodeId node = AddNode(clError, event, lane, name);
+	if(node >= 0)
+		m_Nodes[node].IsKernel = true;
+	return node;
+}
+
+cl_int CEventGraph::Finish()
+{
+	for(size_t i = 0; i < m_Queues.size(); i++)
+	{
+		cl_int clError = clFinish(m_Queues[i]);
+		if(clError != CL_SUCCESS && m_Error == CL_SUCCESS)
+			m_Error = clError;
+	}
+	m_Timer.Stop();
+	m_Finished = true;
+
+	// put the device execution of the nodes on the trace timeline
+	if(CTraceRecorder::IsEnabled() && !m_Nodes.empty())
+	{
+		cl_ulong queued;
+		if(clGetEventProfilingInfo(m_Nodes[0].Event, CL_PROFILING_COMMAND_QUEUED, sizeof(queued), &queued, NULL) == CL_SUCCESS)
+		{
+			long long deviceToHost = (long long)m_FirstEnqueueTime - (long long)queued;
+			for(size_t i = 0; i < m_Nodes.size(); i++)
+				CTraceRecorder::RecordDeviceEvent(m_Nodes[i].Name, m_Nodes[i].Event, deviceToHost);
+		}
+	}
+
+	return m_Error;
+}
+
+cl_event CEventGraph::GetEvent(NodeId Node) const
+{
+	if(Node < 0 || Node >= (NodeId)m_Nodes.size())
+		return NULL;
+	return m_Nodes[Node].Event;
+}
+
+double CEventGraph::GetElapsedMilliseconds() const
+{
+	CTimer timer = m_Timer;
+	if(!m_Finished)
+		timer.Stop();
+	return timer.GetElapsedMilliseconds();
+}
+
+double CEventGraph::GetCommandMilliseconds() const
+{
+	double sum = 0;
+	for(size_t i = 0; i < m_Nodes.size(); i++)
+	{
+		cl_ulong start, end;
+		cl_int clError;
+		clError  = clGetEventProfilingInfo(m_Nodes[i].Event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+		clError |= clGetEventProfilingInfo(m_Nodes[i].Event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+		if(clError != CL_SUCCESS)
+			return -1;
+		sum += 1.0e-6 * double(end - start);
+	}
+	return sum;
+}
+
+double CEventGraph::GetDeviceMilliseconds() const
+{
+	if(m_Nodes.empty())
+		return 0;
+
+	// all queues of the graph are on the same device, so their timestamps can be compared
+	cl_ulong first = ~cl_ulong(0), last = 0;
+	for(size_t i = 0; i < m_Nodes.size(); i++)
+	{
+		cl_ulong start, end;
+		cl_int clError;
+		clError  = clGetEventProfilingInfo(m_Nodes[i].Event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+		clError |= clGetEventProfilingInfo(m_Nodes[i].Event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+		if(clError != CL_SUCCESS)
+			return -1;
+		first = min(first, start);
+		last = max(last, end);
+	}
+	return 1.0e-6 * double(last - first);
+}
+
+double CEventGraph::GetRunMilliseconds() const
+{
+	double ms = GetDeviceMilliseconds();
+	return ms >= 0 ? ms : GetElapsedMilliseconds();
+}
+
+void CEventGraph::PrintSummary(const std::string& Title) const
+{
+	double elapsed = GetElapsedMilliseconds();
+	double commands = GetCommandMilliseconds();
+
+	cout<<Title<<": "<<m_Nodes.size()<<" commands in "<<elapsed<<" ms";
+	if(commands >= 0)
+		cout<<", "<<commands<<" ms of command execution ("<<commands / elapsed<<"x overlap)";
+	if(m_Queues.size() > 1)
+		cout<<", "<<m_Queues.size()<<" queues";
+	else if(m_OutOfOrder)
+		cout<<", out-of-order queue";
+	cout<<endl;
+}
+
+void CEventGraph::PrintKernelProfiles() const
+{
+	// the kernels in the order of their first launch, with the samples of all their launches
+	vector<CLUtil::KernelProfile> profiles;
+	vector<vector<double> > queuedToSubmit, submitToStart, startToEnd;
+	for(size_t i = 0; i < m_Nodes.size(); i++)
+	{
+		if(!m_Nodes[i].IsKernel)
+			continue;
+
+		cl_ulong queued, submit, start, end;
+		if(CLUtil::GetEventTimes(m_Nodes[i].Event, queued, submit, start, end) != CL_SUCCESS)
+			return;
+
+		size_t k = 0;
+		while(k < profiles.size() && profiles[k].KernelName != m_Nodes[i].Name)
+			k++;
+		if(k == profiles.size())
+		{
+			CLUtil::KernelProfile profile;
+			profile.KernelName = m_Nodes[i].Name;
+			profile.NIterations = 0;
+			profiles.push_back(profile);
+			queuedToSubmit.resize(k + 1);
+			submitToStart.resize(k + 1);
+			startToEnd.resize(k + 1);
+		}
+		profiles[k].NIterations++;
+		// nanoseconds to milliseconds
+		queuedToSubmit[k].push_back(1.0e-6 * double(submit - queued));
+		submitToStart[k].push_back(1.0e-6 * double(start - submit));
+		startToEnd[k].push_back(1.0e-6 * double(end - start));
+	}
+
+	for(size_t k = 0; k < profiles.size(); k++)
+	{
+		profiles[k].QueuedToSubmit = CLUtil::ComputeLatencyStats(queuedToSubmit[k]);
+		profiles[k].SubmitToStart = CLUtil::ComputeLatencyStats(submitToStart[k]);
+		profiles[k].StartToEnd = CLUtil::ComputeLatencyStats(startToEnd[k]);
+		CLUtil::PrintKernelProfile(profiles[k]);
+		CBenchmarkRecorder::ReportTime(profiles[k].KernelName, profiles[k].StartToEnd.Mean);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
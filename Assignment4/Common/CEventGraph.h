@@ -0,0 +1,168 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CEVENT_GRAPH_H
+#define _CEVENT_GRAPH_H
+
+// All OpenCL headers
+#if defined(WIN32)
+    #include <CL/opencl.h>
+#elif defined (__APPLE__) || defined(MACOSX)
+    #include <OpenCL/opencl.h>
+#else
+    #include <CL/cl.h>
+#endif 
+
+#include "CTimer.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! Enqueues transfers and kernels with explicit dependencies, so that independent chains can overlap
+/*!
+	Every enqueued command is a node of the graph. A command only waits for the nodes listed
+	as its dependencies, not for everything that was enqueued before.
+
+	By default the commands go into the in-order queue passed to the constructor, which
+	executes them one after another as before. If the out-of-order mode is enabled
+	(see the --out-of-order option of CAssignmentBase) the graph uses an out-of-order queue
+	on the same device, or several in-order queues if the device does not support
+	out-of-order execution.
+
+	Usage:
+	CEventGraph graph(CommandQueue);
+	CEventGraph::NodeId kernel = graph.EnqueueKernel(Kernel, 2, globalWorkSize, localWorkSize);
+	graph.EnqueueReadBuffer(Buffer, 0, size, pHostData, { kernel });
+	V_RETURN_CL(graph.Finish(), "...");
+
+	Kernel arguments are captured when the kernel is enqueued, so a kernel object can be
+	enqueued several times with different arguments.
+*/
+class CEventGraph
+{
+public:
+	typedef int NodeId;
+	typedef std::vector<NodeId> Dependencies;
+
+	//! Waits for the commands already in Queue, so they are done before any node of the graph starts
+	CEventGraph(cl_command_queue Queue);
+
+	//! Uses the additional queues if Concurrent is set, independent of SetOutOfOrderEnabled()
+	/*!
+		For tasks which are built around overlapping commands, e.g. streaming transfers
+		which should run while the previous chunk is computed.
+	*/
+	CEventGraph(cl_command_queue Queue, bool Concurrent);
+
+	//! Waits for all nodes
+	~CEventGraph();
+
+	static void SetOutOfOrderEnabled(bool Enabled);
+
+	static bool IsOutOfOrderEnabled() { return s_OutOfOrderEnabled; }
+
+	//! Releases the additional queues created for the out-of-order mode (of all contexts if nullptr)
+	static void ReleaseQueues(cl_context Context = nullptr);
+
+	//! All Enqueue methods return the new node, or -1 on failure (see Finish())
+	NodeId EnqueueWriteBuffer(cl_mem Buffer, size_t Offset, size_t Size, const void* pData,
+		const Dependencies& Deps = Dependencies());
+
+	NodeId EnqueueReadBuffer(cl_mem Buffer, size_t Offset, size_t Size, void* pData,
+		const Dependencies& Deps = Dependencies());
+
+	NodeId EnqueueKernel(cl_kernel Kernel, cl_uint Dimensions, const size_t* pGlobalWorkSize, const size_t* pLocalWorkSize,
+		const Dependencies& Deps = Dependencies());
+
+	//! Waits for all nodes. Returns the first error of an Enqueue method or of the wait.
+	cl_int Finish();
+
+	cl_event GetEvent(NodeId Node) const;
+
+	//! Host time from the construction of the graph until Finish() returned
+	/*!
+		Starts after the constructor waited for the commands enqueued before the graph,
+		but includes enqueueing the nodes.
+	*/
+	double GetElapsedMilliseconds() const;
+
+	//! Device time from the start of the first node to the end of the last one, or -1 if the queue does not record profiling information
+	double GetDeviceMilliseconds() const;
+
+	//! GetDeviceMilliseconds() if available, otherwise GetElapsedMilliseconds()
+	double GetRunMilliseconds() const;
+
+	//! Sum of the execution times of all nodes, or -1 if the queue does not record profiling information
+	double GetCommandMilliseconds() const;
+
+	//! Prints the wall-clock and the summed command time of the graph, which shows how much the commands overlapped
+	void PrintSummary(const std::string& Title) const;
+
+	//! Prints the launch time distribution of each kernel of the graph, like CLUtil::ProfileKernel()
+	/*!
+		Also reports the mean execution time of each kernel to CBenchmarkRecorder.
+		Does nothing if the queue does not record profiling information.
+	*/
+	void PrintKernelProfiles() const;
+
+protected:
+	struct Node
+	{
+		cl_event		Event;
+		unsigned int	Lane;
+		std::string		Name;
+		bool			IsKernel;
+	};
+
+	struct QueueSet
+	{
+		std::vector<cl_command_queue>	Queues;
+		bool							OutOfOrder;
+	};
+
+	CEventGraph(const CEventGraph&);
+	CEventGraph& operator=(const CEventGraph&);
+
+	//! Chooses the queue for a new node: the lane of its first dependency, or the next lane
+	unsigned int SelectLane(const Dependencies& Deps);
+
+	//! Builds the event wait list. Returns false if a dependency failed to enqueue.
+	bool GetWaitList(const Dependencies& Deps, std::vector<cl_event>& WaitList) const;
+
+	NodeId AddNode(cl_int Error, cl_event Event, unsigned int Lane, const std::string& Name);
+
+	std::vector<cl_command_queue>	m_Queues;
+	bool				m_OutOfOrder;
+	unsigned int		m_NextLane;
+	std::vector<Node>	m_Nodes;
+	cl_int				m_Error;
+	bool				m_Finished;
+	CTimer				m_Timer;
+	//! host time of the first enqueue, used to place the device events on the trace timeline
+	unsigned long long	m_FirstEnqueueTime;
+
+	static bool			s_OutOfOrderEnabled;
+	static std::mutex	s_QueuesMutex;
+	static std::map<std::pair<cl_context, cl_device_id>, QueueSet>	s_Queues;
+};
+
+#endif // _CEVENT_GRAPH_H
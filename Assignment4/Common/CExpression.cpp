@@ -0,0 +1,173 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CExpression.h"
+
+#include "CLUtil.h"
+
+#include <iostream>
+#include <sstream>
+#include <string.h>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// CExpressionBuilder
+
+std::mutex CExpressionBuilder::s_KernelsMutex;
+std::map<std::pair<cl_context, std::string>, cl_kernel> CExpressionBuilder::s_Kernels;
+static const bool s_ReleaseHookRegistered = CLUtil::RegisterReleaseHook(&CExpressionBuilder::ReleaseKernels);
+
+CExpressionBuilder::CExpressionBuilder(size_t Size)
+	: m_Size(Size), m_SizeMismatch(false)
+{
+}
+
+string CExpressionBuilder::ReadBuffer(cl_mem Buffer, size_t Size, const char* TypeName, const string& Index)
+{
+	if(Size != m_Size)
+		m_SizeMismatch = true;
+
+	bool shifted = (Index != GetIndex());
+
+	// an array used several times is passed once
+	size_t p = 0;
+	for(; p < m_Parameters.size(); p++)
+	{
+		if(m_Parameters[p].Buffer == Buffer)
+			break;
+	}
+
+	ostringstream name;
+	name << "a" << p;
+
+	if(p == m_Parameters.size())
+	{
+		Parameter param;
+		param.Declaration = string("__global const ") + TypeName + "* " + name.str();
+		param.Buffer = Buffer;
+		param.Shifted = shifted;
+		m_Parameters.push_back(param);
+	}
+	else
+		m_Parameters[p].Shifted |= shifted;
+
+	return name.str() + "[" + Index + "]";
+}
+
+string CExpressionBuilder::AddScalar(const void* pValue, size_t ValueSize, const char* TypeName)
+{
+	ostringstream name;
+	name << "s" << m_Parameters.size();
+
+	Parameter param;
+	param.Declaration = string(TypeName) + " " + name.str();
+	param.Buffer = nullptr;
+	param.Shifted = false;
+	param.Value.assign((const unsigned char*)pValue, (const unsigned char*)pValue + ValueSize);
+	m_Parameters.push_back(param);
+
+	return name.str();
+}
+
+string CExpressionBuilder::GetSource(const char* TypeName, const string& Code) const
+{
+	ostringstream source;
+	source << "__kernel void FusedExpression(__global " << TypeName << "* out, uint " << GetSize();
+	for(size_t p = 0; p < m_Parameters.size(); p++)
+		source << ", " << m_Parameters[p].Declaration;
+	source << ")\n{\n";
+	source << "\tuint " << GetIndex() << " = get_global_id(0);\n";
+	source << "\tif(" << GetIndex() << " >= " << GetSize() << ") return;\n";
+	source << "\tout[" << GetIndex() << "] = " << Code << ";\n";
+	source << "}\n";
+	return source.str();
+}
+
+cl_kernel CExpressionBuilder::PrepareKernel(cl_command_queue Queue, cl_mem Target, const char* TypeName, const string& Code)
+{
+	if(m_SizeMismatch)
+	{
+		cerr<<"Error: all arrays of an expression must have the size of the target."<<endl;
+		return nullptr;
+	}
+	for(size_t p = 0; p < m_Parameters.size(); p++)
+	{
+		// other work-items could overwrite the element before it is read
+		if(m_Parameters[p].Buffer == Target && m_Parameters[p].Shifted)
+		{
+			cerr<<"Error: the target of an expression can only be read at the element which is written."<<endl;
+			return nullptr;
+		}
+	}
+
+	cl_context context;
+	cl_device_id device;
+	clGetCommandQueueInfo(Queue, CL_QUEUE_CONTEXT, sizeof(context), &context, NULL);
+	clGetCommandQueueInfo(Queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+
+	string source = GetSource(TypeName, Code);
+
+	cl_kernel kernel;
+	{
+		lock_guard<mutex> lock(s_KernelsMutex);
+		cl_kernel& cached = s_Kernels[make_pair(context, source)];
+		if(cached == nullptr)
+		{
+			cl_program program = CLUtil::BuildCLProgramFromMemory(device, context, source);
+			if(program == nullptr)
+				return nullptr;
+
+			cl_int clError;
+			cached = clCreateKernel(program, "FusedExpression", &clError);
+			// the kernel keeps the program alive
+			clReleaseProgram(program);
+			V_RETURN_0_CL(clError, "Failed to create kernel: FusedExpression");
+		}
+		kernel = cached;
+	}
+
+	cl_uint size = (cl_uint)m_Size;
+	cl_int clError = clSetKernelArg(kernel, 0, sizeof(cl_mem), &Target);
+	clError |= clSetKernelArg(kernel, 1, sizeof(cl_uint), &size);
+	for(size_t p = 0; p < m_Parameters.size(); p++)
+	{
+		const Parameter& param = m_Parameters[p];
+		if(param.Buffer != nullptr)
+			clError |= clSetKernelArg(kernel, cl_uint(p + 2), sizeof(cl_mem), &param.Buffer);
+		else
+			clError |= clSetKernelArg(kernel, cl_uint(p + 2), param.Value.size(), param.Value.data());
+	}
+	V_RETURN_0_CL(clError, "Failed to set kernel args: FusedExpression");
+
+	return kernel;
+}
+
+cl_int CExpressionBuilder::EnqueueKernel(cl_command_queue Queue, cl_kernel Kernel, size_t LocalWorkSize) const
+{
+	if(LocalWorkSize == 0)
+		return clEnqueueNDRangeKernel(Queue, Kernel, 1, NULL, &m_Size, NULL, 0, NULL, NULL);
+
+	size_t globalWorkSize = CLUtil::GetGlobalWorkSize(m_Size, LocalWorkSize);
+	return clEnqueueNDRangeKernel(Queue, Kernel, 1, NULL, &globalWorkSize, &LocalWorkSize, 0, NULL, NULL);
+}
+
+void CExpressionBuilder::ReleaseKernels(cl_context Context)
+{
+	lock_guard<mutex> lock(s_KernelsMutex);
+	for(auto it = s_Kernels.begin(); it != s_Kernels.end(); )
+	{
+		if(Context == nullptr || it->first.first == Context)
+		{
+			if(it->second != nullptr)
+				clReleaseKernel(it->second);
+			it = s_Kernels.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,175 @@
+/******************************************************************************
+GPU Computing / GPGPU Praktikum source code.
+
+******************************************************************************/
+
+#include "CHostMatrix.h"
+
+#include "CThreadPool.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define HOST_MATRIX_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define HOST_MATRIX_SSE
+#endif
+
+using namespace std;
+
+// one tile of the input and one of the output (32 x 32 floats each) fit into the L1 cache
+static const size_t c_TileSize = 32;
+
+#if defined(HOST_MATRIX_AVX)
+
+static const size_t c_BlockSize = 8;
+
+// transposes the 8x8 block at pIn into pOut, with Reverse the rows of the result are mirrored
+static inline void TransposeBlock(const float* pIn, size_t InPitch, float* pOut, size_t OutPitch, bool Reverse)
+{
+	__m256 r0 = _mm256_loadu_ps(pIn + 0 * InPitch);
+	__m256 r1 = _mm256_loadu_ps(pIn + 1 * InPitch);
+	__m256 r2 = _mm256_loadu_ps(pIn + 2 * InPitch);
+	__m256 r3 = _mm256_loadu_ps(pIn + 3 * InPitch);
+	__m256 r4 = _mm256_loadu_ps(pIn + 4 * InPitch);
+	__m256 r5 = _mm256_loadu_ps(pIn + 5 * InPitch);
+	__m256 r6 = _mm256_loadu_ps(pIn + 6 * InPitch);
+	__m256 r7 = _mm256_loadu_ps(pIn + 7 * InPitch);
+
+	// interleave pairs of rows, then pairs of pairs, then swap the 128 bit halves
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+	__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+	__m256 t4 = _mm256_unpacklo_ps(r4, r5);
+	__m256 t5 = _mm256_unpackhi_ps(r4, r5);
+	__m256 t6 = _mm256_unpacklo_ps(r6, r7);
+	__m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	__m256 c[8];
+	c[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	c[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	c[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	c[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	c[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	c[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	c[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	c[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+
+	for(size_t i = 0; i < 8; i++)
+	{
+		if(Reverse)
+		{
+			c[i] = _mm256_permute2f128_ps(c[i], c[i], 0x01);
+			c[i] = _mm256_permute_ps(c[i], _MM_SHUFFLE(0, 1, 2, 3));
+		}
+		_mm256_storeu_ps(pOut + i * OutPitch, c[i]);
+	}
+}
+
+#elif defined(HOST_MATRIX_SSE)
+
+static const size_t c_BlockSize = 4;
+
+// transposes the 4x4 block at pIn into pOut, with Reverse the rows of the result are mirrored
+static inline void TransposeBlock(const float* pIn, size_t InPitch, float* pOut, size_t OutPitch, bool Reverse)
+{
+	__m128 r0 = _mm_loadu_ps(pIn + 0 * InPitch);
+	__m128 r1 = _mm_loadu_ps(pIn + 1 * InPitch);
+	__m128 r2 = _mm_loadu_ps(pIn + 2 * InPitch);
+	__m128 r3 = _mm_loadu_ps(pIn + 3 * InPitch);
+
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+	if(Reverse)
+	{
+		r0 = _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(0, 1, 2, 3));
+		r1 = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(0, 1, 2, 3));
+		r2 = _mm_shuffle_ps(r2, r2, _MM_SHUFFLE(0, 1, 2, 3));
+		r3 = _mm_shuffle_ps(r3, r3, _MM_SHUFFLE(0, 1, 2, 3));
+	}
+
+	_mm_storeu_ps(pOut + 0 * OutPitch, r0);
+	_mm_storeu_ps(pOut + 1 * OutPitch, r1);
+	_mm_storeu_ps(pOut + 2 * OutPitch, r2);
+	_mm_storeu_ps(pOut + 3 * OutPitch, r3);
+}
+
+#endif
+
+// moves the elements [X0, X1) x [Y0, Y1) one by one
+static inline void TransposeScalar(const float* pIn, float* pOut, size_t SizeX, size_t SizeY,
+	size_t X0, size_t X1, size_t Y0, size_t Y1, bool Reverse)
+{
+	for(size_t y = Y0; y < Y1; y++)
+	{
+		size_t outY = Reverse ? SizeY - 1 - y : y;
+		for(size_t x = X0; x < X1; x++)
+			pOut[x * SizeY + outY] = pIn[y * SizeX + x];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CHostMatrix
+
+void CHostMatrix::Transpose(const float* pIn, float* pOut, size_t SizeX, size_t SizeY)
+{
+	TransposeBlocked(pIn, pOut, SizeX, SizeY, false);
+}
+
+void CHostMatrix::RotateClockwise(const float* pIn, float* pOut, size_t SizeX, size_t SizeY)
+{
+	TransposeBlocked(pIn, pOut, SizeX, SizeY, true);
+}
+
+const char* CHostMatrix::GetInstructionSet()
+{
+#if defined(HOST_MATRIX_AVX)
+	return "AVX";
+#elif defined(HOST_MATRIX_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+void CHostMatrix::TransposeBlocked(const float* pIn, float* pOut, size_t SizeX, size_t SizeY, bool Reverse)
+{
+	size_t nTileRows = (SizeY + c_TileSize - 1) / c_TileSize;
+
+	// every task handles whole rows of tiles, so the threads write disjoint columns of pOut
+	CThreadPool::Get().ParallelFor(0, nTileRows, 1, [&](size_t Begin, size_t End) {
+		for(size_t tileY = Begin * c_TileSize; tileY < End * c_TileSize && tileY < SizeY; tileY += c_TileSize)
+		{
+			size_t endY = tileY + c_TileSize < SizeY ? tileY + c_TileSize : SizeY;
+			for(size_t tileX = 0; tileX < SizeX; tileX += c_TileSize)
+			{
+				size_t endX = tileX + c_TileSize < SizeX ? tileX + c_TileSize : SizeX;
+				size_t y = tileY;
+#if defined(HOST_MATRIX_AVX) || defined(HOST_MATRIX_SSE)
+				for(; y + c_BlockSize <= endY; y += c_BlockSize)
+				{
+					// the block rows y .. y + c_BlockSize - 1 end up in these columns of pOut
+					size_t outY = Reverse ? SizeY - y - c_BlockSize : y;
+					size_t x = tileX;
+					for(; x + c_BlockSize <= endX; x += c_BlockSize)
+						TransposeBlock(pIn + y * SizeX + x, SizeX, pOut + x * SizeY + outY, SizeY, Reverse);
+					TransposeScalar(pIn, pOut, SizeX, SizeY, x, endX, y, y + c_BlockSize, Reverse);
+				}
+#endif
+				TransposeScalar(pIn, pOut, SizeX, SizeY, tileX, endX, y, endY, Reverse);
+			}
+		}
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
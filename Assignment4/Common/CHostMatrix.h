@@ -0,0 +1,52 @@
+/******************************************************************************
+                         .88888.   888888ba  dP     dP 
+                        d8'   `88  88    `8b 88     88 
+                        88        a88aaaa8P' 88     88 
+                        88   YP88  88        88     88 
+                        Y8.   .88  88        Y8.   .8P 
+                         `88888'   dP        `Y88888P' 
+                                                       
+                                                       
+   a88888b.                                         dP   oo                   
+  d8'   `88                                         88                        
+  88        .d8888b. 88d8b.d8b. 88d888b. dP    dP d8888P dP 88d888b. .d8888b. 
+  88        88'  `88 88'`88'`88 88'  `88 88    88   88   88 88'  `88 88'  `88 
+  Y8.   .88 88.  .88 88  88  88 88.  .88 88.  .88   88   88 88    88 88.  .88 
+   Y88888P' `88888P' dP  dP  dP 88Y888P' `88888P'   dP   dP dP    dP `8888P88 
+                                88                                        .88 
+                                dP                                    d8888P  
+******************************************************************************/
+
+#ifndef _CHOST_MATRIX_H
+#define _CHOST_MATRIX_H
+
+#include <cstddef>
+
+//! Cache-blocked transposes and rotations of float matrices on the host
+/*!
+	Used by the CPU reference implementations and as CPU fallback. The matrix is processed
+	in tiles which fit into the L1 cache, the tiles are distributed over CThreadPool.
+	Within a tile, blocks of 8x8 (AVX) or 4x4 (SSE) elements are transposed in registers,
+	so every load and store moves a whole row of a block. Without SIMD support
+	(or at the edges of the matrix) the elements are moved one by one.
+
+	The AVX path is only compiled if the compiler targets AVX (e.g. -mavx, /arch:AVX).
+*/
+class CHostMatrix
+{
+public:
+	//! pOut[x * SizeY + y] = pIn[y * SizeX + x], pOut has SizeX rows of SizeY elements
+	static void Transpose(const float* pIn, float* pOut, size_t SizeX, size_t SizeY);
+
+	//! pOut[x * SizeY + (SizeY - 1 - y)] = pIn[y * SizeX + x], the clockwise rotation of MatrixRot.cl
+	static void RotateClockwise(const float* pIn, float* pOut, size_t SizeX, size_t SizeY);
+
+	//! "AVX", "SSE" or "scalar"
+	static const char* GetInstructionSet();
+
+protected:
+	//! Transposes, with Reverse the rows of pOut are mirrored (which is the clockwise rotation)
+	static void TransposeBlocked(const float* pIn, float* pOut, size_t SizeX, size_t SizeY, bool Reverse);
+};
+
+#endif // _CHOST_MATRIX_H
@@ -17,3 +17,20 @@
                                 dP                                    d8888P  
 ******************************************************************************/
 
+#ifndef _COMMON_DEFS_H
+#define _COMMON_DEFS_H
+
+//! How the host arrays of a compute task get to the device and back
+enum ETransferPolicy
+{
+	//! use the policy of the assignment (--transfer)
+	TRANSFER_DEFAULT,
+	//! separate device buffers, filled and read with clEnqueueWriteBuffer() / clEnqueueReadBuffer()
+	TRANSFER_COPY,
+	//! the buffers use the host arrays (CL_MEM_USE_HOST_PTR) and are synchronized by mapping them
+	TRANSFER_ZERO_COPY,
+	//! zero-copy on CPU devices and devices sharing the host memory, copy otherwise
+	TRANSFER_AUTO
+};
+
+#endif // _COMMON_DEFS_H
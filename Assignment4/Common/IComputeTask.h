@@ -30,6 +30,9 @@
 #endif 
 
 #include "CommonDefs.h"
+#include "CBufferPool.h"
+#include "CAutoTuner.h"
+#include "CDeviceCaps.h"
 
 //! Common interface for the tasks within the assignment.
 /*!
@@ -56,6 +59,83 @@ public:
 
 	//! Compare the GPU solution to the "golden" solution
 	virtual bool ValidateResults() = 0;
+
+	//! Number of elements processed and bytes moved by one execution of the task's kernels
+	/*!
+		Used by the benchmark runner (see CBenchmark.h) to compute the throughput.
+		Tasks which do not overload this report no throughput.
+	*/
+	virtual void GetWorkload(size_t& Elements, size_t& Bytes) const { Elements = 0; Bytes = 0; }
+
+	//! Buffers of CreateBuffer() are taken from this pool (set by CAssignmentBase::RunComputeTask())
+	void SetBufferPool(CBufferPool* pPool) { m_pBufferPool = pPool; }
+
+	//! Selects how host arrays are transferred, see CreateHostBuffer(). Set it before InitResources().
+	void SetTransferPolicy(ETransferPolicy Policy) { m_TransferPolicy = Policy; }
+
+	ETransferPolicy GetTransferPolicy() const { return m_TransferPolicy; }
+
+	//! Used by TuneLocalWorkSize() (set by CAssignmentBase::PrepareTask())
+	void SetAutoTuner(CAutoTuner* pTuner) { m_pAutoTuner = pTuner; }
+
+	//! Capabilities of the device the task runs on (set by CAssignmentBase::PrepareTask())
+	void SetDeviceCaps(const CDeviceCaps* pCaps) { m_pDeviceCaps = pCaps; }
+
+	//! Returns the defaults of CDeviceCaps if no capabilities were set
+	const CDeviceCaps& GetDeviceCaps() const
+	{
+		static const CDeviceCaps defaultCaps;
+		return m_pDeviceCaps ? *m_pDeviceCaps : defaultCaps;
+	}
+
+protected:
+	//! Creates a device buffer without host data, reusing a pooled one if there is a pool
+	cl_mem CreateBuffer(cl_context Context, cl_mem_flags Flags, size_t Size, cl_int* pError)
+	{
+		if(m_pBufferPool)
+			return m_pBufferPool->Acquire(Context, Flags, Size, pError);
+		return clCreateBuffer(Context, Flags, Size, NULL, pError);
+	}
+
+	//! Creates the device buffer for a host array of Size bytes, according to the transfer policy
+	/*!
+		With TRANSFER_ZERO_COPY the buffer uses pHostArray as its memory. The array has to be allocated
+		with CLUtil::AllocHostArray() and must stay valid until the buffer is released.
+		Transfer the data with CLUtil::UploadBuffer() and CLUtil::DownloadBuffer().
+	*/
+	cl_mem CreateHostBuffer(cl_context Context, cl_mem_flags Flags, size_t Size, void* pHostArray, cl_int* pError)
+	{
+		if(m_TransferPolicy == TRANSFER_ZERO_COPY)
+			return clCreateBuffer(Context, Flags | CL_MEM_USE_HOST_PTR, Size, pHostArray, pError);
+		return CreateBuffer(Context, Flags, Size, pError);
+	}
+
+	//! Releases a buffer of CreateBuffer() and sets it to nullptr
+	void ReleaseBuffer(cl_mem& Buffer)
+	{
+		if(m_pBufferPool)
+			m_pBufferPool->Release(Buffer);
+		else if(Buffer)
+		{
+			clReleaseMemObject(Buffer);
+			Buffer = nullptr;
+		}
+	}
+
+	//! Sets LocalWorkSize to the tuned shape of a kernel, call it in InitResources() after setting the kernel arguments
+	/*!
+		Returns false and leaves LocalWorkSize unchanged if tuning is disabled, then the
+		local work size given to ComputeGPU() should be used.
+	*/
+	bool TuneLocalWorkSize(const CAutoTuner::Request& R, size_t LocalWorkSize[3])
+	{
+		return m_pAutoTuner && m_pAutoTuner->GetLocalWorkSize(R, LocalWorkSize);
+	}
+
+	CBufferPool*	m_pBufferPool = nullptr;
+	ETransferPolicy	m_TransferPolicy = TRANSFER_DEFAULT;
+	CAutoTuner*		m_pAutoTuner = nullptr;
+	const CDeviceCaps*	m_pDeviceCaps = nullptr;
 };
 
 #endif // _ICOMPUTE_TASK_H